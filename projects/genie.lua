@@ -19,6 +19,8 @@ end
 local ROOT_DIR = path.getabsolute("../")
 local BINARY_DIR = LOCATION .. "/bin/"
 build_app = false
+build_bench = false
+build_tests = false
 local use_basisu = false
 build_studio = true
 local working_dir = nil
@@ -60,6 +62,16 @@ function linkPlugin(plugin_name)
 		project "app"
 			links {plugin_name}
 	end
+
+	if build_bench then
+		project "bench"
+			links {plugin_name}
+	end
+
+	if build_tests then
+		project "tests"
+			links {plugin_name}
+	end
 end
 
 newoption {
@@ -122,6 +134,16 @@ newoption {
 	description = "Do build app."
 }
 
+newoption {
+	trigger = "with-bench",
+	description = "Do build benchmarks."
+}
+
+newoption {
+	trigger = "with-tests",
+	description = "Do build tests."
+}
+
 newoption {
 	trigger = "with-basis-universal",
 	description = "Use basis universal compression."
@@ -152,6 +174,11 @@ newoption {
 	description = "Do not build Studio."
 }
 
+newoption {
+	trigger = "avx2",
+	description = "Use AVX2 and FMA instructions (8-wide SIMD in engine/simd.h)."
+}
+
 if _OPTIONS["plugins"] then
 	plugins = string.explode( _OPTIONS["plugins"], ",")
 end
@@ -216,6 +243,14 @@ if _OPTIONS["with-app"] then
 	build_app = true
 end
 
+if _OPTIONS["with-bench"] then
+	build_bench = true
+end
+
+if _OPTIONS["with-tests"] then
+	build_tests = true
+end
+
 if _OPTIONS["with-basis-universal"] then
 	use_basisu = true
 end
@@ -417,7 +452,7 @@ solution "LumixEngine"
 			"-ffunction-sections",
 			"-Wunused-value",
 			"-Wundef",
-			"-msse2",
+			"-msse4.1",
 			"-Wno-multichar",
 			"-Wno-undef",
 		}
@@ -440,6 +475,14 @@ solution "LumixEngine"
 			"-fopenmp"
 		}
 
+	if _OPTIONS["avx2"] then
+		configuration { "linux" }
+			-- do not fuse mul + add, SIMD kernels (e.g. Pose::blend) must give the same results as the scalar code
+			buildoptions { "-mavx2", "-mfma", "-ffp-contract=off" }
+		configuration { "vs*" }
+			buildoptions { "/arch:AVX2" }
+	end
+
 	configuration {}
 	
 	configurations { "Debug", "RelWithDebInfo" }
@@ -828,6 +871,58 @@ if build_app then
 		defaultConfigurations()
 end
 
+-- console app linked with the engine and plugins, sources are in src/<name>
+function consoleApp(name)
+	project(name)
+		kind "ConsoleApp"
+		debugdir "../data"
+
+		files { "../src/" .. name .. "/**.h", "../src/" .. name .. "/**.cpp" }
+		includedirs { "../src", "../external" }
+		if not has_plugin("animation") then
+			excludes { "../src/" .. name .. "/animation.cpp" }
+		end
+
+		if not _OPTIONS["dynamic-plugins"] then
+			if has_plugin("renderer") then
+				linkOpenGL()
+			end
+			if has_plugin("physics") then
+				linkPhysX()
+			end
+			if build_studio then links {"editor"} end
+
+			links { "engine" }
+			if use_basisu then
+				linkLib "basisu"
+			end
+			linkLib "freetype"
+			linkLib "recast"
+
+			configuration { "vs*" }
+				links { "psapi", "dxguid", "winmm", "imm32", "version" }
+
+			configuration { "linux" }
+				links { "GL", "X11", "dl", "rt", "Xi", "gtk-3", "gobject-2.0" }
+
+			configuration {}
+		else
+			if has_plugin("animation") then links { "animation" } end
+			links { "renderer", "editor", "engine" }
+		end
+
+		useLua()
+		defaultConfigurations()
+end
+
+if build_bench then
+	consoleApp "bench"
+end
+
+if build_tests then
+	consoleApp "tests"
+end
+
 -- write plugins.inl
 for _, plugin in ipairs(base_plugins) do
 	linkPlugin(plugin)
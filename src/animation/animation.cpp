@@ -1,4 +1,5 @@
 #include "animation/animation.h"
+#include "engine/atomic.h"
 #include "engine/log.h"
 #include "engine/math.h"
 #include "engine/profiler.h"
@@ -17,6 +18,7 @@ const ResourceType Animation::TYPE("animation");
 
 Animation::Animation(const Path& path, ResourceManager& resource_manager, IAllocator& allocator)
 	: Resource(path, resource_manager, allocator)
+	, m_allocator(allocator)
 	, m_mem(allocator)
 	, m_translations(allocator)
 	, m_rotations(allocator)
@@ -24,164 +26,207 @@ Animation::Animation(const Path& path, ResourceManager& resource_manager, IAlloc
 }
 
 
+// index of the first key after `t`, times are sorted
+static LUMIX_FORCE_INLINE u32 findKey(const u16* times, u32 count, u16 t) {
+	u32 lo = 1;
+	u32 hi = count - 1;
+	while (lo < hi) {
+		const u32 mid = (lo + hi) >> 1;
+		if (times[mid] > t) hi = mid;
+		else lo = mid + 1;
+	}
+	return lo;
+}
+
 struct AnimationSampler {
+	static LUMIX_FORCE_INLINE Vec3 getPos(const Animation::TranslationCurve& curve, u32 idx) {
+		if (!curve.keys) return curve.pos[idx];
+		const u16* key = curve.keys + idx * 3;
+		return Vec3(key[0] * curve.to_range.x + curve.min.x
+			, key[1] * curve.to_range.y + curve.min.y
+			, key[2] * curve.to_range.z + curve.min.z);
+	}
+
+	static LUMIX_FORCE_INLINE Quat getRot(const Animation::RotationCurve& curve, u32 idx) {
+		if (!curve.keys) return curve.rot[idx];
+		return Animation::dequantizeRotation(curve.keys + idx * 3);
+	}
+
+	static LUMIX_FORCE_INLINE Vec3 samplePos(const Animation::TranslationCurve& curve, u16 anim_t, u32 frame_idx, float frame_t) {
+		if (curve.count == 1) return getPos(curve, 0);
+		if (curve.times) {
+			const u32 idx = findKey(curve.times, curve.count, anim_t);
+			const float t = float(anim_t - curve.times[idx - 1]) / (curve.times[idx] - curve.times[idx - 1]);
+			return lerp(getPos(curve, idx - 1), getPos(curve, idx), t);
+		}
+		return lerp(getPos(curve, frame_idx), getPos(curve, frame_idx + 1), frame_t);
+	}
+
+	static LUMIX_FORCE_INLINE Quat sampleRot(const Animation::RotationCurve& curve, u16 anim_t, u32 frame_idx, float frame_t) {
+		if (curve.count == 1) return getRot(curve, 0);
+		if (curve.times) {
+			const u32 idx = findKey(curve.times, curve.count, anim_t);
+			const float t = float(anim_t - curve.times[idx - 1]) / (curve.times[idx] - curve.times[idx - 1]);
+			return nlerp(getRot(curve, idx - 1), getRot(curve, idx), t);
+		}
+		return nlerp(getRot(curve, frame_idx), getRot(curve, frame_idx + 1), frame_t);
+	}
+
 	template <bool use_mask, bool use_weight>
-	static void getRelativePose(const Animation& anim, Time time, Pose& pose, const Model& model, float weight, const BoneMask* mask) {
+	static void getRelativePose(const Animation& anim, Time time, Pose& pose, const Animation::BoneRemap& remap, float weight, const BoneMask* mask, u32 max_bone_depth, u32 from_bone, u32 to_bone) {
 		ASSERT(!pose.is_absolute);
-		ASSERT(model.isReady());
+		ASSERT(remap.curves_version == anim.m_curves_version);
+		ASSERT(!remap.model || remap.bones_version == remap.model->getBonesVersion());
 
 		Vec3* pos = pose.positions;
 		Quat* rot = pose.rotations;
+		const bool is_end = !(time < anim.getLength());
 
-		if (time < anim.getLength()) {
+		u16 anim_t = 0;
+		u32 frame_idx = 0;
+		float frame_t = 0;
+		if (!is_end) {
 			const u64 anim_t_highres = ((u64)time.raw() << 16) / (anim.m_length.raw());
 			ASSERT(anim_t_highres <= 0xffFF);
-			const u16 anim_t = u16(anim_t_highres);
+			anim_t = u16(anim_t_highres);
 			const u64 frame_48_16 = (anim.m_frame_count - 1) * anim_t_highres;
 			ASSERT((frame_48_16 & 0xffFF00000000) == 0);
-			const u32 frame_idx = u32(frame_48_16 >> 16);
-			const float frame_t = (frame_48_16 & 0xffFF) / float(0xffFF);
+			frame_idx = u32(frame_48_16 >> 16);
+			frame_t = (frame_48_16 & 0xffFF) / float(0xffFF);
+		}
 		
-			for (const Animation::TranslationCurve& curve : anim.m_translations) {
-				Model::BoneMap::ConstIterator iter = model.getBoneIndex(curve.name);
-				if (!iter.isValid()) continue;
-				if constexpr(use_mask) {
-					if (mask->bones.find(curve.name) == mask->bones.end()) continue;
-				}
-
-				Vec3 anim_pos;
-				if (curve.times) {
-					u32 idx = 1;
-					for (u32 c = curve.count; idx < c; ++idx) {
-						if (curve.times[idx] > anim_t) break;
-					}
-					const float t = float(anim_t - curve.times[idx - 1]) / (curve.times[idx] - curve.times[idx - 1]);
-					anim_pos = lerp(curve.pos[idx - 1], curve.pos[idx], t);
-				}
-				else {
-					anim_pos = lerp(curve.pos[frame_idx], curve.pos[frame_idx + 1], frame_t);
-				}
-
-				const int model_bone_index = iter.value();
-				if constexpr (use_weight) {
-					pos[model_bone_index] = lerp(pos[model_bone_index], anim_pos, weight);
-				}
-				else {
-					pos[model_bone_index] = anim_pos;
-				}
+		for (u32 i = 0, c = anim.m_translations.size(); i < c; ++i) {
+			const Animation::BoneRemap::Entry& entry = remap.translations[i];
+			if (entry.bone < 0 || entry.depth > max_bone_depth) continue;
+			if (u32(entry.bone) - from_bone >= to_bone - from_bone) continue;
+			const int model_bone_index = entry.bone;
+			const Animation::TranslationCurve& curve = anim.m_translations[i];
+			if constexpr(use_mask) {
+				if (mask->bones.find(curve.name) == mask->bones.end()) continue;
 			}
 
-			for (const Animation::RotationCurve& curve : anim.m_rotations) {
-				Model::BoneMap::ConstIterator iter = model.getBoneIndex(curve.name);
-				if (!iter.isValid()) continue;
-				if constexpr(use_mask) {
-					if (mask->bones.find(curve.name) == mask->bones.end()) continue;
-				}
-
-				Quat anim_rot;
-				if(curve.times) {
-					u32 idx = 1;
-					for (u32 c = curve.count; idx < c; ++idx) {
-						if (curve.times[idx] > anim_t) break;
-					}
-					const float t = float(anim_t - curve.times[idx - 1]) / (curve.times[idx] - curve.times[idx - 1]);
-					anim_rot = nlerp(curve.rot[idx - 1], curve.rot[idx], t);
-				}
-				else {
-					anim_rot = nlerp(curve.rot[frame_idx], curve.rot[frame_idx + 1], frame_t);
-				}
-
-				const int model_bone_index = iter.value();
-				if constexpr (use_weight) {
-					rot[model_bone_index] = nlerp(rot[model_bone_index], anim_rot, weight);
-				}
-				else {
-					rot[model_bone_index] = anim_rot;
-				}
+			const Vec3 anim_pos = is_end ? getPos(curve, curve.count - 1) : samplePos(curve, anim_t, frame_idx, frame_t);
+			if constexpr (use_weight) {
+				pos[model_bone_index] = lerp(pos[model_bone_index], anim_pos, weight);
+			}
+			else {
+				pos[model_bone_index] = anim_pos;
 			}
 		}
-		else {
-			for (const Animation::TranslationCurve& curve : anim.m_translations) {
-				Model::BoneMap::ConstIterator iter = model.getBoneIndex(curve.name);
-				if (!iter.isValid()) continue;
-				if constexpr(use_mask) {
-					if (mask->bones.find(curve.name) == mask->bones.end()) continue;
-				}
-
-				const int model_bone_index = iter.value();
-				if constexpr (use_weight) {
-					pos[model_bone_index] = lerp(pos[model_bone_index], curve.pos[curve.count - 1], weight);
-				}
-				else {
-					pos[model_bone_index] = curve.pos[curve.count - 1];
-				}
+
+		for (u32 i = 0, c = anim.m_rotations.size(); i < c; ++i) {
+			const Animation::BoneRemap::Entry& entry = remap.rotations[i];
+			if (entry.bone < 0 || entry.depth > max_bone_depth) continue;
+			if (u32(entry.bone) - from_bone >= to_bone - from_bone) continue;
+			const int model_bone_index = entry.bone;
+			const Animation::RotationCurve& curve = anim.m_rotations[i];
+			if constexpr(use_mask) {
+				if (mask->bones.find(curve.name) == mask->bones.end()) continue;
 			}
 
-			for (const Animation::RotationCurve& curve : anim.m_rotations) {
-				Model::BoneMap::ConstIterator iter = model.getBoneIndex(curve.name);
-				if (!iter.isValid()) continue;
-				if constexpr(use_mask) {
-					if (mask->bones.find(curve.name) == mask->bones.end()) continue;
-				}
-
-				const int model_bone_index = iter.value();
-				if constexpr (use_weight) {
-					rot[model_bone_index] = nlerp(rot[model_bone_index], curve.rot[curve.count - 1], weight);
-				}
-				else {
-					rot[model_bone_index] = curve.rot[curve.count - 1];
-				}
+			const Quat anim_rot = is_end ? getRot(curve, curve.count - 1) : sampleRot(curve, anim_t, frame_idx, frame_t);
+			if constexpr (use_weight) {
+				rot[model_bone_index] = nlerp(rot[model_bone_index], anim_rot, weight);
+			}
+			else {
+				rot[model_bone_index] = anim_rot;
 			}
 		}
 	}
 }; // AnimationSampler
 
-void Animation::getRelativePose(Time time, Pose& pose, const Model& model, float weight, const BoneMask* mask) const {
+template <typename F>
+void Animation::fillBoneRemap(BoneRemap& remap, F get_entry) const {
+	remap.translations.resize(m_translations.size());
+	for (u32 i = 0, c = m_translations.size(); i < c; ++i) {
+		remap.translations[i] = get_entry(m_translations[i].name);
+	}
+	remap.rotations.resize(m_rotations.size());
+	for (u32 i = 0, c = m_rotations.size(); i < c; ++i) {
+		remap.rotations[i] = get_entry(m_rotations[i].name);
+	}
+}
+
+void Animation::updateBoneRemap(const Model& model, BoneRemap& remap) const {
+	if (remap.model == &model && remap.bones_version == model.getBonesVersion() && remap.curves_version == m_curves_version) return;
+
+	// model or animation was (re)loaded, or it's the first time they are used together
+	remap.model = &model;
+	remap.bones_version = model.getBonesVersion();
+	remap.curves_version = m_curves_version;
+	auto get_entry = [&](BoneNameHash name){
+		BoneRemap::Entry entry = { -1, 0 };
+		Model::BoneMap::ConstIterator iter = model.getBoneIndex(name);
+		if (!iter.isValid()) return entry;
+		entry.bone = (i16)iter.value();
+		for (i32 parent = model.getBone(entry.bone).parent_idx; parent >= 0; parent = model.getBone(parent).parent_idx) {
+			++entry.depth;
+		}
+		return entry;
+	};
+	fillBoneRemap(remap, get_entry);
+}
+
+void Animation::updateBoneRemap(Span<const BoneNameHash> bone_names, Span<const i32> bone_parents, BoneRemap& remap) const {
+	ASSERT(bone_names.length() == bone_parents.length());
+	remap.model = nullptr;
+	remap.bones_version = 0;
+	remap.curves_version = m_curves_version;
+	auto get_entry = [&](BoneNameHash name){
+		BoneRemap::Entry entry = { -1, 0 };
+		for (u32 i = 0, c = bone_names.length(); i < c; ++i) {
+			if (bone_names[i] == name) {
+				entry.bone = (i16)i;
+				for (i32 parent = bone_parents[i]; parent >= 0; parent = bone_parents[parent]) ++entry.depth;
+				break;
+			}
+		}
+		return entry;
+	};
+	fillBoneRemap(remap, get_entry);
+}
+
+void Animation::getRelativePose(Time time, Pose& pose, const BoneRemap& remap, float weight, const BoneMask* mask, u32 max_bone_depth, u32 from_bone, u32 to_bone) const {
 	if (mask) {
 		if (weight < 0.9999f) {
-			AnimationSampler::getRelativePose<true, true>(*this, time, pose, model, weight, mask);
+			AnimationSampler::getRelativePose<true, true>(*this, time, pose, remap, weight, mask, max_bone_depth, from_bone, to_bone);
 		}
 		else {
-			AnimationSampler::getRelativePose<true, false>(*this, time, pose, model, weight, mask);
+			AnimationSampler::getRelativePose<true, false>(*this, time, pose, remap, weight, mask, max_bone_depth, from_bone, to_bone);
 		}
 	}
 	else {
 		if (weight < 0.9999f) {
-			AnimationSampler::getRelativePose<false, true>(*this, time, pose, model, weight, mask);
+			AnimationSampler::getRelativePose<false, true>(*this, time, pose, remap, weight, mask, max_bone_depth, from_bone, to_bone);
 		}
 		else {
-			AnimationSampler::getRelativePose<false, false>(*this, time, pose, model, weight, mask);
+			AnimationSampler::getRelativePose<false, false>(*this, time, pose, remap, weight, mask, max_bone_depth, from_bone, to_bone);
 		}
 	}
 }
 
+static void getFrame(Time time, Time length, u32 frame_count, u16& anim_t, u32& frame_idx, float& frame_t) {
+	const u64 anim_t_highres = ((u64)time.raw() << 16) / (length.raw());
+	ASSERT(anim_t_highres <= 0xffFF);
+	anim_t = u16(anim_t_highres);
+	const u64 frame_48_16 = (frame_count - 1) * anim_t_highres;
+	ASSERT((frame_48_16 & 0xffFF00000000) == 0);
+	frame_idx = u32(frame_48_16 >> 16);
+	frame_t = (frame_48_16 & 0xffFF) / float(0xffFF);
+}
+
 Vec3 Animation::getTranslation(Time time, u32 curve_idx) const
 {
 	const TranslationCurve& curve = m_translations[curve_idx];
 	if (time < m_length) {
-		const u64 anim_t_highres = ((u64)time.raw() << 16) / (m_length.raw());
-		ASSERT(anim_t_highres <= 0xffFF);
-		const u16 anim_t = u16(anim_t_highres);
-
-		if (curve.times) {
-			u32 idx = 1;
-			for (u32 c = curve.count; idx < c; ++idx) {
-				if (curve.times[idx] > anim_t) break;
-			}
-
-			const float t = float(anim_t - curve.times[idx - 1]) / (curve.times[idx] - curve.times[idx - 1]);
-			return lerp(curve.pos[idx - 1], curve.pos[idx], t);
-		}
-
-		const u64 frame_48_16 = (m_frame_count - 1) * anim_t_highres;
-		ASSERT((frame_48_16 & 0xffFF00000000) == 0);
-		const u32 frame_idx = u32(frame_48_16 >> 16);
-		const float frame_t = (frame_48_16 & 0xffFF) / float(0xffFF);
-
-		return lerp(curve.pos[frame_idx], curve.pos[frame_idx + 1], frame_t);
+		u16 anim_t;
+		u32 frame_idx;
+		float frame_t;
+		getFrame(time, m_length, m_frame_count, anim_t, frame_idx, frame_t);
+		return AnimationSampler::samplePos(curve, anim_t, frame_idx, frame_t);
 	}
 
-	return curve.pos[curve.count - 1];
+	return AnimationSampler::getPos(curve, curve.count - 1);
 }
 
 int Animation::getTranslationCurveIndex(BoneNameHash name_hash) const {
@@ -202,42 +247,73 @@ Quat Animation::getRotation(Time time, u32 curve_idx) const
 {
 	const RotationCurve& curve = m_rotations[curve_idx];
 	if (time < m_length) {
-		const u64 anim_t_highres = ((u64)time.raw() << 16) / (m_length.raw());
-		ASSERT(anim_t_highres <= 0xffFF);
-		const u16 anim_t = u16(anim_t_highres);
-
-		if (curve.times) {
-			u32 idx = 1;
-			for (u32 c = curve.count; idx < c; ++idx) {
-				if (curve.times[idx] > anim_t) break;
-			}
-
-			const float t = float(anim_t - curve.times[idx - 1]) / (curve.times[idx] - curve.times[idx - 1]);
-			return nlerp(curve.rot[idx - 1], curve.rot[idx], t);
-		}
+		u16 anim_t;
+		u32 frame_idx;
+		float frame_t;
+		getFrame(time, m_length, m_frame_count, anim_t, frame_idx, frame_t);
+		return AnimationSampler::sampleRot(curve, anim_t, frame_idx, frame_t);
+	}
 
-		const u64 frame_48_16 = (m_frame_count - 1) * anim_t_highres;
-		ASSERT((frame_48_16 & 0xffFF00000000) == 0);
-		const u32 frame_idx = u32(frame_48_16 >> 16);
-		const float frame_t = (frame_48_16 & 0xffFF) / float(0xffFF);
+	return AnimationSampler::getRot(curve, curve.count - 1);
+}
 
-		return nlerp(curve.rot[frame_idx], curve.rot[frame_idx + 1], frame_t);
+// smallest three - drop the largest component, it can be computed from the rest since |rot| == 1,
+// the rest are in [-1/sqrt(2), 1/sqrt(2)] and stored in the upper 15 bits, 
+// index of the dropped component is in the lowest bits of the first two keys
+void Animation::quantizeRotation(const Quat& rot, u16* out) {
+	const float* q = &rot.x;
+	u32 largest = 0;
+	for (u32 i = 1; i < 4; ++i) {
+		if (fabsf(q[i]) > fabsf(q[largest])) largest = i;
 	}
+	// q and -q are the same rotation, make the dropped component positive
+	const float sign = q[largest] < 0 ? -1.f : 1.f;
+	for (u32 i = 0, j = 0; i < 4; ++i) {
+		if (i == largest) continue;
+		const float v = clamp(q[i] * sign * 0.5f * SQRT2 + 0.5f, 0.f, 1.f);
+		const u16 bit = j < 2 ? u16((largest >> j) & 1) : 0;
+		out[j] = u16(u32(v * 0x7fff + 0.5f) << 1) | bit;
+		++j;
+	}
+}
 
-	return curve.rot[curve.count - 1];
+Quat Animation::dequantizeRotation(const u16* key) {
+	static const u8 order[4][3] = { {1, 2, 3}, {0, 2, 3}, {0, 1, 3}, {0, 1, 2} };
+	const u32 largest = (key[0] & 1) | ((key[1] & 1) << 1);
+	const float a = ((key[0] >> 1) * (2.f / 0x7fff) - 1) * (1 / SQRT2);
+	const float b = ((key[1] >> 1) * (2.f / 0x7fff) - 1) * (1 / SQRT2);
+	const float c = ((key[2] >> 1) * (2.f / 0x7fff) - 1) * (1 / SQRT2);
+	Quat res;
+	float* q = &res.x;
+	q[order[largest][0]] = a;
+	q[order[largest][1]] = b;
+	q[order[largest][2]] = c;
+	q[largest] = sqrtf(maximum(0.f, 1 - a * a - b * b - c * c));
+	return res;
 }
 
 void Animation::getRelativePose(Time time, Pose& pose, const Model& model, const BoneMask* mask) const {
+	BoneRemap remap(m_allocator);
+	updateBoneRemap(model, remap);
 	if(mask) {
-		AnimationSampler::getRelativePose<true, false>(*this, time, pose, model, 1, mask);
+		AnimationSampler::getRelativePose<true, false>(*this, time, pose, remap, 1, mask, 0xffFFffFF, 0, 0xffFFffFF);
 	}
 	else {
-		AnimationSampler::getRelativePose<false, false>(*this, time, pose, model, 1, mask);
+		AnimationSampler::getRelativePose<false, false>(*this, time, pose, remap, 1, mask, 0xffFFffFF, 0, 0xffFFffFF);
 	}
 }
 
 bool Animation::load(u64 mem_size, const u8* mem)
 {
+	return prepare(mem_size, mem) && finalize(mem_size, mem);
+}
+
+// animation does not depend on anything, so it's completely loaded on a worker
+bool Animation::prepare(u64 mem_size, const u8* mem)
+{
+	PROFILE_FUNCTION();
+	static volatile i32 curves_version = 0;
+	m_curves_version = (u32)atomicIncrement(&curves_version);
 	m_translations.clear();
 	m_rotations.clear();
 	m_mem.clear();
@@ -269,6 +345,7 @@ bool Animation::load(u64 mem_size, const u8* mem)
 
 	m_translations.resize(translations_count);
 
+	const bool quantized = header.version >= Version::QUANTIZED;
 	InputMemoryStream blob(&m_mem[0], size);
 	for (int i = 0; i < m_translations.size(); ++i) {
 		TranslationCurve& curve = m_translations[i];
@@ -277,7 +354,16 @@ bool Animation::load(u64 mem_size, const u8* mem)
 		curve.count = blob.read<u32>();
 		ASSERT(curve.count > 1 || type != Animation::CurveType::KEYFRAMED);
 		curve.times = type == Animation::CurveType::KEYFRAMED ? (const u16*)blob.skip(curve.count * sizeof(u16)) : nullptr;
-		curve.pos = (const Vec3*)blob.skip(curve.count * sizeof(Vec3));
+		curve.pos = nullptr;
+		curve.keys = nullptr;
+		if (quantized && type != Animation::CurveType::CONSTANT) {
+			blob.read(curve.min);
+			blob.read(curve.to_range);
+			curve.keys = (const u16*)blob.skip(curve.count * 3 * sizeof(u16));
+		}
+		else {
+			curve.pos = (const Vec3*)blob.skip(curve.count * sizeof(Vec3));
+		}
 	}
 	
 	const u32 rotations_count = blob.read<u32>();
@@ -290,7 +376,14 @@ bool Animation::load(u64 mem_size, const u8* mem)
 		curve.count = blob.read<u32>();
 		ASSERT(curve.count > 1 || type != Animation::CurveType::KEYFRAMED);
 		curve.times = type == Animation::CurveType::KEYFRAMED ? (const u16*)blob.skip(curve.count * sizeof(u16)) : nullptr;
-		curve.rot = (const Quat*)blob.skip(curve.count * sizeof(Quat));
+		curve.rot = nullptr;
+		curve.keys = nullptr;
+		if (quantized && type != Animation::CurveType::CONSTANT) {
+			curve.keys = (const u16*)blob.skip(curve.count * 3 * sizeof(u16));
+		}
+		else {
+			curve.rot = (const Quat*)blob.skip(curve.count * sizeof(Quat));
+		}
 	}
 
 	return true;
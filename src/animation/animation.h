@@ -1,7 +1,9 @@
 #pragma once
 
+#include "engine/array.h"
 #include "engine/hash.h"
 #include "engine/hash_map.h"
+#include "engine/math.h"
 #include "engine/resource.h"
 #include "engine/string.h"
 
@@ -10,8 +12,6 @@ namespace Lumix
 
 struct Model;
 struct Pose;
-struct Quat;
-struct Vec3;
 
 struct Time {
 	Time() {}
@@ -56,11 +56,16 @@ struct Animation final : Resource
 	public:
 		enum class CurveType : u8 {
 			KEYFRAMED,
-			SAMPLED
+			SAMPLED,
+			CONSTANT // single raw key
 		};
 
 		enum class Version : u32 {
 			FIRST = 3,
+			RAW_KEYS = 4,
+			// translations quantized to 16 bits per component in the curve's range, 
+			// rotations to 48 bits (smallest three), constant curves stored as single raw key
+			QUANTIZED,
 
 			LAST
 		};
@@ -81,34 +86,77 @@ struct Animation final : Resource
 		Quat getRotation(Time time, u32 curve_idx) const;
 		int getTranslationCurveIndex(BoneNameHash name_hash) const;
 		int getRotationCurveIndex(BoneNameHash name_hash) const;
+		// model's bone for each curve, owned by the user (e.g. anim::RuntimeContext), so sampling does not need any lock
+		struct BoneRemap {
+			struct Entry {
+				i16 bone; // -1 if the model does not have the bone
+				u16 depth; // in model's hierarchy
+			};
+
+			BoneRemap(IAllocator& allocator) : translations(allocator), rotations(allocator) {}
+
+			const Model* model = nullptr;
+			u32 bones_version = 0;
+			u32 curves_version = 0;
+			Array<Entry> translations;
+			Array<Entry> rotations;
+		};
+
+		// rebuilds `remap` if the model or this animation changed since it was built
+		void updateBoneRemap(const Model& model, BoneRemap& remap) const;
+		// always rebuilds `remap` for a skeleton which is not a model, parents are before children, -1 for roots
+		void updateBoneRemap(Span<const BoneNameHash> bone_names, Span<const i32> bone_parents, BoneRemap& remap) const;
+		// builds a temporary remap, use the other overload on hot paths
 		void getRelativePose(Time time, Pose& pose, const Model& model, const BoneMask* mask) const;
-		void getRelativePose(Time time, Pose& pose, const Model& model, float weight, const BoneMask* mask) const;
+		// `remap` must be up to date, see updateBoneRemap, the pose is sampled for the skeleton the remap was built for
+		// bones deeper than `max_bone_depth` in model's hierarchy are not sampled,
+		// only model's bones in [from_bone, to_bone) are sampled
+		void getRelativePose(Time time, Pose& pose, const BoneRemap& remap, float weight, const BoneMask* mask, u32 max_bone_depth = 0xffFFffFF, u32 from_bone = 0, u32 to_bone = 0xffFFffFF) const;
 		Time getLength() const { return m_length; }
 
+		// Version::QUANTIZED rotation encoding, 3 x u16 per key
+		static void quantizeRotation(const Quat& rot, u16* out);
+		static Quat dequantizeRotation(const u16* key);
+
 	private:
+		// `get_entry` returns BoneRemap::Entry for a curve's bone name
+		template <typename F> void fillBoneRemap(BoneRemap& remap, F get_entry) const;
 		void unload() override;
 		bool load(u64 size, const u8* mem) override;
+		bool prepare(u64 size, const u8* mem) override;
+		bool finalize(u64 size, const u8* mem) override { return true; }
 
 	private:
+		IAllocator& m_allocator;
 		Time m_length;
 		struct TranslationCurve
 		{
 			BoneNameHash name;
 			u32 count;
 			const u16* times;
+			// raw keys, older versions and constant curves
 			const Vec3* pos;
+			// 3 x u16 per key, value = key * to_range + min
+			const u16* keys;
+			Vec3 min;
+			Vec3 to_range;
 		};
 		struct RotationCurve
 		{
 			BoneNameHash name;
 			u32 count;
 			const u16* times;
+			// raw keys, older versions and constant curves
 			const Quat* rot;
+			// see quantizeRotation
+			const u16* keys;
 		};
 		Array<TranslationCurve> m_translations;
 		Array<RotationCurve> m_rotations;
 		Array<u8> m_mem;
 		u32 m_frame_count = 0;
+		// changes with each load, so BoneRemap can detect a reload
+		u32 m_curves_version = 0;
 
 		friend struct AnimationSampler;
 };
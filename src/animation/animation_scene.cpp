@@ -7,15 +7,18 @@
 #include "engine/associative_array.h"
 #include "engine/atomic.h"
 #include "engine/engine.h"
+#include "engine/geometry.h"
 #include "engine/hash.h"
 #include "engine/job_system.h"
 #include "engine/log.h"
+#include "engine/os.h"
 #include "engine/profiler.h"
 #include "engine/reflection.h"
 #include "engine/resource_manager.h"
 #include "engine/stream.h"
 #include "engine/world.h"
 #include "nodes.h"
+#include "pose_jobs.h"
 #include "renderer/model.h"
 #include "renderer/pose.h"
 #include "renderer/render_scene.h"
@@ -51,6 +54,13 @@ struct AnimationSceneImpl final : AnimationScene
 		u32 default_set = 0;
 		anim::RuntimeContext* ctx = nullptr;
 		LocalRigidTransform root_motion = {{0, 0, 0}, {0, 0, 0, 1}};
+		// absolute poses of the last two evaluations, interpolated in between when LOD's update interval > 1
+		Pose* lod_poses[2] = {};
+		u32 frames_since_update = 0;
+		u32 update_interval = 1;
+		bool are_lod_poses_valid = false;
+		// pose being evaluated in this frame, model instance's pose or lod_poses[1]
+		Pose* evaluated_pose = nullptr;
 
 		struct IK {
 			float weight = 0;
@@ -59,6 +69,21 @@ struct AnimationSceneImpl final : AnimationScene
 	};
 
 
+	struct LODCamera {
+		DVec3 pos;
+		Frustum frustum;
+		float inv_tan_half_fov;
+		// direction of the sun's shadows and how far from the camera they are rendered, 0 if there are no shadows
+		Vec3 shadow_dir;
+		float shadow_distance = 0;
+	};
+
+	// LOD of animators which are not visible, neither they nor their shadows
+	static constexpr i32 OFFSCREEN_LOD = -1;
+	// such animators are still updated from time to time, so bones queried by gameplay or shown in other views are not frozen
+	static constexpr u32 OFFSCREEN_UPDATE_INTERVAL = 16;
+
+
 	struct PropertyAnimator
 	{
 		struct Key
@@ -94,8 +119,13 @@ struct AnimationSceneImpl final : AnimationScene
 		, m_animators(allocator)
 		, m_allocator(allocator)
 		, m_animator_map(allocator)
+		, m_heavy_animators(allocator)
 	{
 		m_is_game_running = false;
+		m_lods[0] = { 0.3f, 2, 0xffFFffFF };
+		m_lods[1] = { 0.1f, 4, 0xffFFffFF };
+		m_lods[2] = { 0.03f, 8, 7 };
+		m_lods_count = 3;
 	}
 
 	void init() override {
@@ -125,6 +155,7 @@ struct AnimationSceneImpl final : AnimationScene
 		{
 			unloadResource(animator.resource);
 			setSource(animator, nullptr);
+			destroyLODPoses(animator);
 		}
 		m_animators.clear();
 	}
@@ -319,6 +350,7 @@ struct AnimationSceneImpl final : AnimationScene
 		Animator& animator = m_animators[idx];
 		unloadResource(animator.resource);
 		setSource(animator, nullptr);
+		destroyLODPoses(animator);
 		const Animator& last = m_animators.back();
 		m_animator_map[last.entity] = idx;
 		m_animator_map.erase(entity);
@@ -616,39 +648,168 @@ struct AnimationSceneImpl final : AnimationScene
 		return animator.default_set;
 	}
 
-	void updateAnimator(Animator& animator, float time_delta)
+	void setAnimatorLODs(Span<const AnimatorLOD> lods) override {
+		ASSERT(lods.length() <= lengthOf(m_lods));
+		m_lods_count = minimum(lods.length(), (u32)lengthOf(m_lods));
+		memcpy(m_lods, lods.begin(), sizeof(m_lods[0]) * m_lods_count);
+	}
+
+	Span<const AnimatorLOD> getAnimatorLODs() const override { return Span(m_lods, m_lods_count); }
+
+	void destroyLODPoses(Animator& animator) {
+		LUMIX_DELETE(m_allocator, animator.lod_poses[0]);
+		LUMIX_DELETE(m_allocator, animator.lod_poses[1]);
+		animator.lod_poses[0] = nullptr;
+		animator.lod_poses[1] = nullptr;
+		animator.are_lod_poses_valid = false;
+	}
+
+	// true if the bounding sphere swept along the shadow direction intersects the frustum
+	static bool isShadowInside(const LODCamera& camera, const Vec3& center, float radius) {
+		if (camera.shadow_distance <= 0) return false;
+		const Frustum& f = camera.frustum;
+		const Vec3 end = center + camera.shadow_dir * camera.shadow_distance;
+		for (u32 i = 0; i < (u32)Frustum::Planes::COUNT; ++i) {
+			const Vec3 n(f.xs[i], f.ys[i], f.zs[i]);
+			if (dot(n, center) + f.ds[i] < -radius && dot(n, end) + f.ds[i] < -radius) return false;
+		}
+		return true;
+	}
+
+	// OFFSCREEN_LOD if the animator is not visible, 0 if it's not using any LOD, otherwise index to m_lods + 1
+	i32 getLOD(EntityRef entity, const Model& model, const LODCamera& camera) const {
+		const Transform tr = m_world.getTransform(entity);
+		const float radius = model.getOriginBoundingRadius() * maximum(tr.scale.x, tr.scale.y, tr.scale.z);
+		const Vec3 center = Vec3(tr.pos - camera.pos);
+		if (!camera.frustum.isSphereInside(center, radius)) {
+			// only the shadow is visible
+			if (isShadowInside(camera, center, radius)) return m_lods_count;
+			return OFFSCREEN_LOD;
+		}
+
+		const float dist = length(center);
+		if (dist <= radius) return 0;
+		const float screen_size = radius / dist * camera.inv_tan_half_fov;
+		i32 lod = 0;
+		for (u32 i = 0; i < m_lods_count; ++i) {
+			if (screen_size < m_lods[i].screen_size) lod = i + 1;
+		}
+		return lod;
+	}
+
+	static void copyPose(const Pose& src, Pose& dst) {
+		ASSERT(src.count == dst.count);
+		memcpy(dst.positions, src.positions, sizeof(src.positions[0]) * src.count);
+		memcpy(dst.rotations, src.rotations, sizeof(src.rotations[0]) * src.count);
+		dst.is_absolute = src.is_absolute;
+	}
+
+	static void blendLODPoses(const Animator& animator, Pose& pose) {
+		// interpolating absolute poses is good enough for the small changes between updates, and we skip computeAbsolute
+		// the shown pose lags up to update_interval - 1 frames behind the animation, while root motion is applied
+		// immediately, so feet can slightly slide; extrapolating would avoid it, but overshoots on loops and transitions
+		copyPose(*animator.lod_poses[0], pose);
+		pose.blend(*animator.lod_poses[1], float(animator.frames_since_update + 1) / animator.update_interval);
+	}
+
+	// updates controller and prepares pose evaluation, returns the pose to evaluate with executePose and endUpdate,
+	// nullptr if there is nothing to evaluate in this frame
+	Pose* beginUpdate(Animator& animator, float time_delta, const LODCamera* camera)
 	{
-		if (!animator.resource || !animator.resource->isReady()) return;
+		if (!animator.resource || !animator.resource->isReady()) return nullptr;
 		if (!animator.ctx) {
 			animator.ctx = animator.resource->createRuntime(animator.default_set);
 		}
 
 		const EntityRef entity = animator.entity;
-		if (!m_world.hasComponent(entity, MODEL_INSTANCE_TYPE)) return;
+		if (!m_world.hasComponent(entity, MODEL_INSTANCE_TYPE)) return nullptr;
 
 		Model* model = m_render_scene->getModelInstanceModel(entity);
-		if (!model->isReady()) return;
-
-		Pose* pose = m_render_scene->lockPose(entity);
-		if (!pose) return;
+		if (!model->isReady()) return nullptr;
 
 		animator.ctx->model = model;
 		animator.ctx->time_delta = Time::fromSeconds(time_delta);
 		animator.ctx->root_bone_hash = BoneNameHash(animator.resource->m_root_motion_bone);
 		animator.resource->update(*animator.ctx, animator.root_motion);
 
-		model->getRelativePose(*pose);
-		animator.resource->getPose(*animator.ctx, *pose);
-		
+		// bone attachments can be on any bone and they are used by gameplay, so their parents are never offscreen
+		const bool is_attachment_parent = m_render_scene->getModelInstance(entity)->flags.isSet(ModelInstance::IS_BONE_ATTACHMENT_PARENT);
+		i32 lod = camera ? getLOD(entity, *model, *camera) : 0;
+		if (lod == OFFSCREEN_LOD && is_attachment_parent) lod = m_lods_count;
+
+		Pose* pose = m_render_scene->lockPose(entity);
+		if (!pose) return nullptr;
+
+		if (lod == OFFSCREEN_LOD) {
+			animator.update_interval = OFFSCREEN_UPDATE_INTERVAL;
+			animator.ctx->max_bone_depth = m_lods_count == 0 ? 0xffFFffFF : m_lods[m_lods_count - 1].max_bone_depth;
+		}
+		else {
+			animator.update_interval = lod == 0 ? 1 : maximum(m_lods[lod - 1].update_interval, 1u);
+			animator.ctx->max_bone_depth = lod == 0 || is_attachment_parent ? 0xffFFffFF : m_lods[lod - 1].max_bone_depth;
+		}
+		Pose* evaluated_pose = pose;
+		if (animator.update_interval == 1) {
+			animator.are_lod_poses_valid = false;
+		}
+		else {
+			if (!animator.lod_poses[0]) {
+				animator.lod_poses[0] = LUMIX_NEW(m_allocator, Pose)(m_allocator);
+				animator.lod_poses[1] = LUMIX_NEW(m_allocator, Pose)(m_allocator);
+			}
+			if (animator.lod_poses[0]->count != pose->count) {
+				animator.lod_poses[0]->resize(pose->count);
+				animator.lod_poses[1]->resize(pose->count);
+				animator.are_lod_poses_valid = false;
+			}
+
+			if (animator.are_lod_poses_valid && ++animator.frames_since_update < animator.update_interval) {
+				blendLODPoses(animator, *pose);
+				m_render_scene->unlockPose(entity, true);
+				return nullptr;
+			}
+			
+			if (animator.are_lod_poses_valid) swap(animator.lod_poses[0], animator.lod_poses[1]);
+			animator.frames_since_update = 0;
+			evaluated_pose = animator.lod_poses[1];
+		}
+
+		model->getRelativePose(*evaluated_pose);
+		animator.resource->compilePose(*animator.ctx, *evaluated_pose);
+		animator.evaluated_pose = evaluated_pose;
+		return evaluated_pose;
+	}
+
+	void endUpdate(Animator& animator) {
+		Pose& pose = *animator.evaluated_pose;
+		Model& model = *animator.ctx->model;
+		animator.evaluated_pose = nullptr;
+		animator.resource->finishPose(*animator.ctx, pose);
+
 		for (Animator::IK& ik : animator.inverse_kinematics) {
 			if (ik.weight == 0) break;
 			const u32 idx = u32(&ik - animator.inverse_kinematics);
-			updateIK(animator.resource->m_ik[idx], ik, *pose, *model);
+			updateIK(animator.resource->m_ik[idx], ik, pose, model);
 		}
 
-		pose->computeAbsolute(*model);
+		pose.computeAbsolute(model);
 
-		m_render_scene->unlockPose(entity, true);
+		if (animator.update_interval > 1) {
+			if (!animator.are_lod_poses_valid) {
+				copyPose(*animator.lod_poses[1], *animator.lod_poses[0]);
+				animator.are_lod_poses_valid = true;
+			}
+			blendLODPoses(animator, *m_render_scene->lockPose(animator.entity));
+		}
+		m_render_scene->unlockPose(animator.entity, true);
+	}
+
+	void updateAnimator(Animator& animator, float time_delta) {
+		Pose* pose = beginUpdate(animator, time_delta, nullptr);
+		if (!pose) return;
+
+		animator.resource->executePose(*animator.ctx, *pose, 0, pose->count);
+		endUpdate(animator);
 	}
 
 	static LocalRigidTransform getAbsolutePosition(const Pose& pose, const Model& model, int bone_index)
@@ -824,9 +985,49 @@ struct AnimationSceneImpl final : AnimationScene
 		updateAnimables(time_delta);
 		updatePropertyAnimators(time_delta);
 
-		jobs::forEach(m_animators.size(), 1, [&](i32 idx, i32){
-			updateAnimator(m_animators[idx], time_delta);
-		});
+		PROFILE_BLOCK("animators");
+		os::Timer timer;
+		LODCamera camera;
+		bool use_lods = false;
+		const EntityPtr camera_entity = m_render_scene->getActiveCamera();
+		if (camera_entity.isValid()) {
+			const Viewport vp = m_render_scene->getCameraViewport(*camera_entity);
+			// screen size is not computed for ortho cameras
+			use_lods = !vp.is_ortho;
+			camera.pos = vp.pos;
+			camera.frustum = vp.getFrustum().getRelative(vp.pos);
+			camera.inv_tan_half_fov = 1 / tanf(vp.fov * 0.5f);
+
+			const EntityPtr env_entity = m_render_scene->getActiveEnvironment();
+			if (env_entity.isValid()) {
+				const Environment& env = m_render_scene->getEnvironment(*env_entity);
+				if (env.flags.isSet(Environment::CAST_SHADOWS)) {
+					// light direction points to the light, see Pipeline
+					camera.shadow_dir = normalize(m_world.getRotation(*env_entity).rotate(Vec3(0, 0, 1)));
+					camera.shadow_distance = env.cascades.w;
+				}
+			}
+		}
+
+		const anim::EvaluatePosesStats stats = anim::evaluatePoses(m_animators.size(), m_heavy_animators
+			, [&](u32 idx, u32& ops_count) -> Pose* {
+				Animator& animator = m_animators[idx];
+				Pose* pose = beginUpdate(animator, time_delta, use_lods ? &camera : nullptr);
+				if (pose) ops_count = animator.ctx->pose_ops.size();
+				return pose;
+			}
+			, [&](u32 idx, Pose& pose, u32 from_bone, u32 to_bone) {
+				m_animators[idx].resource->executePose(*m_animators[idx].ctx, pose, from_bone, to_bone);
+			}
+			, [&](u32 idx, Pose&) { endUpdate(m_animators[idx]); });
+
+		profiler::pushInt("Animators", m_animators.size());
+		profiler::pushInt("Evaluated poses", stats.evaluated_count);
+		profiler::pushInt("Heavy poses", stats.heavy_count);
+		static const u32 animators_counter = profiler::createCounter("Animators", 0);
+		static const u32 animators_time_counter = profiler::createCounter("Animators update (ms)", 0);
+		profiler::pushCounter(animators_counter, float(m_animators.size()));
+		profiler::pushCounter(animators_time_counter, timer.getTimeSinceStart() * 1000);
 	}
 
 
@@ -893,6 +1094,10 @@ struct AnimationSceneImpl final : AnimationScene
 	AssociativeArray<EntityRef, PropertyAnimator> m_property_animators;
 	HashMap<EntityRef, u32> m_animator_map;
 	Array<Animator> m_animators;
+	// scratch for anim::evaluatePoses
+	Array<anim::HeavyPose> m_heavy_animators;
+	AnimatorLOD m_lods[4];
+	u32 m_lods_count;
 	RenderScene* m_render_scene;
 	bool m_is_game_running;
 };
@@ -18,6 +18,16 @@ struct Animable {
 	EntityRef entity;
 };
 
+// animators smaller on screen than `screen_size` use this LOD
+struct AnimatorLOD {
+	// radius of model's bounding sphere relative to half of screen height
+	float screen_size;
+	// pose is evaluated every `update_interval` frames and interpolated in between, so it lags a few frames behind root motion
+	u32 update_interval;
+	// bones deeper in hierarchy are not animated
+	u32 max_bone_depth;
+};
+
 struct AnimationScene : IScene {
 	static UniquePtr<AnimationScene> create(Engine& engine, IPlugin& plugin, World& world, struct IAllocator& allocator);
 	static void reflect(Engine& engine);
@@ -49,6 +59,10 @@ struct AnimationScene : IScene {
 	virtual anim::Controller* getAnimatorController(EntityRef entity) = 0;
 	virtual void setAnimatorIK(EntityRef entity, u32 index, float weight, const struct Vec3& target) = 0;
 	virtual float getAnimationLength(int animation_idx) = 0;
+	// sorted by decreasing screen size; animators whose only visible part is their shadow use the last LOD,
+	// animators not visible at all are updated only every few frames, unless they have bone attachments
+	virtual void setAnimatorLODs(Span<const AnimatorLOD> lods) = 0;
+	virtual Span<const AnimatorLOD> getAnimatorLODs() const = 0;
 };
 
 
@@ -1,6 +1,7 @@
 #include "animation.h"
 #include "controller.h"
 #include "nodes.h"
+#include "engine/crt.h"
 #include "engine/hash.h"
 #include "engine/log.h"
 #include "engine/resource_manager.h"
@@ -76,6 +77,10 @@ RuntimeContext* Controller::createRuntime(u32 anim_set) {
 	memset(ctx->inputs.begin(), 0, ctx->inputs.byte_size());
 	ctx->animations.resize(m_animation_slots.size());
 	memset(ctx->animations.begin(), 0, ctx->animations.byte_size());
+	ctx->bone_remaps.reserve(m_animation_slots.size());
+	for (i32 i = 0; i < m_animation_slots.size(); ++i) {
+		ctx->bone_remaps.emplace(m_allocator);
+	}
 	for (AnimationEntry& anim : m_animation_entries) {
 		if (anim.set == anim_set) {
 			ctx->animations[anim.slot] = anim.animation;
@@ -142,30 +147,76 @@ void Controller::update(RuntimeContext& ctx, LocalRigidTransform& root_motion) c
 	}
 }
 
-void Controller::getPose(RuntimeContext& ctx, Pose& pose) {
+void Controller::compilePose(RuntimeContext& ctx, const Pose& pose) const {
 	ASSERT(&ctx.controller == this);
 	ctx.input_runtime.set(ctx.data.data(), ctx.data.size());
 	
-	LocalRigidTransform root_bind_pose;
 	auto root_bone_iter = ctx.model->getBoneIndex(ctx.root_bone_hash);
 	if (root_bone_iter.isValid()) {
 		const int root_bone_idx = root_bone_iter.value();
-		root_bind_pose.pos = pose.positions[root_bone_idx];
-		root_bind_pose.rot = pose.rotations[root_bone_idx];
+		ctx.root_bind_pose.pos = pose.positions[root_bone_idx];
+		ctx.root_bind_pose.rot = pose.rotations[root_bone_idx];
 	}
 	
-	m_root->getPose(ctx, 1.f, pose, 0xffFFffFF);
-	
+	ctx.pose_ops.clear();
+	m_root->getPose(ctx, 1.f, 0xffFFffFF);
+
+	if (ctx.blend_pose.count != pose.count) ctx.blend_pose.resize(pose.count);
+	ctx.bone_weights.clear();
+	// rebuilt only if the model or the animation changed, so executePose can run in parallel without locks
+	for (PoseOp& op : ctx.pose_ops) {
+		op.anim->updateBoneRemap(*ctx.model, ctx.bone_remaps[op.slot]);
+		if (!op.mask || op.weight >= 0.9999f) continue;
+
+		op.bone_weights = ctx.bone_weights.size();
+		ctx.bone_weights.resize(op.bone_weights + pose.count);
+		float* weights = &ctx.bone_weights[op.bone_weights];
+		memset(weights, 0, sizeof(float) * pose.count);
+		for (auto iter = op.mask->bones.begin(), end = op.mask->bones.end(); iter != end; ++iter) {
+			auto bone_iter = ctx.model->getBoneIndex(iter.key());
+			if (bone_iter.isValid()) weights[bone_iter.value()] = op.weight;
+		}
+	}
+}
+
+void Controller::executePose(RuntimeContext& ctx, Pose& pose, u32 from_bone, u32 to_bone) const {
+	to_bone = minimum(to_bone, pose.count);
+	if (from_bone >= to_bone) return;
+
+	Pose& tmp = ctx.blend_pose;
+	ASSERT(tmp.count == pose.count);
+	for (const PoseOp& op : ctx.pose_ops) {
+		const Animation::BoneRemap& remap = ctx.bone_remaps[op.slot];
+		if (op.weight >= 0.9999f) {
+			op.anim->getRelativePose(op.time, pose, remap, 1, op.mask, ctx.max_bone_depth, from_bone, to_bone);
+			continue;
+		}
+
+		// bones without curves keep the current pose, masked out bones have 0 weight
+		memcpy(tmp.positions + from_bone, pose.positions + from_bone, sizeof(pose.positions[0]) * (to_bone - from_bone));
+		memcpy(tmp.rotations + from_bone, pose.rotations + from_bone, sizeof(pose.rotations[0]) * (to_bone - from_bone));
+		op.anim->getRelativePose(op.time, tmp, remap, 1, nullptr, ctx.max_bone_depth, from_bone, to_bone);
+		if (op.mask) {
+			pose.blend(tmp, Span<const float>(&ctx.bone_weights[op.bone_weights], pose.count), from_bone, to_bone);
+		}
+		else {
+			pose.blend(tmp, op.weight, from_bone, to_bone);
+		}
+	}
+}
+
+void Controller::finishPose(const RuntimeContext& ctx, Pose& pose) const {
 	// TODO this should be in AnimationNode
+	auto root_bone_iter = ctx.model->getBoneIndex(ctx.root_bone_hash);
 	if (root_bone_iter.isValid()) {
 		const int root_bone_idx = root_bone_iter.value();
 		if (m_flags.isSet(Flags::XZ_ROOT_MOTION)) {
-			pose.positions[root_bone_idx].x = root_bind_pose.pos.x;
-			pose.positions[root_bone_idx].z = root_bind_pose.pos.z;
+			pose.positions[root_bone_idx].x = ctx.root_bind_pose.pos.x;
+			pose.positions[root_bone_idx].z = ctx.root_bind_pose.pos.z;
 		}
 		else {
-			pose.positions[root_bone_idx] = root_bind_pose.pos;
-			pose.rotations[root_bone_idx] = root_bind_pose.rot;
+			pose.positions[root_bone_idx] = ctx.root_bind_pose.pos;
+			pose.rotations[root_bone_idx] = ctx.root_bind_pose.rot;
 		}
 	}
 }
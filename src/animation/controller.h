@@ -36,7 +36,11 @@ public:
 	RuntimeContext* createRuntime(u32 anim_set);
 	void destroyRuntime(RuntimeContext& ctx);
 	void update(RuntimeContext& ctx, LocalRigidTransform& root_motion) const;
-	void getPose(RuntimeContext& ctx, struct Pose& pose);
+	// flattens node tree to ctx.pose_ops, `pose` must contain model's relative bind pose
+	void compilePose(RuntimeContext& ctx, const struct Pose& pose) const;
+	// executes ctx.pose_ops on model's bones in [from_bone, to_bone), different ranges can run in parallel
+	void executePose(RuntimeContext& ctx, Pose& pose, u32 from_bone, u32 to_bone) const;
+	void finishPose(const RuntimeContext& ctx, Pose& pose) const;
 	void initEmpty();
 	void destroy();
 
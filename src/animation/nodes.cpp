@@ -80,8 +80,12 @@ RuntimeContext::RuntimeContext(Controller& controller, IAllocator& allocator)
 	, inputs(allocator)
 	, controller(controller)
 	, animations(allocator)
+	, bone_remaps(allocator)
 	, events(allocator)
 	, input_runtime(nullptr, 0)
+	, pose_ops(allocator)
+	, bone_weights(allocator)
+	, blend_pose(allocator)
 {
 }
 
@@ -204,7 +208,7 @@ void Blend1DNode::skip(RuntimeContext& ctx) const {
 	ctx.input_runtime.skip(sizeof(float));
 }
 
-static void getPose(const RuntimeContext& ctx, float rel_time, float weight, u32 slot, Pose& pose, u32 mask_idx, bool looped) {
+static void getPose(RuntimeContext& ctx, float rel_time, float weight, u32 slot, u32 mask_idx, bool looped) {
 	Animation* anim = ctx.animations[slot];
 	if (!anim) return;
 	if (!ctx.model->isReady()) return;
@@ -214,10 +218,10 @@ static void getPose(const RuntimeContext& ctx, float rel_time, float weight, u32
 	const Time anim_time = looped ? time % anim->getLength() : minimum(time, anim->getLength());
 
 	const BoneMask* mask = mask_idx < (u32)ctx.controller.m_bone_masks.size() ? &ctx.controller.m_bone_masks[mask_idx] : nullptr;
-	anim->getRelativePose(anim_time, pose, *ctx.model, weight, mask);
+	ctx.pose_ops.push({anim, slot, anim_time, weight, mask, 0});
 }
 
-static void getPose(const RuntimeContext& ctx, Time time, float weight, u32 slot, Pose& pose, u32 mask_idx, bool looped) {
+static void getPose(RuntimeContext& ctx, Time time, float weight, u32 slot, u32 mask_idx, bool looped) {
 	Animation* anim = ctx.animations[slot];
 	if (!anim) return;
 	if (!ctx.model->isReady()) return;
@@ -226,24 +230,24 @@ static void getPose(const RuntimeContext& ctx, Time time, float weight, u32 slot
 	const Time anim_time = looped ? time % anim->getLength() : minimum(time, anim->getLength());
 
 	const BoneMask* mask = mask_idx < (u32)ctx.controller.m_bone_masks.size() ? &ctx.controller.m_bone_masks[mask_idx] : nullptr;
-	anim->getRelativePose(anim_time, pose, *ctx.model, weight, mask);
+	ctx.pose_ops.push({anim, slot, anim_time, weight, mask, 0});
 }
 
-void Blend1DNode::getPose(RuntimeContext& ctx, float weight, Pose& pose, u32 mask) const {
+void Blend1DNode::getPose(RuntimeContext& ctx, float weight, u32 mask) const {
 	const float t = ctx.input_runtime.read<float>();
 
 	if (m_children.empty()) return;
 	if (m_children.size() == 1) {
-		anim::getPose(ctx, t, weight, m_children[0].slot, pose, mask, true);
+		anim::getPose(ctx, t, weight, m_children[0].slot, mask, true);
 		return;
 	}
 
 	const float input_val = getInputValue(ctx, m_input_index);
 	const Blend1DActivePair pair = getActivePair(*this, input_val);
 	
-	anim::getPose(ctx, t, weight, pair.a->slot, pose, mask, true);
+	anim::getPose(ctx, t, weight, pair.a->slot, mask, true);
 	if (pair.b) {
-		anim::getPose(ctx, t, weight * pair.t, pair.b->slot, pose, mask, true);
+		anim::getPose(ctx, t, weight * pair.t, pair.b->slot, mask, true);
 	}
 }
 
@@ -344,9 +348,9 @@ void AnimationNode::skip(RuntimeContext& ctx) const {
 	ctx.input_runtime.skip(sizeof(Time));
 }
 	
-void AnimationNode::getPose(RuntimeContext& ctx, float weight, Pose& pose, u32 mask) const {
+void AnimationNode::getPose(RuntimeContext& ctx, float weight, u32 mask) const {
 	const Time t = ctx.input_runtime.read<Time>();
-	anim::getPose(ctx, t, weight, m_slot, pose, mask, m_flags & LOOPED);
+	anim::getPose(ctx, t, weight, m_slot, mask, m_flags & LOOPED);
 }
 
 void AnimationNode::serialize(OutputMemoryStream& stream) const {
@@ -404,9 +408,9 @@ void LayersNode::skip(RuntimeContext& ctx) const {
 	}
 }
 
-void LayersNode::getPose(RuntimeContext& ctx, float weight, Pose& pose, u32 mask) const {
+void LayersNode::getPose(RuntimeContext& ctx, float weight, u32 mask) const {
 	for (const Layer& layer : m_layers) {
-		layer.node.getPose(ctx, weight, pose, layer.mask);
+		layer.node.getPose(ctx, weight, layer.mask);
 	}
 }
 
@@ -559,13 +563,13 @@ void GroupNode::skip(RuntimeContext& ctx) const {
 	}
 }
 	
-void GroupNode::getPose(RuntimeContext& ctx, float weight, Pose& pose, u32 mask) const {
+void GroupNode::getPose(RuntimeContext& ctx, float weight, u32 mask) const {
 	const RuntimeData data = ctx.input_runtime.read<RuntimeData>();
 
-	m_children[data.from].node->getPose(ctx, weight, pose, mask);
+	m_children[data.from].node->getPose(ctx, weight, mask);
 	if(data.from != data.to) {
 		const float t = clamp(data.t.seconds() / data.blend_length.seconds(), 0.f, 1.f);
-		m_children[data.to].node->getPose(ctx, weight * t, pose, mask);
+		m_children[data.to].node->getPose(ctx, weight * t, mask);
 	}
 }
 
@@ -3,13 +3,13 @@
 #include "animation/animation.h"
 #include "engine/array.h"
 #include "engine/stream.h"
+#include "renderer/pose.h"
 
 
 namespace Lumix
 {
 
 struct Model;
-struct Pose;
 
 namespace anim
 {
@@ -17,6 +17,19 @@ namespace anim
 struct Controller;
 struct GroupNode;
 
+// samples `anim` and blends it into the pose with `weight`, only bones in `mask`
+// node tree is flattened to a list of these, so the list can be executed on any subset of bones
+struct PoseOp {
+	Animation* anim;
+	// index to RuntimeContext::animations and RuntimeContext::bone_remaps
+	u32 slot;
+	Time time;
+	float weight;
+	const BoneMask* mask;
+	// offset to RuntimeContext::bone_weights, used if the op is masked and blended
+	u32 bone_weights;
+};
+
 struct RuntimeContext {
 	RuntimeContext(Controller& controller, IAllocator& allocator);
 
@@ -26,13 +39,24 @@ struct RuntimeContext {
 	Controller& controller;
 	Array<u8> inputs;
 	Array<Animation*> animations;
+	// for each slot, updated by Controller::compilePose and read without locks by Controller::executePose
+	Array<Animation::BoneRemap> bone_remaps;
 	OutputMemoryStream data;
 	OutputMemoryStream events;
 	
 	BoneNameHash root_bone_hash;
 	Time time_delta;
 	Model* model = nullptr;
+	// bones deeper in model's hierarchy keep their current pose, used by LODs
+	u32 max_bone_depth = 0xffFFffFF;
 	InputMemoryStream input_runtime;
+	// built by Controller::compilePose
+	Array<PoseOp> pose_ops;
+	// per bone weights of masked ops, 0 for bones not in the mask
+	Array<float> bone_weights;
+	// weighted ops are sampled here and blended to the final pose, each executePose call touches only its bones
+	Pose blend_pose;
+	LocalRigidTransform root_bind_pose;
 };
 
 struct Node {
@@ -54,7 +78,8 @@ struct Node {
 	virtual void update(RuntimeContext& ctx, LocalRigidTransform& root_motion) const = 0;
 	virtual void enter(RuntimeContext& ctx) const = 0;
 	virtual void skip(RuntimeContext& ctx) const = 0;
-	virtual void getPose(RuntimeContext& ctx, float weight, Pose& pose, u32 mask) const = 0;
+	// appends ops to ctx.pose_ops
+	virtual void getPose(RuntimeContext& ctx, float weight, u32 mask) const = 0;
 	virtual void serialize(OutputMemoryStream& stream) const = 0;
 	virtual void deserialize(InputMemoryStream& stream, Controller& ctrl, u32 version) = 0;
 	virtual Time length(const RuntimeContext& ctx) const = 0;
@@ -76,7 +101,7 @@ struct AnimationNode final : Node {
 	void update(RuntimeContext& ctx, LocalRigidTransform& root_motion) const override;
 	void enter(RuntimeContext& ctx) const override;
 	void skip(RuntimeContext& ctx) const override;
-	void getPose(RuntimeContext& ctx, float weight, Pose& pose, u32 mask) const override;
+	void getPose(RuntimeContext& ctx, float weight, u32 mask) const override;
 	void serialize(OutputMemoryStream& stream) const override;
 	void deserialize(InputMemoryStream& stream, Controller& ctrl, u32 version) override;
 	Time length(const RuntimeContext& ctx) const override;
@@ -97,7 +122,7 @@ struct Blend1DNode final : Node {
 	void update(RuntimeContext& ctx, LocalRigidTransform& root_motion) const override;
 	void enter(RuntimeContext& ctx) const override;
 	void skip(RuntimeContext& ctx) const override;
-	void getPose(RuntimeContext& ctx, float weight, Pose& pose, u32 mask) const override;
+	void getPose(RuntimeContext& ctx, float weight, u32 mask) const override;
 	void serialize(OutputMemoryStream& stream) const override;
 	void deserialize(InputMemoryStream& stream, Controller& ctrl, u32 version) override;
 	Time length(const RuntimeContext& ctx) const override;
@@ -121,7 +146,7 @@ struct GroupNode final : Node {
 	void update(RuntimeContext& ctx, LocalRigidTransform& root_motion) const override;
 	void enter(RuntimeContext& ctx) const override;
 	void skip(RuntimeContext& ctx) const override;
-	void getPose(RuntimeContext& ctx, float weight, Pose& pose, u32 mask) const override;
+	void getPose(RuntimeContext& ctx, float weight, u32 mask) const override;
 	void serialize(OutputMemoryStream& stream) const override;
 	void deserialize(InputMemoryStream& stream, Controller& ctrl, u32 version) override;
 	Time length(const RuntimeContext& ctx) const override;
@@ -170,7 +195,7 @@ struct LayersNode final : Node {
 	void update(RuntimeContext& ctx, LocalRigidTransform& root_motion) const override;
 	void enter(RuntimeContext& ctx) const override;
 	void skip(RuntimeContext& ctx) const override;
-	void getPose(RuntimeContext& ctx, float weight, Pose& pose, u32 mask) const override;
+	void getPose(RuntimeContext& ctx, float weight, u32 mask) const override;
 	void serialize(OutputMemoryStream& stream) const override;
 	void deserialize(InputMemoryStream& stream, Controller& ctrl, u32 version) override;
 	Time length(const RuntimeContext& ctx) const override;
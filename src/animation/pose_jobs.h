@@ -0,0 +1,82 @@
+#pragma once
+
+
+#include "engine/array.h"
+#include "engine/atomic.h"
+#include "engine/job_system.h"
+#include "engine/math.h"
+#include "engine/profiler.h"
+#include "renderer/pose.h"
+
+
+namespace Lumix
+{
+
+
+namespace anim
+{
+
+
+// poses with more sampled curves (ops * bones) are evaluated in parallel bone ranges
+constexpr u32 HEAVY_POSE_COST = 4096;
+
+struct HeavyPose {
+	u32 idx;
+	Pose* pose;
+};
+
+struct EvaluatePosesStats {
+	i32 evaluated_count = 0;
+	i32 heavy_count = 0;
+};
+
+// evaluates poses of `count` animators on the job system, light animators are batched, many per job, since job overhead
+// dominates with thousands of simple animators, heavy ones are split in a bone range per worker
+// `begin(idx, u32& ops_count)` returns the pose to evaluate, or nullptr if the animator is not evaluated this frame
+// `execute(idx, Pose&, from_bone, to_bone)` evaluates a range of bones, ranges of a pose can run in parallel
+// `end(idx, Pose&)` is called once the whole pose is evaluated
+// `heavy` is a scratch array, so it does not need to be allocated each frame
+template <typename Begin, typename Execute, typename End>
+EvaluatePosesStats evaluatePoses(u32 count, Array<HeavyPose>& heavy, const Begin& begin, const Execute& execute, const End& end) {
+	EvaluatePosesStats stats;
+	const u32 workers_count = jobs::getWorkersCount();
+	heavy.resize(count);
+	const i32 step = maximum(1, i32(count / (workers_count * 4)));
+	jobs::forEach(count, step, [&](i32 from, i32 to){
+		PROFILE_BLOCK("update animators");
+		for (i32 i = from; i < to; ++i) {
+			u32 ops_count = 0;
+			Pose* pose = begin(u32(i), ops_count);
+			if (!pose) continue;
+
+			atomicIncrement(&stats.evaluated_count);
+			if (ops_count * pose->count > HEAVY_POSE_COST) {
+				heavy[atomicIncrement(&stats.heavy_count) - 1] = {u32(i), pose};
+				continue;
+			}
+			execute(u32(i), *pose, 0, pose->count);
+			end(u32(i), *pose);
+		}
+	});
+
+	if (stats.heavy_count > 0) {
+		PROFILE_BLOCK("heavy animators");
+		jobs::forEach(stats.heavy_count * workers_count, 1, [&](i32 idx, i32){
+			const HeavyPose& h = heavy[idx / workers_count];
+			const u32 range = idx % workers_count;
+			const u32 from = h.pose->count * range / workers_count;
+			const u32 to = h.pose->count * (range + 1) / workers_count;
+			execute(h.idx, *h.pose, from, to);
+		});
+		jobs::forEach(stats.heavy_count, 1, [&](i32 idx, i32){
+			end(heavy[idx].idx, *heavy[idx].pose);
+		});
+	}
+	return stats;
+}
+
+
+} // namespace anim
+
+
+} // namespace Lumix
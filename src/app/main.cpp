@@ -153,6 +153,63 @@ struct Runner final
 		return false;
 	}
 
+	void parseProfilerOptions() {
+		char cmd_line[2048];
+		os::getCommandLine(Span(cmd_line));
+
+		CommandLineParser parser(cmd_line);
+		while (parser.next()) {
+			const bool is_frames = parser.currentEquals("-profile_frames");
+			const bool is_spike = parser.currentEquals("-profile_spike_ms");
+			const bool is_output = parser.currentEquals("-profile_output");
+			if (!is_frames && !is_spike && !is_output) continue;
+
+			if (!parser.next()) {
+				logError("Command line option without value");
+				return;
+			}
+			char tmp[LUMIX_MAX_PATH];
+			parser.getCurrent(tmp, sizeof(tmp));
+			if (is_frames) fromCString(Span(tmp, stringLength(tmp)), m_profile_frames);
+			else if (is_spike) m_profile_spike_ms = (float)atof(tmp);
+			else m_profile_output = tmp;
+		}
+	}
+
+	void saveProfilerCapture(const char* path) {
+		os::OutputFile file;
+		if (!file.open(path)) {
+			logError("Failed to create ", path);
+			return;
+		}
+		profiler::exportChromeTrace(file);
+		if (file.isError()) logError("Failed to write ", path);
+		else logInfo("Profiler capture saved to ", path);
+		file.close();
+	}
+
+	// -profile_frames N - save capture after N frames
+	// -profile_spike_ms X - save capture when a frame takes longer than X ms
+	// -profile_output path - where to save the capture
+	void updateProfilerCapture() {
+		profiler::frame();
+		++m_frame_index;
+
+		if (m_frame_index == m_profile_frames) {
+			saveProfilerCapture(m_profile_output);
+		}
+
+		if (m_profile_spike_ms > 0 && profiler::getLastFrameDuration() * 1000 > m_profile_spike_ms) {
+			// spikes usually come in groups, and the next capture would contain mostly the same data anyway
+			if (m_last_spike_capture_frame == 0 || m_frame_index - m_last_spike_capture_frame > 300) {
+				m_last_spike_capture_frame = m_frame_index;
+				const char* output = m_profile_output;
+				const StaticString<LUMIX_MAX_PATH> path(Path::getDir(output), Path::getBasename(output), "_spike_", m_frame_index, ".json");
+				saveProfilerCapture(path);
+			}
+		}
+	}
+
 	void loadProject() {
 		FileSystem& fs = m_engine->getFileSystem();
 		OutputMemoryStream data(m_allocator);
@@ -203,6 +260,7 @@ struct Runner final
 		os::showCursor(false);
 		onResize();
 		m_engine->startGame(*m_world);
+		parseProfilerOptions();
 	}
 
 	void shutdown() {
@@ -267,6 +325,8 @@ struct Runner final
 		m_pipeline->setViewport(m_viewport);
 		m_pipeline->render(false);
 		m_renderer->frame();
+		m_main_allocator.pushProfilerCounters();
+		updateProfilerCapture();
 	}
 
 	DefaultAllocator m_main_allocator;
@@ -276,6 +336,11 @@ struct Runner final
 	World* m_world = nullptr;
 	UniquePtr<Pipeline> m_pipeline;
 	char m_startup_world[96] = "main";
+	u32 m_frame_index = 0;
+	u32 m_profile_frames = 0;
+	float m_profile_spike_ms = 0;
+	u32 m_last_spike_capture_frame = 0;
+	StaticString<LUMIX_MAX_PATH> m_profile_output = "profile.json";
 
 	Viewport m_viewport;
 	bool m_finished = false;
@@ -0,0 +1,346 @@
+#include "animation/animation.h"
+#include "animation/pose_jobs.h"
+#include "bench/bench.h"
+#include "engine/allocator.h"
+#include "engine/array.h"
+#include "engine/atomic.h"
+#include "engine/crt.h"
+#include "engine/file_system.h"
+#include "engine/job_system.h"
+#include "engine/log.h"
+#include "engine/os.h"
+#include "engine/path.h"
+#include "engine/resource.h"
+#include "engine/resource_manager.h"
+#include "engine/stream.h"
+#include "renderer/pose.h"
+
+using namespace Lumix;
+
+namespace {
+
+constexpr u32 LIGHT_BONES_COUNT = 60;
+// hero characters with many bones, e.g. fingers and facial bones
+constexpr u32 HEAVY_BONES_COUNT = 600;
+constexpr u32 FRAMES_COUNT = 30;
+// per skeleton type
+constexpr u32 ANIMATIONS_COUNT = 4;
+const char* DATA_DIR = "bench_data/";
+
+struct AnimationManager final : ResourceManager {
+	explicit AnimationManager(IAllocator& allocator)
+		: ResourceManager(allocator)
+		, m_allocator(allocator)
+	{}
+
+	Resource* createResource(const Path& path) override {
+		return LUMIX_NEW(m_allocator, Animation)(path, *this, m_allocator);
+	}
+
+	void destroyResource(Resource& resource) override {
+		LUMIX_DELETE(m_allocator, static_cast<Animation*>(&resource));
+	}
+
+	IAllocator& m_allocator;
+};
+
+BoneNameHash getBoneName(u32 bone) {
+	char name[32] = "bone";
+	toCString(bone, Span(name + 4, name + lengthOf(name)));
+	return BoneNameHash(name);
+}
+
+Quat getRandomRotation() {
+	return normalize(Quat(randFloat(-1, 1), randFloat(-1, 1), randFloat(-1, 1), randFloat(-1, 1)));
+}
+
+// like imported character animations: root translation is sampled, the rest of translations are constant,
+// half of rotations are sampled, the other half are keyframed
+void writeAnimation(u32 bones_count, OutputMemoryStream& blob) {
+	// filled in when the animation is written
+	blob.write(CompiledResourceHeader());
+
+	Animation::Header header;
+	header.magic = Animation::HEADER_MAGIC;
+	header.version = Animation::Version::QUANTIZED;
+	header.length = Time::fromSeconds(1);
+	header.frame_count = FRAMES_COUNT;
+	blob.write(header);
+
+	blob.write(bones_count);
+	for (u32 bone = 0; bone < bones_count; ++bone) {
+		blob.write(getBoneName(bone));
+		if (bone == 0) {
+			blob.write(Animation::CurveType::SAMPLED);
+			blob.write(FRAMES_COUNT);
+			blob.write(Vec3(-1));
+			blob.write(Vec3(2.f / 0xffFF));
+			for (u32 i = 0; i < FRAMES_COUNT * 3; ++i) blob.write((u16)rand(0, 0xffFF));
+		}
+		else {
+			blob.write(Animation::CurveType::CONSTANT);
+			blob.write((u32)1);
+			blob.write(Vec3(0, 0.1f, 0));
+		}
+	}
+
+	blob.write(bones_count);
+	for (u32 bone = 0; bone < bones_count; ++bone) {
+		blob.write(getBoneName(bone));
+		const bool keyframed = bone % 2 == 1;
+		const u32 count = keyframed ? FRAMES_COUNT / 3 : FRAMES_COUNT;
+		blob.write(keyframed ? Animation::CurveType::KEYFRAMED : Animation::CurveType::SAMPLED);
+		blob.write(count);
+		if (keyframed) {
+			// irregular times, first and last key are at the start and end
+			for (u32 i = 0; i < count; ++i) blob.write(u16(i == count - 1 ? 0xffFF : (i * 0xffFF + rand(0, 0x7ff)) / count));
+		}
+		for (u32 i = 0; i < count; ++i) {
+			u16 key[3];
+			Animation::quantizeRotation(getRandomRotation(), key);
+			blob.write(key);
+		}
+	}
+
+	CompiledResourceHeader& compiled_header = *(CompiledResourceHeader*)blob.getMutableData();
+	compiled_header.decompressed_size = blob.size() - sizeof(CompiledResourceHeader);
+}
+
+// animations are loaded as they were compiled by the editor
+Path getAnimationPath(u32 idx) { return Path("anims/", u64(idx), ".ani"); }
+Path getCompiledPath(u32 idx) { return Path(".lumix/resources/", getAnimationPath(idx).getHash(), ".res"); }
+
+struct Skeleton {
+	explicit Skeleton(u32 count) : bones_count(count) {
+		for (u32 i = 0; i < count; ++i) {
+			names[i] = getBoneName(i);
+			parents[i] = i == 0 ? -1 : i32(i - 1) / 2;
+		}
+	}
+
+	Span<const BoneNameHash> getNames() const { return Span(names, bones_count); }
+	Span<const i32> getParents() const { return Span(parents, bones_count); }
+
+	BoneNameHash names[HEAVY_BONES_COUNT];
+	i32 parents[HEAVY_BONES_COUNT];
+	u32 bones_count;
+};
+
+// compiled animations written to DATA_DIR and loaded through the resource manager
+struct Animations {
+	explicit Animations(IAllocator& allocator)
+		: hub(allocator)
+		, manager(allocator)
+		, light_skeleton(LIGHT_BONES_COUNT)
+		, heavy_skeleton(HEAVY_BONES_COUNT)
+	{
+		const Path dir(DATA_DIR, ".lumix/resources");
+		if (!os::dirExists(dir) && !os::makePath(dir)) {
+			logError("Failed to create ", dir);
+			return;
+		}
+
+		fs = FileSystem::create(DATA_DIR, allocator);
+		OutputMemoryStream blob(allocator);
+		for (u32 i = 0; i < ANIMATIONS_COUNT * 2; ++i) {
+			blob.clear();
+			writeAnimation(i < ANIMATIONS_COUNT ? LIGHT_BONES_COUNT : HEAVY_BONES_COUNT, blob);
+			if (!fs->saveContentSync(getCompiledPath(i), blob)) {
+				logError("Failed to write animations to ", dir);
+				return;
+			}
+		}
+
+		hub.init(*fs);
+		manager.create(Animation::TYPE, hub);
+		for (u32 i = 0; i < ANIMATIONS_COUNT; ++i) {
+			light[i] = hub.load<Animation>(getAnimationPath(i));
+			heavy[i] = hub.load<Animation>(getAnimationPath(ANIMATIONS_COUNT + i));
+		}
+		while (fs->hasWork()) {
+			// animations are loaded in prepare jobs, we are a job too, so we must let them run
+			fs->waitForPrepareJobs();
+			fs->processCallbacks();
+		}
+
+		ready = true;
+		for (Animation* anim : light) ready = ready && anim->isReady();
+		for (Animation* anim : heavy) ready = ready && anim->isReady();
+		if (!ready) logError("Failed to load animations");
+	}
+
+	~Animations() {
+		for (Animation* anim : light) if (anim) anim->decRefCount();
+		for (Animation* anim : heavy) if (anim) anim->decRefCount();
+		if (light[0]) manager.destroy();
+		for (u32 i = 0; i < ANIMATIONS_COUNT * 2; ++i) os::deleteFile(Path(DATA_DIR, getCompiledPath(i).c_str()));
+	}
+
+	UniquePtr<FileSystem> fs;
+	ResourceManagerHub hub;
+	AnimationManager manager;
+	Animation* light[ANIMATIONS_COUNT] = {};
+	Animation* heavy[ANIMATIONS_COUNT] = {};
+	Skeleton light_skeleton;
+	Skeleton heavy_skeleton;
+	bool ready = false;
+};
+
+// samples animations into a pose, like a controller compiled to pose ops
+struct Animator {
+	static constexpr u32 MAX_OPS = 8;
+
+	explicit Animator(IAllocator& allocator)
+		: pose(allocator)
+		, blend_pose(allocator)
+		, remaps{
+			Animation::BoneRemap(allocator), Animation::BoneRemap(allocator), Animation::BoneRemap(allocator), Animation::BoneRemap(allocator),
+			Animation::BoneRemap(allocator), Animation::BoneRemap(allocator), Animation::BoneRemap(allocator), Animation::BoneRemap(allocator)
+		}
+	{}
+
+	void init(Span<Animation* const> anims, u32 ops, const Skeleton& skeleton) {
+		ASSERT(ops <= MAX_OPS);
+		pose.resize(skeleton.bones_count);
+		blend_pose.resize(skeleton.bones_count);
+		parents = skeleton.parents;
+		ops_count = ops;
+		for (u32 i = 0; i < ops; ++i) {
+			animations[i] = anims[i % anims.length()];
+			animations[i]->updateBoneRemap(skeleton.getNames(), skeleton.getParents(), remaps[i]);
+			times[i] = randFloat(0, 1);
+		}
+	}
+
+	// first op overwrites the pose, the rest are sampled to `blend_pose` and blended on top of it, like Controller::executePose
+	void execute(float time_offset, u32 from_bone, u32 to_bone) {
+		to_bone = minimum(to_bone, pose.count);
+		for (u32 i = 0; i < ops_count; ++i) {
+			float anim_time = times[i] + time_offset;
+			anim_time -= u32(anim_time);
+			const Time time = Time::fromSeconds(anim_time);
+			if (i == 0) {
+				animations[i]->getRelativePose(time, pose, remaps[i], 1, nullptr, 0xffFFffFF, from_bone, to_bone);
+				continue;
+			}
+			memcpy(blend_pose.positions + from_bone, pose.positions + from_bone, sizeof(pose.positions[0]) * (to_bone - from_bone));
+			memcpy(blend_pose.rotations + from_bone, pose.rotations + from_bone, sizeof(pose.rotations[0]) * (to_bone - from_bone));
+			animations[i]->getRelativePose(time, blend_pose, remaps[i], 1, nullptr, 0xffFFffFF, from_bone, to_bone);
+			pose.blend(blend_pose, 0.5f, from_bone, to_bone);
+		}
+	}
+
+	// the same as Pose::computeAbsolute, which needs a model
+	void computeAbsolute() {
+		for (u32 i = 1; i < pose.count; ++i) {
+			const i32 parent = parents[i];
+			pose.positions[i] = pose.rotations[parent].rotate(pose.positions[i]) + pose.positions[parent];
+			pose.rotations[i] = pose.rotations[parent] * pose.rotations[i];
+		}
+	}
+
+	bool isPoseValid() const {
+		for (u32 i = 0; i < pose.count; ++i) {
+			const Quat& r = pose.rotations[i];
+			if (fabsf(r.x * r.x + r.y * r.y + r.z * r.z + r.w * r.w - 1) > 0.01f) return false;
+		}
+		return true;
+	}
+
+	Pose pose;
+	Pose blend_pose;
+	const i32* parents = nullptr;
+	u32 ops_count = 0;
+	Animation* animations[MAX_OPS];
+	Animation::BoneRemap remaps[MAX_OPS];
+	float times[MAX_OPS];
+};
+
+} // anonymous namespace
+
+// each skeleton samples one animation and blends another one on top of it, like a simple controller
+LUMIX_BENCHMARK(animation_sampling) {
+	Animations animations(allocator);
+	if (!animations.ready) return;
+
+	const u32 counts[] = { 10, 100, 1'000, 10'000 };
+	for (u32 count : counts) {
+		Array<UniquePtr<Animator>> animators(allocator);
+		for (u32 i = 0; i < count; ++i) {
+			UniquePtr<Animator>& a = animators.emplace(UniquePtr<Animator>::create(allocator, allocator));
+			Animation* const anims[] = { animations.light[i % ANIMATIONS_COUNT], animations.light[(i + 1) % ANIMATIONS_COUNT] };
+			a->init(Span(anims), 2, animations.light_skeleton);
+		}
+
+		const u32 iterations = count >= 1'000 ? 20 : 200;
+		float time_offset = 0;
+		const float t = bench::measure(iterations, [&](){
+			time_offset += 0.016f;
+			jobs::forEach(count, 64, [&](i32 from, i32 to){
+				for (i32 i = from; i < to; ++i) {
+					animators[i]->execute(time_offset, 0, LIGHT_BONES_COUNT);
+				}
+			});
+		});
+
+		for (const UniquePtr<Animator>& a : animators) {
+			if (!a->isPoseValid()) {
+				logError("Invalid pose");
+				break;
+			}
+		}
+
+		logInfo(count, " skeletons: ", t * 1e3f, " ms, ", t * 1e6f / count, " us per skeleton, "
+			, float(count) * LIGHT_BONES_COUNT * 2 / t / 1e6f, " M bones/s");
+	}
+}
+
+// every 10th animator is a hero character with many bones and layers, i.e. a heavy animator evaluated in parallel bone ranges,
+// compares anim::evaluatePoses with evaluating the animators one by one
+LUMIX_BENCHMARK(animators) {
+	Animations animations(allocator);
+	if (!animations.ready) return;
+
+	const u32 counts[] = { 10, 100, 1'000, 10'000 };
+	for (u32 count : counts) {
+		Array<UniquePtr<Animator>> animators(allocator);
+		for (u32 i = 0; i < count; ++i) {
+			UniquePtr<Animator>& a = animators.emplace(UniquePtr<Animator>::create(allocator, allocator));
+			if (i % 10 == 0) a->init(Span(animations.heavy), Animator::MAX_OPS, animations.heavy_skeleton);
+			else a->init(Span(animations.light), 2, animations.light_skeleton);
+		}
+
+		const u32 iterations = count >= 1'000 ? 10 : 100;
+		float time_offset = 0;
+		const float sequential_time = bench::measure(iterations, [&](){
+			time_offset += 0.016f;
+			for (UniquePtr<Animator>& a : animators) {
+				a->execute(time_offset, 0, a->pose.count);
+				a->computeAbsolute();
+			}
+		});
+
+		Array<anim::HeavyPose> heavy(allocator);
+		anim::EvaluatePosesStats stats;
+		const float t = bench::measure(iterations, [&](){
+			time_offset += 0.016f;
+			stats = anim::evaluatePoses(count, heavy
+				, [&](u32 idx, u32& ops_count) -> Pose* {
+					ops_count = animators[idx]->ops_count;
+					return &animators[idx]->pose;
+				}
+				, [&](u32 idx, Pose&, u32 from_bone, u32 to_bone) { animators[idx]->execute(time_offset, from_bone, to_bone); }
+				, [&](u32 idx, Pose&) { animators[idx]->computeAbsolute(); });
+		});
+
+		for (const UniquePtr<Animator>& a : animators) {
+			if (!a->isPoseValid()) {
+				logError("Invalid pose");
+				break;
+			}
+		}
+
+		logInfo(count, " animators (", stats.heavy_count, " heavy): sequential ", sequential_time * 1e3f, " ms, evaluatePoses ", t * 1e3f
+			, " ms, ", t * 1e6f / count, " us per animator");
+	}
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include "engine/lumix.h"
+#include "engine/os.h"
+
+namespace Lumix {
+
+struct IAllocator;
+
+namespace bench {
+
+using BenchmarkFunction = void (*)(IAllocator& allocator);
+
+// registered with LUMIX_BENCHMARK, runs on a job system worker
+struct Benchmark {
+	Benchmark(const char* name, BenchmarkFunction function);
+
+	const char* name;
+	BenchmarkFunction function;
+	Benchmark* next;
+};
+
+// average seconds per call of `f`, `f` is called once more before measuring to warm up caches
+template <typename F>
+float measure(u32 iterations, F&& f) {
+	f();
+	os::Timer timer;
+	for (u32 i = 0; i < iterations; ++i) f();
+	return timer.getTimeSinceStart() / iterations;
+}
+
+} // namespace bench
+
+#define LUMIX_BENCHMARK(NAME) \
+	static void benchmark_##NAME(IAllocator& allocator); \
+	static bench::Benchmark benchmark_registration_##NAME(#NAME, benchmark_##NAME); \
+	static void benchmark_##NAME(IAllocator& allocator)
+
+} // namespace Lumix
@@ -0,0 +1,94 @@
+#include "bench/bench.h"
+#include "engine/array.h"
+#include "engine/component_pool.h"
+#include "engine/hash_map.h"
+#include "engine/log.h"
+#include "engine/math.h"
+
+using namespace Lumix;
+
+namespace {
+
+// size of a typical light / decal component
+struct Component {
+	Vec3 position;
+	Vec3 color;
+	float range;
+	float fov;
+	EntityRef entity;
+};
+
+// avoids optimizing out the loops
+volatile float g_sink;
+
+template <typename Container>
+void fill(Container& container, u32 count) {
+	// entities are interleaved with entities without the component
+	for (u32 i = 0; i < count; ++i) {
+		const EntityRef e{i32(i * 3)};
+		container.insert(e, Component{Vec3(1, 2, 3), Vec3(1), float(i), 1, e});
+	}
+}
+
+template <typename Container>
+void measureContainer(const char* name, u32 count, Span<const u32> order, IAllocator& allocator) {
+	const u32 iterations = count > 10'000 ? 10 : 100;
+
+	// into an empty container, like when a world is loaded
+	float insert_time = 0;
+	for (u32 j = 0; j < iterations; ++j) {
+		Container tmp(allocator);
+		os::Timer timer;
+		fill(tmp, count);
+		insert_time += timer.getTimeSinceStart();
+	}
+	insert_time /= iterations;
+
+	Container container(allocator);
+	fill(container, count);
+
+	const float iterate_time = bench::measure(iterations * 10, [&](){
+		float sum = 0;
+		for (const Component& c : container) sum += c.range;
+		g_sink = sum;
+	});
+
+	const float lookup_time = bench::measure(iterations, [&](){
+		float sum = 0;
+		for (u32 i : order) sum += container[EntityRef{i32(i * 3)}].range;
+		g_sink = sum;
+	});
+
+	float erase_time = 0;
+	for (u32 j = 0; j < iterations; ++j) {
+		if (j > 0) fill(container, count);
+		os::Timer timer;
+		for (u32 i : order) container.erase(EntityRef{i32(i * 3)});
+		erase_time += timer.getTimeSinceStart();
+	}
+	erase_time /= iterations;
+	if (!container.empty()) logError(name, ": not empty after erase");
+
+	logInfo(count, " ", name, ": insert ", insert_time * 1e6f, " us, iterate ", iterate_time * 1e6f
+		, " us, random lookup ", lookup_time * 1e6f, " us, random erase ", erase_time * 1e6f, " us");
+}
+
+} // anonymous namespace
+
+LUMIX_BENCHMARK(component_pool) {
+	const u32 counts[] = { 1'000, 10'000, 100'000 };
+	for (u32 count : counts) {
+		Array<u32> order(allocator);
+		order.resize(count);
+		for (u32 i = 0; i < count; ++i) order[i] = i;
+		for (u32 i = count - 1; i > 0; --i) {
+			const u32 j = rand(0, i);
+			const u32 tmp = order[i];
+			order[i] = order[j];
+			order[j] = tmp;
+		}
+
+		measureContainer<HashMap<EntityRef, Component>>("HashMap", count, order, allocator);
+		measureContainer<ComponentPool<Component>>("ComponentPool", count, order, allocator);
+	}
+}
@@ -0,0 +1,60 @@
+#include "bench/bench.h"
+#include "engine/fibers.h"
+#include "engine/log.h"
+#include "engine/thread.h"
+
+using namespace Lumix;
+
+// raw Fiber::switchTo ping-pong between two fibers on a dedicated thread, without the job system around it
+static constexpr u32 ROUND_TRIPS = 1'000'000;
+static Fiber::Handle g_main_fiber = Fiber::INVALID_FIBER;
+static Fiber::Handle g_other_fiber = Fiber::INVALID_FIBER;
+static float g_time = 0;
+
+#ifdef _WIN32
+	static void __stdcall other(void*)
+#else
+	static void other(void*)
+#endif
+{
+	// fibers other than the one from initThread must not return
+	for (;;) Fiber::switchTo(&g_other_fiber, g_main_fiber);
+}
+
+#ifdef _WIN32
+	static void __stdcall pingPong(void*)
+#else
+	static void pingPong(void*)
+#endif
+{
+	g_other_fiber = Fiber::create(64 * 1024, other, nullptr);
+	Fiber::switchTo(&g_main_fiber, g_other_fiber);
+
+	os::Timer timer;
+	for (u32 i = 0; i < ROUND_TRIPS; ++i) {
+		Fiber::switchTo(&g_main_fiber, g_other_fiber);
+	}
+	g_time = timer.getTimeSinceStart();
+	Fiber::destroy(g_other_fiber);
+}
+
+struct FiberThread : Thread {
+	FiberThread(IAllocator& allocator) : Thread(allocator) {}
+
+	int task() override {
+		Fiber::initThread(pingPong, &g_main_fiber);
+		return 0;
+	}
+};
+
+LUMIX_BENCHMARK(fibers) {
+	FiberThread thread(allocator);
+	if (!thread.create("fiber bench", true)) {
+		logError("Failed to create thread.");
+		return;
+	}
+	thread.destroy();
+
+	const u32 switches = ROUND_TRIPS * 2;
+	logInfo(switches / g_time / 1e6f, " M switches per s, ", g_time / switches * 1e9f, " ns per switch");
+}
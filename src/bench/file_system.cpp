@@ -0,0 +1,184 @@
+#include "bench/bench.h"
+#include "engine/allocator.h"
+#include "engine/array.h"
+#include "engine/crt.h"
+#include "engine/delegate.h"
+#include "engine/file_system.h"
+#include "engine/log.h"
+#include "engine/math.h"
+#include "engine/os.h"
+#include "engine/path.h"
+#include "engine/stream.h"
+
+using namespace Lumix;
+
+static constexpr u32 FILES_COUNT = 10'000;
+static const char* DATA_DIR = "bench_data/";
+
+// small files of varying size, like most of compiled resources
+static u32 getContentSize(u32 idx) { return 1024 + (idx * 7919) % (15 * 1024); }
+
+static Path getFilePath(u32 idx) { return Path("files/", u64(idx), ".res"); }
+
+static void fillContent(u32 idx, OutputMemoryStream& content) {
+	content.clear();
+	for (u32 j = 0, c = getContentSize(idx); j < c; ++j) content.write(u8(idx + j));
+}
+
+static bool makeDataDir() {
+	const Path dir(DATA_DIR, "files");
+	return os::dirExists(dir) || os::makePath(dir);
+}
+
+static bool createFiles(IAllocator& allocator) {
+	if (!makeDataDir()) return false;
+
+	OutputMemoryStream content(allocator);
+	for (u32 i = 0; i < FILES_COUNT; ++i) {
+		fillContent(i, content);
+
+		os::OutputFile file;
+		if (!file.open(Path(DATA_DIR, getFilePath(i).c_str()))) return false;
+		const bool res = file.write(content.data(), content.size());
+		file.close();
+		if (!res) return false;
+	}
+	return true;
+}
+
+static void deleteFiles() {
+	for (u32 i = 0; i < FILES_COUNT; ++i) {
+		os::deleteFile(Path(DATA_DIR, getFilePath(i).c_str()));
+	}
+}
+
+// the files are in page cache after they are created, so this measures the filesystem's overhead, not the disk
+LUMIX_BENCHMARK(file_system) {
+	if (!createFiles(allocator)) {
+		logError("Failed to create files in ", DATA_DIR);
+		deleteFiles();
+		return;
+	}
+
+	UniquePtr<FileSystem> fs = FileSystem::create(DATA_DIR, allocator);
+
+	u64 expected_bytes = 0;
+	for (u32 i = 0; i < FILES_COUNT; ++i) expected_bytes += getContentSize(i);
+
+	for (u32 iteration = 0; iteration < 3; ++iteration) {
+		u32 loaded = 0;
+		u64 bytes = 0;
+		auto callback = [&](u64 size, const u8* data, bool success) {
+			if (success) ++loaded;
+			bytes += size;
+		};
+
+		os::Timer timer;
+		for (u32 i = 0; i < FILES_COUNT; ++i) {
+			fs->getContent(getFilePath(i), FileSystem::ContentCallback(callback));
+		}
+		const float request_time = timer.getTimeSinceStart();
+		while (fs->hasWork()) fs->processCallbacks();
+		const float t = timer.getTimeSinceStart();
+
+		if (loaded != FILES_COUNT || bytes != expected_bytes) logError("async: loaded ", loaded, " files, ", bytes, " B");
+		logInfo("async: ", t * 1e3f, " ms (requests ", request_time * 1e3f, " ms), ", FILES_COUNT / t, " files/s");
+	}
+
+	os::Timer timer;
+	u64 bytes = 0;
+	for (u32 i = 0; i < FILES_COUNT; ++i) {
+		OutputMemoryStream content(allocator);
+		if (fs->getContentSync(getFilePath(i), content)) bytes += content.size();
+	}
+	const float t = timer.getTimeSinceStart();
+	if (bytes != expected_bytes) logError("sync: loaded ", bytes, " B");
+	logInfo("sync: ", t * 1e3f, " ms, ", FILES_COUNT / t, " files/s");
+
+	fs.reset();
+	deleteFiles();
+}
+
+// v2 pak with the same files as above, stored uncompressed in load order
+static bool createPak(const char* path, IAllocator& allocator) {
+	if (!makeDataDir()) return false;
+
+	os::OutputFile file;
+	if (!file.open(path)) return false;
+
+	PakHeader header;
+	header.count = FILES_COUNT;
+	bool res = file.write(&header, sizeof(header));
+
+	Array<PakEntry> entries(allocator);
+	OutputMemoryStream content(allocator);
+	const u8 zeros[PakHeader::ALIGNMENT] = {};
+	u64 offset = sizeof(header);
+	for (u32 i = 0; i < FILES_COUNT; ++i) {
+		const u64 padding = (PakHeader::ALIGNMENT - offset % PakHeader::ALIGNMENT) % PakHeader::ALIGNMENT;
+		if (padding > 0) res = res && file.write(zeros, padding);
+		offset += padding;
+
+		fillContent(i, content);
+		PakEntry& e = entries.emplace();
+		e.hash = FileSystem::getPakHash(getFilePath(i));
+		e.offset = offset;
+		e.size = content.size();
+		e.uncompressed_size = content.size();
+		res = res && file.write(content.data(), content.size());
+		offset += content.size();
+	}
+
+	qsort(entries.begin(), entries.size(), sizeof(PakEntry), [](const void* a, const void* b) -> int {
+		const FilePathHash ha = ((const PakEntry*)a)->hash;
+		const FilePathHash hb = ((const PakEntry*)b)->hash;
+		return ha < hb ? -1 : hb < ha ? 1 : 0;
+	});
+	res = res && file.write(entries.begin(), entries.byte_size());
+	file.close();
+	return res;
+}
+
+// peak RSS is sampled between processCallbacks, pages of loaded files should be released, so it should not grow with the pak size
+LUMIX_BENCHMARK(pak) {
+	const Path pak_path(DATA_DIR, "files.pak");
+	if (!createPak(pak_path, allocator)) {
+		logError("Failed to create ", pak_path);
+		os::deleteFile(pak_path);
+		return;
+	}
+
+	u64 expected_bytes = 0;
+	for (u32 i = 0; i < FILES_COUNT; ++i) expected_bytes += getContentSize(i);
+
+	for (u32 iteration = 0; iteration < 3; ++iteration) {
+		const u64 rss_before = os::getProcessMemory();
+		os::Timer timer;
+		UniquePtr<FileSystem> fs = FileSystem::createPacked(pak_path, allocator);
+		const float open_time = timer.getTimeSinceStart();
+
+		u32 loaded = 0;
+		u64 bytes = 0;
+		auto callback = [&](u64 size, const u8* data, bool success) {
+			if (success) ++loaded;
+			bytes += size;
+		};
+
+		for (u32 i = 0; i < FILES_COUNT; ++i) {
+			fs->getContent(getFilePath(i), FileSystem::ContentCallback(callback));
+		}
+		u64 peak_rss = os::getProcessMemory();
+		while (fs->hasWork()) {
+			fs->processCallbacks();
+			peak_rss = maximum(peak_rss, os::getProcessMemory());
+		}
+		const float t = timer.getTimeSinceStart();
+		fs.reset();
+
+		if (loaded != FILES_COUNT || bytes != expected_bytes) logError("pak: loaded ", loaded, " files, ", bytes, " B");
+		logInfo("pak: open ", open_time * 1e3f, " ms, load ", t * 1e3f, " ms, ", FILES_COUNT / t, " files/s, "
+			, bytes / 1024 / 1024, " MB, peak RSS +", (peak_rss - minimum(peak_rss, rss_before)) / 1024, " KB");
+	}
+
+	os::deleteFile(pak_path);
+}
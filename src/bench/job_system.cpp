@@ -0,0 +1,51 @@
+#include "bench/bench.h"
+#include "engine/atomic.h"
+#include "engine/job_system.h"
+#include "engine/log.h"
+
+using namespace Lumix;
+
+// run with different core counts (e.g. taskset) to see how the scheduler scales
+LUMIX_BENCHMARK(job_system) {
+	const u32 counts[] = { 1'000, 10'000, 100'000 };
+	for (u32 count : counts) {
+		// empty jobs, so this is only the cost of pushing, stealing and finishing a job
+		const float t = bench::measure(5, [&](){
+			jobs::Signal signal;
+			for (u32 i = 0; i < count; ++i) {
+				jobs::run(nullptr, [](void*){}, &signal);
+			}
+			jobs::wait(&signal);
+		});
+		logInfo(count, " empty jobs: ", count / t / 1e6f, " M jobs/s");
+	}
+
+	// jobs spawning jobs, the pattern work stealing deques are made for
+	const u32 fanout = 64;
+	const float nested = bench::measure(5, [&](){
+		jobs::Signal signal;
+		for (u32 i = 0; i < fanout; ++i) {
+			jobs::runLambda([](){
+				jobs::Signal inner;
+				for (u32 j = 0; j < 64; ++j) {
+					jobs::run(nullptr, [](void*){}, &inner);
+				}
+				jobs::wait(&inner);
+			}, &signal);
+		}
+		jobs::wait(&signal);
+	});
+	logInfo(fanout * 65, " nested jobs: ", fanout * 65 / nested / 1e6f, " M jobs/s");
+
+	const i32 items = 1 << 20;
+	const i32 steps[] = { 64, 1024, 16384 };
+	for (i32 step : steps) {
+		volatile i32 sum = 0;
+		const float t = bench::measure(5, [&](){
+			jobs::forEach(items, step, [&](i32 from, i32 to){
+				atomicAdd(&sum, to - from);
+			});
+		});
+		logInfo("forEach, step ", step, ": ", items / step / t / 1e6f, " M chunks/s");
+	}
+}
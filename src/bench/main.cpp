@@ -0,0 +1,75 @@
+#include "bench/bench.h"
+#include "engine/allocators.h"
+#include "engine/atomic.h"
+#include "engine/job_system.h"
+#include "engine/log.h"
+#include "engine/profiler.h"
+#include "engine/string.h"
+#include "engine/sync.h"
+#include <stdio.h>
+
+using namespace Lumix;
+
+static bench::Benchmark* g_first_benchmark = nullptr;
+static bench::Benchmark** g_last_benchmark = &g_first_benchmark;
+
+bench::Benchmark::Benchmark(const char* name, BenchmarkFunction function)
+	: name(name)
+	, function(function)
+	, next(nullptr)
+{
+	*g_last_benchmark = this;
+	g_last_benchmark = &next;
+}
+
+static void logToStdout(LogLevel level, const char* message) {
+	if (level == LogLevel::ERROR) printf("Error: ");
+	printf("%s\n", message);
+	fflush(stdout);
+}
+
+// usage: bench [name...], runs all benchmarks if no name is given
+int main(int argc, char* argv[]) {
+	profiler::setThreadName("Main thread");
+	registerLogCallback<logToStdout>();
+
+	struct Data {
+		Data() : semaphore(0, 1) {}
+		DefaultAllocator allocator;
+		Semaphore semaphore;
+		int argc;
+		char** argv;
+		u32 run_count = 0;
+	} data;
+	data.argc = argc;
+	data.argv = argv;
+
+	if (!jobs::init((u8)os::getCPUsCount(), data.allocator)) {
+		logError("Failed to initialize job system.");
+		return 1;
+	}
+	logInfo("workers: ", jobs::getWorkersCount());
+
+	jobs::runEx(&data, [](void* ptr) {
+		Data* data = (Data*)ptr;
+		for (bench::Benchmark* b = g_first_benchmark; b; b = b->next) {
+			bool selected = data->argc < 2;
+			for (int i = 1; i < data->argc; ++i) {
+				selected = selected || equalStrings(data->argv[i], b->name);
+			}
+			if (!selected) continue;
+
+			logInfo("--- ", b->name);
+			b->function(data->allocator);
+			++data->run_count;
+		}
+		data->semaphore.signal();
+	}, nullptr, 0);
+
+	data.semaphore.wait();
+	jobs::shutdown();
+
+	if (data.run_count == 0) logError("No benchmark matches the command line.");
+	unregisterLogCallback<logToStdout>();
+	return data.run_count == 0 ? 1 : 0;
+}
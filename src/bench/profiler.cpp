@@ -0,0 +1,32 @@
+#include "bench/bench.h"
+#include "engine/atomic.h"
+#include "engine/job_system.h"
+#include "engine/log.h"
+#include "engine/profiler.h"
+
+using namespace Lumix;
+
+static void profileBlocks(u32 count) {
+	for (u32 i = 0; i < count; ++i) {
+		PROFILE_BLOCK("bench");
+	}
+}
+
+LUMIX_BENCHMARK(profiler) {
+	constexpr u32 BLOCKS = 1'000'000;
+
+	const float single = bench::measure(5, [](){ profileBlocks(BLOCKS); });
+	logInfo("one thread: ", single / BLOCKS * 1e9f, " ns per PROFILE_BLOCK");
+
+	// every worker writes to its own buffer, so this should not get slower with more workers
+	const u32 workers = jobs::getWorkersCount();
+	const float all = bench::measure(5, [](){
+		jobs::runOnWorkers([](){ profileBlocks(BLOCKS); });
+	});
+	logInfo(workers, " workers: ", workers * BLOCKS / all / 1e6f, " M PROFILE_BLOCKs per s in total");
+
+	profiler::pause(true);
+	const float paused = bench::measure(5, [](){ profileBlocks(BLOCKS); });
+	profiler::pause(false);
+	logInfo("paused: ", paused / BLOCKS * 1e9f, " ns per PROFILE_BLOCK");
+}
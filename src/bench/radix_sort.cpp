@@ -0,0 +1,62 @@
+#include "bench/bench.h"
+#include "engine/allocator.h"
+#include "engine/array.h"
+#include "engine/crt.h"
+#include "engine/log.h"
+#include "engine/math.h"
+#include "renderer/radix_sort.h"
+
+using namespace Lumix;
+
+// sort keys look like pipeline's: a few bits of bucket/material and depth, so there are many equal keys
+static u64 randomKey() {
+	return (u64(rand(0, 15)) << 60) | (u64(rand(0, 1023)) << 40) | u64(rand(0, 0xffFF));
+}
+
+LUMIX_BENCHMARK(radix_sort) {
+	const i32 sizes[] = { 10'000, 100'000, 500'000, 2'000'000 };
+	for (i32 size : sizes) {
+		Array<u64> src_keys(allocator);
+		Array<u64> keys(allocator);
+		Array<u64> values(allocator);
+		src_keys.resize(size);
+		keys.resize(size);
+		values.resize(size);
+		for (u64& key : src_keys) key = randomKey();
+
+		u8* scratch = (u8*)allocator.allocate_aligned(getRadixSortScratchSize(size), 64);
+		const u32 iterations = size > 500'000 ? 5 : 20;
+		float t = 0;
+		for (u32 i = 0; i < iterations + 1; ++i) {
+			memcpy(keys.begin(), src_keys.begin(), size * sizeof(u64));
+			for (i32 j = 0; j < size; ++j) values[j] = j;
+			os::Timer timer;
+			radixSort(keys.begin(), values.begin(), size, scratch);
+			// first one warms up caches
+			if (i > 0) t += timer.getTimeSinceStart();
+		}
+		t /= iterations;
+		allocator.deallocate_aligned(scratch);
+
+		// values are original indices, so this checks order, stability and that values moved with their keys
+		for (i32 j = 0; j < size; ++j) {
+			const bool valid = keys[j] == src_keys[(i32)values[j]]
+				&& (j == 0 || keys[j - 1] < keys[j] || (keys[j - 1] == keys[j] && values[j - 1] < values[j]));
+			if (!valid) {
+				logError(size, " keys: wrong order at ", j);
+				break;
+			}
+		}
+
+		memcpy(keys.begin(), src_keys.begin(), size * sizeof(u64));
+		os::Timer timer;
+		qsort(keys.begin(), size, sizeof(u64), [](const void* a, const void* b) -> int {
+			const u64 l = *(const u64*)a;
+			const u64 r = *(const u64*)b;
+			return l < r ? -1 : (l > r ? 1 : 0);
+		});
+		const float qsort_time = timer.getTimeSinceStart();
+
+		logInfo(size, " keys: ", t * 1e3f, " ms, ", size / t / 1e6f, " M keys/s (qsort ", qsort_time * 1e3f, " ms)");
+	}
+}
@@ -0,0 +1,82 @@
+#include "bench/bench.h"
+#include "engine/atomic.h"
+#include "engine/job_system.h"
+#include "engine/log.h"
+
+using namespace Lumix;
+
+// stress test of jobs::Signal and jobs::Mutex, results are checked so a broken fast path is reported as an error
+LUMIX_BENCHMARK(signals) {
+	// contended mutex, the counter is not atomic, so any lost exclusion shows up in the sum
+	{
+		constexpr u32 JOBS = 64;
+		constexpr u32 ITERATIONS = 10'000;
+		jobs::Mutex mutex;
+		u32 counter = 0;
+		const float t = bench::measure(3, [&](){
+			counter = 0;
+			jobs::Signal signal;
+			for (u32 i = 0; i < JOBS; ++i) {
+				jobs::runLambda([&](){
+					for (u32 j = 0; j < ITERATIONS; ++j) {
+						jobs::MutexGuard guard(mutex);
+						++counter;
+					}
+				}, &signal);
+			}
+			jobs::wait(&signal);
+		});
+		if (counter != JOBS * ITERATIONS) logError("mutex: expected ", JOBS * ITERATIONS, ", got ", counter);
+		logInfo("mutex: ", JOBS * ITERATIONS / t / 1e6f, " M lock/unlock per s");
+	}
+
+	// two jobs waking each other, every round trip is two red/green pairs and two waits
+	{
+		constexpr u32 ROUND_TRIPS = 100'000;
+		jobs::Signal ping, pong, finished;
+		u32 received = 0;
+		os::Timer timer;
+		jobs::setRed(&ping);
+		jobs::runLambda([&](){
+			for (u32 i = 0; i < ROUND_TRIPS; ++i) {
+				jobs::wait(&ping);
+				jobs::setRed(&ping);
+				++received;
+				jobs::setGreen(&pong);
+			}
+		}, &finished);
+		for (u32 i = 0; i < ROUND_TRIPS; ++i) {
+			jobs::setRed(&pong);
+			jobs::setGreen(&ping);
+			jobs::wait(&pong);
+		}
+		jobs::wait(&finished);
+		// the last round left it red
+		jobs::setGreen(&ping);
+		const float t = timer.getTimeSinceStart();
+		if (received != ROUND_TRIPS) logError("ping pong: expected ", ROUND_TRIPS, ", got ", received);
+		logInfo("ping pong: ", ROUND_TRIPS / t / 1e6f, " M round trips per s");
+	}
+
+	// many jobs waiting on one signal
+	{
+		// every parked waiter holds a fiber, so this has to stay well below the fiber pool size
+		constexpr u32 WAITERS = 256;
+		volatile i32 woken = 0;
+		const float t = bench::measure(10, [&](){
+			woken = 0;
+			jobs::Signal gate, finished;
+			jobs::setRed(&gate);
+			for (u32 i = 0; i < WAITERS; ++i) {
+				jobs::runLambda([&](){
+					jobs::wait(&gate);
+					atomicIncrement(&woken);
+				}, &finished);
+			}
+			jobs::setGreen(&gate);
+			jobs::wait(&finished);
+		});
+		if (woken != WAITERS) logError("gate: expected ", WAITERS, ", got ", woken);
+		logInfo("gate: ", WAITERS, " waiters released in ", t * 1e3f, " ms");
+	}
+}
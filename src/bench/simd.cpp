@@ -0,0 +1,103 @@
+#include "bench/bench.h"
+#include "engine/allocator.h"
+#include "engine/array.h"
+#include "engine/geometry.h"
+#include "engine/log.h"
+#include "engine/math.h"
+#include "engine/page_allocator.h"
+#include "engine/simd.h"
+#include "renderer/culling_system.h"
+#include "renderer/pose.h"
+
+using namespace Lumix;
+
+// build with LUMIX_SIMD_SCALAR defined or with --avx2 to compare simd.h backends
+
+LUMIX_BENCHMARK(culling) {
+	PageAllocator page_allocator;
+	UniquePtr<CullingSystem> culling = CullingSystem::create(allocator, page_allocator);
+	ShiftedFrustum frustum;
+	frustum.computePerspective(DVec3(0), Vec3(0, 0, -1), Vec3(0, 1, 0), degreesToRadians(60.f), 16 / 9.f, 0.1f, 1000.f);
+
+	const u32 counts[] = { 10'000, 100'000, 1'000'000 };
+	u32 count = 0;
+	for (u32 n : counts) {
+		for (; count < n; ++count) {
+			const DVec3 pos(randFloat(-1000, 1000), randFloat(-1000, 1000), randFloat(-1000, 1000));
+			culling->add(EntityRef{(i32)count}, 0, pos, randFloat(0.5f, 5.f));
+		}
+
+		u32 visible = 0;
+		const float t = bench::measure(20, [&](){
+			CullResult* result = culling->cull(frustum);
+			visible = result ? result->count() : 0;
+			if (result) result->free(page_allocator);
+		});
+		logInfo(n, " spheres: ", t * 1000, " ms per cull, ", visible, " visible");
+	}
+}
+
+// the same kernels the particle VM runs over its float4 streams
+LUMIX_BENCHMARK(particles) {
+	constexpr u32 COUNT = 64 * 1024;
+	struct alignas(16) Value { float v[4]; };
+	Array<Value> a(allocator), b(allocator), c(allocator), dst(allocator);
+	Array<Value>* streams[] = { &a, &b, &c, &dst };
+	for (Array<Value>* stream : streams) {
+		stream->resize(COUNT / 4);
+		for (Value& v : *stream) {
+			for (float& f : v.v) f = randFloat(-1, 1);
+		}
+	}
+
+	const float madd = bench::measure(200, [&](){
+		const float4* LUMIX_RESTRICT pa = (const float4*)a.begin();
+		const float4* LUMIX_RESTRICT pb = (const float4*)b.begin();
+		const float4* LUMIX_RESTRICT pc = (const float4*)c.begin();
+		float4* LUMIX_RESTRICT pdst = (float4*)dst.begin();
+		for (u32 i = 0; i < COUNT / 4; ++i) pdst[i] = f4MulAdd(pa[i], pb[i], pc[i]);
+	});
+	logInfo("madd: ", madd / COUNT * 1e9f, " ns per particle");
+
+	u32 killed = 0;
+	const float kill = bench::measure(200, [&](){
+		const float4* LUMIX_RESTRICT pa = (const float4*)a.begin();
+		const float4 zero = f4Splat(0);
+		killed = 0;
+		for (u32 i = 0; i < COUNT / 4; ++i) {
+			const int mask = f4MoveMask(f4CmpGT(pa[i], zero));
+			killed += (mask & 1) + ((mask >> 1) & 1) + ((mask >> 2) & 1) + ((mask >> 3) & 1);
+		}
+	});
+	logInfo("kill test: ", kill / COUNT * 1e9f, " ns per particle, ", killed, " killed");
+}
+
+// Pose::blend against the same math one bone at a time, e.g. Blend1DNode blends 2 poses per character
+LUMIX_BENCHMARK(pose_blend) {
+	const u32 counts[] = { 60, 600 };
+	for (u32 count : counts) {
+		Pose pose(allocator), rhs(allocator);
+		Pose* poses[] = { &pose, &rhs };
+		for (Pose* p : poses) {
+			p->resize(count);
+			for (u32 i = 0; i < count; ++i) {
+				p->positions[i] = Vec3(randFloat(-1, 1), randFloat(-1, 1), randFloat(-1, 1));
+				p->rotations[i] = normalize(Quat(randFloat(-1, 1), randFloat(-1, 1), randFloat(-1, 1), randFloat(-1, 1)));
+			}
+		}
+		Array<float> weights(allocator);
+		for (u32 i = 0; i < count; ++i) weights.push(i % 3 == 0 ? 0 : 0.5f);
+
+		const u32 iterations = 100'000 / count * 10;
+		const float scalar = bench::measure(iterations, [&](){
+			for (u32 i = 0; i < count; ++i) {
+				pose.positions[i] = pose.positions[i] * (1 - 0.5f) + rhs.positions[i] * 0.5f;
+				pose.rotations[i] = nlerp(pose.rotations[i], rhs.rotations[i], 0.5f);
+			}
+		});
+		const float uniform = bench::measure(iterations, [&](){ pose.blend(rhs, 0.5f); });
+		const float masked = bench::measure(iterations, [&](){ pose.blend(rhs, weights); });
+		logInfo(count, " bones: scalar ", scalar / count * 1e9f, " ns, SIMD ", uniform / count * 1e9f
+			, " ns, SIMD masked ", masked / count * 1e9f, " ns per bone");
+	}
+}
@@ -7,6 +7,7 @@
 #include "editor/utils.h"
 #include "editor/world_editor.h"
 #include "engine/atomic.h"
+#include "engine/command_line_parser.h"
 #include "engine/engine.h"
 #include "engine/hash.h"
 #include "engine/job_system.h"
@@ -30,9 +31,6 @@ namespace Lumix
 {
 
 
-struct AssetCompilerImpl;
-
-
 template<>
 struct HashFunc<Path>
 {
@@ -44,20 +42,6 @@ struct HashFunc<Path>
 };
 
 
-struct AssetCompilerTask : Thread
-{
-	AssetCompilerTask(AssetCompilerImpl& compiler, IAllocator& allocator) 
-		: Thread(allocator) 
-		 , m_compiler(compiler)
-	{}
-
-	int task() override;
-
-	AssetCompilerImpl& m_compiler;
-	volatile bool m_finished = false;
-};
-
-
 void AssetCompiler::IPlugin::addSubresources(AssetCompiler& compiler, const char* path)
 {
 	const ResourceType type = compiler.getResourceType(path);
@@ -73,6 +57,32 @@ struct AssetCompilerImpl : AssetCompiler {
 		Path path;
 	};
 
+	// outputs and dependencies of a file being compiled, they are stored in the cache when compilation succeeds
+	struct CompileRecord {
+		CompileRecord(IAllocator& allocator) : outputs(allocator), dependencies(allocator) {}
+
+		// [FilePathHash, u32 size, content of .res file] for each output
+		OutputMemoryStream outputs;
+		u32 outputs_count = 0;
+		u64 outputs_size = 0;
+		Array<Path> dependencies;
+	};
+
+	// per extension, so it's per plugin too
+	struct CompileStats {
+		StaticString<16> extension;
+		u32 count = 0;
+		u32 failed = 0;
+		u32 cached = 0;
+		// sum of all jobs, so it can be bigger than wall time
+		float time = 0;
+		u64 bytes_in = 0;
+		u64 bytes_out = 0;
+	};
+
+	static constexpr u32 CACHE_MAGIC = '_LAC';
+	static constexpr u32 CACHE_VERSION = 0;
+
 	struct LoadHook : ResourceManagerHub::LoadHook
 	{
 		LoadHook(AssetCompilerImpl& compiler) : compiler(compiler) {}
@@ -90,10 +100,11 @@ struct AssetCompilerImpl : AssetCompiler {
 		: m_app(app)
 		, m_load_hook(*this)
 		, m_plugins(app.getAllocator())
-		, m_task(*this, app.getAllocator())
 		, m_to_compile(app.getAllocator())
+		, m_running(app.getAllocator())
 		, m_compiled(app.getAllocator())
-		, m_semaphore(0, 0x7fFFffFF)
+		, m_records(app.getAllocator())
+		, m_stats(app.getAllocator())
 		, m_registered_extensions(app.getAllocator())
 		, m_resources(app.getAllocator())
 		, m_generations(app.getAllocator())
@@ -109,7 +120,7 @@ struct AssetCompilerImpl : AssetCompiler {
 		const char* base_path = fs.getBasePath();
 		m_watcher = FileSystemWatcher::create(base_path, app.getAllocator());
 		m_watcher->getCallback().bind<&AssetCompilerImpl::onFileChanged>(this);
-		m_task.create("Asset compiler", true);
+		initCache();
 		Path path(base_path, ".lumix/resources");
 		if (!os::dirExists(path)) {
 			if (!os::makePath(path)) logError("Could not create ", path);
@@ -169,6 +180,12 @@ struct AssetCompilerImpl : AssetCompiler {
 
 	~AssetCompilerImpl()
 	{
+		{
+			MutexGuard lock(m_to_compile_mutex);
+			m_to_compile.clear();
+		}
+		jobs::wait(&m_compile_signal);
+
 		os::OutputFile file;
 		FileSystem& fs = m_app.getEngine().getFileSystem();
 		if (fs.open(".lumix/resources/_list.txt_tmp", file)) {
@@ -196,10 +213,6 @@ struct AssetCompilerImpl : AssetCompiler {
 		}
 
 		ASSERT(m_plugins.empty());
-		m_task.m_finished = true;
-		m_to_compile.emplace();
-		m_semaphore.signal();
-		m_task.destroy();
 		ResourceManagerHub& rm = m_app.getEngine().getResourceManager();
 		rm.setLoadHook(nullptr);
 	}
@@ -210,11 +223,330 @@ struct AssetCompilerImpl : AssetCompiler {
 		const char* base_path = fs.getBasePath();
 		m_watcher = FileSystemWatcher::create(base_path, m_app.getAllocator());
 		m_watcher->getCallback().bind<&AssetCompilerImpl::onFileChanged>(this);
-		m_dependencies.clear();
+		initCache();
+		{
+			MutexGuard lock(m_dependencies_mutex);
+			m_dependencies.clear();
+		}
 		m_resources.clear();
 		fillDB();
 	}
 
+	// compiled outputs are cached by content of their source, so switching branches or fresh checkouts do not compile everything again
+	// the cache is just a directory, so it can be shared by more projects or machines with `-asset_cache <dir>`
+	void initCache() {
+		char cmd_line[2048];
+		os::getCommandLine(Span(cmd_line));
+		CommandLineParser parser(cmd_line);
+		m_cache_dir = Path(m_app.getEngine().getFileSystem().getBasePath(), ".lumix/cache");
+		while (parser.next()) {
+			if (!parser.currentEquals("-asset_cache")) continue;
+			if (!parser.next()) break;
+
+			char tmp[LUMIX_MAX_PATH];
+			parser.getCurrent(tmp, lengthOf(tmp));
+			m_cache_dir = tmp;
+			break;
+		}
+		if (!os::dirExists(m_cache_dir) && !os::makePath(m_cache_dir)) {
+			logError("Could not create ", m_cache_dir, ", compiled assets are not going to be cached");
+			m_cache_dir = "";
+		}
+	}
+
+	// does not include dependencies, their content is checked when outputs are restored from the cache
+	bool getCacheKey(IPlugin& plugin, const Path& src, StableHash& key) const {
+		FileSystem& fs = m_app.getEngine().getFileSystem();
+		OutputMemoryStream data(m_app.getAllocator());
+		if (!fs.getContentSync(src, data)) return false;
+
+		struct {
+			u32 cache_version;
+			u32 plugin_version;
+			FilePathHash path;
+			StableHash content;
+			StableHash meta;
+		} k = {};
+		k.cache_version = CACHE_VERSION;
+		k.plugin_version = plugin.getVersion();
+		k.path = src.getHash();
+		k.content = StableHash(data.data(), (u32)data.size());
+
+		const Path meta_path(src.c_str(), ".meta");
+		data.clear();
+		if (fs.getContentSync(meta_path, data)) k.meta = StableHash(data.data(), (u32)data.size());
+
+		key = StableHash(&k, sizeof(k));
+		return true;
+	}
+
+	Path getCachePath(StableHash key) const {
+		return Path(m_cache_dir, "/", key, ".bin");
+	}
+
+	// returns false if there's no valid entry, in that case nothing is written
+	bool restoreFromCache(const Path& src, StableHash key, u64& bytes_out) {
+		PROFILE_FUNCTION();
+		IAllocator& allocator = m_app.getAllocator();
+		OutputMemoryStream entry(allocator);
+		{
+			os::InputFile file;
+			if (!file.open(getCachePath(key))) return false;
+			entry.resize(file.size());
+			const bool read = file.read(entry.getMutableData(), entry.size());
+			file.close();
+			if (!read) return false;
+		}
+
+		FileSystem& fs = m_app.getEngine().getFileSystem();
+		InputMemoryStream blob(entry);
+		if (blob.read<u32>() != CACHE_MAGIC) return false;
+		if (blob.read<u32>() != CACHE_VERSION) return false;
+
+		Array<Path> dependencies(allocator);
+		const u32 dependencies_count = blob.read<u32>();
+		OutputMemoryStream data(allocator);
+		for (u32 i = 0; i < dependencies_count; ++i) {
+			const Path dependency(blob.readString());
+			const StableHash hash = blob.read<StableHash>();
+			data.clear();
+			if (!fs.getContentSync(dependency, data)) return false;
+			if (StableHash(data.data(), (u32)data.size()) != hash) return false;
+			dependencies.push(dependency);
+		}
+
+		const u32 outputs_count = blob.read<u32>();
+		if (blob.getPosition() > blob.size()) return false;
+		for (u32 i = 0; i < outputs_count; ++i) {
+			const FilePathHash hash = blob.read<FilePathHash>();
+			const u32 size = blob.read<u32>();
+			if (blob.getPosition() + size > blob.size()) {
+				logError("Corrupted ", getCachePath(key));
+				return false;
+			}
+			const Path out_path(".lumix/resources/", hash, ".res");
+			if (!fs.saveContentSync(out_path, Span((const u8*)blob.skip(size), size))) {
+				logError("Could not create ", out_path);
+				return false;
+			}
+			bytes_out += size;
+		}
+
+		for (const Path& dependency : dependencies) registerDependency(src, dependency);
+		return true;
+	}
+
+	void storeToCache(StableHash key, const CompileRecord& record) {
+		PROFILE_FUNCTION();
+		FileSystem& fs = m_app.getEngine().getFileSystem();
+		OutputMemoryStream blob(m_app.getAllocator());
+		blob.write(CACHE_MAGIC);
+		blob.write(CACHE_VERSION);
+		blob.write(record.dependencies.size());
+		OutputMemoryStream data(m_app.getAllocator());
+		for (const Path& dependency : record.dependencies) {
+			data.clear();
+			// output depends on something we can not hash, do not cache it
+			if (!fs.getContentSync(dependency, data)) return;
+			blob.writeString(dependency.c_str());
+			blob.write(StableHash(data.data(), (u32)data.size()));
+		}
+		blob.write(record.outputs_count);
+		blob.write(record.outputs.data(), record.outputs.size());
+
+		// other editors can share the cache, so they must not see partially written entries
+		const Path path = getCachePath(key);
+		const Path tmp_path(path, "_", os::Timer::getRawTimestamp(), ".tmp");
+		os::OutputFile file;
+		if (!file.open(tmp_path)) return;
+		const bool written = file.write(blob.data(), blob.size());
+		file.close();
+		if (!written || !os::moveFile(tmp_path, path)) os::deleteFile(tmp_path);
+	}
+
+	bool compileWithPlugin(IPlugin& plugin, const Path& src) {
+		if (plugin.canCompileInParallel()) return plugin.compile(src);
+
+		jobs::MutexGuard lock(m_serial_compile_mutex);
+		return plugin.compile(src);
+	}
+
+	bool compileCached(IPlugin& plugin, const Path& src, CompileStats& stats) {
+		StableHash key;
+		const bool use_cache = !m_cache_dir.isEmpty() && getCacheKey(plugin, src, key);
+		if (use_cache && restoreFromCache(src, key, stats.bytes_out)) {
+			++stats.cached;
+			return true;
+		}
+
+		CompileRecord record(m_app.getAllocator());
+		{
+			MutexGuard lock(m_records_mutex);
+			m_records.insert(src.getHash(), &record);
+		}
+		const bool compiled = compileWithPlugin(plugin, src);
+		{
+			MutexGuard lock(m_records_mutex);
+			m_records.erase(src.getHash());
+		}
+		if (compiled && use_cache && record.outputs_count > 0) storeToCache(key, record);
+		stats.bytes_out += record.outputs_size;
+		return compiled;
+	}
+
+	// runs on a worker
+	void compileJob(const CompileJob& job) {
+		PROFILE_BLOCK("compile asset");
+		profiler::pushString(job.path.c_str());
+		os::Timer timer;
+		CompileStats stats;
+		copyString(Span(stats.extension.data), Path::getExtension(Span(job.path.c_str(), job.path.length())));
+		makeLowercase(Span(stats.extension.data), stats.extension);
+		stats.count = 1;
+		const Path full_path(m_app.getEngine().getFileSystem().getBasePath(), job.path.c_str());
+		stats.bytes_in = os::getFileSize(full_path);
+
+		IPlugin* plugin = getPlugin(job.path);
+		if (!plugin) {
+			logError("Unknown resource type ", job.path);
+			stats.failed = 1;
+		}
+		else if (!compileCached(*plugin, job.path, stats)) {
+			logError("Failed to compile resource ", job.path);
+			stats.failed = 1;
+		}
+		stats.time = timer.getTimeSinceStart();
+
+		{
+			MutexGuard lock(m_compiled_mutex);
+			m_compiled.push(job);
+
+			const RuntimeHash ext_hash(stats.extension);
+			auto iter = m_stats.find(ext_hash);
+			if (!iter.isValid()) iter = m_stats.insert(ext_hash, {});
+			CompileStats& total = iter.value();
+			total.extension = stats.extension;
+			total.count += stats.count;
+			total.failed += stats.failed;
+			total.cached += stats.cached;
+			total.time += stats.time;
+			total.bytes_in += stats.bytes_in;
+			total.bytes_out += stats.bytes_out;
+		}
+		atomicDecrement(&m_jobs_in_flight);
+		jobs::setGreen(&m_progress_signal);
+	}
+
+	u32 logCompileStats() override {
+		auto to_MB = [](u64 bytes) { return float(double(bytes) / (1024.0 * 1024.0)); };
+		MutexGuard lock(m_compiled_mutex);
+		CompileStats total;
+		for (const CompileStats& stats : m_stats) {
+			logInfo(stats.extension, ": ", stats.count, " files (", stats.cached, " from cache, ", stats.failed, " failed), "
+				, stats.time, " s, ", to_MB(stats.bytes_in), " MB in, ", to_MB(stats.bytes_out), " MB out");
+			total.count += stats.count;
+			total.failed += stats.failed;
+			total.cached += stats.cached;
+			total.time += stats.time;
+			total.bytes_in += stats.bytes_in;
+			total.bytes_out += stats.bytes_out;
+		}
+		logInfo("total: ", total.count, " files (", total.cached, " from cache, ", total.failed, " failed), "
+			, total.time, " s, ", to_MB(total.bytes_in), " MB in, ", to_MB(total.bytes_out), " MB out");
+		return total.failed;
+	}
+
+	bool hasWork() override {
+		MutexGuard lock(m_to_compile_mutex);
+		return m_batch_remaining_count > 0;
+	}
+
+	bool waitForCompileJob() override {
+		// red before checking the count, so a job finishing in between can not be missed
+		jobs::setRed(&m_progress_signal);
+		if (m_jobs_in_flight == 0) {
+			jobs::setGreen(&m_progress_signal);
+			return false;
+		}
+		jobs::wait(&m_progress_signal);
+		return true;
+	}
+
+	// compiled file is missing or older than its source or meta
+	bool isOutdated(const char* filepath, FilePathHash hash) const {
+		FileSystem& fs = m_app.getEngine().getFileSystem();
+		const Path dst_path(".lumix/resources/", hash, ".res");
+		const StaticString<LUMIX_MAX_PATH> meta_path(filepath, ".meta");
+		return !fs.fileExists(dst_path)
+			|| fs.getLastModified(dst_path) < fs.getLastModified(filepath)
+			|| fs.getLastModified(dst_path) < fs.getLastModified(meta_path);
+	}
+
+	void compileOutdated() override {
+		Array<Path> outdated(m_app.getAllocator());
+		{
+			jobs::MutexGuard lock(m_resources_mutex);
+			for (const ResourceItem& ri : m_resources) {
+				const char* filepath = getResourceFilePath(ri.path.c_str());
+				if (!isOutdated(filepath, ri.path.getHash())) continue;
+
+				// subresources share the file
+				const Path path(filepath);
+				if (outdated.indexOf(path) < 0) outdated.push(path);
+			}
+		}
+		for (const Path& path : outdated) pushToCompileQueue(path);
+	}
+
+	// `path` has to wait until all files it depends on are compiled, otherwise it would be compiled again after them
+	bool isWaitingForDependency(const Path& path) const {
+		auto depends_on = [&](const Path& dependency){
+			if (dependency == path) return false;
+			auto iter = m_dependencies.find(dependency);
+			return iter.isValid() && iter.value().indexOf(path) >= 0;
+		};
+		for (const Path& p : m_running) {
+			if (depends_on(p)) return true;
+		}
+		for (const CompileJob& job : m_to_compile) {
+			if (depends_on(job.path)) return true;
+		}
+		return false;
+	}
+
+	void dispatchCompileJobs() {
+		// keep some workers for the editor
+		const u32 max_running = maximum(1, jobs::getWorkersCount() - 1);
+		MutexGuard lock(m_to_compile_mutex);
+		MutexGuard dependencies_lock(m_dependencies_mutex);
+		for (i32 i = m_to_compile.size() - 1; i >= 0 && (u32)m_running.size() < max_running; --i) {
+			const CompileJob job = m_to_compile[i];
+			if (job.generation != m_generations[job.path]) {
+				// there's a newer request for the same file
+				m_to_compile.erase(i);
+				--m_batch_remaining_count;
+				continue;
+			}
+			// outputs of the same file must not be written by two jobs at once
+			if (m_running.indexOf(job.path) >= 0) continue;
+			if (isWaitingForDependency(job.path)) continue;
+
+			runCompileJob(i);
+		}
+
+		// nothing is running and nothing could be started, so there's a cycle in dependencies, just compile something
+		if (m_running.empty() && !m_to_compile.empty()) runCompileJob(m_to_compile.size() - 1);
+	}
+
+	void runCompileJob(i32 idx) {
+		const CompileJob job = m_to_compile[idx];
+		m_to_compile.erase(idx);
+		m_running.push(job.path);
+		m_res_in_progress = job.path.c_str();
+		atomicIncrement(&m_jobs_in_flight);
+		jobs::runLambda([this, job](){ compileJob(job); }, &m_compile_signal);
+	}
+
 	DelegateList<void(const Path&)>& listChanged() override {
 		return m_on_list_changed;
 	}
@@ -263,18 +595,31 @@ struct AssetCompilerImpl : AssetCompiler {
 		}
 		CompiledResourceHeader header;
 		header.decompressed_size = data.length();
+		Span<const u8> content = data;
 		if (data.length() > COMPRESSION_SIZE_LIMIT && compressed_size < i32(data.length() / 4 * 3)) {
 			header.flags |= CompiledResourceHeader::COMPRESSED;
-			(void)file.write(&header, sizeof(header));
-			(void)file.write(compressed.data(), compressed_size);
-		}
-		else {
-			(void)file.write(&header, sizeof(header));
-			(void)file.write(data.begin(), data.length());
+			content = Span(compressed.data(), compressed_size);
 		}
+		(void)file.write(&header, sizeof(header));
+		(void)file.write(content.begin(), content.length());
 		file.close();
-		if (file.isError()) logError("Could not write ", out_path);
-		return !file.isError();
+		if (file.isError()) {
+			logError("Could not write ", out_path);
+			return false;
+		}
+
+		MutexGuard lock(m_records_mutex);
+		auto iter = m_records.find(Path(getResourceFilePath(locator)).getHash());
+		if (iter.isValid()) {
+			CompileRecord* record = iter.value();
+			record->outputs.write(hash);
+			record->outputs.write(u32(sizeof(header) + content.length()));
+			record->outputs.write(&header, sizeof(header));
+			record->outputs.write(content.begin(), content.length());
+			record->outputs_size += sizeof(header) + content.length();
+			++record->outputs_count;
+		}
+		return true;
 	}
 
 	static RuntimeHash dirHash(const char* path) {
@@ -394,6 +739,15 @@ struct AssetCompilerImpl : AssetCompiler {
 
 	void registerDependency(const Path& included_from, const Path& dependency) override
 	{
+		{
+			MutexGuard lock(m_records_mutex);
+			auto record_iter = m_records.find(included_from.getHash());
+			if (record_iter.isValid() && record_iter.value()->dependencies.indexOf(dependency) < 0) {
+				record_iter.value()->dependencies.push(dependency);
+			}
+		}
+
+		MutexGuard lock(m_dependencies_mutex);
 		auto iter = m_dependencies.find(dependency);
 		if (!iter.isValid()) {
 			IAllocator& allocator = m_app.getAllocator();
@@ -455,6 +809,7 @@ struct AssetCompilerImpl : AssetCompiler {
 				lua_getglobal(L, "dependencies");
 				if (lua_type(L, -1) != LUA_TTABLE) return;
 
+				MutexGuard dependencies_lock(m_dependencies_mutex);
 				lua_pushnil(L);
 				while (lua_next(L, -2) != 0) {
 					if (!lua_isstring(L, -2) || !lua_istable(L, -1)) {
@@ -601,15 +956,7 @@ struct AssetCompilerImpl : AssetCompiler {
 		if (startsWith(filepath, ".lumix/resources/")) return ResourceManagerHub::LoadHook::Action::IMMEDIATE;
 		if (startsWith(filepath, ".lumix/asset_tiles/")) return ResourceManagerHub::LoadHook::Action::IMMEDIATE;
 
-		const FilePathHash hash = res.getPath().getHash();
-		const Path dst_path(".lumix/resources/", hash, ".res");
-		const StaticString<LUMIX_MAX_PATH> meta_path(filepath, ".meta");
-
-		if (!fs.fileExists(dst_path)
-			|| fs.getLastModified(dst_path) < fs.getLastModified(filepath)
-			|| fs.getLastModified(dst_path) < fs.getLastModified(meta_path)
-			)
-		{
+		if (isOutdated(filepath, res.getPath().getHash())) {
 			if (!getPlugin(res.getPath())) return ResourceManagerHub::LoadHook::Action::IMMEDIATE;
 			if (!m_init_finished) {
 				res.incRefCount();
@@ -638,9 +985,9 @@ struct AssetCompilerImpl : AssetCompiler {
 		job.generation = iter.value();
 
 		m_to_compile.push(job);
+		if (m_compile_batch_count == 0) m_batch_timer = os::Timer();
 		++m_compile_batch_count;
 		++m_batch_remaining_count;
-		m_semaphore.signal();
 	}
 
 	CompileJob popCompiledResource()
@@ -650,7 +997,10 @@ struct AssetCompilerImpl : AssetCompiler {
 		const CompileJob p = m_compiled.back();
 		m_compiled.pop();
 		--m_batch_remaining_count;
-		if (m_batch_remaining_count == 0) m_compile_batch_count = 0;
+		if (m_batch_remaining_count == 0) {
+			logInfo("Compiled ", m_compile_batch_count, " resources in ", m_batch_timer.getTimeSinceStart(), " s");
+			m_compile_batch_count = 0;
+		}
 		return p;
 	}
 
@@ -698,6 +1048,7 @@ struct AssetCompilerImpl : AssetCompiler {
 		for(;;) {
 			CompileJob job = popCompiledResource();
 			if (job.path.isEmpty()) break;
+			m_running.swapAndPopItem(job.path);
 
 			// this can take some time, mutex is probably not the best option
 
@@ -720,12 +1071,7 @@ struct AssetCompilerImpl : AssetCompiler {
 			}
 
 			// compile all dependents
-			auto dep_iter = m_dependencies.find(job.path);
-			if (dep_iter.isValid()) {
-				for (const Path& p : dep_iter.value()) {
-					pushToCompileQueue(p);
-				}
-			}
+			pushDependentsToCompileQueue(job.path);
 		}
 
 		for (;;) {
@@ -791,18 +1137,29 @@ struct AssetCompilerImpl : AssetCompiler {
 				}
 			}
 			else {
-				auto dep_iter = m_dependencies.find(path_obj);
-				if (dep_iter.isValid()) {
-					for (const Path& p : dep_iter.value()) {
-						pushToCompileQueue(p);
-					}
-				}
+				pushDependentsToCompileQueue(path_obj);
 			}
 		}
+
+		dispatchCompileJobs();
+	}
+
+	void pushDependentsToCompileQueue(const Path& path) {
+		Array<Path> dependents(m_app.getAllocator());
+		{
+			MutexGuard lock(m_dependencies_mutex);
+			auto iter = m_dependencies.find(path);
+			if (!iter.isValid()) return;
+			dependents.resize(iter.value().size());
+			for (i32 i = 0; i < dependents.size(); ++i) dependents[i] = iter.value()[i];
+		}
+		for (const Path& p : dependents) pushToCompileQueue(p);
 	}
 
 	void removePlugin(IPlugin& plugin) override
 	{
+		// plugin can be used by running jobs
+		jobs::wait(&m_compile_signal);
 		MutexGuard lock(m_plugin_mutex);
 		bool removed;
 		do {
@@ -837,22 +1194,36 @@ struct AssetCompilerImpl : AssetCompiler {
 		return m_resources;
 	}
 
-	Semaphore m_semaphore;
 	Mutex m_to_compile_mutex;
 	Mutex m_compiled_mutex;
 	Mutex m_changed_mutex;
 	Mutex m_plugin_mutex;
+	Mutex m_dependencies_mutex;
+	Mutex m_records_mutex;
 	jobs::Mutex m_resources_mutex;
+	// plugins which can not compile in parallel
+	jobs::Mutex m_serial_compile_mutex;
+	jobs::Signal m_compile_signal;
+	// green whenever a compile job finishes, see waitForCompileJob
+	jobs::Signal m_progress_signal;
+	volatile i32 m_jobs_in_flight = 0;
 	HashMap<Path, u32> m_generations; 
 	HashMap<Path, Array<Path>> m_dependencies; 
 	Array<Path> m_changed_files;
 	Array<Path> m_changed_dirs;
 	Array<CompileJob> m_to_compile;
+	// paths being compiled, main thread only
+	Array<Path> m_running;
 	Array<CompileJob> m_compiled;
+	// key is hash of the file being compiled
+	HashMap<FilePathHash, CompileRecord*> m_records;
+	// empty if caching is disabled
+	Path m_cache_dir;
+	// key is hash of extension, guarded by m_compiled_mutex
+	HashMap<RuntimeHash, CompileStats> m_stats;
 	StudioApp& m_app;
 	LoadHook m_load_hook;
 	HashMap<RuntimeHash, IPlugin*> m_plugins;
-	AssetCompilerTask m_task;
 	UniquePtr<FileSystemWatcher> m_watcher;
 	HashMap<FilePathHash, ResourceItem> m_resources;
 	HashMap<u32, ResourceType, HashFuncDirect<u32>> m_registered_extensions;
@@ -863,44 +1234,11 @@ struct AssetCompilerImpl : AssetCompiler {
 
 	u32 m_compile_batch_count = 0;
 	u32 m_batch_remaining_count = 0;
+	os::Timer m_batch_timer;
 	StaticString<LUMIX_MAX_PATH> m_res_in_progress;
 };
 
 
-int AssetCompilerTask::task()
-{
-	while (!m_finished) {
-		m_compiler.m_semaphore.wait();
-		const AssetCompilerImpl::CompileJob p = [&]{
-			MutexGuard lock(m_compiler.m_to_compile_mutex);
-			AssetCompilerImpl::CompileJob p = m_compiler.m_to_compile.back();
-			if (p.path.isEmpty()) return p;
-
-			auto iter = m_compiler.m_generations.find(p.path);
-			const bool is_most_recent = p.generation == iter.value();
-			if (is_most_recent) {
-				m_compiler.m_res_in_progress = p.path.c_str();
-			}
-			else {
-				p.path = Path();
-				--m_compiler.m_batch_remaining_count;
-			}
-			m_compiler.m_to_compile.pop();
-			return p;
-		}();
-		if (!p.path.isEmpty()) {
-			PROFILE_BLOCK("compile asset");
-			profiler::pushString(p.path.c_str());
-			const bool compiled = m_compiler.compile(p.path);
-			if (!compiled) logError("Failed to compile resource ", p.path);
-			MutexGuard lock(m_compiler.m_compiled_mutex);
-			m_compiler.m_compiled.push(p);
-		}
-	}
-	return 0;
-}
-
-
 UniquePtr<AssetCompiler> AssetCompiler::create(StudioApp& app) {
 	return UniquePtr<AssetCompilerImpl>::create(app.getAllocator(), app);
 }
@@ -16,6 +16,10 @@ struct LUMIX_EDITOR_API AssetCompiler {
 		virtual ~IPlugin() {}
 		virtual bool compile(const Path& src) = 0;
 		virtual void addSubresources(AssetCompiler& compiler, const char* path);
+		// compile can run on more workers at once, otherwise it's serialized with other such plugins
+		virtual bool canCompileInParallel() const { return false; }
+		// change when compiled output changes for the same source, so cached outputs are not used
+		virtual u32 getVersion() const { return 0; }
 	};
 
 	struct ResourceItem {
@@ -34,6 +38,14 @@ struct LUMIX_EDITOR_API AssetCompiler {
 	virtual void addPlugin(IPlugin& plugin, const char** extensions) = 0;
 	virtual void removePlugin(IPlugin& plugin) = 0;
 	virtual bool compile(const Path& path) = 0;
+	// queues all resources which were not compiled yet or whose source or meta changed since they were compiled
+	virtual void compileOutdated() = 0;
+	// something is queued, compiling or waiting for update() to process it
+	virtual bool hasWork() = 0;
+	// yields the calling job until some compile job finishes, returns false if none is running
+	virtual bool waitForCompileJob() = 0;
+	// time, count and bytes in/out of compiled resources grouped by extension, returns number of failed resources
+	virtual u32 logCompileStats() = 0;
 	virtual bool getMeta(const Path& res, void* user_ptr, void (*callback)(void*, lua_State*)) const = 0;
 	virtual void updateMeta(const Path& res, const char* src) const = 0;
 	virtual const HashMap<FilePathHash, ResourceItem>& lockResources() = 0;
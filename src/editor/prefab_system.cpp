@@ -236,22 +236,21 @@ public:
 		}
 		
 		Engine& engine = m_editor.getEngine();
-		EntityMap entity_map(m_editor.getAllocator());
+		Array<EntityPtr> instances(m_editor.getAllocator());
+		if (!engine.instantiatePrefabs(*m_world, prefab_res, transforms, instances)) {
+			logError("Failed to instantiate prefab ", prefab_res.getPath());
+			return;
+		}
+
 		const PrefabHandle prefab = prefab_res.getPath().getHash();
 		m_roots.reserve(m_roots.size() + transforms.size());
-		
-		for (const Transform& tr : transforms) {
-			entity_map.m_map.clear();
-			if (!engine.instantiatePrefab(*m_world, prefab_res, tr.pos, tr.rot, tr.scale, entity_map)) {
-				logError("Failed to instantiate prefab ", prefab_res.getPath());
-				return;
-			}
-
-			for (const EntityPtr& e : entity_map.m_map) {
-				setPrefab((EntityRef)e, prefab);
-			}
+		for (const EntityPtr& e : instances) {
+			if (e.isValid()) setPrefab((EntityRef)e, prefab);
+		}
 
-			const EntityRef root = (EntityRef)entity_map.m_map[0];
+		const u32 stride = prefab_res.instance_template.map_size;
+		for (u32 i = 0, c = transforms.size(); i < c; ++i) {
+			const EntityRef root = (EntityRef)instances[i * stride];
 			m_roots.insert(root, prefab);
 			entities.push(root);
 		}
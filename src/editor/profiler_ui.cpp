@@ -926,7 +926,11 @@ void ProfilerUIImpl::onGUICPUProfiler()
 		else {
 			ImGui::Separator();
 			ImGui::Text("Context switch tracing not available.");
-			ImGui::Text("Run the app as an administrator.");
+			#ifdef _WIN32
+				ImGui::Text("Run the app as an administrator.");
+			#else
+				ImGui::Text("Run the app as root or set kernel.perf_event_paranoid to 0.");
+			#endif
 		}
 		ImGui::EndPopup();
 	}
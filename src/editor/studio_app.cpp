@@ -30,6 +30,7 @@
 #include "engine/reflection.h"
 #include "engine/resource_manager.h"
 #include "engine/world.h"
+#include "lz4/lz4.h"
 #include "log_ui.h"
 #include "profiler_ui.h"
 #include "property_grid.h"
@@ -266,6 +267,7 @@ struct StudioAppImpl final : StudioApp
 			m_inactive_fps_timer.tick();
 		}
 
+		m_main_allocator.pushProfilerCounters();
 		profiler::frame();
 		m_events.clear();
 		m_is_f2_pressed = false;
@@ -282,6 +284,10 @@ struct StudioAppImpl final : StudioApp
 		} data = {this, &semaphore};
 		jobs::runLambda([&data]() {
 			data.that->onInit();
+			if (data.that->m_cook) {
+				data.that->cook();
+				data.that->m_finished = true;
+			}
 			while (!data.that->m_finished) {
 				os::Event e;
 				while(os::getEvent(e)) {
@@ -335,8 +341,10 @@ struct StudioAppImpl final : StudioApp
 
 		char data_dir[LUMIX_MAX_PATH] = "";
 		checkDataDirCommandLine(data_dir, lengthOf(data_dir));
+		m_cook = checkCookCommandLine();
 
 		Engine::InitArgs init_data = {};
+		init_data.create_window = !m_cook;
 		init_data.handle_file_drops = true;
 		init_data.window_title = "Lumix Studio";
 		init_data.working_dir = data_dir[0] ? data_dir : (saved_data_dir[0] ? saved_data_dir : current_dir);
@@ -347,8 +355,10 @@ struct StudioAppImpl final : StudioApp
 		};
 		init_data.plugins = Span(plugins, plugins + lengthOf(plugins) - 1);
 		m_engine = Engine::create(static_cast<Engine::InitArgs&&>(init_data), m_allocator);
+		// exported pak is laid out in the order files were loaded
+		m_engine->getFileSystem().setLoadTraceEnabled(true);
 		m_main_window = m_engine->getWindowHandle();
-		m_windows.push(m_main_window);
+		if (m_main_window != os::INVALID_WINDOW) m_windows.push(m_main_window);
 		logInfo("Current directory: ", current_dir);
 
 		createLua();
@@ -369,16 +379,17 @@ struct StudioAppImpl final : StudioApp
 		ImGui::SetAllocatorFunctions(imguiAlloc, imguiFree, this);
 		ImGui::CreateContext();
 		loadSettings();
-		initIMGUI();
+		if (!m_cook) initIMGUI();
 
 		setStudioApp();
 		loadSettings();
-		loadWorldFromCommandLine();
+		if (!m_cook) loadWorldFromCommandLine();
 
 		m_asset_compiler->onInitFinished();
-		m_asset_browser->onInitFinished();
+		// asset browser's file list is only for UI and it needs render interface for thumbnails
+		if (!m_cook) m_asset_browser->onInitFinished();
 		
-		checkScriptCommandLine();
+		if (!m_cook) checkScriptCommandLine();
 
 		logInfo("Startup took ", init_timer.getTimeSinceStart(), " s"); 
 	}
@@ -394,7 +405,8 @@ struct StudioAppImpl final : StudioApp
 		m_asset_browser->releaseResources();
 		m_watched_plugin.watcher.reset();
 
-		saveSettings();
+		// cook does not change settings, and without imgui there's no UI state to save
+		if (!m_cook) saveSettings();
 
 		while (m_engine->getFileSystem().hasWork()) {
 			m_engine->getFileSystem().processCallbacks();
@@ -1097,6 +1109,7 @@ struct StudioAppImpl final : StudioApp
 	void toggleEntityList() { m_is_entity_list_open = !m_is_entity_list_open; }
 	bool isEntityListOpen() const { return m_is_entity_list_open; }
 	int getExitCode() const override { return m_exit_code; }
+	bool isHeadless() const override { return m_cook; }
 	
 	DirSelector& getDirSelector() override {
 		return m_dir_selector;
@@ -2120,18 +2133,21 @@ struct StudioAppImpl final : StudioApp
 
 		m_is_entity_list_open = m_settings.m_is_entity_list_open;
 
-		if (m_settings.m_is_maximized)
-		{
-			os::maximizeWindow(m_main_window);
-		}
-		else if (m_settings.m_window.w > 0)
+		if (m_main_window != os::INVALID_WINDOW)
 		{
-			os::Rect r;
-			r.left = m_settings.m_window.x;
-			r.top = m_settings.m_window.y;
-			r.width = m_settings.m_window.w;
-			r.height = m_settings.m_window.h;
-			os::setWindowScreenRect(m_main_window, r);
+			if (m_settings.m_is_maximized)
+			{
+				os::maximizeWindow(m_main_window);
+			}
+			else if (m_settings.m_window.w > 0)
+			{
+				os::Rect r;
+				r.left = m_settings.m_window.x;
+				r.top = m_settings.m_window.y;
+				r.width = m_settings.m_window.w;
+				r.height = m_settings.m_window.h;
+				os::setWindowScreenRect(m_main_window, r);
+			}
 		}
 		m_export.dest_dir = "";
 		m_settings.getValue(Settings::LOCAL, "export_dir", Span(m_export.dest_dir.data));
@@ -2855,6 +2871,71 @@ struct StudioAppImpl final : StudioApp
 		}
 	}
 
+	// -cook <dest_dir> compiles all outdated resources, packs them to <dest_dir>/main.pak and exits
+	bool checkCookCommandLine() {
+		char command_line[1024];
+		os::getCommandLine(Span(command_line));
+		CommandLineParser parser(command_line);
+		while (parser.next()) {
+			if (!parser.currentEquals("-cook")) continue;
+			if (!parser.next()) {
+				logError("-cook expects destination directory");
+				return false;
+			}
+
+			char dest_dir[LUMIX_MAX_PATH];
+			parser.getCurrent(dest_dir, lengthOf(dest_dir));
+			Path::normalize(dest_dir, Span(m_cook_dir.data));
+			const i32 len = stringLength(m_cook_dir);
+			if (len > 0 && m_cook_dir.data[len - 1] != '/') m_cook_dir.append("/");
+			return true;
+		}
+		return false;
+	}
+
+	void cook() {
+		os::Timer timer;
+		// loadSettings sets export dir from user settings
+		m_export.dest_dir = m_cook_dir;
+		logInfo("Cooking to ", m_export.dest_dir);
+
+		FileSystem& fs = m_engine->getFileSystem();
+		m_asset_compiler->compileOutdated();
+		while (m_asset_compiler->hasWork() || fs.hasWork()) {
+			m_asset_compiler->update();
+			fs.processCallbacks();
+			// we are in a job pinned to worker 0, so yield instead of sleeping, compile and prepare jobs
+			// need this worker if it's the only one
+			const bool compiling = m_asset_compiler->waitForCompileJob();
+			fs.waitForPrepareJobs();
+			// only file reads left, those do not run on workers
+			if (!compiling) os::sleep(1);
+		}
+		const u32 failed = m_asset_compiler->logCompileStats();
+		const float compile_time = timer.getTimeSinceStart();
+
+		if (!os::makePath(m_export.dest_dir) && !os::dirExists(m_export.dest_dir)) {
+			logError("Failed to create ", m_export.dest_dir);
+			m_exit_code = 1;
+			return;
+		}
+		m_export.mode = ExportConfig::Mode::ALL_FILES;
+		m_export.pack = true;
+		if (!exportData()) {
+			m_exit_code = 1;
+			return;
+		}
+
+		const StaticString<LUMIX_MAX_PATH> pak_path(m_export.dest_dir, "main.pak");
+		const u64 pak_size = os::getFileSize(pak_path);
+		logInfo("Cooking finished in ", timer.getTimeSinceStart(), " s (compile ", compile_time, " s), "
+			, pak_path, " is ", float(double(pak_size) / (1024.0 * 1024.0)), " MB");
+		if (failed > 0) {
+			logError(failed, " resources failed to compile");
+			m_exit_code = 1;
+		}
+	}
+
 	static bool includeFileInExport(const char* filename) {
 		if (filename[0] == '.') return false;
 		if (compareStringN("bin/", filename, 4) == 0) return false;
@@ -2984,6 +3065,108 @@ struct StudioAppImpl final : StudioApp
 	}
 
 
+	static bool writePadding(os::OutputFile& file, u64& pos) {
+		static const u8 zeros[PakHeader::ALIGNMENT] = {};
+		const u64 padding = (PakHeader::ALIGNMENT - pos % PakHeader::ALIGNMENT) % PakHeader::ALIGNMENT;
+		if (padding == 0) return true;
+		pos += padding;
+		return file.write(zeros, padding);
+	}
+
+	// compresses `src` to `dst` in PakHeader::BLOCK_SIZE blocks, returns false if it's not worth it
+	static bool compressPakEntry(Span<const u8> src, OutputMemoryStream& dst) {
+		const u32 blocks_count = (src.length() + PakHeader::BLOCK_SIZE - 1) / PakHeader::BLOCK_SIZE;
+		dst.clear();
+		dst.reserve(blocks_count * sizeof(u32) + LZ4_compressBound(PakHeader::BLOCK_SIZE) * blocks_count);
+		dst.resize(blocks_count * sizeof(u32));
+		for (u32 i = 0; i < blocks_count; ++i) {
+			const u32 block_size = minimum(PakHeader::BLOCK_SIZE, src.length() - i * PakHeader::BLOCK_SIZE);
+			const char* block = (const char*)src.begin() + i * PakHeader::BLOCK_SIZE;
+			const u64 pos = dst.size();
+			dst.resize(pos + LZ4_compressBound(block_size));
+			i32 compressed_size = LZ4_compress_default(block, (char*)dst.getMutableData() + pos, block_size, LZ4_compressBound(block_size));
+			if (compressed_size <= 0 || (u32)compressed_size >= block_size) {
+				memcpy(dst.getMutableData() + pos, block, block_size);
+				compressed_size = block_size;
+			}
+			dst.resize(pos + compressed_size);
+			memcpy(dst.getMutableData() + i * sizeof(u32), &compressed_size, sizeof(u32));
+		}
+		// uncompressed entries can be used directly from the mapped pak without any copy, so small gains are not worth it
+		return dst.size() < src.length() / 10 * 9;
+	}
+
+	bool exportPak(const char* dest, AssociativeArray<FilePathHash, ExportFileInfo>& infos) {
+		FileSystem& fs = m_engine->getFileSystem();
+
+		// files are in the order they were loaded in the editor, so loading the same world reads the pak mostly sequentially
+		Array<u32> order(m_allocator);
+		Array<bool> is_ordered(m_allocator);
+		is_ordered.resize(infos.size());
+		for (bool& b : is_ordered) b = false;
+		for (FilePathHash hash : fs.getLoadTrace()) {
+			const i32 idx = infos.find(hash);
+			if (idx < 0 || is_ordered[idx]) continue;
+			is_ordered[idx] = true;
+			order.push(idx);
+		}
+		for (i32 i = 0; i < infos.size(); ++i) {
+			if (!is_ordered[i]) order.push(i);
+		}
+
+		os::OutputFile file;
+		if (!file.open(dest)) {
+			logError("Could not create ", dest);
+			return false;
+		}
+
+		PakHeader header;
+		header.count = infos.size();
+		u64 pos = sizeof(header);
+		bool success = file.write(&header, sizeof(header));
+		success = writePadding(file, pos) && success;
+
+		Array<PakEntry> index(m_allocator);
+		index.reserve(infos.size());
+		OutputMemoryStream src(m_allocator);
+		OutputMemoryStream compressed(m_allocator);
+		for (u32 idx : order) {
+			const ExportFileInfo& info = infos.at(idx);
+			src.clear();
+			if (!fs.getContentSync(Path(info.path), src)) {
+				logError("Could not read ", info.path);
+				file.close();
+				return false;
+			}
+
+			PakEntry& entry = index.emplace();
+			entry.hash = info.hash;
+			entry.offset = pos;
+			entry.uncompressed_size = src.size();
+			const bool is_compressed = compressPakEntry(src, compressed);
+			const OutputMemoryStream& data = is_compressed ? compressed : src;
+			entry.size = data.size();
+			success = file.write(data.data(), data.size()) && success;
+			pos += data.size();
+			success = writePadding(file, pos) && success;
+		}
+
+		qsort(index.begin(), index.size(), sizeof(PakEntry), [](const void* a, const void* b) -> i32 {
+			const FilePathHash ha = ((const PakEntry*)a)->hash;
+			const FilePathHash hb = ((const PakEntry*)b)->hash;
+			return ha < hb ? -1 : hb < ha ? 1 : 0;
+		});
+		success = file.write(index.begin(), index.byte_size()) && success;
+		file.close();
+
+		if (!success) {
+			logError("Could not write ", dest);
+			return false;
+		}
+		return true;
+	}
+
+
 	void showExportGameDialog() { m_is_export_game_dialog_open = true; }
 
 
@@ -3066,43 +3249,7 @@ struct StudioAppImpl final : StudioApp
 				logError("No files found while trying to create ", dest);
 				return false;
 			}
-			u64 total_size = 0;
-			for (ExportFileInfo& info : infos) {
-				info.offset = total_size;
-				total_size += info.size;
-			}
-			
-			os::OutputFile file;
-			if (!file.open(dest)) {
-				logError("Could not create ", dest);
-				return false;
-			}
-
-			const u32 count = (u32)infos.size();
-			bool success = file.write(&count, sizeof(count));
-
-			for (auto& info : infos) {
-				success = file.write(&info.hash, sizeof(info.hash)) && success;
-				success = file.write(&info.offset, sizeof(info.offset)) && success;
-				success = file.write(&info.size, sizeof(info.size)) && success;
-			}
-
-			OutputMemoryStream src(m_allocator);
-			for (const ExportFileInfo& info : infos) {
-				src.clear();
-				if (!fs.getContentSync(Path(info.path), src)) {
-					logError("Could not read ", info.path);
-					file.close();
-					return false;
-				}
-				success = file.write(src.data(), src.size()) && success;
-			}
-			file.close();
-
-			if (!success) {
-				logError("Could not write ", dest);
-				return false;
-			}
+			if (!exportPak(dest, infos)) return false;
 		}
 		else {
 			char dest[LUMIX_MAX_PATH];
@@ -3308,6 +3455,8 @@ struct StudioAppImpl final : StudioApp
 	float m_export_msg_timer = -1;
 	bool m_entity_selection_changed = false;
 	bool m_finished;
+	bool m_cook = false;
+	StaticString<LUMIX_MAX_PATH> m_cook_dir;
 	bool m_deferred_game_mode_exit;
 	int m_exit_code;
 
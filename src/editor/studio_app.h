@@ -84,6 +84,8 @@ struct LUMIX_EDITOR_API StudioApp {
 	virtual WorldEditor& getWorldEditor() = 0;
 	virtual void run() = 0;
 	virtual int getExitCode() const = 0;
+	// no window and no GPU device (-cook), plugins register only their asset compiler plugins
+	virtual bool isHeadless() const = 0;
 	
 	virtual struct PropertyGrid& getPropertyGrid() = 0;
 	virtual struct LogUI& getLogUI() = 0;
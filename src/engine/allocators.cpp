@@ -3,6 +3,7 @@
 #include "engine/crt.h"
 #include "engine/math.h"
 #include "engine/os.h"
+#include "engine/profiler.h"
 #if !defined __linux__ && defined __clang__
 	#include <intrin.h>
 #endif
@@ -14,9 +15,31 @@
 
 namespace Lumix
 {
-	static constexpr u32 PAGE_SIZE = 4096;
-	static constexpr size_t MAX_PAGE_COUNT = 16384;
-	static constexpr u32 SMALL_ALLOC_MAX_SIZE = 64;
+	static constexpr u32 PAGE_SIZE = 16384;
+	static constexpr u32 PAGES_PER_CHUNK = 4096; // 64MB
+	static constexpr size_t CHUNK_SIZE = size_t(PAGE_SIZE) * PAGES_PER_CHUNK;
+	static constexpr u32 SMALL_ALLOC_MAX_SIZE = 1024;
+	static constexpr u32 MIN_ITEM_SIZE = 8;
+
+	// MAX_THREADS after the thread released its index, such thread uses global bins
+	static thread_local u32 g_thread_index = 0xffFFffFF;
+	
+	// thread indices and caches are released when a thread exits, see ThreadExitHook
+	// guarded by a spinlock, since allocators can be created before any static mutex
+	static volatile i32 g_registry_lock = 0;
+	static DefaultAllocator* g_allocators[16] = {};
+	static u32 g_allocators_count = 0;
+	static u32 g_thread_count = 0;
+	static u32 g_free_thread_indices[DefaultAllocator::MAX_THREADS];
+	static u32 g_free_thread_indices_count = 0;
+
+	struct RegistryGuard {
+		RegistryGuard() { while (!compareAndExchange(&g_registry_lock, 1, 0)) {} }
+		~RegistryGuard() {
+			writeBarrier();
+			g_registry_lock = 0;
+		}
+	};
 
 	struct DefaultAllocator::Page {
 		struct Header {
@@ -30,18 +53,35 @@ namespace Lumix
 	};
 
 	static_assert(sizeof(DefaultAllocator::Page) == PAGE_SIZE);
+	static_assert(MIN_ITEM_SIZE << (DefaultAllocator::BIN_COUNT - 1) == SMALL_ALLOC_MAX_SIZE);
+
+	// per-thread magazines, items are moved between them and the global bins in batches,
+	// so the mutex is taken once per batch instead of once per allocation
+	struct DefaultAllocator::ThreadCache {
+		struct Bin {
+			void* head = nullptr;
+			u32 count = 0;
+		};
+		Bin bins[BIN_COUNT];
+	};
 
 	static u32 sizeToBin(size_t n) {
 		ASSERT(n > 0);
 		ASSERT(n <= SMALL_ALLOC_MAX_SIZE);
+		if (n <= MIN_ITEM_SIZE) return 0;
 		#ifdef _WIN32
 			unsigned long res;
-			return _BitScanReverse(&res, ((unsigned long)n - 1) >> 2) ? res : 0;
+			_BitScanReverse(&res, (unsigned long)n - 1);
+			return res - 2;
 		#else
-			return 31 - __builtin_clz((n - 1) >> 2);
+			return 32 - __builtin_clz(u32(n - 1)) - 3;
 		#endif
 	}
 
+	static u32 batchSize(u32 item_size) {
+		return maximum(4u, 2048 / item_size);
+	}
+
 	void initPage(u32 item_size, DefaultAllocator::Page* page) {
 		os::memCommit(page, PAGE_SIZE);
 		page = new (NewPlaceholder(), page) DefaultAllocator::Page;
@@ -59,71 +99,61 @@ namespace Lumix
 		return (DefaultAllocator::Page*)((uintptr)ptr & ~u64(PAGE_SIZE - 1));
 	}
 
-	static void freeSmall(DefaultAllocator& allocator, void* mem) {
+	static DefaultAllocator::Page* newPage(DefaultAllocator& allocator) {
+		const u32 chunk = allocator.m_page_count / PAGES_PER_CHUNK;
+		if (chunk == (u32)allocator.m_chunk_count) {
+			if (chunk == DefaultAllocator::MAX_CHUNKS) return nullptr;
+
+			// os reserve is not necessarily aligned to our page size
+			u8* mem = (u8*)os::memReserve(CHUNK_SIZE + PAGE_SIZE);
+			if (!mem) return nullptr;
+			allocator.m_chunk_reserves[chunk] = mem;
+			allocator.m_chunks[chunk] = (u8*)(((uintptr)mem + PAGE_SIZE - 1) & ~uintptr(PAGE_SIZE - 1));
+			// isSmallAlloc reads chunks without lock
+			memoryBarrier();
+			allocator.m_chunk_count = chunk + 1;
+		}
+		const u32 page_idx = allocator.m_page_count % PAGES_PER_CHUNK;
+		++allocator.m_page_count;
+		return (DefaultAllocator::Page*)(allocator.m_chunks[chunk] + size_t(PAGE_SIZE) * page_idx);
+	}
+
+	// m_mutex must be locked
+	static void freeToPage(DefaultAllocator& allocator, void* mem) {
 		u8* ptr = (u8*)mem;
 		DefaultAllocator::Page* page = getPage(ptr);
 		
-		MutexGuard guard(allocator.m_mutex);
 		if (page->header.first_free + page->header.item_size > sizeof(page->data)) {
 			ASSERT(!page->header.next);
 			ASSERT(!page->header.prev);
 			const u32 bin = sizeToBin(page->header.item_size);
-			page->header.next = allocator.m_free_lists[bin];
+			DefaultAllocator::Page* head = allocator.m_free_lists[bin];
+			page->header.next = head;
+			if (head) head->header.prev = page;
 			allocator.m_free_lists[bin] = page;
 		}
 
 		*(u32*)ptr = page->header.first_free;
 		page->header.first_free = u32(ptr - page->data);
+		allocator.m_small_used -= page->header.item_size;
 	}
 
-	static void* reallocSmall(DefaultAllocator& allocator, void* mem, size_t n) {
-		DefaultAllocator::Page* p = getPage(mem);
-		if (n <= SMALL_ALLOC_MAX_SIZE) {
-			const u32 bin = sizeToBin(n);
-			if (sizeToBin(p->header.item_size) == bin) return mem;
-		}
-		
-		void* new_mem = allocator.allocate(n);
-		memcpy(new_mem, mem, minimum((size_t)p->header.item_size, n));
-		allocator.deallocate(mem);
-		return new_mem;
-	}
-	
-	static void* reallocSmallAligned(DefaultAllocator& allocator, void* mem, size_t n, size_t align) {
-		DefaultAllocator::Page* p = getPage(mem);
-		if (n <= SMALL_ALLOC_MAX_SIZE) {
-			const u32 bin = sizeToBin(n);
-			if (sizeToBin(p->header.item_size) == bin) return mem;
-		}
-		
-		void* new_mem = allocator.allocate_aligned(n, align);
-		memcpy(new_mem, mem, minimum((size_t)p->header.item_size, n));
-		allocator.deallocate_aligned(mem);
-		return new_mem;
-	}
-
-	static void* allocSmall(DefaultAllocator& allocator, size_t n) {
-		const u32 bin = sizeToBin(n);
-
-		MutexGuard guard(allocator.m_mutex);
-
-		if (!allocator.m_small_allocations) {
-			allocator.m_small_allocations = (u8*)os::memReserve(PAGE_SIZE * MAX_PAGE_COUNT);
-		}
+	// m_mutex must be locked
+	static void* allocFromPage(DefaultAllocator& allocator, u32 bin) {
 		DefaultAllocator::Page* p = allocator.m_free_lists[bin];
 		if (!p) {
-			if (allocator.m_page_count == MAX_PAGE_COUNT) return nullptr;
+			p = newPage(allocator);
+			if (!p) return nullptr;
 
-			p = (DefaultAllocator::Page*)(allocator.m_small_allocations + PAGE_SIZE * allocator.m_page_count);
-			initPage(8 << bin, p);
+			initPage(MIN_ITEM_SIZE << bin, p);
 			allocator.m_free_lists[bin] = p;
-			++allocator.m_page_count;
 		}
 
 		ASSERT(p->header.item_size > 0);
-		ASSERT(p->header.first_free + n < sizeof(p->data));
+		ASSERT(p->header.first_free + p->header.item_size <= sizeof(p->data));
 		void* res = &p->data[p->header.first_free];
 		p->header.first_free = *(u32*)res;
+		allocator.m_small_used += p->header.item_size;
 
 		const bool is_page_full = p->header.first_free + p->header.item_size > sizeof(p->data);
 		if (is_page_full) {
@@ -142,23 +172,240 @@ namespace Lumix
 		return res;
 	}
 
+	// returns all cached items to pages
+	static void flushAll(DefaultAllocator& allocator, DefaultAllocator::ThreadCache& cache) {
+		MutexGuard guard(allocator.m_mutex);
+		++allocator.m_lock_count;
+		for (DefaultAllocator::ThreadCache::Bin& bin : cache.bins) {
+			while (bin.head) {
+				void* item = bin.head;
+				bin.head = *(void**)item;
+				freeToPage(allocator, item);
+			}
+			bin.count = 0;
+		}
+	}
+
+	struct ThreadExitHook {
+		~ThreadExitHook() {
+			const u32 idx = g_thread_index;
+			// allocations from other thread_local destructors go directly to global bins
+			g_thread_index = DefaultAllocator::MAX_THREADS;
+			if (idx >= DefaultAllocator::MAX_THREADS) return;
+
+			RegistryGuard guard;
+			for (u32 i = 0; i < g_allocators_count; ++i) {
+				DefaultAllocator& allocator = *g_allocators[i];
+				DefaultAllocator::ThreadCache* cache = allocator.m_thread_caches[idx];
+				if (!cache) continue;
+				flushAll(allocator, *cache);
+				allocator.m_thread_caches[idx] = nullptr;
+				free(cache);
+			}
+			g_free_thread_indices[g_free_thread_indices_count] = idx;
+			++g_free_thread_indices_count;
+		}
+	};
+
+	static thread_local ThreadExitHook g_thread_exit_hook;
+
+	static u32 acquireThreadIndex() {
+		RegistryGuard guard;
+		u32 idx;
+		if (g_free_thread_indices_count > 0) {
+			--g_free_thread_indices_count;
+			idx = g_free_thread_indices[g_free_thread_indices_count];
+		}
+		else if (g_thread_count < DefaultAllocator::MAX_THREADS) {
+			idx = g_thread_count;
+			++g_thread_count;
+		}
+		else {
+			return DefaultAllocator::MAX_THREADS;
+		}
+		// constructs the thread_local, so its destructor runs on thread exit
+		(void)&g_thread_exit_hook;
+		return idx;
+	}
+
+	static DefaultAllocator::ThreadCache* getThreadCache(DefaultAllocator& allocator) {
+		if (g_thread_index == 0xffFFffFF) g_thread_index = acquireThreadIndex();
+		// too many threads, the rest goes directly to global bins
+		if (g_thread_index >= DefaultAllocator::MAX_THREADS) return nullptr;
+
+		DefaultAllocator::ThreadCache* cache = allocator.m_thread_caches[g_thread_index];
+		if (cache) return cache;
+
+		cache = new (NewPlaceholder(), malloc(sizeof(DefaultAllocator::ThreadCache))) DefaultAllocator::ThreadCache;
+		allocator.m_thread_caches[g_thread_index] = cache;
+		return cache;
+	}
+
+	static void refill(DefaultAllocator& allocator, u32 bin, DefaultAllocator::ThreadCache::Bin& cache) {
+		const u32 count = batchSize(MIN_ITEM_SIZE << bin);
+		
+		MutexGuard guard(allocator.m_mutex);
+		++allocator.m_lock_count;
+		for (u32 i = 0; i < count; ++i) {
+			void* item = allocFromPage(allocator, bin);
+			if (!item) break;
+			*(void**)item = cache.head;
+			cache.head = item;
+			++cache.count;
+		}
+	}
+
+	static void flush(DefaultAllocator& allocator, u32 bin, DefaultAllocator::ThreadCache::Bin& cache) {
+		const u32 count = batchSize(MIN_ITEM_SIZE << bin);
+		
+		MutexGuard guard(allocator.m_mutex);
+		++allocator.m_lock_count;
+		for (u32 i = 0; i < count; ++i) {
+			void* item = cache.head;
+			cache.head = *(void**)item;
+			--cache.count;
+			freeToPage(allocator, item);
+		}
+	}
+
+	static void freeSmall(DefaultAllocator& allocator, void* mem) {
+		DefaultAllocator::Page* page = getPage(mem);
+		const u32 bin = sizeToBin(page->header.item_size);
+
+		DefaultAllocator::ThreadCache* cache = getThreadCache(allocator);
+		if (!cache) {
+			MutexGuard guard(allocator.m_mutex);
+			++allocator.m_lock_count;
+			freeToPage(allocator, mem);
+			return;
+		}
+
+		DefaultAllocator::ThreadCache::Bin& cache_bin = cache->bins[bin];
+		*(void**)mem = cache_bin.head;
+		cache_bin.head = mem;
+		++cache_bin.count;
+		if (cache_bin.count > 2 * batchSize(page->header.item_size)) {
+			flush(allocator, bin, cache_bin);
+		}
+	}
+
+	static void* allocSmall(DefaultAllocator& allocator, size_t n) {
+		const u32 bin = sizeToBin(n);
+
+		DefaultAllocator::ThreadCache* cache = getThreadCache(allocator);
+		if (!cache) {
+			MutexGuard guard(allocator.m_mutex);
+			++allocator.m_lock_count;
+			return allocFromPage(allocator, bin);
+		}
+
+		DefaultAllocator::ThreadCache::Bin& cache_bin = cache->bins[bin];
+		if (!cache_bin.head) {
+			refill(allocator, bin, cache_bin);
+			if (!cache_bin.head) return nullptr;
+		}
+
+		void* res = cache_bin.head;
+		cache_bin.head = *(void**)res;
+		--cache_bin.count;
+		return res;
+	}
+
+	static void* reallocSmall(DefaultAllocator& allocator, void* mem, size_t n) {
+		DefaultAllocator::Page* p = getPage(mem);
+		if (n <= SMALL_ALLOC_MAX_SIZE) {
+			const u32 bin = sizeToBin(n);
+			if (sizeToBin(p->header.item_size) == bin) return mem;
+		}
+		
+		void* new_mem = allocator.allocate(n);
+		memcpy(new_mem, mem, minimum((size_t)p->header.item_size, n));
+		allocator.deallocate(mem);
+		return new_mem;
+	}
+	
+	static void* reallocSmallAligned(DefaultAllocator& allocator, void* mem, size_t n, size_t align) {
+		DefaultAllocator::Page* p = getPage(mem);
+		if (n <= SMALL_ALLOC_MAX_SIZE && align <= n) {
+			const u32 bin = sizeToBin(n);
+			if (sizeToBin(p->header.item_size) == bin) return mem;
+		}
+		
+		void* new_mem = allocator.allocate_aligned(n, align);
+		memcpy(new_mem, mem, minimum((size_t)p->header.item_size, n));
+		allocator.deallocate_aligned(mem);
+		return new_mem;
+	}
+
 	static bool isSmallAlloc(DefaultAllocator& allocator, void* p) {
-		return allocator.m_small_allocations && p >= allocator.m_small_allocations && p < allocator.m_small_allocations + (PAGE_SIZE * MAX_PAGE_COUNT);
+		for (i32 i = 0, c = allocator.m_chunk_count; i < c; ++i) {
+			const u8* chunk = allocator.m_chunks[i];
+			if (p >= chunk && p < chunk + CHUNK_SIZE) return true;
+		}
+		return false;
 	}
 
 	DefaultAllocator::DefaultAllocator() {
 		m_page_count = 0;
 		memset(m_free_lists, 0, sizeof(m_free_lists));
+		memset(m_chunks, 0, sizeof(m_chunks));
+		memset(m_chunk_reserves, 0, sizeof(m_chunk_reserves));
+		memset(m_thread_caches, 0, sizeof(m_thread_caches));
+
+		RegistryGuard guard;
+		ASSERT(g_allocators_count < lengthOf(g_allocators));
+		if (g_allocators_count < lengthOf(g_allocators)) {
+			g_allocators[g_allocators_count] = this;
+			++g_allocators_count;
+		}
 	}
 
 	DefaultAllocator::~DefaultAllocator() {
-		os::memRelease(m_small_allocations, PAGE_SIZE * MAX_PAGE_COUNT);
+		{
+			RegistryGuard guard;
+			for (u32 i = 0; i < g_allocators_count; ++i) {
+				if (g_allocators[i] != this) continue;
+				--g_allocators_count;
+				g_allocators[i] = g_allocators[g_allocators_count];
+				break;
+			}
+		}
+		for (ThreadCache* cache : m_thread_caches) {
+			free(cache);
+		}
+		for (i32 i = 0; i < m_chunk_count; ++i) {
+			os::memRelease(m_chunk_reserves[i], CHUNK_SIZE + PAGE_SIZE);
+		}
+	}
+
+	void DefaultAllocator::pushProfilerCounters() {
+		if (m_profiler_counters[0] == 0xffFFffFF) {
+			m_profiler_counters[0] = profiler::createCounter("Small allocations committed (MB)", 0);
+			m_profiler_counters[1] = profiler::createCounter("Small allocations used (MB)", 0);
+			m_profiler_counters[2] = profiler::createCounter("Small allocator locks", 0);
+		}
+		
+		u64 used;
+		u32 page_count;
+		u32 lock_count;
+		{
+			MutexGuard guard(m_mutex);
+			used = m_small_used;
+			page_count = m_page_count;
+			lock_count = m_lock_count;
+			m_lock_count = 0;
+		}
+		// used includes items sitting in thread caches, committed - used is what fragmentation costs us
+		profiler::pushCounter(m_profiler_counters[0], float(double(page_count) * PAGE_SIZE / (1024.0 * 1024.0)));
+		profiler::pushCounter(m_profiler_counters[1], float(double(used) / (1024.0 * 1024.0)));
+		profiler::pushCounter(m_profiler_counters[2], (float)lock_count);
 	}
 
 	void* DefaultAllocator::allocate(size_t n)
 	{
 		if (n <= SMALL_ALLOC_MAX_SIZE) {
-			return allocSmall(*this, n);
+			void* res = allocSmall(*this, n);
+			if (res) return res;
 		}
 		return malloc(n);
 	}
@@ -186,7 +433,8 @@ namespace Lumix
 	void* DefaultAllocator::allocate_aligned(size_t size, size_t align)
 	{
 		if (size <= SMALL_ALLOC_MAX_SIZE && align <= size) {
-			return allocSmall(*this, size);
+			void* res = allocSmall(*this, size);
+			if (res) return res;
 		}
 		return _aligned_malloc(size, align);
 	}
@@ -212,28 +460,40 @@ namespace Lumix
 #else
 	void* DefaultAllocator::allocate_aligned(size_t size, size_t align)
 	{
+		if (size <= SMALL_ALLOC_MAX_SIZE && align <= size) {
+			void* res = allocSmall(*this, size);
+			if (res) return res;
+		}
 		return aligned_alloc(align, size);
 	}
 
 
 	void DefaultAllocator::deallocate_aligned(void* ptr)
 	{
+		if (isSmallAlloc(*this, ptr)) {
+			freeSmall(*this, ptr);
+			return;
+		}
 		free(ptr);
 	}
 
 
 	void* DefaultAllocator::reallocate_aligned(void* ptr, size_t size, size_t align)
 	{
+		if (!ptr) return allocate_aligned(size, align);
+		if (isSmallAlloc(*this, ptr)) {
+			return reallocSmallAligned(*this, ptr, size, align);
+		}
 		// POSIX and glibc do not provide a way to realloc with alignment preservation
 		if (size == 0) {
 			free(ptr);
 			return nullptr;
 		}
-		void* newptr = aligned_alloc(align, size);
+		void* newptr = allocate_aligned(size, align);
 		if (newptr == nullptr) {
 			return nullptr;
 		}
-		memcpy(newptr, ptr, malloc_usable_size(ptr));
+		memcpy(newptr, ptr, minimum(size, malloc_usable_size(ptr)));
 		free(ptr);
 		return newptr;
 	}
@@ -318,11 +578,18 @@ static u32 roundUp(u32 val, u32 align) {
 }
 
 void* LinearAllocator::allocate_aligned(size_t size, size_t align) {
-	ASSERT(size < 0xffFFffFF);
+	void* res = tryAllocateAligned(size, align);
+	ASSERT(res);
+	return res;
+}
+
+void* LinearAllocator::tryAllocateAligned(size_t size, size_t align) {
+	if (size >= m_reserved) return nullptr;
 	u32 start;
 	for (;;) {
 		const u32 end = m_end;
 		start = roundUp(end, (u32)align);
+		if (u64(start) + size >= m_reserved) return nullptr;
 		if (compareAndExchange(&m_end, u32(start + size), end)) break;
 	}
 
@@ -331,8 +598,7 @@ void* LinearAllocator::allocate_aligned(size_t size, size_t align) {
 	MutexGuard guard(m_mutex);
 	if (start + size <= m_commited) return m_mem + start;
 
-	const u32 commited = roundUp(start + (u32)size, 4096);
-	ASSERT(commited < m_reserved);
+	const u32 commited = minimum(roundUp(start + (u32)size, 4096), m_reserved);
 	os::memCommit(m_mem + m_commited, commited - m_commited);
 	m_commited = commited;
 
@@ -356,8 +622,7 @@ void* LinearAllocator::allocate(size_t size) {
 	MutexGuard guard(m_mutex);
 	if (start + size <= m_commited) return m_mem + start;
 
-	const u32 commited = roundUp(start + (u32)size, 4096);
-	ASSERT(commited < m_reserved);
+	const u32 commited = minimum(roundUp(start + (u32)size, 4096), m_reserved);
 	os::memCommit(m_mem + m_commited, commited - m_commited);
 	m_commited = commited;
 
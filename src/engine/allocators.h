@@ -5,7 +5,7 @@
 
 namespace Lumix {
 
-// use buckets for small allocations - relatively fast
+// use buckets with per-thread caches for small allocations (up to 1KB) - relatively fast
 // fallback to system allocator for big allocations
 // use case: use this unless you really require something special
 struct LUMIX_ENGINE_API DefaultAllocator final : IAllocator {
@@ -21,9 +21,23 @@ struct LUMIX_ENGINE_API DefaultAllocator final : IAllocator {
 	void deallocate_aligned(void* ptr) override;
 	void* reallocate_aligned(void* ptr, size_t size, size_t align) override;
 
-	u8* m_small_allocations = nullptr;
-	Page* m_free_lists[4];
+	// pushes small allocation stats to profiler, call once per frame
+	void pushProfilerCounters();
+
+	static constexpr u32 BIN_COUNT = 8;
+	static constexpr u32 MAX_CHUNKS = 64;
+	static constexpr u32 MAX_THREADS = 256;
+	struct ThreadCache;
+
+	u8* m_chunks[MAX_CHUNKS];
+	u8* m_chunk_reserves[MAX_CHUNKS];
+	volatile i32 m_chunk_count = 0;
+	ThreadCache* m_thread_caches[MAX_THREADS];
+	Page* m_free_lists[BIN_COUNT];
 	u32 m_page_count = 0;
+	u64 m_small_used = 0;
+	u32 m_lock_count = 0;
+	u32 m_profiler_counters[3] = { 0xffFFffFF, 0xffFFffFF, 0xffFFffFF };
 	Mutex m_mutex;
 };
 
@@ -58,6 +72,8 @@ struct LUMIX_ENGINE_API LinearAllocator : IAllocator {
 	void* allocate(size_t size) override;
 	void deallocate(void* ptr) override;
 	void* reallocate(void* ptr, size_t size) override;
+	// nullptr if there's not enough reserved memory left
+	void* tryAllocateAligned(size_t size, size_t align);
 
 	u32 getCommited() const { return m_commited; }
 
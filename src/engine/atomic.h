@@ -15,5 +15,9 @@ LUMIX_ENGINE_API i32 atomicSubtract(i32 volatile* addend, i32 value);
 LUMIX_ENGINE_API bool compareAndExchange(i32 volatile* dest, i32 exchange, i32 comperand);
 LUMIX_ENGINE_API bool compareAndExchange64(i64 volatile* dest, i64 exchange, i64 comperand);
 LUMIX_ENGINE_API void memoryBarrier();
+// loads before the barrier are not reordered with loads and stores after it (acquire)
+LUMIX_ENGINE_API void readBarrier();
+// loads and stores before the barrier are not reordered with stores after it (release)
+LUMIX_ENGINE_API void writeBarrier();
 
 } // namespace Lumix
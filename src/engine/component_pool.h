@@ -0,0 +1,153 @@
+#pragma once
+
+
+#include "engine/array.h"
+#include "engine/lumix.h"
+
+
+namespace Lumix
+{
+
+
+// Sparse set of components keyed by entity, drop-in replacement for HashMap<EntityRef, T>.
+// Values are packed in one array, so iteration is linear, and lookup by entity is a single array access.
+// Erasing moves the last value to the erased slot, so pointers and iterators to values are invalidated
+// by erase and insert; entity is the stable handle.
+template <typename T>
+struct ComponentPool {
+	template <typename Pool, typename V>
+	struct IteratorBase {
+		Pool* pool;
+		u32 idx;
+
+		template <typename Pool2, typename V2>
+		bool operator !=(const IteratorBase<Pool2, V2>& rhs) const {
+			ASSERT(pool == rhs.pool);
+			return idx != rhs.idx;
+		}
+
+		template <typename Pool2, typename V2>
+		bool operator ==(const IteratorBase<Pool2, V2>& rhs) const {
+			ASSERT(pool == rhs.pool);
+			return idx == rhs.idx;
+		}
+
+		void operator++() { ++idx; }
+
+		const EntityRef& key() const { return pool->m_entities[idx]; }
+		V& value() const { return pool->m_values[idx]; }
+		V& operator*() const { return pool->m_values[idx]; }
+		bool isValid() const { return idx < (u32)pool->m_values.size(); }
+	};
+
+	using Iterator = IteratorBase<ComponentPool, T>;
+	using ConstIterator = IteratorBase<const ComponentPool, const T>;
+
+	explicit ComponentPool(IAllocator& allocator)
+		: m_sparse(allocator)
+		, m_entities(allocator)
+		, m_values(allocator)
+	{}
+
+	Iterator begin() { return {this, 0}; }
+	ConstIterator begin() const { return {this, 0}; }
+	Iterator end() { return {this, (u32)m_values.size()}; }
+	ConstIterator end() const { return {this, (u32)m_values.size()}; }
+
+	Iterator find(EntityRef e) { return {this, getIndex(e)}; }
+	ConstIterator find(EntityRef e) const { return {this, getIndex(e)}; }
+	bool has(EntityRef e) const { return getIndex(e) != (u32)m_values.size(); }
+
+	T& operator[](EntityRef e) {
+		ASSERT(has(e));
+		return m_values[m_sparse[e.index]];
+	}
+
+	const T& operator[](EntityRef e) const {
+		ASSERT(has(e));
+		return m_values[m_sparse[e.index]];
+	}
+
+	T& insert(EntityRef e) { return insert(e, T{}).value(); }
+
+	Iterator insert(EntityRef e, T&& value) {
+		const u32 idx = allocIndex(e);
+		m_values.push(static_cast<T&&>(value));
+		return {this, idx};
+	}
+
+	Iterator insert(EntityRef e, const T& value) {
+		const u32 idx = allocIndex(e);
+		m_values.push(value);
+		return {this, idx};
+	}
+
+	void erase(const Iterator& iter) {
+		ASSERT(iter.isValid());
+		const u32 idx = iter.idx;
+		// destructors can access other components in the pool (e.g. to unlink from a list),
+		// so the erased value is destroyed only after the pool is consistent again
+		T value(static_cast<T&&>(m_values[idx]));
+		const EntityRef last = m_entities.back();
+		m_sparse[m_entities[idx].index] = -1;
+		if (idx + 1 != (u32)m_values.size()) m_sparse[last.index] = idx;
+		m_entities.swapAndPop(idx);
+		m_values.swapAndPop(idx);
+	}
+
+	void erase(EntityRef e) {
+		const Iterator iter = find(e);
+		if (iter.isValid()) erase(iter);
+	}
+
+	void clear() {
+		// destroy values first, their destructors can still look up the rest of the pool
+		m_values.clear();
+		for (EntityRef e : m_entities) m_sparse[e.index] = -1;
+		m_entities.clear();
+	}
+
+	void reserve(u32 capacity) {
+		m_entities.reserve(capacity);
+		m_values.reserve(capacity);
+	}
+
+	bool empty() const { return m_values.empty(); }
+	u32 size() const { return (u32)m_values.size(); }
+	Span<T> values() { return m_values; }
+	Span<const T> values() const { return m_values; }
+	Span<const EntityRef> entities() const { return m_entities; }
+
+private:
+	u32 getIndex(EntityRef e) const {
+		if (e.index < 0 || e.index >= m_sparse.size()) return (u32)m_values.size();
+		const i32 idx = m_sparse[e.index];
+		return idx < 0 ? (u32)m_values.size() : (u32)idx;
+	}
+
+	u32 allocIndex(EntityRef e) {
+		ASSERT(!has(e));
+		if (e.index >= m_sparse.size()) {
+			const u32 old_size = m_sparse.size();
+			// grow geometrically, entities are usually created with increasing index
+			if (u32(e.index) >= m_sparse.capacity()) {
+				const u32 capacity = m_sparse.capacity() * 2;
+				m_sparse.reserve(capacity > u32(e.index + 1) ? capacity : e.index + 1);
+			}
+			m_sparse.resize(e.index + 1);
+			for (u32 i = old_size; i < (u32)m_sparse.size(); ++i) m_sparse[i] = -1;
+		}
+		const u32 idx = (u32)m_values.size();
+		m_sparse[e.index] = idx;
+		m_entities.push(e);
+		return idx;
+	}
+
+	// index to m_values for each entity, -1 if entity does not have the component
+	Array<i32> m_sparse;
+	Array<EntityRef> m_entities;
+	Array<T> m_values;
+};
+
+
+} // namespace Lumix
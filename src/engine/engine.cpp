@@ -25,24 +25,9 @@ namespace Lumix
 
 void registerEngineAPI(lua_State* L, Engine* engine);
 
-static const u32 SERIALIZED_ENGINE_MAGIC = 0x5f4c454e; // == '_LEN'
 static const u32 SERIALIZED_PROJECT_MAGIC = 0x5f50524c; // == '_PRL'
 
 
-enum class SerializedEngineVersion : u32 {
-	VEC3_SCALE,
-	LAST
-};
-
-#pragma pack(1)
-struct SerializedEngineHeader
-{
-	u32 magic;
-	SerializedEngineVersion version;
-};
-#pragma pack()
-
-
 struct PrefabResourceManager final : ResourceManager
 {
 	explicit PrefabResourceManager(IAllocator& allocator)
@@ -87,12 +72,15 @@ public:
 		registerLogCallback<&EngineImpl::logToFile>(this);
 		registerLogCallback<logToDebugOutput>();
 
-		os::InitWindowArgs init_win_args;
-		init_win_args.handle_file_drops = init_data.handle_file_drops;
-		init_win_args.name = init_data.window_title;
-		m_window_handle = os::createWindow(init_win_args);
-		if (m_window_handle == os::INVALID_WINDOW) {
-			logError("Failed to create main window.");
+		m_window_handle = os::INVALID_WINDOW;
+		if (init_data.create_window) {
+			os::InitWindowArgs init_win_args;
+			init_win_args.handle_file_drops = init_data.handle_file_drops;
+			init_win_args.name = init_data.window_title;
+			m_window_handle = os::createWindow(init_win_args);
+			if (m_window_handle == os::INVALID_WINDOW) {
+				logError("Failed to create main window.");
+			}
 		}
 
 		m_is_log_file_open = m_log_file.open("lumix.log");
@@ -174,7 +162,7 @@ public:
 		unregisterLogCallback<&EngineImpl::logToFile>(this);
 		m_log_file.close();
 		m_is_log_file_open = false;
-		os::destroyWindow(m_window_handle);
+		if (m_window_handle != os::INVALID_WINDOW) os::destroyWindow(m_window_handle);
 	}
 
 	static void* luaAlloc(void* ud, void* ptr, size_t osize, size_t nsize) {
@@ -222,18 +210,69 @@ public:
 		const Vec3& scale,
 		EntityMap& entity_map) override
 	{
+		const Transform tr = {pos, rot, scale};
+		return instantiatePrefabs(world, prefab, Span(&tr, 1), entity_map.m_map);
+	}
+
+	bool instantiatePrefabs(World& world, const PrefabResource& prefab, Span<const Transform> transforms, Array<EntityPtr>& entities) override
+	{
+		PROFILE_FUNCTION();
 		ASSERT(prefab.isReady());
+		if (transforms.length() == 0) return true;
+
 		InputMemoryStream blob(prefab.data);
-		if (!deserialize(world, blob, entity_map)) {
+		blob.setPosition(sizeof(SerializedEngineHeader));
+		if (!hasSerializedPlugins(blob)) {
 			logError("Failed to instantiate prefab ", prefab.getPath());
 			return false;
 		}
 
-		ASSERT(!entity_map.m_map.empty());
-		const EntityRef root = (EntityRef)entity_map.m_map[0];
-		ASSERT(!world.getParent(root).isValid());
-		ASSERT(!world.getNextSibling(root).isValid());
-		world.setTransform(root, pos, rot, scale);
+		const WorldTemplate& tpl = prefab.instance_template;
+		world.beginBatch();
+		world.instantiate(tpl, transforms.length(), entities);
+
+		EntityMap entity_map(m_allocator);
+		entity_map.m_map.resize(tpl.map_size);
+		auto set_instance = [&](u32 instance) {
+			memcpy(entity_map.m_map.begin(), &entities[instance * tpl.map_size], tpl.map_size * sizeof(EntityPtr));
+		};
+
+		struct SceneSection {
+			IScene* scene;
+			i32 version;
+			u64 offset;
+		};
+		Array<SceneSection> sections(m_allocator);
+
+		// scene data have no size, the first instance is done in order to find where each scene starts
+		set_instance(0);
+		blob.setPosition(prefab.scenes_offset);
+		const i32 scene_count = blob.read<i32>();
+		for (i32 i = 0; i < scene_count; ++i) {
+			const char* name = blob.readString();
+			SceneSection& section = sections.emplace();
+			section.scene = world.getScene(name);
+			section.version = blob.read<i32>();
+			section.offset = blob.getPosition();
+			section.scene->deserialize(blob, entity_map, section.version);
+		}
+
+		// the rest is done scene by scene, so each scene creates all its components at once
+		for (const SceneSection& section : sections) {
+			for (u32 i = 1; i < transforms.length(); ++i) {
+				set_instance(i);
+				blob.setPosition(section.offset);
+				section.scene->deserialize(blob, entity_map, section.version);
+			}
+		}
+
+		for (u32 i = 0; i < transforms.length(); ++i) {
+			const EntityRef root = (EntityRef)entities[i * tpl.map_size];
+			ASSERT(!world.getParent(root).isValid());
+			ASSERT(!world.getNextSibling(root).isValid());
+			world.setTransform(root, transforms[i]);
+		}
+		world.endBatch();
 		return true;
 	}
 
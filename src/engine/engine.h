@@ -8,6 +8,22 @@ struct lua_State;
 namespace Lumix {
 
 namespace os { using WindowHandle = void*; }
+template <typename T> struct Array;
+
+static const u32 SERIALIZED_ENGINE_MAGIC = 0x5f4c454e; // == '_LEN'
+
+enum class SerializedEngineVersion : u32 {
+	VEC3_SCALE,
+	LAST
+};
+
+#pragma pack(1)
+struct SerializedEngineHeader
+{
+	u32 magic;
+	SerializedEngineVersion version;
+};
+#pragma pack()
 
 enum class DeserializeProjectResult {
 	SUCCESS,
@@ -23,6 +39,8 @@ struct LUMIX_ENGINE_API Engine {
 		Span<const char*> plugins;
 		bool handle_file_drops = false;
 		const char* window_title = "Lumix App";
+		// tools without UI (e.g. headless cook) do not need a window, renderer does not create a GPU device then
+		bool create_window = true;
 		UniquePtr<struct FileSystem> file_system; 
 	};
 
@@ -48,6 +66,12 @@ struct LUMIX_ENGINE_API Engine {
 		const struct Quat& rot,
 		const struct Vec3& scale,
 		struct EntityMap& entity_map) = 0;
+	// creates an instance of `prefab` for each transform, much faster than calling instantiatePrefab in a loop
+	// `entities` gets prefab.instance_template.map_size entries per instance, root of i-th instance is entities[i * map_size]
+	virtual bool instantiatePrefabs(World& world,
+		const struct PrefabResource& prefab,
+		Span<const struct Transform> transforms,
+		Array<EntityPtr>& entities) = 0;
 
 	virtual void startGame(World& context) = 0;
 	virtual void stopGame(World& context) = 0;
@@ -1,10 +1,6 @@
 #pragma once
 
-
-#ifdef __linux__
-	#include <ucontext.h>
-#endif
-
+#include "engine/lumix.h"
 
 namespace Lumix
 {
@@ -22,17 +18,19 @@ namespace Fiber
 	using FiberProc = void(__stdcall *)(void*);
 	constexpr Handle INVALID_FIBER = nullptr;
 #else 
-	using Handle = ucontext_t;
+	struct Context;
+	using Handle = Context*;
 	using FiberProc = void (*)(void*);
-	constexpr Handle INVALID_FIBER = {};
+	constexpr Handle INVALID_FIBER = nullptr;
 #endif
 
 
-void initThread(FiberProc proc, Handle* handle);
-Handle create(int stack_size, FiberProc proc, void* parameter);
-void destroy(Handle fiber);
-void switchTo(Handle* from, Handle fiber);
-bool isValid(Handle handle);
+LUMIX_ENGINE_API void initThread(FiberProc proc, Handle* handle);
+LUMIX_ENGINE_API Handle create(int stack_size, FiberProc proc, void* parameter);
+LUMIX_ENGINE_API void destroy(Handle fiber);
+// `from` is the handle of the currently running fiber
+LUMIX_ENGINE_API void switchTo(Handle* from, Handle fiber);
+LUMIX_ENGINE_API bool isValid(Handle handle);
 
 
 } // namespace Fiber
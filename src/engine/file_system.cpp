@@ -2,11 +2,14 @@
 
 #include "engine/allocator.h"
 #include "engine/array.h"
+#include "engine/atomic.h"
 #include "engine/delegate_list.h"
 #include "engine/flag_set.h"
 #include "engine/hash_map.h"
+#include "engine/job_system.h"
 #include "engine/metaprogramming.h"
 #include "engine/log.h"
+#include "engine/math.h"
 #include "engine/sync.h"
 #include "engine/thread.h"
 #include "engine/os.h"
@@ -14,6 +17,7 @@
 #include "engine/profiler.h"
 #include "engine/stream.h"
 #include "engine/string.h"
+#include "lz4/lz4.h"
 
 namespace Lumix {
 
@@ -23,16 +27,58 @@ struct AsyncItem {
 		CANCELED = 1 << 1,
 	};
 
+	enum class State : u32 {
+		FREE,
+		QUEUED,
+		READING,
+		PREPARING,
+		FINISHED
+	};
+
 	AsyncItem(IAllocator& allocator) : data(allocator) {}
 	
 	bool isFailed() const { return flags.isSet(Flags::FAILED); }
 	bool isCanceled() const { return flags.isSet(Flags::CANCELED); }
 
 	FileSystem::ContentCallback callback;
+	FileSystem::PrepareCallback prepare;
+	// only the first item of a chain of requests for the same file owns the data
 	OutputMemoryStream data;
 	StaticString<LUMIX_MAX_PATH> path;
-	u32 id = 0;
+	FilePathHash path_hash;
+	// next request for the same file, requests for the same file share a single read
+	u32 next = INVALID;
+	// set by cancel while the item is preparing, the prepare job turns it green once it's done
+	jobs::Signal* prepare_done = nullptr;
+	u32 generation = 0;
+	State state = State::FREE;
 	FlagSet<Flags, u32> flags;
+
+	static constexpr u32 INVALID = 0xffFFffFF;
+};
+
+
+// FIFO of item handles, popped items are not erased until the queue is empty, so push and pop are O(1)
+struct AsyncQueue {
+	explicit AsyncQueue(IAllocator& allocator) : items(allocator) {}
+
+	void push(u32 handle) { items.push(handle); }
+	bool empty() const { return head == (u32)items.size(); }
+	u32 front() const { ASSERT(!empty()); return items[head]; }
+
+	u32 pop() {
+		ASSERT(!empty());
+		const u32 res = items[head];
+		++head;
+		if (head == (u32)items.size()) {
+			items.clear();
+			head = 0;
+		}
+		return res;
+	}
+
+	Array<u32> items;
+	u32 head = 0;
 };
 
 
@@ -47,40 +93,66 @@ struct FSTask final : Thread {
 
 	~FSTask() = default;
 
-	void stop();
 	int task() override;
 
 private:
 	FileSystemImpl& m_fs;
-	bool m_finish = false;
 };
 
 
 struct FileSystemImpl : FileSystem {
+	static constexpr u32 MAX_TASKS = 8;
+	// handle = generation << INDEX_BITS | index to m_items
+	static constexpr u32 INDEX_BITS = 20;
+	static constexpr u32 INDEX_MASK = (1 << INDEX_BITS) - 1;
+
 	explicit FileSystemImpl(const char* base_path, IAllocator& allocator)
 		: m_allocator(allocator)
-		, m_queue(allocator)	
-		, m_finished(allocator)	
-		, m_last_id(0)
-		, m_semaphore(0, 0xffFF)
+		, m_items(allocator)
+		, m_free_items(allocator)
+		, m_queues{AsyncQueue(allocator), AsyncQueue(allocator), AsyncQueue(allocator)}
+		, m_finished(allocator)
+		, m_pending_files(allocator)
+		, m_load_trace(allocator)
+		, m_load_trace_set(allocator)
+		, m_semaphore(0, 0x7fffFFFF)
 	{
 		setBasePath(base_path);
-		m_task.create(*this, m_allocator);
-		m_task->create("Filesystem", true);
+		// reads are mostly waiting for the disk, so we can have more threads than there are free cores
+		m_tasks_count = clamp(os::getCPUsCount() / 2, 2, MAX_TASKS);
+		for (u32 i = 0; i < m_tasks_count; ++i) {
+			m_tasks[i].create(*this, m_allocator);
+			m_tasks[i]->create("Filesystem", true);
+		}
 	}
 
 	~FileSystemImpl() override {
-		m_task->stop();
-		m_task->destroy();
-		m_task.destroy();
+		shutdown();
+	}
+
+protected:
+	// stops reader tasks and waits for prepare jobs, derived filesystems must call it before releasing anything the tasks read from
+	void shutdown() {
+		m_finish = true;
+		for (u32 i = 0; i < m_tasks_count; ++i) m_semaphore.signal();
+		for (u32 i = 0; i < m_tasks_count; ++i) {
+			m_tasks[i]->destroy();
+			m_tasks[i].destroy();
+		}
+		m_tasks_count = 0;
+		jobs::wait(&m_prepare_signal);
 	}
 
+public:
+
 
 	bool hasWork() override
 	{
 		return m_work_counter != 0;
 	}
 
+	void waitForPrepareJobs() override { jobs::wait(&m_prepare_signal); }
+
 	const char* getBasePath() const override { return m_base_path; }
 
 	void setBasePath(const char* dir) final
@@ -118,42 +190,150 @@ struct FileSystemImpl : FileSystem {
 		return true;
 	}
 
-	AsyncHandle getContent(const Path& file, const ContentCallback& callback) override
+	u32 allocItem() {
+		if (!m_free_items.empty()) {
+			const u32 idx = m_free_items.back();
+			m_free_items.pop();
+			return idx;
+		}
+		ASSERT(m_items.size() < INDEX_MASK);
+		m_items.emplace(m_allocator);
+		return m_items.size() - 1;
+	}
+
+	void freeItem(u32 idx) {
+		AsyncItem& item = m_items[idx];
+		item.callback = {};
+		item.prepare = {};
+		item.data.free();
+		item.flags.clear();
+		item.next = AsyncItem::INVALID;
+		item.prepare_done = nullptr;
+		item.state = AsyncItem::State::FREE;
+		// invalidates all existing handles to this item
+		item.generation = (item.generation + 1) & (0xffFFffFF >> INDEX_BITS);
+		// handle with all bits set is AsyncHandle::invalid()
+		if (idx == INDEX_MASK && item.generation == (0xffFFffFF >> INDEX_BITS)) item.generation = 0;
+		m_free_items.push(idx);
+	}
+
+	u32 getHandle(u32 idx) const { return (m_items[idx].generation << INDEX_BITS) | idx; }
+
+	// returns nullptr if the handle is stale
+	AsyncItem* getItem(u32 handle) {
+		const u32 idx = handle & INDEX_MASK;
+		if (idx >= (u32)m_items.size()) return nullptr;
+		AsyncItem& item = m_items[idx];
+		if (item.state == AsyncItem::State::FREE || getHandle(idx) != handle) return nullptr;
+		return &item;
+	}
+
+	AsyncHandle getContent(const Path& file, const ContentCallback& callback, Priority priority) override
+	{
+		return getContent(file, PrepareCallback(), callback, priority);
+	}
+
+	AsyncHandle getContent(const Path& file, const PrepareCallback& prepare, const ContentCallback& callback, Priority priority) override
 	{
 		if (file.isEmpty()) return AsyncHandle::invalid();
 
 		MutexGuard lock(m_mutex);
+		if (m_record_load_trace) {
+			const FilePathHash hash = getPakHash(file);
+			if (!m_load_trace_set.find(hash).isValid()) {
+				m_load_trace_set.insert(hash, true);
+				m_load_trace.push(hash);
+			}
+		}
+
 		++m_work_counter;
-		AsyncItem& item = m_queue.emplace(m_allocator);
-		++m_last_id;
-		if (m_last_id == 0) ++m_last_id;
-		item.id = m_last_id;
+		const u32 idx = allocItem();
+		AsyncItem& item = m_items[idx];
 		item.path = file.c_str();
+		item.path_hash = file.getHash();
 		item.callback = callback;
+		item.prepare = prepare;
+		item.state = AsyncItem::State::QUEUED;
+
+		if (item.prepare.isValid()) {
+			// prepare can change the content, so it can not be shared with other requests
+			m_queues[(u32)priority].push(getHandle(idx));
+			m_semaphore.signal();
+			return AsyncHandle(getHandle(idx));
+		}
+
+		auto iter = m_pending_files.find(item.path_hash);
+		if (iter.isValid() && m_items[iter.value()].state == AsyncItem::State::QUEUED) {
+			// someone already requested the file and it was not read yet, piggyback on their read
+			// the file could have changed since an ongoing read started (hot reload), so those are not joined
+			AsyncItem& first = m_items[iter.value()];
+			item.next = first.next;
+			first.next = idx;
+			// the file might be queued with lower priority, the first pop of the file wins and makes the other entries stale
+			m_queues[(u32)priority].push(getHandle(iter.value()));
+			m_semaphore.signal();
+			return AsyncHandle(getHandle(idx));
+		}
+
+		// replaces ongoing read, unregisterPendingFile keeps this one
+		if (iter.isValid()) iter.value() = idx;
+		else m_pending_files.insert(item.path_hash, idx);
+		m_queues[(u32)priority].push(getHandle(idx));
 		m_semaphore.signal();
-		return AsyncHandle(item.id);
+		return AsyncHandle(getHandle(idx));
 	}
 
 
 	void cancel(AsyncHandle async) override
 	{
-		MutexGuard lock(m_mutex);
-		for (AsyncItem& item : m_queue) {
-			if (item.id == async.value) {
-				item.flags.set(AsyncItem::Flags::CANCELED);
-				--m_work_counter;
-				return;
-			}
-		}
-		for (AsyncItem& item : m_finished) {
-			if (item.id == async.value) {
-				item.flags.set(AsyncItem::Flags::CANCELED);
+		jobs::Signal prepare_done;
+		{
+			MutexGuard lock(m_mutex);
+			AsyncItem* item = getItem(async.value);
+			if (!item || item->isCanceled()) {
+				ASSERT(false);
 				return;
 			}
+			item->flags.set(AsyncItem::Flags::CANCELED);
+			// finished items are counted until processCallbacks handles them
+			if (item->state != AsyncItem::State::FINISHED) --m_work_counter;
+			if (item->state != AsyncItem::State::PREPARING) return;
+
+			// caller can destroy whatever prepare works with right after cancel returns, so wait for prepare to finish
+			// the job frees the item once it sees it's canceled
+			jobs::setRed(&prepare_done);
+			item->prepare_done = &prepare_done;
 		}
-		ASSERT(false);
+		// yields to the job system, so the prepare job can run even on the same worker
+		jobs::wait(&prepare_done);
 	}
 
+	void setLoadTraceEnabled(bool enabled) override {
+		MutexGuard lock(m_mutex);
+		m_record_load_trace = enabled;
+	}
+
+	Span<const FilePathHash> getLoadTrace() const override { return m_load_trace; }
+
+	void unregisterPendingFile(u32 idx) {
+		auto iter = m_pending_files.find(m_items[idx].path_hash);
+		if (iter.isValid() && iter.value() == idx) m_pending_files.erase(iter);
+	}
+
+	// used by FSTask, content can be a read-only view of memory owned by the filesystem
+	virtual bool readContent(const Path& path, OutputMemoryStream& content) { return getContentSync(path, content); }
+	// called for the file which is going to be read next, so its data can be loaded in the background
+	virtual void prefetch(const Path& path) {}
+	// called when nobody needs the content returned by readContent anymore
+	virtual void release(Span<const u8> content) {}
+
+	struct PrepareJob {
+		FileSystemImpl* fs;
+		u32 handle;
+	};
+
+	static void prepareJob(void* data);
+
 
 	bool open(const char* path, os::InputFile& file) override
 	{
@@ -224,16 +404,35 @@ struct FileSystemImpl : FileSystem {
 				break;
 			}
 
-			AsyncItem item = static_cast<AsyncItem&&>(m_finished[0]);
-			m_finished.erase(0);
-			ASSERT(m_work_counter > 0);
-			--m_work_counter;
-
+			// take the whole chain of requests for the file, so the data stays alive for all their callbacks
+			const u32 first = m_finished.pop() & INDEX_MASK;
+			OutputMemoryStream data(static_cast<OutputMemoryStream&&>(m_items[first].data));
+			const bool failed = m_items[first].isFailed();
+			
 			m_mutex.exit();
 
-			if(!item.isCanceled()) {
-				item.callback.invoke(item.data.size(), (const u8*)item.data.data(), !item.isFailed());
+			for (u32 idx = first; idx != AsyncItem::INVALID;) {
+				ContentCallback cb;
+				bool canceled;
+				u32 next;
+				{
+					// callbacks can request or cancel other files, which can reallocate m_items
+					MutexGuard lock(m_mutex);
+					AsyncItem& item = m_items[idx];
+					ASSERT(item.state == AsyncItem::State::FINISHED);
+					canceled = item.isCanceled();
+					cb = item.callback;
+					next = item.next;
+					ASSERT(m_work_counter > 0);
+					--m_work_counter;
+					freeItem(idx);
+				}
+				if (!canceled) {
+					cb.invoke(data.size(), (const u8*)data.data(), !failed);
+				}
+				idx = next;
 			}
+			release(data);
 
 			if (timer.getTimeSinceStart() > 0.1f) {
 				break;
@@ -242,118 +441,362 @@ struct FileSystemImpl : FileSystem {
 	}
 
 	IAllocator& m_allocator;
-	Local<FSTask> m_task;
+	Local<FSTask> m_tasks[MAX_TASKS];
+	u32 m_tasks_count = 0;
+	volatile bool m_finish = false;
 	StaticString<LUMIX_MAX_PATH> m_base_path;
-	Array<AsyncItem> m_queue;
+	Array<AsyncItem> m_items;
+	Array<u32> m_free_items;
+	AsyncQueue m_queues[(u32)Priority::COUNT];
+	AsyncQueue m_finished;
+	// path hash -> first of the requests waiting for the file
+	HashMap<FilePathHash, u32> m_pending_files;
+	bool m_record_load_trace = false;
+	Array<FilePathHash> m_load_trace;
+	HashMap<FilePathHash, bool> m_load_trace_set;
+	// running prepare jobs, so we can wait for them in destructor
+	jobs::Signal m_prepare_signal;
 	u32 m_work_counter = 0;
-	Array<AsyncItem> m_finished;
 	Mutex m_mutex;
 	Semaphore m_semaphore;
-
-	u32 m_last_id;
 };
 
 
+void FileSystemImpl::prepareJob(void* data) {
+	PROFILE_FUNCTION();
+	const PrepareJob job = *(PrepareJob*)data;
+	FileSystemImpl& fs = *job.fs;
+	LUMIX_DELETE(fs.m_allocator, (PrepareJob*)data);
+
+	const u32 idx = job.handle & INDEX_MASK;
+	OutputMemoryStream content(fs.m_allocator);
+	PrepareCallback prepare;
+	jobs::Signal* prepare_done = nullptr;
+	{
+		MutexGuard lock(fs.m_mutex);
+		AsyncItem& item = fs.m_items[idx];
+		ASSERT(fs.getHandle(idx) == job.handle);
+		ASSERT(item.state == AsyncItem::State::PREPARING);
+		if (item.isCanceled()) {
+			prepare_done = item.prepare_done;
+			fs.freeItem(idx);
+		}
+		else {
+			content = static_cast<OutputMemoryStream&&>(item.data);
+			prepare = item.prepare;
+		}
+	}
+
+	if (prepare.isValid()) {
+		// item can not be freed while we are here, cancel just marks it and waits for us
+		OutputMemoryStream output(fs.m_allocator);
+		const bool success = prepare.invoke(content, output);
+		if (!output.empty()) {
+			// prepare replaced what was read, e.g. by decompressed data
+			fs.release(content);
+			content = static_cast<OutputMemoryStream&&>(output);
+		}
+
+		MutexGuard lock(fs.m_mutex);
+		AsyncItem& item = fs.m_items[idx];
+		if (item.isCanceled()) {
+			prepare_done = item.prepare_done;
+			fs.freeItem(idx);
+		}
+		else {
+			item.data = static_cast<OutputMemoryStream&&>(content);
+			if (!success) item.flags.set(AsyncItem::Flags::FAILED);
+			item.state = AsyncItem::State::FINISHED;
+			fs.m_finished.push(job.handle);
+		}
+	}
+
+	// cancel is waiting for us, the signal lives on its stack, so it must not be touched after this
+	if (prepare_done) jobs::setGreen(prepare_done);
+}
+
+
 int FSTask::task()
 {
-	while (!m_finish) {
+	for (;;) {
 		m_fs.m_semaphore.wait();
-		if (m_finish) break;
+		if (m_fs.m_finish) break;
 
 		StaticString<LUMIX_MAX_PATH> path;
+		StaticString<LUMIX_MAX_PATH> next_path;
+		u32 idx;
 		{
 			MutexGuard lock(m_fs.m_mutex);
-			ASSERT(!m_fs.m_queue.empty());
-			path = m_fs.m_queue[0].path;
-			if (m_fs.m_queue[0].isCanceled()) {
-				m_fs.m_queue.erase(0);
+			u32 handle = AsyncItem::INVALID;
+			for (i32 i = (i32)FileSystem::Priority::COUNT - 1; i >= 0; --i) {
+				if (!m_fs.m_queues[i].empty()) {
+					handle = m_fs.m_queues[i].pop();
+					break;
+				}
+			}
+			AsyncItem* item = m_fs.getItem(handle);
+			// file was queued more than once and another task already took it
+			if (handle == AsyncItem::INVALID || !item || item->state != AsyncItem::State::QUEUED) continue;
+
+			idx = handle & FileSystemImpl::INDEX_MASK;
+			bool all_canceled = true;
+			for (u32 i = idx; i != AsyncItem::INVALID; i = m_fs.m_items[i].next) {
+				all_canceled = all_canceled && m_fs.m_items[i].isCanceled();
+			}
+			if (all_canceled) {
+				m_fs.unregisterPendingFile(idx);
+				for (u32 i = idx; i != AsyncItem::INVALID;) {
+					const u32 next = m_fs.m_items[i].next;
+					m_fs.freeItem(i);
+					i = next;
+				}
 				continue;
 			}
+
+			for (u32 i = idx; i != AsyncItem::INVALID; i = m_fs.m_items[i].next) {
+				m_fs.m_items[i].state = AsyncItem::State::READING;
+			}
+			path = item->path;
+
+			for (i32 i = (i32)FileSystem::Priority::COUNT - 1; i >= 0; --i) {
+				if (!m_fs.m_queues[i].empty()) {
+					const AsyncItem* next = m_fs.getItem(m_fs.m_queues[i].front());
+					if (next && next->state == AsyncItem::State::QUEUED) next_path = next->path;
+					break;
+				}
+			}
 		}
 
+		if (next_path.data[0]) m_fs.prefetch(Path(next_path));
+
 		OutputMemoryStream data(m_fs.m_allocator);
-		bool success = m_fs.getContentSync(Path(path), data);
+		const bool success = m_fs.readContent(Path(path), data);
 
 		{
 			MutexGuard lock(m_fs.m_mutex);
-			if (!m_fs.m_queue[0].isCanceled()) {
-				m_fs.m_finished.emplace(static_cast<AsyncItem&&>(m_fs.m_queue[0]));
-				m_fs.m_finished.back().data = static_cast<OutputMemoryStream&&>(data);
-				if(!success) {
-					m_fs.m_finished.back().flags.set(AsyncItem::Flags::FAILED);
+			m_fs.unregisterPendingFile(idx);
+
+			AsyncItem& item = m_fs.m_items[idx];
+			if (item.prepare.isValid() && success && !item.isCanceled()) {
+				// requests with prepare are never merged, so there's no chain
+				ASSERT(item.next == AsyncItem::INVALID);
+				item.state = AsyncItem::State::PREPARING;
+				item.data = static_cast<OutputMemoryStream&&>(data);
+				auto* job = LUMIX_NEW(m_fs.m_allocator, FileSystemImpl::PrepareJob){&m_fs, m_fs.getHandle(idx)};
+				jobs::run(job, &FileSystemImpl::prepareJob, &m_fs.m_prepare_signal);
+				continue;
+			}
+
+			// drop requests canceled while we were reading, they are not counted in m_work_counter anymore
+			u32 first = AsyncItem::INVALID;
+			u32 last = AsyncItem::INVALID;
+			for (u32 i = idx; i != AsyncItem::INVALID;) {
+				AsyncItem& item = m_fs.m_items[i];
+				const u32 next = item.next;
+				if (item.isCanceled()) {
+					m_fs.freeItem(i);
+				}
+				else {
+					item.state = AsyncItem::State::FINISHED;
+					item.next = AsyncItem::INVALID;
+					if (last == AsyncItem::INVALID) first = i;
+					else m_fs.m_items[last].next = i;
+					last = i;
 				}
+				i = next;
+			}
+
+			if (first != AsyncItem::INVALID) {
+				m_fs.m_items[first].data = static_cast<OutputMemoryStream&&>(data);
+				if (!success) m_fs.m_items[first].flags.set(AsyncItem::Flags::FAILED);
+				m_fs.m_finished.push(m_fs.getHandle(first));
 			}
-			m_fs.m_queue.erase(0);
 		}
 	}
 	return 0;
 }
 
 
-void FSTask::stop()
-{
-	m_finish = true;
-	m_fs.m_semaphore.signal();
-}
-
 struct PackFileSystem : FileSystemImpl {
 	PackFileSystem(const char* pak_path, IAllocator& allocator) 
 		: FileSystemImpl("pack://", allocator) 
-		, m_map(allocator)
+		, m_v1_entries(allocator)
 	{
-		if (!m_file.open(pak_path)) {
-			logError("Failed to open game.pak");
+		if (!m_mapped.open(pak_path)) {
+			logError("Failed to open ", pak_path);
 			return;
 		}
-		const u32 count = m_file.read<u32>();
-		for (u32 i = 0; i < count; ++i) {
-			const FilePathHash hash = m_file.read<FilePathHash>();
-			PackFile& f = m_map.insert(hash);
-			f.offset = m_file.read<u64>();
-			f.size = m_file.read<u64>();
+		if (!(m_mapped.size() >= sizeof(PakHeader) && ((const PakHeader*)m_mapped.data())->magic == PakHeader::MAGIC ? initV2() : initV1())) {
+			logError(pak_path, " is corrupted");
+			m_entries = {};
 		}
 	}
 
 	~PackFileSystem() {
-		m_file.close();
+		shutdown();
+		m_mapped.close();
+	}
+
+	bool initV1() {
+		InputMemoryStream header(m_mapped.data(), m_mapped.size());
+		const u32 count = header.read<u32>();
+		const u64 data_offset = sizeof(u32) + u64(count) * (2 * sizeof(u64) + sizeof(FilePathHash));
+		if (data_offset > m_mapped.size()) return false;
+
+		m_v1_entries.reserve(count);
+		for (u32 i = 0; i < count; ++i) {
+			PakEntry& e = m_v1_entries.emplace();
+			e.hash = header.read<FilePathHash>();
+			e.offset = header.read<u64>() + data_offset;
+			e.size = header.read<u64>();
+			e.uncompressed_size = e.size;
+		}
+		qsort(m_v1_entries.begin(), m_v1_entries.size(), sizeof(PakEntry), [](const void* a, const void* b) -> i32 {
+			const FilePathHash ha = ((const PakEntry*)a)->hash;
+			const FilePathHash hb = ((const PakEntry*)b)->hash;
+			return ha < hb ? -1 : hb < ha ? 1 : 0;
+		});
+		m_entries = m_v1_entries;
+		m_block_size = 0;
+		return validateEntries();
+	}
+
+	bool initV2() {
+		const PakHeader& header = *(const PakHeader*)m_mapped.data();
+		if (header.version != PakHeader::VERSION) return false;
+		if (header.block_size == 0) return false;
+		const u64 index_size = u64(header.count) * sizeof(PakEntry);
+		if (sizeof(header) + index_size > m_mapped.size()) return false;
+
+		// index is at the end, it's used directly from the mapped pak, nothing to parse
+		const PakEntry* entries = (const PakEntry*)(m_mapped.data() + m_mapped.size() - index_size);
+		m_entries = Span(entries, header.count);
+		m_block_size = header.block_size;
+		return validateEntries();
+	}
+
+	bool validateEntries() const {
+		for (u32 i = 0; i < m_entries.length(); ++i) {
+			const PakEntry& e = m_entries[i];
+			if (e.offset > m_mapped.size() || e.size > m_mapped.size() - e.offset) return false;
+			if (i > 0 && !(m_entries[i - 1].hash < e.hash)) return false;
+			if (e.size != e.uncompressed_size && m_block_size == 0) return false;
+		}
+		return true;
+	}
+
+	// entries are sorted by hash and never modified, so this is safe to call from any thread without locking
+	const PakEntry* find(FilePathHash hash) const {
+		u32 from = 0;
+		u32 to = m_entries.length();
+		while (from < to) {
+			const u32 mid = (from + to) / 2;
+			if (m_entries[mid].hash < hash) from = mid + 1;
+			else to = mid;
+		}
+		if (from < m_entries.length() && m_entries[from].hash == hash) return &m_entries[from];
+		return nullptr;
+	}
+
+	const PakEntry* find(const Path& path) const {
+		const PakEntry* e = find(getPakHash(path));
+		if (!e) e = find(path.getHash());
+		return e;
+	}
+
+	bool decompress(const PakEntry& e, OutputMemoryStream& content) const {
+		PROFILE_FUNCTION();
+		const u32 blocks_count = u32((e.uncompressed_size + m_block_size - 1) / m_block_size);
+		if (u64(blocks_count) * sizeof(u32) > e.size) return false;
+
+		const u8* src = m_mapped.data() + e.offset;
+		const u8* src_end = src + e.size;
+		const u32* block_sizes = (const u32*)src;
+		src += blocks_count * sizeof(u32);
+
+		content.resize(e.uncompressed_size);
+		u8* dst = content.getMutableData();
+		u64 remaining = e.uncompressed_size;
+		for (u32 i = 0; i < blocks_count; ++i) {
+			const u32 block_size = u32(minimum(remaining, (u64)m_block_size));
+			if (block_sizes[i] > u64(src_end - src)) return false;
+			if (block_sizes[i] == block_size) {
+				memcpy(dst, src, block_size);
+			}
+			else if (LZ4_decompress_safe((const char*)src, (char*)dst, block_sizes[i], block_size) != (i32)block_size) {
+				return false;
+			}
+			src += block_sizes[i];
+			dst += block_size;
+			remaining -= block_size;
+		}
+		return true;
 	}
 
 	bool getContentSync(const Path& path, OutputMemoryStream& content) override {
 		ASSERT(content.size() == 0);
-		Span<const char> basename = Path::getBasename(path.c_str());
-		u64 hashu64;
-		fromCString(basename, hashu64);
-		FilePathHash hash = FilePathHash::fromU64(hashu64);
-		if (basename[0] < '0' || basename[0] > '9' || hashu64 == 0) {
-			hash = path.getHash();
-		}
-		auto iter = m_map.find(hash);
-		if (!iter.isValid()) {
-			iter = m_map.find(path.getHash());
-			if (!iter.isValid()) return false;
+		const PakEntry* e = find(path);
+		if (!e) return false;
+
+		if (e->size != e->uncompressed_size) {
+			if (decompress(*e, content)) return true;
+			logError("Could not decompress ", path);
+			return false;
 		}
 
-		content.resize(iter.value().size);
-		MutexGuard lock(m_mutex);
-		const u32 header_size = sizeof(u32) + m_map.size() * (2 * sizeof(u64) + sizeof(FilePathHash));
-		if (!m_file.seek(iter.value().offset + header_size) || !m_file.read(content.getMutableData(), content.size())) {
-			logError("Could not read ", path);
+		// caller owns the content, so it's a copy
+		content.resize(e->size);
+		memcpy(content.getMutableData(), m_mapped.data() + e->offset, e->size);
+		return true;
+	}
+
+	bool readContent(const Path& path, OutputMemoryStream& content) override {
+		const PakEntry* e = find(path);
+		if (!e) return false;
+
+		if (e->size != e->uncompressed_size) {
+			if (decompress(*e, content)) return true;
+			logError("Could not decompress ", path);
 			return false;
 		}
 
+		// no copy, content points directly to the mapped pak, it's alive as long as the filesystem
+		content = OutputMemoryStream((void*)(m_mapped.data() + e->offset), e->size);
+		content.resize(e->size);
 		return true;
 	}
-	
-	struct PackFile {
-		u64 offset;
-		u64 size;
-	};
 
-	HashMap<FilePathHash, PackFile> m_map;
-	os::InputFile m_file;
+	void prefetch(const Path& path) override {
+		const PakEntry* e = find(path);
+		if (e) m_mapped.prefetch(e->offset, e->size);
+	}
+
+	void release(Span<const u8> content) override {
+		const u8* data = m_mapped.data();
+		if (content.begin() < data || content.end() > data + m_mapped.size()) return;
+		// we do not need the pages mapped anymore, so they do not count in our working set
+		m_mapped.evict(content.begin() - data, content.length());
+	}
+
+	os::MappedFile m_mapped;
+	// sorted by hash, points to the mapped pak in v2 or to m_v1_entries
+	Span<const PakEntry> m_entries;
+	Array<PakEntry> m_v1_entries;
+	// 0 in v1, which does not support compression
+	u32 m_block_size = 0;
 };
 
 
+FilePathHash FileSystem::getPakHash(const Path& path) {
+	// compiled resources are named by the hash of their source path
+	Span<const char> basename = Path::getBasename(path.c_str());
+	u64 hash;
+	fromCString(basename, hash);
+	if (basename.length() == 0 || basename[0] < '0' || basename[0] > '9' || hash == 0) return path.getHash();
+	return FilePathHash::fromU64(hash);
+}
+
+
 UniquePtr<FileSystem> FileSystem::create(const char* base_path, IAllocator& allocator)
 {
 	return UniquePtr<FileSystemImpl>::create(allocator, base_path, allocator);
@@ -1,5 +1,6 @@
 #pragma once
 
+#include "engine/hash.h"
 #include "engine/lumix.h"
 
 namespace Lumix {
@@ -13,8 +14,47 @@ namespace os {
 	struct OutputFile;
 }
 
+#pragma pack(1)
+// v2 pak layout: PakHeader, data of entries, each aligned to PakHeader::ALIGNMENT, PakEntry[count] sorted by hash
+// data are usually in load order, so loading is mostly sequential, index is at the end so the pak can be written in a single pass
+// compressed entry (size != uncompressed_size) is u32 stored sizes of its blocks followed by the blocks
+// each block is LZ4 compressed block_size bytes of the file (except the last one), blocks which do not compress are stored as is
+// v1 pak is u32 count, {FilePathHash hash, u64 offset, u64 size}[count], data of entries (offsets are relative to it)
+struct PakHeader {
+	static constexpr u32 MAGIC = '2KAP';
+	static constexpr u32 VERSION = 2;
+	static constexpr u32 BLOCK_SIZE = 64 * 1024;
+	static constexpr u32 ALIGNMENT = 4096;
+
+	u32 magic = MAGIC;
+	u32 version = VERSION;
+	u32 count = 0;
+	u32 block_size = BLOCK_SIZE;
+};
+
+struct PakEntry {
+	FilePathHash hash;
+	u64 offset; // from the beginning of the pak
+	u64 size; // stored size
+	u64 uncompressed_size;
+};
+#pragma pack()
+
 struct LUMIX_ENGINE_API FileSystem {
 	using ContentCallback = Delegate<void(u64, const u8*, bool)>;
+	// runs on a job system worker, returning false fails the request
+	// `content` is read-only, it can be a view of a memory-mapped pack file
+	// if prepare writes anything to `output`, it's passed to ContentCallback instead of `content`
+	using PrepareCallback = Delegate<bool(Span<const u8> content, struct OutputMemoryStream& output)>;
+
+	// requests with higher priority are read first, requests with the same priority are read in FIFO order
+	enum class Priority : u32 {
+		LOW,
+		NORMAL,
+		HIGH,
+
+		COUNT
+	};
 
 	struct LUMIX_ENGINE_API AsyncHandle {
 		static AsyncHandle invalid() { return AsyncHandle(0xffFFffFF); };
@@ -41,11 +81,25 @@ struct LUMIX_ENGINE_API FileSystem {
 	virtual const char* getBasePath() const = 0;
 	virtual void processCallbacks() = 0;
 	virtual bool hasWork() = 0;
+	// waits for `prepare` callbacks which are queued or running, yields if called from a job
+	virtual void waitForPrepareJobs() = 0;
 
 	[[nodiscard]] virtual bool saveContentSync(const struct Path& file, Span<const u8> content) =  0;
 	[[nodiscard]] virtual bool getContentSync(const struct Path& file, struct OutputMemoryStream& content) =  0;
-	virtual AsyncHandle getContent(const Path& file, const ContentCallback& callback) = 0;
+	virtual AsyncHandle getContent(const Path& file, const ContentCallback& callback, Priority priority = Priority::NORMAL) = 0;
+	// `prepare` is called on a worker after the file is read and before `callback` is called on the main thread
+	// such requests are not merged with other requests for the same file
+	// canceling the request waits until `prepare` finishes, if it's already running
+	// content passed to `prepare` can be a read-only view (e.g. of a memory mapped pak), it can be replaced but not written to
+	virtual AsyncHandle getContent(const Path& file, const PrepareCallback& prepare, const ContentCallback& callback, Priority priority = Priority::NORMAL) = 0;
 	virtual void cancel(AsyncHandle handle) = 0;
+
+	// key of the file in paks, compiled resources are stored under the hash of their source path
+	static FilePathHash getPakHash(const Path& path);
+	// records files requested by getContent in the order of requests, so the export can lay out paks in load order
+	virtual void setLoadTraceEnabled(bool enabled) = 0;
+	// files are recorded by their getPakHash, each file only once
+	virtual Span<const FilePathHash> getLoadTrace() const = 0;
 };
 
 } // namespace Lumix
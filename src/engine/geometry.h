@@ -20,6 +20,12 @@ struct LUMIX_ENGINE_API Sphere {
 };
 
 
+struct Ray {
+	DVec3 origin;
+	Vec3 dir;
+};
+
+
 struct alignas(16) LUMIX_ENGINE_API Frustum {
 	Frustum();
 
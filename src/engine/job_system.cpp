@@ -97,6 +97,56 @@ struct RingBuffer {
 	Array<T> m_fallback;
 };
 
+// Chase-Lev work stealing deque
+// only the owning worker can push and pop (LIFO), any thread can steal (FIFO)
+template <typename T, u32 CAPACITY>
+struct WorkStealingQueue {
+	static_assert((CAPACITY & (CAPACITY - 1)) == 0, "Capacity must be power of two");
+
+	// returns false if the queue is full, the caller must put obj somewhere else
+	LUMIX_FORCE_INLINE bool push(const T& obj) {
+		const i64 b = bottom;
+		const i64 t = top;
+		if (b - t >= CAPACITY) return false;
+		objects[b & (CAPACITY - 1)] = obj;
+		memoryBarrier();
+		bottom = b + 1;
+		return true;
+	}
+
+	LUMIX_FORCE_INLINE bool pop(T& obj) {
+		const i64 b = bottom - 1;
+		bottom = b;
+		memoryBarrier();
+		const i64 t = top;
+		if (t > b) {
+			// empty
+			bottom = b + 1;
+			return false;
+		}
+		obj = objects[b & (CAPACITY - 1)];
+		if (t != b) return true;
+		
+		// last item, race with thieves
+		const bool res = compareAndExchange64(&top, t + 1, t);
+		bottom = b + 1;
+		return res;
+	}
+
+	LUMIX_FORCE_INLINE bool steal(T& obj) {
+		const i64 t = top;
+		memoryBarrier();
+		const i64 b = bottom;
+		if (t >= b) return false;
+		obj = objects[t & (CAPACITY - 1)];
+		return compareAndExchange64(&top, t + 1, t);
+	}
+
+	alignas(64) volatile i64 top = 0;
+	alignas(64) volatile i64 bottom = 0;
+	T objects[CAPACITY];
+};
+
 struct WorkerTask;
 
 struct FiberDecl {
@@ -143,11 +193,13 @@ struct System
 	Lumix::Mutex m_job_queue_sync;
 	Lumix::Mutex m_sleeping_sync;
 	Array<WorkerTask*> m_sleeping_workers;
+	volatile i32 m_sleeping_count = 0;
 	Array<WorkerTask*> m_workers;
 	Array<WorkerTask*> m_backup_workers;
 	FiberDecl m_fiber_pool[512];
 	Array<FiberDecl*> m_free_fibers;
 	IAllocator& m_allocator;
+	// work pushed from non-worker threads and overflow from full worker deques
 	RingBuffer<Work, 64> m_work_queue;
 };
 
@@ -205,7 +257,10 @@ struct WorkerTask : Thread
 	FiberDecl* m_current_fiber = nullptr;
 	Fiber::Handle m_primary_fiber;
 	System& m_system;
+	// work pinned to this worker
 	RingBuffer<Work, 4> m_work_queue;
+	// work this worker pushed, other workers steal from it
+	WorkStealingQueue<Work, 1024> m_deque;
 	u8 m_worker_index;
 	bool m_is_enabled = false;
 	bool m_is_backup = false;
@@ -217,30 +272,54 @@ struct Waitor {
 };
 
 void wake() {
+	// pairs with the barrier in manage, either we see the sleeper or the sleeper sees the pushed work
+	memoryBarrier();
+	if (g_system->m_sleeping_count == 0) return;
+
 	Lumix::MutexGuard lock(g_system->m_sleeping_sync);
 
 	for (WorkerTask* task : g_system->m_sleeping_workers) {
 		task->wakeup();
 	}
 	g_system->m_sleeping_workers.clear();
+	g_system->m_sleeping_count = 0;
+}
+
+// push to the current worker's deque if possible, so the work stays local unless somebody steals it
+static void pushWork(const Work& work) {
+	WorkerTask* worker = getWorker();
+	if (worker && !worker->m_is_backup && worker->m_deque.push(work)) return;
+	
+	g_system->m_work_queue.push(work, g_system->m_job_queue_sync);
 }
 
+// Signal::counter is the number of pending jobs (or 1 for red), WAITING_BIT is set while there are parked waitors
+// nobody has claimed yet. Both are in one word so the common case needs just one atomic op and no lock.
+static constexpr i32 WAITING_BIT = 1 << 30;
+static constexpr i32 COUNTER_MASK = WAITING_BIT - 1;
+
 template <bool ZERO>
 LUMIX_FORCE_INLINE static bool trigger(Signal* signal)
 {
+	if constexpr (ZERO) {
+		i32 prev;
+		do {
+			prev = signal->counter;
+		} while (!compareAndExchange(&signal->counter, 0, prev));
+		if (!(prev & WAITING_BIT)) return false;
+	}
+	else {
+		const i32 counter = atomicDecrement(&signal->counter);
+		ASSERT(counter >= 0);
+		if (counter != WAITING_BIT) return false;
+		// claim the waitors, fails if the signal got red again, the next trigger wakes them up then
+		if (!compareAndExchange(&signal->counter, 0, WAITING_BIT)) return false;
+	}
+
+	// the signal can not be destroyed while we hold waitors, so it's safe to access it here
 	Waitor* waitor = nullptr;
 	{
 		Lumix::MutexGuard lock(g_system->m_sync);
-
-		if constexpr (ZERO) {
-			signal->counter = 0;
-		}
-		else {
-			--signal->counter;
-			ASSERT(signal->counter >= 0);
-			if (signal->counter > 0) return false;
-		}
-
 		waitor = signal->waitor;
 		signal->waitor = nullptr;
 	}
@@ -251,7 +330,7 @@ LUMIX_FORCE_INLINE static bool trigger(Signal* signal)
 			Waitor* next = waitor->next;
 			const u8 worker_idx = waitor->fiber->current_job.worker_index;
 			if (worker_idx == ANY_WORKER) {
-				g_system->m_work_queue.push(waitor->fiber, g_system->m_job_queue_sync);
+				pushWork(waitor->fiber);
 			}
 			else {
 				WorkerTask* worker = g_system->m_workers[worker_idx % g_system->m_workers.size()];
@@ -292,12 +371,14 @@ void enableBackupWorker(bool enable)
 
 LUMIX_FORCE_INLINE static bool setRedEx(Signal* signal) {
 	ASSERT(signal);
-	ASSERT(signal->counter <= 1);
-	bool res = compareAndExchange(&signal->counter, 1, 0);
-	if (res) {
-		signal->generation = atomicIncrement(&g_generation);
+	for (;;) {
+		const i32 counter = signal->counter;
+		ASSERT((counter & COUNTER_MASK) <= 1);
+		if (counter & COUNTER_MASK) return false;
+		if (compareAndExchange(&signal->counter, counter | 1, counter)) break;
 	}
-	return res;
+	signal->generation = atomicIncrement(&g_generation);
+	return true;
 }
 
 void setRed(Signal* signal) {
@@ -306,7 +387,7 @@ void setRed(Signal* signal) {
 
 void setGreen(Signal* signal) {
 	ASSERT(signal);
-	ASSERT(signal->counter <= 1);
+	ASSERT((signal->counter & COUNTER_MASK) <= 1);
 	const u32 gen = signal->generation;
 	if (trigger<true>(signal)){
 		profiler::signalTriggered(gen);
@@ -329,9 +410,7 @@ void runEx(void* data, void(*task)(void*), Signal* on_finished, u8 worker_index)
 	job.dec_on_finish = on_finished;
 
 	if (on_finished) {
-		Lumix::MutexGuard guard(g_system->m_sync);
-		++on_finished->counter;
-		if (on_finished->counter == 1) {
+		if ((atomicIncrement(&on_finished->counter) & COUNTER_MASK) == 1) {
 			on_finished->generation = atomicIncrement(&g_generation);
 		}
 	}
@@ -343,13 +422,27 @@ void runEx(void* data, void(*task)(void*), Signal* on_finished, u8 worker_index)
 		return;
 	}
 
-	g_system->m_work_queue.push(job, g_system->m_job_queue_sync);
+	pushWork(job);
 	wake();
 }
 
+static bool stealWork(Work& work, WorkerTask* worker) {
+	const u32 count = g_system->m_workers.size();
+	// start at different victims so thieves do not all hammer the same deque
+	const u32 offset = worker->m_is_backup ? 0 : worker->m_worker_index + 1;
+	for (u32 i = 0; i < count; ++i) {
+		WorkerTask* victim = g_system->m_workers[(i + offset) % count];
+		if (victim == worker) continue;
+		if (victim->m_deque.steal(work)) return true;
+	}
+	return false;
+}
+
 static bool popWork(Work& work, WorkerTask* worker) {
 	if (worker->m_work_queue.pop(work)) return true;
+	if (!worker->m_is_backup && worker->m_deque.pop(work)) return true;
 	if (g_system->m_work_queue.pop(work)) return true;
+	if (stealWork(work, worker)) return true;
 
 	Lumix::MutexGuard lock(g_system->m_job_queue_sync);
 	if (worker->m_work_queue.popSecondary(work)) return true;
@@ -385,12 +478,22 @@ static bool popWork(Work& work, WorkerTask* worker) {
 
 			{
 				Lumix::MutexGuard queue_guard(g_system->m_sleeping_sync);
-				if (popWork(work, worker)) break;
+				g_system->m_sleeping_workers.push(worker);
+				g_system->m_sleeping_count = g_system->m_sleeping_workers.size();
+				// pairs with the barrier in wake
+				memoryBarrier();
+				if (popWork(work, worker)) {
+					g_system->m_sleeping_workers.swapAndPopItem(worker);
+					g_system->m_sleeping_count = g_system->m_sleeping_workers.size();
+					break;
+				}
 			
 				PROFILE_BLOCK("sleeping");
 				profiler::blockColor(0x30, 0x30, 0x30);
-				g_system->m_sleeping_workers.push(worker);
 				worker->sleep(g_system->m_sleeping_sync);
+				// spurious wakeup
+				g_system->m_sleeping_workers.swapAndPopItem(worker);
+				g_system->m_sleeping_count = g_system->m_sleeping_workers.size();
 			}
 
 			if (worker->m_is_backup) break;
@@ -446,8 +549,10 @@ bool init(u8 workers_count, IAllocator& allocator)
 	}
 
 	int count = maximum(1, int(workers_count));
+	// workers already running steal from m_workers while we push, so it must not reallocate
+	g_system->m_workers.reserve(count);
 	for (int i = 0; i < count; ++i) {
-		WorkerTask* task = LUMIX_NEW(allocator, WorkerTask)(*g_system, i < 64 ? u64(1) << i : 0);
+		WorkerTask* task = LUMIX_NEW(allocator, WorkerTask)(*g_system, (u8)i);
 		if (task->create("Worker", false)) {
 			task->m_is_enabled = true;
 			g_system->m_workers.push(task);
@@ -512,44 +617,60 @@ void shutdown()
 	g_system.destroy();
 }
 
+static bool isRed(const Signal* signal) {
+	return (signal->counter & COUNTER_MASK) != 0;
+}
+
 static void waitEx(Signal* signal, bool is_mutex)
 {
 	ASSERT(signal);
-	g_system->m_sync.enter();
-
-	if (signal->counter == 0) {
-		g_system->m_sync.exit();
-		return;
-	}
+	if (!isRed(signal)) return;
 	
 	if (!getWorker()) {
-		while (signal->counter > 0) {
-			g_system->m_sync.exit();
+		while (isRed(signal)) {
 			os::sleep(1);
-			g_system->m_sync.enter();
 		}
-		g_system->m_sync.exit();
 		return;
 	}
 
-	FiberDecl* this_fiber = getWorker()->m_current_fiber;
+	// we can be woken up when the signal is already red again, see trigger
+	for (;;) {
+		g_system->m_sync.enter();
+
+		FiberDecl* this_fiber = getWorker()->m_current_fiber;
 
-	Waitor waitor;
-	waitor.fiber = this_fiber;
-	waitor.next = signal->waitor;
-	signal->waitor = &waitor;
+		Waitor waitor;
+		waitor.fiber = this_fiber;
+		waitor.next = signal->waitor;
+		signal->waitor = &waitor;
 
-	const profiler::FiberSwitchData& switch_data = profiler::beginFiberWait(signal->generation, is_mutex);
-	FiberDecl* new_fiber = g_system->m_free_fibers.back();
-	g_system->m_free_fibers.pop();
-	if (!Fiber::isValid(new_fiber->fiber)) {
-		new_fiber->fiber = Fiber::create(64 * 1024, manage, new_fiber);
+		for (;;) {
+			const i32 counter = signal->counter;
+			if ((counter & COUNTER_MASK) == 0) {
+				// green, waitors are changed only under m_sync so we are still first
+				ASSERT(signal->waitor == &waitor);
+				signal->waitor = waitor.next;
+				g_system->m_sync.exit();
+				return;
+			}
+			if (counter & WAITING_BIT) break;
+			if (compareAndExchange(&signal->counter, counter | WAITING_BIT, counter)) break;
+		}
+
+		const profiler::FiberSwitchData& switch_data = profiler::beginFiberWait(signal->generation, is_mutex);
+		FiberDecl* new_fiber = g_system->m_free_fibers.back();
+		g_system->m_free_fibers.pop();
+		if (!Fiber::isValid(new_fiber->fiber)) {
+			new_fiber->fiber = Fiber::create(64 * 1024, manage, new_fiber);
+		}
+		getWorker()->m_current_fiber = new_fiber;
+		Fiber::switchTo(&this_fiber->fiber, new_fiber->fiber);
+		getWorker()->m_current_fiber = this_fiber;
+		g_system->m_sync.exit();
+		profiler::endFiberWait(switch_data);
+
+		if (!isRed(signal)) return;
 	}
-	getWorker()->m_current_fiber = new_fiber;
-	Fiber::switchTo(&this_fiber->fiber, new_fiber->fiber);
-	getWorker()->m_current_fiber = this_fiber;
-	g_system->m_sync.exit();
-	profiler::endFiberWait(switch_data);
 }
 
 void enter(Mutex* mutex) {
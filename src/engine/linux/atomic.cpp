@@ -45,5 +45,15 @@ LUMIX_ENGINE_API void memoryBarrier()
 	__sync_synchronize();
 }
 
+LUMIX_ENGINE_API void readBarrier()
+{
+	__atomic_thread_fence(__ATOMIC_ACQUIRE);
+}
+
+LUMIX_ENGINE_API void writeBarrier()
+{
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
 
 } // namespace Lumix
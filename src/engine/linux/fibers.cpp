@@ -1,9 +1,9 @@
 #include "engine/fibers.h"
 #include "engine/lumix.h"
 #include "engine/profiler.h"
-#include <ucontext.h>
-#include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
 
 namespace Lumix
 {
@@ -13,55 +13,217 @@ namespace Fiber
 {
 
 
-thread_local Handle g_finisher;
+// lives at the top of the fiber's stack mapping
+struct Context {
+	void* sp; // must be first, used by lumix_fiber_switch
+	void* mapping;
+	size_t mapping_size;
+	FiberProc proc;
+	void* parameter;
+};
+
+
+// saves callee-saved registers on the current stack, stores the stack pointer to *from_sp,
+// switches to to_sp and restores registers from there, unlike swapcontext it does no syscall
+extern "C" void lumix_fiber_switch(void** from_sp, void* to_sp);
+// first return address of a new fiber, calls lumix_fiber_main(ctx)
+extern "C" void lumix_fiber_trampoline();
+extern "C" void lumix_fiber_main(Context* ctx);
+
+
+#if defined __x86_64__
+	asm(R"(
+		.pushsection .text
+		.globl lumix_fiber_switch
+		.hidden lumix_fiber_switch
+		.type lumix_fiber_switch, @function
+		.p2align 4
+	lumix_fiber_switch:
+		pushq %rbp
+		pushq %rbx
+		pushq %r12
+		pushq %r13
+		pushq %r14
+		pushq %r15
+		subq $8, %rsp
+		stmxcsr (%rsp)
+		fnstcw 4(%rsp)
+		movq %rsp, (%rdi)
+		movq %rsi, %rsp
+		ldmxcsr (%rsp)
+		fldcw 4(%rsp)
+		addq $8, %rsp
+		popq %r15
+		popq %r14
+		popq %r13
+		popq %r12
+		popq %rbx
+		popq %rbp
+		ret
+		.size lumix_fiber_switch, .-lumix_fiber_switch
+
+		.globl lumix_fiber_trampoline
+		.hidden lumix_fiber_trampoline
+		.type lumix_fiber_trampoline, @function
+		.p2align 4
+	lumix_fiber_trampoline:
+		movq %r12, %rdi
+		call lumix_fiber_main
+		ud2
+		.size lumix_fiber_trampoline, .-lumix_fiber_trampoline
+		.popsection
+	)");
+
+	// initial frame popped by lumix_fiber_switch
+	struct InitialFrame {
+		u32 mxcsr;
+		u16 fpu_cw;
+		u16 padding;
+		u64 r15, r14, r13, r12, rbx, rbp;
+		void* ret;
+	};
+
+	static void initFrame(InitialFrame* frame, Context* ctx) {
+		frame->mxcsr = 0x1F80; // default, all exceptions masked, round to nearest
+		frame->fpu_cw = 0x037F;
+		frame->r15 = frame->r14 = frame->r13 = frame->rbx = frame->rbp = 0;
+		frame->r12 = (u64)ctx;
+		frame->ret = (void*)lumix_fiber_trampoline;
+	}
+#elif defined __aarch64__
+	asm(R"(
+		.pushsection .text
+		.globl lumix_fiber_switch
+		.hidden lumix_fiber_switch
+		.type lumix_fiber_switch, %function
+		.p2align 4
+	lumix_fiber_switch:
+		sub sp, sp, #160
+		stp x19, x20, [sp, #0]
+		stp x21, x22, [sp, #16]
+		stp x23, x24, [sp, #32]
+		stp x25, x26, [sp, #48]
+		stp x27, x28, [sp, #64]
+		stp x29, x30, [sp, #80]
+		stp d8, d9, [sp, #96]
+		stp d10, d11, [sp, #112]
+		stp d12, d13, [sp, #128]
+		stp d14, d15, [sp, #144]
+		mov x2, sp
+		str x2, [x0]
+		mov sp, x1
+		ldp x19, x20, [sp, #0]
+		ldp x21, x22, [sp, #16]
+		ldp x23, x24, [sp, #32]
+		ldp x25, x26, [sp, #48]
+		ldp x27, x28, [sp, #64]
+		ldp x29, x30, [sp, #80]
+		ldp d8, d9, [sp, #96]
+		ldp d10, d11, [sp, #112]
+		ldp d12, d13, [sp, #128]
+		ldp d14, d15, [sp, #144]
+		add sp, sp, #160
+		ret
+		.size lumix_fiber_switch, .-lumix_fiber_switch
+
+		.globl lumix_fiber_trampoline
+		.hidden lumix_fiber_trampoline
+		.type lumix_fiber_trampoline, %function
+		.p2align 4
+	lumix_fiber_trampoline:
+		mov x0, x19
+		bl lumix_fiber_main
+		brk #0
+		.size lumix_fiber_trampoline, .-lumix_fiber_trampoline
+		.popsection
+	)");
+
+	// initial frame popped by lumix_fiber_switch
+	struct InitialFrame {
+		u64 x19_x28[10];
+		u64 x29;
+		void* x30;
+		u64 d8_d15[8];
+	};
+
+	static void initFrame(InitialFrame* frame, Context* ctx) {
+		memset(frame, 0, sizeof(*frame));
+		frame->x19_x28[0] = (u64)ctx;
+		frame->x30 = (void*)lumix_fiber_trampoline;
+	}
+#else
+	#error Platform not supported
+#endif
+
+
+// context of the thread's original stack
+thread_local Context g_finisher;
+
+
+extern "C" void lumix_fiber_main(Context* ctx)
+{
+	ctx->proc(ctx->parameter);
+	// only the fiber from initThread returns, go back to the thread
+	lumix_fiber_switch(&ctx->sp, g_finisher.sp);
+	ASSERT(false);
+}
 
 
 void initThread(FiberProc proc, Handle* out)
 {
 	*out = create(64*1024, proc, nullptr);
-	getcontext(&g_finisher);
-	out->uc_link = &g_finisher;
-	switchTo(&g_finisher, *out);
+	Handle finisher = &g_finisher;
+	switchTo(&finisher, *out);
+	// proc returned, nothing runs on the fiber anymore
+	destroy(*out);
+	*out = INVALID_FIBER;
 }
 
 
 Handle create(int stack_size, FiberProc proc, void* parameter)
 {
-	ucontext_t fib;
-	getcontext(&fib);
-    fib.uc_stack.ss_sp = (::malloc)(stack_size);
-    fib.uc_stack.ss_size = stack_size;
-    fib.uc_link = 0;
-    makecontext(&fib, (void(*)())proc, 1, parameter); 
-	return fib;
+	const size_t page_size = (size_t)sysconf(_SC_PAGESIZE);
+	const size_t usable_size = (stack_size + sizeof(Context) + page_size - 1) & ~(page_size - 1);
+	const size_t mapping_size = usable_size + page_size;
+	u8* mapping = (u8*)mmap(nullptr, mapping_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_STACK, -1, 0);
+	if (mapping == MAP_FAILED) return INVALID_FIBER;
+	
+	// guard page, stack overflow crashes right away instead of corrupting memory
+	mprotect(mapping, page_size, PROT_NONE);
+
+	Context* ctx = (Context*)(mapping + mapping_size - sizeof(Context));
+	ctx->mapping = mapping;
+	ctx->mapping_size = mapping_size;
+	ctx->proc = proc;
+	ctx->parameter = parameter;
+
+	const uintptr stack_top = ((uintptr)ctx - 16) & ~uintptr(15);
+	InitialFrame* frame = (InitialFrame*)(stack_top - sizeof(InitialFrame));
+	initFrame(frame, ctx);
+	ctx->sp = frame;
+	return ctx;
 }
 
 bool isValid(Handle handle)
 {
-	return handle.uc_stack.ss_sp != nullptr;
+	return handle != INVALID_FIBER;
 }
 
 void destroy(Handle fiber)
 {
-	ASSERT(false);
+	ASSERT(fiber);
+	munmap(fiber->mapping, fiber->mapping_size);
 }
 
 
 void switchTo(Handle* prev, Handle fiber)
 {
 	profiler::beforeFiberSwitch();
-	swapcontext(prev, &fiber); 
-}
-
-
-void* getParameter()
-{
-	ASSERT(false);
-	return nullptr;
+	lumix_fiber_switch(&(*prev)->sp, fiber->sp); 
 }
 
 
 } // namespace Fibers
 
 
-} // namespace Lumix
\ No newline at end of file
+} // namespace Lumix
@@ -100,7 +100,7 @@ void init() {
 
 	XInitThreads();
 	G.display = XOpenDisplay(nullptr);
-	G.im = XOpenIM(G.display, nullptr, nullptr, nullptr);
+	if (G.display) G.im = XOpenIM(G.display, nullptr, nullptr, nullptr);
 
 	struct {
 		KeySym x11;
@@ -286,6 +286,9 @@ void init() {
 		s_keycode_names[(u8)m.lumix] = m.name;
 	}
 
+	// no X server, e.g. headless build machine, only windowless tools (-cook) can run
+	if (!G.display) return;
+
 	G.net_wm_state_atom = XInternAtom(G.display, "_NET_WM_STATE", False);
 	G.net_wm_state_maximized_horz_atom = XInternAtom(G.display, "_NET_WM_STATE_MAXIMIZED_HORZ", False);
 	G.net_wm_state_maximized_vert_atom = XInternAtom(G.display, "_NET_WM_STATE_MAXIMIZED_VERT", False);
@@ -406,6 +409,74 @@ bool InputFile::seek(u64 pos) {
 }
 
 
+MappedFile::MappedFile() {
+	m_data = nullptr;
+	m_size = 0;
+	m_handle = nullptr;
+}
+
+
+MappedFile::~MappedFile() {
+	ASSERT(!m_data);
+}
+
+
+bool MappedFile::open(const char* path) {
+	ASSERT(!m_data);
+	const int fd = ::open(path, O_RDONLY);
+	if (fd < 0) return false;
+
+	struct stat st;
+	if (fstat(fd, &st) != 0 || st.st_size == 0) {
+		::close(fd);
+		return false;
+	}
+
+	// the mapping keeps the file alive, we do not need the descriptor anymore
+	void* mem = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	::close(fd);
+	if (mem == MAP_FAILED) return false;
+
+	m_data = (const u8*)mem;
+	m_size = st.st_size;
+	return true;
+}
+
+
+void MappedFile::close() {
+	if (m_data) {
+		munmap((void*)m_data, m_size);
+		m_data = nullptr;
+		m_size = 0;
+	}
+}
+
+
+void MappedFile::prefetch(u64 offset, u64 size) {
+	ASSERT(m_data);
+	if (offset >= m_size) return;
+	size = minimum(size, m_size - offset);
+	// madvise needs page aligned address
+	const u64 page_size = getMemPageSize();
+	const u64 aligned = offset & ~(page_size - 1);
+	madvise((void*)(m_data + aligned), size + offset - aligned, MADV_WILLNEED);
+}
+
+
+void MappedFile::evict(u64 offset, u64 size) {
+	ASSERT(m_data);
+	if (offset >= m_size) return;
+	size = minimum(size, m_size - offset);
+	// only whole pages, partial pages can be used by neighbouring data
+	const u64 page_size = getMemPageSize();
+	const u64 from = (offset + page_size - 1) & ~(page_size - 1);
+	const u64 to = offset + size == m_size ? m_size : (offset + size) & ~(page_size - 1);
+	if (to <= from) return;
+	// mapping is read-only, so this only drops the pages from our process, they stay in the page cache
+	madvise((void*)(m_data + from), to - from, MADV_DONTNEED);
+}
+
+
 u32 getCPUsCount() {
 	return sysconf(_SC_NPROCESSORS_ONLN);
 }
@@ -1,5 +1,6 @@
 #include "lua_wrapper.h"
 #include "log.h"
+#include "stream.h"
 #include "string.h"
 
 namespace Lumix::LuaWrapper {
@@ -83,6 +84,25 @@ bool execute(lua_State* L
 	return true;
 }
 
+bool compile(Span<const char> content, const char* name, OutputMemoryStream& bytecode) {
+	// lua states are not thread safe, so we use a private one
+	lua_State* L = luaL_newstate();
+	if (luaL_loadbuffer(L, content.begin(), content.length(), name) != 0) {
+		logError(name, ": ", lua_tostring(L, -1));
+		lua_close(L);
+		return false;
+	}
+
+	bytecode.clear();
+	const int res = lua_dump(L, [](lua_State*, const void* data, size_t size, void* ud) -> int {
+		((OutputMemoryStream*)ud)->write(data, size);
+		return 0;
+	}, &bytecode);
+	lua_close(L);
+	return res == 0;
+}
+
+
 bool checkStringField(lua_State* L, int idx, const char* k, Span<char> out) {
 	lua_getfield(L, idx, k);
 	if (!isType<const char*>(L, -1)) {
@@ -237,4 +257,4 @@ void argError(lua_State* L, int index, const char* expected_type) {
 }
 
 
-} // namespace Lumix::LuaWrapper
\ No newline at end of file
+} // namespace Lumix::LuaWrapper
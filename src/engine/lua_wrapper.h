@@ -11,6 +11,7 @@ namespace Lumix {
 
 struct World;
 struct CameraParams;
+struct OutputMemoryStream;
 struct PipelineTexture;
 
 namespace LuaWrapper {
@@ -52,6 +53,8 @@ struct Optional {
 LUMIX_ENGINE_API int traceback (lua_State *L);
 LUMIX_ENGINE_API bool pcall(lua_State* L, int nargs, int nres);
 LUMIX_ENGINE_API bool execute(lua_State* L, Span<const char> content, const char* name, int nresults);
+// compiles `content` to bytecode, which can be passed to execute instead of the source, thread safe
+LUMIX_ENGINE_API bool compile(Span<const char> content, const char* name, OutputMemoryStream& bytecode);
 LUMIX_ENGINE_API int getField(lua_State* L, int idx, const char* k);
 
 template <typename T> inline bool isType(lua_State* L, int index)
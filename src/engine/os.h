@@ -144,6 +144,29 @@ private:
 	void* m_handle;
     bool m_is_error;
 };
+
+
+// whole file mapped read-only to memory, data is valid until close
+struct LUMIX_ENGINE_API MappedFile {
+	MappedFile();
+	~MappedFile();
+
+	[[nodiscard]] bool open(const char* path);
+	void close();
+
+	const u8* data() const { return m_data; }
+	u64 size() const { return m_size; }
+	// hint that the range is going to be read soon, does not wait for the data
+	void prefetch(u64 offset, u64 size);
+	// hint that the range is not needed for now, it stays valid and is loaded again if accessed
+	void evict(u64 offset, u64 size);
+
+private:
+	MappedFile(const MappedFile&) = delete;
+	const u8* m_data;
+	u64 m_size;
+	void* m_handle;
+};
 	
 
 struct FileInfo {
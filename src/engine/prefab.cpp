@@ -1,5 +1,7 @@
 #include "engine/crt.h"
+#include "engine/engine.h"
 #include "engine/hash.h"
+#include "engine/log.h"
 #include "prefab.h"
 
 namespace Lumix
@@ -12,6 +14,7 @@ const ResourceType PrefabResource::TYPE("prefab");
 PrefabResource::PrefabResource(const Path& path, ResourceManager& resource_manager, IAllocator& allocator)
 	: Resource(path, resource_manager, allocator)
 	, data(allocator)
+	, instance_template(allocator)
 {
 }
 
@@ -19,7 +22,11 @@ PrefabResource::PrefabResource(const Path& path, ResourceManager& resource_manag
 ResourceType PrefabResource::getType() const { return TYPE; }
 
 
-void PrefabResource::unload() { data.clear(); }
+void PrefabResource::unload() {
+	data.clear();
+	instance_template.clear();
+	scenes_offset = 0;
+}
 
 
 bool PrefabResource::load(u64 size, const u8* mem)
@@ -27,6 +34,28 @@ bool PrefabResource::load(u64 size, const u8* mem)
 	data.resize((int)size);
 	memcpy(data.getMutableData(), mem, size);
 	content_hash = StableHash(mem, (u32)size);
+
+	InputMemoryStream blob(data);
+	SerializedEngineHeader header;
+	blob.read(header);
+	if (header.magic != SERIALIZED_ENGINE_MAGIC) {
+		logError("Wrong or corrupted file ", getPath());
+		return false;
+	}
+	if (header.version > SerializedEngineVersion::LAST) {
+		logError("Unsupported version of prefab ", getPath());
+		return false;
+	}
+	// plugins are checked when instantiated, since they are known only to engine
+	const i32 plugins_count = blob.read<i32>();
+	for (i32 i = 0; i < plugins_count; ++i) blob.readString();
+
+	instance_template.deserialize(blob, header.version > SerializedEngineVersion::VEC3_SCALE);
+	if (instance_template.entities.empty()) {
+		logError("Prefab ", getPath(), " has no entities");
+		return false;
+	}
+	scenes_offset = (u32)blob.getPosition();
 	return true;
 }
 
@@ -4,6 +4,7 @@
 #include "engine/hash.h"
 #include "engine/resource.h"
 #include "engine/stream.h"
+#include "engine/world.h"
 
 
 namespace Lumix
@@ -28,6 +29,10 @@ struct LUMIX_ENGINE_API PrefabResource final : Resource
 
 	OutputMemoryStream data;
 	StableHash content_hash;
+	// entities parsed from `data` on load
+	WorldTemplate instance_template;
+	// offset of scenes' data in `data`
+	u32 scenes_offset = 0;
 	static const ResourceType TYPE;
 };
 
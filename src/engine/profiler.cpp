@@ -4,6 +4,16 @@
 	#define WIN32_LEAN_AND_MEAN
 	#include <Windows.h>
 	#include <evntcons.h>
+#elif defined __linux__
+	#include <errno.h>
+	#include <linux/perf_event.h>
+	#include <poll.h>
+	#include <sys/ioctl.h>
+	#include <sys/mman.h>
+	#include <sys/syscall.h>
+	#include <sys/sysinfo.h>
+	#include <time.h>
+	#include <unistd.h>
 #endif
 
 #include "engine/array.h"
@@ -12,6 +22,7 @@
 #include "engine/allocators.h"
 #include "engine/atomic.h"
 #include "engine/math.h"
+#include "engine/stream.h"
 #include "engine/string.h"
 #include "engine/sync.h"
 #include "engine/thread.h"
@@ -47,8 +58,10 @@ struct ThreadContext
 
 	Array<i32> open_blocks;
 	OutputMemoryStream buffer;
-	u32 begin = 0;
-	u32 end = 0;
+	// ring buffer with a single producer, written without lock, see writeEvent and serialize
+	volatile u32 begin = 0;
+	volatile u32 end = 0;
+	// only global context has more producers, they lock this mutex; name and show_in_profiler are protected by it too
 	Mutex mutex;
 	StaticString<64> name;
 	bool show_in_profiler = false;
@@ -93,13 +106,53 @@ struct ThreadContext
 
 		TRACEHANDLE open_handle;
 	};
+#elif defined __linux__
+	#ifndef PERF_RECORD_MISC_SWITCH_OUT_PREEMPT
+		#define PERF_RECORD_MISC_SWITCH_OUT_PREEMPT (1 << 14)
+	#endif
+
+	// we only know whether the thread was preempted, map it to the windows wait reasons profiler UI knows
+	static constexpr i8 WAIT_REASON_USER_REQUEST = 6;
+	static constexpr i8 WAIT_REASON_PREEMPTED = 32;
+
+	// PERF_RECORD_SWITCH_CPU_WIDE with sample_id for PERF_SAMPLE_TID | PERF_SAMPLE_TIME
+	struct SwitchCPUWideRecord {
+		perf_event_header header;
+		u32 next_prev_pid;
+		u32 next_prev_tid;
+		u32 pid;
+		u32 tid;
+		u64 time;
+	};
+
+	// reads sched switches from perf_event ring buffers, one per cpu
+	// needs CAP_PERFMON (or root) or kernel.perf_event_paranoid <= 0, since we trace all cpus
+	struct TraceTask : Thread {
+		static constexpr u32 RING_SIZE = 64 * 1024;
+
+		struct Ring {
+			int fd;
+			perf_event_mmap_page* page;
+		};
+
+		TraceTask(IAllocator& allocator);
+
+		bool open();
+		void close();
+		int task() override;
+		void processRing(Ring& ring);
+
+		Array<Ring> rings;
+		u32 pid = 0;
+		u32 page_size = 0;
+		volatile bool finished = false;
+		bool started = false;
+	};
 #else
 	struct TraceTask {
 		TraceTask(IAllocator&) {}
-		void destroy() {}
-		int open_handle;
+		void close() {}
 	};
-	void CloseTrace(int) {}
 #endif
 
 static struct Instance
@@ -116,8 +169,12 @@ static struct Instance
 
 	~Instance()
 	{
-		CloseTrace(trace_task.open_handle);
-		trace_task.destroy();
+		#ifdef _WIN32
+			CloseTrace(trace_task.open_handle);
+			trace_task.destroy();
+		#else
+			trace_task.close();
+		#endif
 	}
 
 
@@ -156,6 +213,11 @@ static struct Instance
 			trace.EventRecordCallback = TraceTask::callback;
 			trace_task.open_handle = OpenTrace(&trace);
 			trace_task.create("profiler trace", true);
+		#elif defined __linux__
+			context_switches_enabled = trace_task.open();
+			if (context_switches_enabled) {
+				trace_task.started = trace_task.create("profiler trace", true);
+			}
 		#endif
 	}
 
@@ -164,7 +226,12 @@ static struct Instance
 	{
 		thread_local ThreadContext* ctx = [&](){
 			ThreadContext* new_ctx = LUMIX_NEW(allocator, ThreadContext)(default_context_size, allocator);
-			new_ctx->thread_id = os::getCurrentThreadID();
+			#ifdef __linux__
+				// kernel thread id, so we can match it with context switch records
+				new_ctx->thread_id = (u32)syscall(SYS_gettid);
+			#else
+				new_ctx->thread_id = os::getCurrentThreadID();
+			#endif
 			MutexGuard lock(mutex);
 			contexts.push(new_ctx);
 			return new_ctx;
@@ -190,40 +257,86 @@ static struct Instance
 
 
 template <typename T>
-void write(ThreadContext& ctx, u64 timestamp, EventType type, const T& value)
+static void read(const u8* buf, u32 buf_size, u32 p, T& value)
 {
-	if (g_instance.paused && timestamp > g_instance.paused_time) return;
+	const u32 l = p % buf_size;
+	if (l + sizeof(value) <= buf_size) {
+		memcpy(&value, buf + l, sizeof(value));
+		return;
+	}
 
-	#pragma pack(1)
-		struct {
-			EventHeader header;
-			T value;
-		} v;
-	#pragma pack()
-	v.header.type = type;
-	v.header.size = sizeof(v);
-	v.header.time = timestamp;
-	v.value = value;
+	memcpy(&value, buf + l, buf_size - l);
+	memcpy((u8*)&value + (buf_size - l), buf, sizeof(value) - (buf_size - l));
+}
 
-	MutexGuard lock(ctx.mutex);
+template <typename T>
+static void read(const ThreadContext& ctx, u32 p, T& value)
+{
+	read(ctx.buffer.data(), (u32)ctx.buffer.size(), p, value);
+}
+
+// Only the owning thread writes to its context, so there is no lock.
+// Old events are dropped by moving `begin` before they are overwritten,
+// readers check `begin` after they copy the buffer to find out what was overwritten in the meantime.
+static void writeEventUnsafe(ThreadContext& ctx, const EventHeader& header, const void* data, u32 data_size)
+{
 	u8* buf = ctx.buffer.getMutableData();
 	const u32 buf_size = (u32)ctx.buffer.size();
-
-	while (sizeof(v) + ctx.end - ctx.begin > buf_size) {
-		const u8 size = buf[ctx.begin % buf_size];
-		ctx.begin += size;
+	const u32 end = ctx.end;
+	u32 begin = ctx.begin;
+
+	if (header.size + end - begin > buf_size) {
+		while (header.size + end - begin > buf_size) {
+			EventHeader h;
+			read(ctx, begin, h);
+			begin += h.size;
+		}
+		ctx.begin = begin;
+		// readers must see new `begin` before we overwrite anything
+		writeBarrier();
 	}
 
-	const u32 lend = ctx.end % buf_size;
-	if (buf_size - lend >= sizeof(v)) {
-		memcpy(buf + lend, &v, sizeof(v));
-	}
-	else {
-		memcpy(buf + lend, &v, buf_size - lend);
-		memcpy(buf, ((u8*)&v) + buf_size - lend, sizeof(v) - (buf_size - lend));
+	u32 pos = end;
+	auto cpy = [&](const void* ptr, u32 size) {
+		const u32 lend = pos % buf_size;
+		if (buf_size - lend >= size) {
+			memcpy(buf + lend, ptr, size);
+		}
+		else {
+			memcpy(buf + lend, ptr, buf_size - lend);
+			memcpy(buf, ((u8*)ptr) + buf_size - lend, size - (buf_size - lend));
+		}
+		pos += size;
+	};
+
+	cpy(&header, sizeof(header));
+	cpy(data, data_size);
+
+	// readers must see the data before new `end`
+	writeBarrier();
+	ctx.end = pos;
+}
+
+static void writeEvent(ThreadContext& ctx, const EventHeader& header, const void* data, u32 data_size)
+{
+	if (&ctx == &g_instance.global_context) {
+		MutexGuard lock(ctx.mutex);
+		writeEventUnsafe(ctx, header, data, data_size);
+		return;
 	}
+	writeEventUnsafe(ctx, header, data, data_size);
+}
 
-	ctx.end += sizeof(v);
+template <typename T>
+void write(ThreadContext& ctx, u64 timestamp, EventType type, const T& value)
+{
+	if (g_instance.paused && timestamp > g_instance.paused_time) return;
+
+	EventHeader header;
+	header.type = type;
+	header.size = sizeof(header) + sizeof(value);
+	header.time = timestamp;
+	writeEvent(ctx, header, &value, sizeof(value));
 };
 
 template <typename T>
@@ -231,36 +344,11 @@ void write(ThreadContext& ctx, EventType type, const T& value)
 {
 	if (g_instance.paused) return;
 
-#pragma pack(1)
-	struct {
-		EventHeader header;
-		T value;
-	} v;
-#pragma pack()
-	v.header.type = type;
-	v.header.size = sizeof(v);
-	v.header.time = os::Timer::getRawTimestamp();
-	v.value = value;
-
-	MutexGuard lock(ctx.mutex);
-	u8* buf = ctx.buffer.getMutableData();
-	const u32 buf_size = (u32)ctx.buffer.size();
-
-	while (sizeof(v) + ctx.end - ctx.begin > buf_size) {
-		const u8 size = buf[ctx.begin % buf_size];
-		ctx.begin += size;
-	}
-
-	const u32 lend = ctx.end % buf_size;
-	if (buf_size - lend >= sizeof(v)) {
-		memcpy(buf + lend, &v, sizeof(v));
-	}
-	else {
-		memcpy(buf + lend, &v, buf_size - lend);
-		memcpy(buf, ((u8*)&v) + buf_size - lend, sizeof(v) - (buf_size - lend));
-	}
-
-	ctx.end += sizeof(v);
+	EventHeader header;
+	header.type = type;
+	header.size = sizeof(header) + sizeof(value);
+	header.time = os::Timer::getRawTimestamp();
+	writeEvent(ctx, header, &value, sizeof(value));
 };
 
 
@@ -273,31 +361,7 @@ void write(ThreadContext& ctx, EventType type, const u8* data, int size)
 	ASSERT(sizeof(header) + size <= 0xffff);
 	header.size = u16(sizeof(header) + size);
 	header.time = os::Timer::getRawTimestamp();
-
-	MutexGuard lock(ctx.mutex);
-	u8* buf = ctx.buffer.getMutableData();
-	const u32 buf_size = (u32)ctx.buffer.size();
-
-	while (header.size + ctx.end - ctx.begin > buf_size) {
-		const u8 size = buf[ctx.begin % buf_size];
-		ctx.begin += size;
-	}
-
-	auto cpy = [&](const u8* ptr, u32 size) {
-		const u32 lend = ctx.end % buf_size;
-		if (buf_size - lend >= size) {
-			memcpy(buf + lend, ptr, size);
-		}
-		else {
-			memcpy(buf + lend, ptr, buf_size - lend);
-			memcpy(buf, ((u8*)ptr) + buf_size - lend, size - (buf_size - lend));
-		}
-
-		ctx.end += size;
-	};
-
-	cpy((u8*)&header, sizeof(header));
-	cpy(data, size);
+	writeEvent(ctx, header, data, size);
 };
 
 #ifdef _WIN32
@@ -324,6 +388,142 @@ void write(ThreadContext& ctx, EventType type, const u8* data, int size)
 		rec.reason = cs->OldThreadWaitReason;
 		write(g_instance.global_context, rec.timestamp, profiler::EventType::CONTEXT_SWITCH, rec);
 	};
+#elif defined __linux__
+	TraceTask::TraceTask(IAllocator& allocator)
+		: Thread(allocator)
+		, rings(allocator)
+	{}
+
+
+	bool TraceTask::open() {
+		pid = (u32)getpid();
+		page_size = (u32)sysconf(_SC_PAGESIZE);
+
+		perf_event_attr attr = {};
+		attr.size = sizeof(attr);
+		attr.type = PERF_TYPE_SOFTWARE;
+		attr.config = PERF_COUNT_SW_CONTEXT_SWITCHES;
+		attr.sample_type = PERF_SAMPLE_TID | PERF_SAMPLE_TIME;
+		attr.sample_id_all = 1;
+		attr.context_switch = 1;
+		attr.disabled = 1;
+		// same clock as os::Timer::getRawTimestamp
+		attr.use_clockid = 1;
+		attr.clockid = CLOCK_REALTIME;
+		attr.watermark = 1;
+		attr.wakeup_watermark = RING_SIZE / 2;
+
+		const int cpu_count = get_nprocs_conf();
+		for (int cpu = 0; cpu < cpu_count; ++cpu) {
+			const int fd = (int)syscall(SYS_perf_event_open, &attr, -1, cpu, -1, PERF_FLAG_FD_CLOEXEC);
+			if (fd < 0) {
+				// offline cpu
+				if (errno == ENODEV) continue;
+				close();
+				return false;
+			}
+
+			void* mem = mmap(nullptr, page_size + RING_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+			if (mem == MAP_FAILED) {
+				::close(fd);
+				close();
+				return false;
+			}
+
+			Ring& ring = rings.emplace();
+			ring.fd = fd;
+			ring.page = (perf_event_mmap_page*)mem;
+		}
+
+		if (rings.empty()) return false;
+
+		for (Ring& ring : rings) {
+			ioctl(ring.fd, PERF_EVENT_IOC_ENABLE, 0);
+		}
+		return true;
+	}
+
+
+	void TraceTask::close() {
+		finished = true;
+		if (started) destroy();
+		started = false;
+
+		for (Ring& ring : rings) {
+			ioctl(ring.fd, PERF_EVENT_IOC_DISABLE, 0);
+			munmap(ring.page, page_size + RING_SIZE);
+			::close(ring.fd);
+		}
+		rings.clear();
+	}
+
+
+	void TraceTask::processRing(Ring& ring) {
+		perf_event_mmap_page* page = ring.page;
+		const u8* data = (const u8*)page + page_size;
+		const u64 head = page->data_head;
+		// records before data_head are written
+		readBarrier();
+
+		auto read = [&](u64 pos, void* dst, u32 size) {
+			const u32 l = u32(pos % RING_SIZE);
+			if (l + size <= RING_SIZE) {
+				memcpy(dst, data + l, size);
+				return;
+			}
+			memcpy(dst, data + l, RING_SIZE - l);
+			memcpy((u8*)dst + (RING_SIZE - l), data, size - (RING_SIZE - l));
+		};
+
+		u64 tail = page->data_tail;
+		while (tail < head) {
+			perf_event_header header;
+			read(tail, &header, sizeof(header));
+			if (header.size == 0) break;
+
+			if (header.type == PERF_RECORD_SWITCH_CPU_WIDE
+				&& (header.misc & PERF_RECORD_MISC_SWITCH_OUT)
+				&& header.size >= sizeof(SwitchCPUWideRecord)) 
+			{
+				SwitchCPUWideRecord r;
+				read(tail, &r, sizeof(r));
+				// we trace whole cpus, ignore other processes
+				if (r.pid == pid || r.next_prev_pid == pid) {
+					ContextSwitchRecord rec;
+					rec.timestamp = r.time;
+					rec.old_thread_id = r.tid;
+					rec.new_thread_id = r.next_prev_tid;
+					rec.reason = (header.misc & PERF_RECORD_MISC_SWITCH_OUT_PREEMPT) ? WAIT_REASON_PREEMPTED : WAIT_REASON_USER_REQUEST;
+					write(g_instance.global_context, rec.timestamp, profiler::EventType::CONTEXT_SWITCH, rec);
+				}
+			}
+			tail += header.size;
+		}
+
+		// we are done reading, kernel can reuse the space
+		writeBarrier();
+		page->data_tail = tail;
+	}
+
+
+	int TraceTask::task() {
+		Array<pollfd> fds(getAllocator());
+		for (const Ring& ring : rings) {
+			pollfd& pfd = fds.emplace();
+			pfd.fd = ring.fd;
+			pfd.events = POLLIN;
+			pfd.revents = 0;
+		}
+
+		while (!finished) {
+			// timeout so we don't wait for the watermark forever and we notice `finished`
+			poll(fds.begin(), fds.size(), 50);
+			for (Ring& ring : rings) {
+				processRing(ring);
+			}
+		}
+		return 0;
+	}
 #endif
 
 u32 createCounter(const char* key_literal, float min) {
@@ -535,34 +735,29 @@ void setThreadName(const char* name)
 	ctx->name = name;
 }
 
-template <typename T>
-static void read(const ThreadContext& ctx, u32 p, T& value)
-{
-	const u8* buf = ctx.buffer.data();
-	const u32 buf_size = (u32)ctx.buffer.size();
-	const u32 l = p % buf_size;
-	if (l + sizeof(value) <= buf_size) {
-		memcpy(&value, buf + l, sizeof(value));
-		return;
-	}
-
-	memcpy(&value, buf + l, buf_size - l);
-	memcpy((u8*)&value + (buf_size - l), buf, sizeof(value) - (buf_size - l));
-}
+// copy of a context's ring buffer stored in serialized blob
+struct ContextSnapshot {
+	ThreadContext* context;
+	u64 offset;
+	u32 size;
+	u32 begin;
+	u32 end;
+};
 
-static void saveStrings(OutputMemoryStream& blob) {
+static void saveStrings(OutputMemoryStream& blob, Span<const ContextSnapshot> snapshots) {
 	HashMap<const char*, const char*> map(g_instance.allocator);
 	map.reserve(512);
-	auto gather = [&](const ThreadContext& ctx){
-		u32 p = ctx.begin;
-		const u32 end = ctx.end;
+	for (const ContextSnapshot& snapshot : snapshots) {
+		const u8* buf = blob.data() + snapshot.offset;
+		u32 p = snapshot.begin;
+		const u32 end = snapshot.end;
 		while (p != end) {
 			profiler::EventHeader header;
-			read(ctx, p, header);
+			read(buf, snapshot.size, p, header);
 			switch (header.type) {
 				case profiler::EventType::BEGIN_BLOCK: {
 					BlockRecord b;
-					read(ctx, p + sizeof(profiler::EventHeader), b);
+					read(buf, snapshot.size, p + sizeof(profiler::EventHeader), b);
 					if (!map.find(b.name).isValid()) {
 						map.insert(b.name, b.name);
 					}
@@ -570,7 +765,7 @@ static void saveStrings(OutputMemoryStream& blob) {
 				}
 				case profiler::EventType::INT: {
 					IntRecord r;
-					read(ctx, p + sizeof(profiler::EventHeader), r);
+					read(buf, snapshot.size, p + sizeof(profiler::EventHeader), r);
 					if (!map.find(r.key).isValid()) {
 						map.insert(r.key, r.key);
 					}
@@ -580,11 +775,6 @@ static void saveStrings(OutputMemoryStream& blob) {
 			}
 			p += header.size;
 		}
-	};
-
-	gather(g_instance.global_context);
-	for (const ThreadContext* ctx : g_instance.contexts) {
-		gather(*ctx);
 	}
 
 	blob.write(map.size());
@@ -594,15 +784,38 @@ static void saveStrings(OutputMemoryStream& blob) {
 	}
 }
 
-void serialize(OutputMemoryStream& blob, ThreadContext& ctx) {
-	MutexGuard lock(ctx.mutex);
-	blob.writeString(ctx.name);
-	blob.write(ctx.thread_id);
-	blob.write(ctx.begin);
-	blob.write(ctx.end);
+// does not block the thread writing to `ctx`
+static ContextSnapshot serialize(OutputMemoryStream& blob, ThreadContext& ctx) {
+	{
+		MutexGuard lock(ctx.mutex);
+		blob.writeString(ctx.name);
+		blob.write(ctx.thread_id);
+	}
+	
+	ContextSnapshot snapshot;
+	snapshot.context = &ctx;
+	snapshot.size = (u32)ctx.buffer.size();
+	snapshot.end = ctx.end;
+	// everything before `end` is written
+	readBarrier();
+
+	const u64 begin_offset = blob.size();
+	blob.write(u32(0)); // begin, patched after the copy
+	blob.write(snapshot.end);
 	blob.write((u8)ctx.show_in_profiler);
-	blob.write((u32)ctx.buffer.size());
-	blob.write(ctx.buffer.data(), ctx.buffer.size());
+	blob.write(snapshot.size);
+	snapshot.offset = blob.size();
+	blob.write(ctx.buffer.data(), snapshot.size);
+
+	// writer moves `begin` before it overwrites anything, so [begin, end) in our copy is intact
+	readBarrier();
+	snapshot.begin = ctx.begin;
+	if (i32(snapshot.end - snapshot.begin) < 0) {
+		// writer wrapped around the whole buffer while we were copying
+		snapshot.begin = snapshot.end;
+	}
+	memcpy(blob.getMutableData() + begin_offset, &snapshot.begin, sizeof(snapshot.begin));
+	return snapshot;
 }
 
 void serialize(OutputMemoryStream& blob) {
@@ -613,12 +826,278 @@ void serialize(OutputMemoryStream& blob) {
 	blob.write((u32)g_instance.counters.size());
 	blob.write(g_instance.counters.begin(), g_instance.counters.byte_size());
 
+	Array<ContextSnapshot> snapshots(g_instance.allocator);
+	snapshots.reserve(g_instance.contexts.size() + 1);
 	blob.write((u32)g_instance.contexts.size());
-	serialize(blob, g_instance.global_context);
+	snapshots.push(serialize(blob, g_instance.global_context));
 	for (ThreadContext* ctx : g_instance.contexts) {
-		serialize(blob, *ctx);
+		snapshots.push(serialize(blob, *ctx));
 	}	
-	saveStrings(blob);
+	saveStrings(blob, snapshots);
+}
+
+static void writeJSONString(IOutputStream& stream, const char* str) {
+	stream << "\"";
+	const char* run = str;
+	for (const char* c = str; *c; ++c) {
+		if (*c != '"' && *c != '\\' && (u8)*c >= 0x20) continue;
+		stream.write(run, c - run);
+		switch (*c) {
+			case '"': stream << "\\\""; break;
+			case '\\': stream << "\\\\"; break;
+			case '\n': stream << "\\n"; break;
+			case '\t': stream << "\\t"; break;
+			default: stream << " "; break;
+		}
+		run = c + 1;
+	}
+	stream << run << "\"";
+}
+
+// https://docs.google.com/document/d/1CvAClvFfyA5R-PhYUmn5OOQtYMH4h6I0nSsKchNAySU
+struct ChromeTraceWriter {
+	static constexpr u32 GPU_THREAD_ID = 0xffFFffFF;
+
+	ChromeTraceWriter(IOutputStream& stream, u64 base_time)
+		: stream(stream)
+		, base_time(base_time)
+		, to_us(1e6 / frequency())
+	{}
+
+	// caller must write the rest of the event and close it with `}`
+	void begin(const char* name, char phase, u64 time, u32 thread_id) {
+		stream << (first ? "\n{\"name\":" : ",\n{\"name\":");
+		first = false;
+		writeJSONString(stream, name);
+		stream << ",\"ph\":\"";
+		stream.write(&phase, 1);
+		stream << "\",\"ts\":" << double(i64(time - base_time)) * to_us << ",\"pid\":0,\"tid\":" << thread_id;
+	}
+
+	void threadName(u32 thread_id, const char* name) {
+		begin("thread_name", 'M', base_time, thread_id);
+		stream << ",\"args\":{\"name\":";
+		writeJSONString(stream, name);
+		stream << "}}";
+	}
+
+	void flow(const char* category, char phase, u64 time, u32 thread_id, i64 id) {
+		begin(category, phase, time, thread_id);
+		stream << ",\"cat\":\"" << category << "\",\"id\":" << id;
+		// bind to enclosing slice
+		if (phase == 'f') stream << ",\"bp\":\"e\"";
+		stream << "}";
+	}
+
+	IOutputStream& stream;
+	u64 base_time;
+	double to_us;
+	bool first = true;
+};
+
+static void exportChromeTrace(ChromeTraceWriter& writer
+	, const OutputMemoryStream& blob
+	, const ContextSnapshot& snapshot
+	, Span<const ContextSnapshot> all_snapshots
+	, const HashMap<i32, const char*>& block_names)
+{
+	auto is_profiled_thread = [&](u32 thread_id){
+		for (const ContextSnapshot& s : all_snapshots) {
+			if (s.context != &g_instance.global_context && s.context->thread_id == thread_id) return true;
+		}
+		return false;
+	};
+
+	IOutputStream& stream = writer.stream;
+	const u8* buf = blob.data() + snapshot.offset;
+	const bool is_global = snapshot.context == &g_instance.global_context;
+	const u32 tid = snapshot.context->thread_id;
+	u32 depth = 0;
+	u32 gpu_depth = 0;
+	u64 gpu_primitives = 0;
+	bool has_gpu_stats = false;
+
+	u32 p = snapshot.begin;
+	while (p != snapshot.end) {
+		EventHeader header;
+		read(buf, snapshot.size, p, header);
+		const u32 data_pos = p + sizeof(header);
+		switch (header.type) {
+			case EventType::BEGIN_BLOCK: {
+				BlockRecord r;
+				read(buf, snapshot.size, data_pos, r);
+				writer.begin(r.name, 'B', header.time, tid);
+				stream << "}";
+				++depth;
+				break;
+			}
+			case EventType::CONTINUE_BLOCK: {
+				i32 id;
+				read(buf, snapshot.size, data_pos, id);
+				auto iter = block_names.find(id);
+				writer.begin(iter.isValid() ? iter.value() : "N/A", 'B', header.time, tid);
+				stream << ",\"args\":{\"continued\":true}}";
+				++depth;
+				break;
+			}
+			case EventType::END_BLOCK:
+				// ring buffer might start in the middle of a block
+				if (depth == 0) break;
+				writer.begin("", 'E', header.time, tid);
+				stream << "}";
+				--depth;
+				break;
+			case EventType::INT: {
+				IntRecord r;
+				read(buf, snapshot.size, data_pos, r);
+				writer.begin(r.key, 'i', header.time, tid);
+				stream << ",\"s\":\"t\",\"args\":{\"value\":" << r.value << "}}";
+				break;
+			}
+			case EventType::STRING: {
+				char tmp[1024];
+				const u32 len = minimum(u32(header.size - sizeof(header)), (u32)sizeof(tmp));
+				for (u32 i = 0; i < len; ++i) read(buf, snapshot.size, data_pos + i, tmp[i]);
+				tmp[len - 1] = '\0';
+				writer.begin("string", 'i', header.time, tid);
+				stream << ",\"s\":\"t\",\"args\":{\"value\":";
+				writeJSONString(stream, tmp);
+				stream << "}}";
+				break;
+			}
+			case EventType::BEGIN_FIBER_WAIT:
+			case EventType::END_FIBER_WAIT: {
+				FiberWaitRecord r;
+				read(buf, snapshot.size, data_pos, r);
+				const bool is_begin = header.type == EventType::BEGIN_FIBER_WAIT;
+				writer.begin(r.is_mutex ? "mutex wait" : "fiber wait", is_begin ? 'b' : 'e', header.time, tid);
+				stream << ",\"cat\":\"fiber\",\"id\":" << r.id << ",\"args\":{\"signal\":" << r.job_system_signal << "}}";
+				// the job that triggered the signal -> the job waiting for it
+				if (!is_begin && depth > 0) writer.flow("signal", 'f', header.time, tid, r.job_system_signal);
+				break;
+			}
+			case EventType::SIGNAL_TRIGGERED: {
+				i32 signal;
+				read(buf, snapshot.size, data_pos, signal);
+				if (depth > 0) writer.flow("signal", 's', header.time, tid, signal);
+				break;
+			}
+			case EventType::LINK: {
+				i64 link;
+				read(buf, snapshot.size, data_pos, link);
+				if (depth > 0) writer.flow("link", 's', header.time, tid, link);
+				break;
+			}
+			case EventType::FRAME:
+				writer.begin("frame", 'i', header.time, tid);
+				stream << ",\"s\":\"g\"}";
+				break;
+			case EventType::PAUSE:
+				writer.begin("pause", 'i', header.time, tid);
+				stream << ",\"s\":\"g\"}";
+				break;
+			case EventType::COUNTER: {
+				CounterRecord r;
+				read(buf, snapshot.size, data_pos, r);
+				if (r.counter >= (u32)g_instance.counters.size()) break;
+				writer.begin(g_instance.counters[r.counter].name, 'C', header.time, tid);
+				stream << ",\"args\":{\"value\":" << r.value << "}}";
+				break;
+			}
+			case EventType::CONTEXT_SWITCH: {
+				ContextSwitchRecord r;
+				read(buf, snapshot.size, data_pos, r);
+				// switches involve other processes' threads too
+				if (is_profiled_thread(r.old_thread_id)) {
+					writer.begin("switch out", 'i', r.timestamp, r.old_thread_id);
+					stream << ",\"s\":\"t\",\"args\":{\"new_thread\":" << r.new_thread_id << ",\"reason\":" << (i32)r.reason << "}}";
+				}
+				if (is_profiled_thread(r.new_thread_id)) {
+					writer.begin("switch in", 'i', r.timestamp, r.new_thread_id);
+					stream << ",\"s\":\"t\",\"args\":{\"old_thread\":" << r.old_thread_id << "}}";
+				}
+				break;
+			}
+			case EventType::BEGIN_GPU_BLOCK: {
+				GPUBlock r;
+				read(buf, snapshot.size, data_pos, r);
+				r.name[lengthOf(r.name) - 1] = '\0';
+				writer.begin(r.name, 'B', r.timestamp, ChromeTraceWriter::GPU_THREAD_ID);
+				stream << "}";
+				if (r.profiler_link) writer.flow("link", 'f', r.timestamp, ChromeTraceWriter::GPU_THREAD_ID, r.profiler_link);
+				++gpu_depth;
+				break;
+			}
+			case EventType::GPU_STATS:
+				read(buf, snapshot.size, data_pos, gpu_primitives);
+				has_gpu_stats = true;
+				break;
+			case EventType::END_GPU_BLOCK: {
+				u64 timestamp;
+				read(buf, snapshot.size, data_pos, timestamp);
+				if (gpu_depth > 0) {
+					writer.begin("", 'E', timestamp, ChromeTraceWriter::GPU_THREAD_ID);
+					if (has_gpu_stats) stream << ",\"args\":{\"primitives\":" << gpu_primitives << "}";
+					stream << "}";
+					--gpu_depth;
+				}
+				has_gpu_stats = false;
+				break;
+			}
+			case EventType::BLOCK_COLOR:
+			case EventType::JOB_INFO:
+				break;
+		}
+		p += header.size;
+	}
+
+	if (is_global) {
+		writer.threadName(ChromeTraceWriter::GPU_THREAD_ID, "GPU");
+	}
+	else {
+		MutexGuard lock(snapshot.context->mutex);
+		writer.threadName(tid, snapshot.context->name);
+	}
+}
+
+void exportChromeTrace(IOutputStream& stream) {
+	OutputMemoryStream blob(g_instance.allocator);
+	Array<ContextSnapshot> snapshots(g_instance.allocator);
+	{
+		MutexGuard lock(g_instance.mutex);
+		snapshots.reserve(g_instance.contexts.size() + 1);
+		snapshots.push(serialize(blob, g_instance.global_context));
+		for (ThreadContext* ctx : g_instance.contexts) {
+			snapshots.push(serialize(blob, *ctx));
+		}
+	}
+
+	// blocks can continue on a different thread after fiber switch, so we need names from all threads
+	HashMap<i32, const char*> block_names(g_instance.allocator);
+	u64 base_time = 0xffFFffFFffFFffFF;
+	for (const ContextSnapshot& snapshot : snapshots) {
+		const u8* buf = blob.data() + snapshot.offset;
+		u32 p = snapshot.begin;
+		while (p != snapshot.end) {
+			EventHeader header;
+			read(buf, snapshot.size, p, header);
+			base_time = minimum(base_time, header.time);
+			if (header.type == EventType::BEGIN_BLOCK) {
+				BlockRecord r;
+				read(buf, snapshot.size, p + sizeof(header), r);
+				block_names.insert(r.id, r.name);
+			}
+			p += header.size;
+		}
+	}
+	if (base_time == 0xffFFffFFffFFffFF) base_time = 0;
+
+	ChromeTraceWriter writer(stream, base_time);
+	stream << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+	for (const ContextSnapshot& snapshot : snapshots) {
+		exportChromeTrace(writer, blob, snapshot, snapshots, block_names);
+	}
+	stream << "\n]}\n";
 }
 
 void pause(bool paused)
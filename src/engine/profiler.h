@@ -4,6 +4,7 @@
 
 namespace Lumix {
 
+struct IOutputStream;
 struct OutputMemoryStream;
 
 namespace profiler {
@@ -31,6 +32,8 @@ LUMIX_ENGINE_API void gpuStats(u64 primitives_generated);
 LUMIX_ENGINE_API void link(i64 link);
 LUMIX_ENGINE_API i64 createNewLinkID();
 LUMIX_ENGINE_API void serialize(OutputMemoryStream& blob);
+// writes what is currently in the buffers as chrome trace event json, open it in ui.perfetto.dev or chrome://tracing
+LUMIX_ENGINE_API void exportChromeTrace(IOutputStream& stream);
 
 struct FiberSwitchData {
 	i32 id;
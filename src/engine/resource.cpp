@@ -3,6 +3,7 @@
 #include "engine/log.h"
 #include "engine/lumix.h"
 #include "engine/path.h"
+#include "engine/profiler.h"
 #include "engine/resource_manager.h"
 #include "engine/stream.h"
 #include "engine/string.h"
@@ -89,6 +90,63 @@ void Resource::checkState()
 }
 
 
+// decompresses compiled resource content to `output` or returns offset of data after the header in `content`
+// content can be a read-only view, so the header is not cut out of it
+bool Resource::unpackCompiledContent(Span<const u8> content, OutputMemoryStream& output, u32& offset) {
+	offset = 0;
+	CompiledResourceHeader header;
+	if (content.length() < sizeof(header)) {
+		logError("Invalid resource file, please delete .lumix directory");
+		return false;
+	}
+	memcpy(&header, content.begin(), sizeof(header));
+	if (header.magic != CompiledResourceHeader::MAGIC) {
+		logError("Invalid resource file, please delete .lumix directory");
+		return false;
+	}
+	if (header.version != 0) {
+		logError("Unsupported resource file version, please delete .lumix directory");
+		return false;
+	}
+
+	if (header.flags & CompiledResourceHeader::COMPRESSED) {
+		output.resize(header.decompressed_size);
+		const i32 res = LZ4_decompress_safe((const char*)content.begin() + sizeof(header), (char*)output.getMutableData(), i32(content.length() - sizeof(header)), (i32)output.size());
+		if (res < 0 || u64(res) != header.decompressed_size) {
+			logError("Failed to decompress ", getPath());
+			output.clear();
+			return false;
+		}
+	}
+	else {
+		offset = sizeof(header);
+	}
+	return true;
+}
+
+
+// runs on a worker, decompresses compiled resource content and skips its header, so prepare/finalize get only the data
+// failures are reported in m_is_prepared, so they are not confused with failed reads
+bool Resource::prepareContent(Span<const u8> content, OutputMemoryStream& output) {
+	PROFILE_FUNCTION();
+	profiler::pushString(m_path.c_str());
+	m_is_prepared = false;
+	m_content_offset = 0;
+
+	if (startsWith(getPath().c_str(), ".lumix/asset_tiles/")) {
+		m_is_prepared = prepare(content.length(), content.begin());
+		return true;
+	}
+
+	if (!unpackCompiledContent(content, output, m_content_offset)) return true;
+
+	// the content callback gets `output` if it's not empty
+	const Span<const u8> data = output.empty() ? content : Span<const u8>(output);
+	m_is_prepared = prepare(data.length() - m_content_offset, data.begin() + m_content_offset);
+	return true;
+}
+
+
 void Resource::fileLoaded(u64 size, const u8* mem, bool success) {
 	ASSERT(m_async_op.isValid());
 	m_async_op = FileSystem::AsyncHandle::invalid();
@@ -118,40 +176,10 @@ void Resource::fileLoaded(u64 size, const u8* mem, bool success) {
 		return;
 	}
 
-	const CompiledResourceHeader* header = (const CompiledResourceHeader*)mem;
-	if (startsWith(getPath().c_str(), ".lumix/asset_tiles/")) {
-		if (!load(size, mem)) {
-			++m_failed_dep_count;
-		}
-		m_size = size;
-	}
-	else if (size < sizeof(*header)) {
-		logError("Invalid resource file, please delete .lumix directory");
-		++m_failed_dep_count;
-	}
-	else if (header->magic != CompiledResourceHeader::MAGIC) {
-		logError("Invalid resource file, please delete .lumix directory");
-		++m_failed_dep_count;
-	}
-	else if (header->version != 0) {
-		logError("Unsupported resource file version, please delete .lumix directory");
+	if (!m_is_prepared || !finalize(size - m_content_offset, mem + m_content_offset)) {
 		++m_failed_dep_count;
 	}
-	else if (header->flags & CompiledResourceHeader::COMPRESSED) {
-		OutputMemoryStream tmp(m_resource_manager.m_allocator);
-		tmp.resize(header->decompressed_size);
-		const i32 res = LZ4_decompress_safe((const char*)mem + sizeof(*header), (char*)tmp.getMutableData(), i32(size - sizeof(*header)), (i32)tmp.size());
-		if (res != header->decompressed_size || !load(header->decompressed_size, tmp.data())) {
-			++m_failed_dep_count;
-		}
-		m_size = header->decompressed_size;
-	}
-	else {
-		if (!load(size - sizeof(*header), mem + sizeof(*header))) {
-			++m_failed_dep_count;
-		}
-		m_size = header->decompressed_size;
-	} 
+	m_size = size - m_content_offset;
 
 	ASSERT(m_empty_dep_count > 0);
 	--m_empty_dep_count;
@@ -204,14 +232,16 @@ void Resource::doLoad()
 
 	FileSystem& fs = m_resource_manager.getOwner().getFileSystem();
 	FileSystem::ContentCallback cb = makeDelegate<&Resource::fileLoaded>(this);
+	FileSystem::PrepareCallback prepare_cb = makeDelegate<&Resource::prepareContent>(this);
 
 	const FilePathHash hash = m_path.getHash();
 	if (startsWith(m_path.c_str(), ".lumix/asset_tiles/")) {
-		m_async_op = fs.getContent(m_path, cb);
+		// asset browser thumbnails should not delay loading of the actual content
+		m_async_op = fs.getContent(m_path, prepare_cb, cb, FileSystem::Priority::LOW);
 	}
 	else {	
 		const Path res_path(".lumix/resources/", hash, ".res");
-		m_async_op = fs.getContent(res_path, cb);
+		m_async_op = fs.getContent(res_path, prepare_cb, cb);
 	}
 }
 
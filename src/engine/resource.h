@@ -9,6 +9,8 @@
 
 namespace Lumix {
 
+struct OutputMemoryStream;
+
 struct LUMIX_ENGINE_API ResourceType {
 	ResourceType() {}
 	explicit ResourceType(const char* type_name);
@@ -82,6 +84,11 @@ protected:
 	virtual void onBeforeReady() {}
 	virtual void unload() = 0;
 	virtual bool load(u64 size, const u8* mem) = 0;
+	// loading is split in two phases, prepare runs on a job system worker and finalize on the main thread afterwards
+	// prepare must not touch anything but the resource itself - no other resources, no lua states, no draw streams
+	// resources which do not override these do the whole load on the main thread
+	virtual bool prepare(u64 size, const u8* mem) { return true; }
+	virtual bool finalize(u64 size, const u8* mem) { return load(size, mem); }
 
 	void onCreated(State state);
 	void doUnload();
@@ -89,6 +96,8 @@ protected:
 	void removeDependency(Resource& dependent_resource);
 	void checkState();
 	void refresh();
+	// thread-safe, for resources which read parts of their compiled file again, e.g. streamed textures
+	bool unpackCompiledContent(Span<const u8> content, OutputMemoryStream& output, u32& offset);
 
 	State m_desired_state;
 	u16 m_empty_dep_count;
@@ -96,6 +105,7 @@ protected:
 
 private:
 	void doLoad();
+	bool prepareContent(Span<const u8> content, OutputMemoryStream& output);
 	void fileLoaded(u64 size, const u8* mem, bool success);
 	void onStateChanged(State old_state, State new_state, Resource&);
 
@@ -109,6 +119,10 @@ private:
 	u16 m_failed_dep_count;
 	State m_current_state;
 	FileSystem::AsyncHandle m_async_op;
+	// set by prepareContent on a worker, read by fileLoaded on the main thread
+	bool m_is_prepared = false;
+	// size of the header, which is skipped in the loaded content
+	u32 m_content_offset = 0;
 	bool m_hooked = false;
 }; // struct Resource
 
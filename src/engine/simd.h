@@ -4,18 +4,44 @@
 #include "engine/lumix.h"
 
 
-#if defined _WIN32 && !defined __clang__
-	#include <xmmintrin.h>
+// define LUMIX_SIMD_SCALAR to force the plain C++ fallback
+#if !defined LUMIX_SIMD_SCALAR
+	#if defined _M_X64 || defined __x86_64__ || defined __SSE2__
+		#define LUMIX_SIMD_SSE
+	#elif defined _M_ARM64 || defined __aarch64__
+		#define LUMIX_SIMD_NEON
+	#endif
+#endif
+
+#if defined LUMIX_SIMD_SSE
+	#if defined __AVX2__
+		#define LUMIX_SIMD_AVX2
+		#include <immintrin.h>
+		#if defined __FMA__ || defined _MSC_VER
+			#define LUMIX_SIMD_FMA
+		#endif
+	#elif defined __SSE4_1__
+		#include <smmintrin.h>
+	#else
+		#include <emmintrin.h>
+	#endif
+#elif defined LUMIX_SIMD_NEON
+	#include <arm_neon.h>
 #else
 	#include <math.h>
 	#include <string.h>
 #endif
 
+// gcc and clang provide arithmetic operators for vector types, msvc does not
+#if defined _MSC_VER && !defined __clang__
+	#define LUMIX_SIMD_OPERATORS
+#endif
+
 namespace Lumix
 {
 
 
-#if defined _WIN32 && !defined __clang__
+#if defined LUMIX_SIMD_SSE
 	using float4 = __m128;
 
 
@@ -64,6 +90,11 @@ namespace Lumix
 		_mm_store_ps((float*)dest, src);
 	}
 
+	LUMIX_FORCE_INLINE void f4StoreUnaligned(void* dest, float4 src)
+	{
+		_mm_storeu_ps((float*)dest, src);
+	}
+
 	LUMIX_FORCE_INLINE float4 f4CmpGT(float4 a, float4 b)
 	{
 		return _mm_cmpgt_ps(a, b);
@@ -79,6 +110,16 @@ namespace Lumix
 		return _mm_movemask_ps(a);
 	}
 
+	// per lane `mask ? b : a`, mask lanes must be all ones or all zeros
+	LUMIX_FORCE_INLINE float4 f4Blend(float4 a, float4 b, float4 mask)
+	{
+		#if defined __SSE4_1__ || defined LUMIX_SIMD_AVX2
+			return _mm_blendv_ps(a, b, mask);
+		#else
+			return _mm_or_ps(_mm_and_ps(mask, b), _mm_andnot_ps(mask, a));
+		#endif
+	}
+
 
 	LUMIX_FORCE_INLINE float4 f4Add(float4 a, float4 b)
 	{
@@ -98,6 +139,17 @@ namespace Lumix
 	}
 
 
+	// a * b + c
+	LUMIX_FORCE_INLINE float4 f4MulAdd(float4 a, float4 b, float4 c)
+	{
+		#ifdef LUMIX_SIMD_FMA
+			return _mm_fmadd_ps(a, b, c);
+		#else
+			return _mm_add_ps(_mm_mul_ps(a, b), c);
+		#endif
+	}
+
+
 	LUMIX_FORCE_INLINE float4 f4Div(float4 a, float4 b)
 	{
 		return _mm_div_ps(a, b);
@@ -133,18 +185,189 @@ namespace Lumix
 		return _mm_max_ps(a, b);
 	}
 
-	LUMIX_FORCE_INLINE float4 operator +(float4 a, float4 b) {
-		return _mm_add_ps(a, b);
+	// rows to columns, e.g. 4 quaternions to xs, ys, zs, ws
+	LUMIX_FORCE_INLINE void f4Transpose(float4& a, float4& b, float4& c, float4& d)
+	{
+		_MM_TRANSPOSE4_PS(a, b, c, d);
 	}
 
-	LUMIX_FORCE_INLINE float4 operator -(float4 a, float4 b) {
-		return _mm_sub_ps(a, b);
+	#ifdef LUMIX_SIMD_OPERATORS
+		LUMIX_FORCE_INLINE float4 operator +(float4 a, float4 b) {
+			return _mm_add_ps(a, b);
+		}
+
+		LUMIX_FORCE_INLINE float4 operator -(float4 a, float4 b) {
+			return _mm_sub_ps(a, b);
+		}
+
+		LUMIX_FORCE_INLINE float4 operator *(float4 a, float4 b) {
+			return _mm_mul_ps(a, b);
+		}
+	#endif
+
+#elif defined LUMIX_SIMD_NEON
+	using float4 = float32x4_t;
+
+
+	LUMIX_FORCE_INLINE float4 f4LoadUnaligned(const void* src)
+	{
+		return vld1q_f32((const float*)src);
 	}
 
-	LUMIX_FORCE_INLINE float4 operator *(float4 a, float4 b) {
-		return _mm_mul_ps(a, b);
+
+	LUMIX_FORCE_INLINE float4 f4Load(const void* src)
+	{
+		return vld1q_f32((const float*)src);
+	}
+
+
+	LUMIX_FORCE_INLINE float4 f4Splat(float value)
+	{
+		return vdupq_n_f32(value);
+	}
+
+	LUMIX_FORCE_INLINE float f4GetX(float4 v)
+	{
+		return vgetq_lane_f32(v, 0);
+	}
+
+	LUMIX_FORCE_INLINE float f4GetY(float4 v)
+	{
+		return vgetq_lane_f32(v, 1);
+	}
+
+	LUMIX_FORCE_INLINE float f4GetZ(float4 v)
+	{
+		return vgetq_lane_f32(v, 2);
+	}
+
+	LUMIX_FORCE_INLINE float f4GetW(float4 v)
+	{
+		return vgetq_lane_f32(v, 3);
+	}
+
+	LUMIX_FORCE_INLINE void f4Store(void* dest, float4 src)
+	{
+		vst1q_f32((float*)dest, src);
+	}
+
+	LUMIX_FORCE_INLINE void f4StoreUnaligned(void* dest, float4 src)
+	{
+		vst1q_f32((float*)dest, src);
+	}
+
+	LUMIX_FORCE_INLINE float4 f4CmpGT(float4 a, float4 b)
+	{
+		return vreinterpretq_f32_u32(vcgtq_f32(a, b));
+	}
+
+	LUMIX_FORCE_INLINE float4 f4CmpLT(float4 a, float4 b)
+	{
+		return vreinterpretq_f32_u32(vcltq_f32(a, b));
+	}
+	
+	LUMIX_FORCE_INLINE int f4MoveMask(float4 a)
+	{
+		static const i32 shifts[] = { 0, 1, 2, 3 };
+		const uint32x4_t signs = vshrq_n_u32(vreinterpretq_u32_f32(a), 31);
+		return (int)vaddvq_u32(vshlq_u32(signs, vld1q_s32(shifts)));
+	}
+
+	// per lane `mask ? b : a`, mask lanes must be all ones or all zeros
+	LUMIX_FORCE_INLINE float4 f4Blend(float4 a, float4 b, float4 mask)
+	{
+		return vbslq_f32(vreinterpretq_u32_f32(mask), b, a);
+	}
+
+
+	LUMIX_FORCE_INLINE float4 f4Add(float4 a, float4 b)
+	{
+		return vaddq_f32(a, b);
 	}
 
+
+	LUMIX_FORCE_INLINE float4 f4Sub(float4 a, float4 b)
+	{
+		return vsubq_f32(a, b);
+	}
+
+
+	LUMIX_FORCE_INLINE float4 f4Mul(float4 a, float4 b)
+	{
+		return vmulq_f32(a, b);
+	}
+
+
+	// a * b + c
+	LUMIX_FORCE_INLINE float4 f4MulAdd(float4 a, float4 b, float4 c)
+	{
+		return vfmaq_f32(c, a, b);
+	}
+
+
+	LUMIX_FORCE_INLINE float4 f4Div(float4 a, float4 b)
+	{
+		return vdivq_f32(a, b);
+	}
+
+
+	LUMIX_FORCE_INLINE float4 f4Rcp(float4 a)
+	{
+		// vrecpe is only ~8 bits precise, one newton step gets us to what _mm_rcp_ps gives
+		const float4 r = vrecpeq_f32(a);
+		return vmulq_f32(vrecpsq_f32(a, r), r);
+	}
+
+
+	LUMIX_FORCE_INLINE float4 f4Sqrt(float4 a)
+	{
+		return vsqrtq_f32(a);
+	}
+
+
+	LUMIX_FORCE_INLINE float4 f4Rsqrt(float4 a)
+	{
+		const float4 r = vrsqrteq_f32(a);
+		return vmulq_f32(vrsqrtsq_f32(vmulq_f32(a, r), r), r);
+	}
+
+
+	LUMIX_FORCE_INLINE float4 f4Min(float4 a, float4 b)
+	{
+		return vminq_f32(a, b);
+	}
+
+
+	LUMIX_FORCE_INLINE float4 f4Max(float4 a, float4 b)
+	{
+		return vmaxq_f32(a, b);
+	}
+
+	// rows to columns, e.g. 4 quaternions to xs, ys, zs, ws
+	LUMIX_FORCE_INLINE void f4Transpose(float4& a, float4& b, float4& c, float4& d)
+	{
+		const float32x4x2_t ab = vtrnq_f32(a, b);
+		const float32x4x2_t cd = vtrnq_f32(c, d);
+		a = vcombine_f32(vget_low_f32(ab.val[0]), vget_low_f32(cd.val[0]));
+		b = vcombine_f32(vget_low_f32(ab.val[1]), vget_low_f32(cd.val[1]));
+		c = vcombine_f32(vget_high_f32(ab.val[0]), vget_high_f32(cd.val[0]));
+		d = vcombine_f32(vget_high_f32(ab.val[1]), vget_high_f32(cd.val[1]));
+	}
+
+	#ifdef LUMIX_SIMD_OPERATORS
+		LUMIX_FORCE_INLINE float4 operator +(float4 a, float4 b) {
+			return vaddq_f32(a, b);
+		}
+
+		LUMIX_FORCE_INLINE float4 operator -(float4 a, float4 b) {
+			return vsubq_f32(a, b);
+		}
+
+		LUMIX_FORCE_INLINE float4 operator *(float4 a, float4 b) {
+			return vmulq_f32(a, b);
+		}
+	#endif
+
 #else 
 	struct float4
 	{
@@ -199,6 +422,11 @@ namespace Lumix
 		(*(float4*)dest) = src;
 	}
 
+	LUMIX_FORCE_INLINE void f4StoreUnaligned(void* dest, float4 src)
+	{
+		memcpy(dest, &src, sizeof(src));
+	}
+
 	LUMIX_FORCE_INLINE float4 f4CmpGT(float4 a, float4 b)
 	{
 		static const float gt = [](){
@@ -232,10 +460,26 @@ namespace Lumix
 	}
 	LUMIX_FORCE_INLINE int f4MoveMask(float4 a)
 	{
-		return (a.w < 0 ? (1 << 3) : 0) | 
-			(a.z < 0 ? (1 << 2) : 0) | 
-			(a.y < 0 ? (1 << 1) : 0) | 
-			(a.x < 0 ? 1 : 0);
+		// sign bits, comparing with 0 would not work for masks from f4CmpGT/f4CmpLT, since those are NaNs
+		u32 u[4];
+		memcpy(u, &a, sizeof(u));
+		return (u[3] >> 31 << 3) | 
+			(u[2] >> 31 << 2) | 
+			(u[1] >> 31 << 1) | 
+			(u[0] >> 31);
+	}
+
+	// per lane `mask ? b : a`, mask lanes must be all ones or all zeros
+	LUMIX_FORCE_INLINE float4 f4Blend(float4 a, float4 b, float4 mask)
+	{
+		u32 m[4];
+		memcpy(m, &mask, sizeof(m));
+		return {
+			m[0] ? b.x : a.x,
+			m[1] ? b.y : a.y,
+			m[2] ? b.z : a.z,
+			m[3] ? b.w : a.w
+		};
 	}
 
 
@@ -272,6 +516,18 @@ namespace Lumix
 	}
 
 
+	// a * b + c
+	LUMIX_FORCE_INLINE float4 f4MulAdd(float4 a, float4 b, float4 c)
+	{
+		return{
+			a.x * b.x + c.x,
+			a.y * b.y + c.y,
+			a.z * b.z + c.z,
+			a.w * b.w + c.w
+		};
+	}
+
+
 	LUMIX_FORCE_INLINE float4 f4Div(float4 a, float4 b)
 	{
 		return{
@@ -337,6 +593,16 @@ namespace Lumix
 		};
 	}
 
+	// rows to columns, e.g. 4 quaternions to xs, ys, zs, ws
+	LUMIX_FORCE_INLINE void f4Transpose(float4& a, float4& b, float4& c, float4& d)
+	{
+		const float4 ta = a, tb = b, tc = c, td = d;
+		a = { ta.x, tb.x, tc.x, td.x };
+		b = { ta.y, tb.y, tc.y, td.y };
+		c = { ta.z, tb.z, tc.z, td.z };
+		d = { ta.w, tb.w, tc.w, td.w };
+	}
+
 	LUMIX_FORCE_INLINE float4 operator +(float4 a, float4 b) {
 		return f4Add(a, b);
 	}
@@ -352,5 +618,123 @@ namespace Lumix
 #endif
 
 
+// 8 lanes, native with AVX2, otherwise a pair of float4
+#if defined LUMIX_SIMD_AVX2
+	using float8 = __m256;
+
+
+	LUMIX_FORCE_INLINE float8 f8LoadUnaligned(const void* src)
+	{
+		return _mm256_loadu_ps((const float*)src);
+	}
+
+
+	LUMIX_FORCE_INLINE float8 f8Splat(float value)
+	{
+		return _mm256_set1_ps(value);
+	}
+
+
+	LUMIX_FORCE_INLINE void f8StoreUnaligned(void* dest, float8 src)
+	{
+		_mm256_storeu_ps((float*)dest, src);
+	}
+
+
+	LUMIX_FORCE_INLINE int f8MoveMask(float8 a)
+	{
+		return _mm256_movemask_ps(a);
+	}
+
+
+	LUMIX_FORCE_INLINE float8 f8Add(float8 a, float8 b)
+	{
+		return _mm256_add_ps(a, b);
+	}
+
+
+	LUMIX_FORCE_INLINE float8 f8Sub(float8 a, float8 b)
+	{
+		return _mm256_sub_ps(a, b);
+	}
+
+
+	LUMIX_FORCE_INLINE float8 f8Mul(float8 a, float8 b)
+	{
+		return _mm256_mul_ps(a, b);
+	}
+
+
+	// a * b + c
+	LUMIX_FORCE_INLINE float8 f8MulAdd(float8 a, float8 b, float8 c)
+	{
+		#ifdef LUMIX_SIMD_FMA
+			return _mm256_fmadd_ps(a, b, c);
+		#else
+			return _mm256_add_ps(_mm256_mul_ps(a, b), c);
+		#endif
+	}
+
+#else
+	struct float8
+	{
+		float4 lo, hi;
+	};
+
+
+	LUMIX_FORCE_INLINE float8 f8LoadUnaligned(const void* src)
+	{
+		return { f4LoadUnaligned(src), f4LoadUnaligned((const float*)src + 4) };
+	}
+
+
+	LUMIX_FORCE_INLINE float8 f8Splat(float value)
+	{
+		const float4 v = f4Splat(value);
+		return { v, v };
+	}
+
+
+	LUMIX_FORCE_INLINE void f8StoreUnaligned(void* dest, float8 src)
+	{
+		f4StoreUnaligned(dest, src.lo);
+		f4StoreUnaligned((float*)dest + 4, src.hi);
+	}
+
+
+	LUMIX_FORCE_INLINE int f8MoveMask(float8 a)
+	{
+		return f4MoveMask(a.lo) | (f4MoveMask(a.hi) << 4);
+	}
+
+
+	LUMIX_FORCE_INLINE float8 f8Add(float8 a, float8 b)
+	{
+		return { f4Add(a.lo, b.lo), f4Add(a.hi, b.hi) };
+	}
+
+
+	LUMIX_FORCE_INLINE float8 f8Sub(float8 a, float8 b)
+	{
+		return { f4Sub(a.lo, b.lo), f4Sub(a.hi, b.hi) };
+	}
+
+
+	LUMIX_FORCE_INLINE float8 f8Mul(float8 a, float8 b)
+	{
+		return { f4Mul(a.lo, b.lo), f4Mul(a.hi, b.hi) };
+	}
+
+
+	// a * b + c
+	LUMIX_FORCE_INLINE float8 f8MulAdd(float8 a, float8 b, float8 c)
+	{
+		return { f4MulAdd(a.lo, b.lo, c.lo), f4MulAdd(a.hi, b.hi, c.hi) };
+	}
+
+#endif
+
+
+
 
 } // namespace Lumix
\ No newline at end of file
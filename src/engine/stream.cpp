@@ -188,7 +188,7 @@ void OutputMemoryStream::operator =(const OutputMemoryStream& rhs)
 
 void OutputMemoryStream::operator =(OutputMemoryStream&& rhs)
 {
-	ASSERT(rhs.m_allocator);
+	// rhs can be a view without allocator, e.g. memory mapped file content
 	if (m_allocator) m_allocator->deallocate(m_data);
 		
 	m_allocator = rhs.m_allocator;
@@ -264,7 +264,7 @@ void OutputMemoryStream::clear()
 
 void OutputMemoryStream::free()
 {
-	m_allocator->deallocate(m_data);
+	if (m_allocator) m_allocator->deallocate(m_data);
 	m_size = 0;
 	m_capacity = 0;
 	m_data = nullptr;
@@ -54,5 +54,25 @@ LUMIX_ENGINE_API void memoryBarrier()
 #endif
 }
 
+LUMIX_ENGINE_API void readBarrier()
+{
+#ifdef _M_ARM64
+	__dmb(_ARM64_BARRIER_ISHLD);
+#else
+	// x86 does not reorder loads with other loads and later stores, we only need to stop the compiler
+	_ReadWriteBarrier();
+#endif
+}
+
+LUMIX_ENGINE_API void writeBarrier()
+{
+#ifdef _M_ARM64
+	__dmb(_ARM64_BARRIER_ISH);
+#else
+	// x86 does not reorder stores with older loads and stores, we only need to stop the compiler
+	_ReadWriteBarrier();
+#endif
+}
+
 
 } // namespace Lumix
@@ -2,6 +2,7 @@
 #include "engine/allocators.h"
 #include "engine/log.h"
 #include "engine/lumix.h"
+#include "engine/math.h"
 #include "engine/os.h"
 #include "engine/path.h"
 #include "engine/string.h"
@@ -187,6 +188,88 @@ bool InputFile::seek(u64 pos)
 }
 
 
+MappedFile::MappedFile()
+{
+	m_data = nullptr;
+	m_size = 0;
+	m_handle = nullptr;
+}
+
+
+MappedFile::~MappedFile()
+{
+	ASSERT(!m_data);
+}
+
+
+bool MappedFile::open(const char* path)
+{
+	ASSERT(!m_data);
+	const HANDLE file = ::CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (file == INVALID_HANDLE_VALUE) return false;
+
+	LARGE_INTEGER size;
+	if (!::GetFileSizeEx(file, &size) || size.QuadPart == 0) {
+		::CloseHandle(file);
+		return false;
+	}
+
+	// the mapping keeps the file alive, we do not need the file handle anymore
+	const HANDLE mapping = ::CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	::CloseHandle(file);
+	if (!mapping) return false;
+
+	void* mem = ::MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	if (!mem) {
+		::CloseHandle(mapping);
+		return false;
+	}
+
+	m_handle = mapping;
+	m_data = (const u8*)mem;
+	m_size = size.QuadPart;
+	return true;
+}
+
+
+void MappedFile::close()
+{
+	if (m_data) {
+		::UnmapViewOfFile(m_data);
+		::CloseHandle((HANDLE)m_handle);
+		m_handle = nullptr;
+		m_data = nullptr;
+		m_size = 0;
+	}
+}
+
+
+void MappedFile::prefetch(u64 offset, u64 size)
+{
+	ASSERT(m_data);
+	if (offset >= m_size) return;
+	WIN32_MEMORY_RANGE_ENTRY range;
+	range.VirtualAddress = (void*)(m_data + offset);
+	range.NumberOfBytes = (SIZE_T)minimum(size, m_size - offset);
+	::PrefetchVirtualMemory(::GetCurrentProcess(), 1, &range, 0);
+}
+
+
+void MappedFile::evict(u64 offset, u64 size)
+{
+	ASSERT(m_data);
+	if (offset >= m_size) return;
+	// only whole pages, partial pages can be used by neighbouring data
+	const u64 page_size = getMemPageSize();
+	size = minimum(size, m_size - offset);
+	const u64 from = (offset + page_size - 1) & ~(page_size - 1);
+	const u64 to = offset + size == m_size ? m_size : (offset + size) & ~(page_size - 1);
+	if (to <= from) return;
+	// unlocking pages which are not locked removes them from the working set
+	::VirtualUnlock((void*)(m_data + from), to - from);
+}
+
+
 static void fromWChar(Span<char> out, const WCHAR* in)
 {
 	const WCHAR* c = in;
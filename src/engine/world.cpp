@@ -1,11 +1,15 @@
 #include "world.h"
+#include "engine/atomic.h"
 #include "engine/engine.h"
 #include "engine/hash.h"
+#include "engine/job_system.h"
 #include "engine/log.h"
 #include "engine/math.h"
 #include "engine/plugin.h"
 #include "engine/prefab.h"
+#include "engine/profiler.h"
 #include "engine/reflection.h"
+#include "engine/stream.h"
 #include "engine/string.h"
 
 
@@ -52,11 +56,16 @@ World::World(Engine& engine, IAllocator& allocator)
 	, m_component_destroyed(m_allocator)
 	, m_entity_destroyed(m_allocator)
 	, m_entity_moved(m_allocator)
+	, m_entities_moved(m_allocator)
+	, m_dirty_transforms(m_allocator)
+	, m_moved_entities(m_allocator)
 	, m_entity_created(m_allocator)
 	, m_first_free_slot(-1)
 	, m_scenes(m_allocator)
 	, m_hierarchy(m_allocator)
 	, m_transforms(m_allocator)
+	, m_batched_entities(m_allocator)
+	, m_batched_components(m_allocator)
 	, m_name("")
 {
 	m_entities.reserve(RESERVED_ENTITIES_COUNT);
@@ -116,10 +125,166 @@ const Quat& World::getRotation(EntityRef entity) const
 }
 
 
+void World::notifyMoved(EntityRef entity)
+{
+	m_entity_moved.invoke(entity);
+	m_entities_moved.invoke(Span<const EntityRef>(&entity, 1));
+}
+
+
+bool World::hasDirtyAncestor(EntityRef entity) const
+{
+	for (EntityPtr p = getParent(entity); p.isValid(); p = getParent((EntityRef)p)) {
+		if (m_entities[p.index].dirty_transform != 0) return true;
+	}
+	return false;
+}
+
+
+// global transform with all pending writes applied, i.e. what flushTransforms will compute
+Transform World::getPendingTransform(EntityRef entity) const
+{
+	const EntityData& data = m_entities[entity.index];
+	if (data.hierarchy < 0 || (data.dirty_transform & DIRTY_GLOBAL)) return m_transforms[entity.index];
+
+	const Hierarchy& h = m_hierarchy[data.hierarchy];
+	if (!h.parent.isValid()) return m_transforms[entity.index];
+	if (!(data.dirty_transform & DIRTY_LOCAL) && !hasDirtyAncestor(entity)) return m_transforms[entity.index];
+	return getPendingTransform((EntityRef)h.parent) * h.local_transform;
+}
+
+
+// in immediate mode children follow their parent, so pending global writes in the subtree are turned into local ones
+void World::foldDirtyDescendants(EntityRef entity)
+{
+	const i32 hierarchy_idx = m_entities[entity.index].hierarchy;
+	if (hierarchy_idx < 0) return;
+
+	for (EntityPtr child = m_hierarchy[hierarchy_idx].first_child; child.isValid(); child = getNextSibling((EntityRef)child)) {
+		EntityData& data = m_entities[child.index];
+		if (data.dirty_transform & DIRTY_GLOBAL) {
+			m_hierarchy[data.hierarchy].local_transform = getPendingTransform(entity).inverted() * m_transforms[child.index];
+			data.dirty_transform = DIRTY_LOCAL;
+			--m_dirty_child_globals;
+		}
+		if (m_dirty_child_globals == 0) return;
+		foldDirtyDescendants((EntityRef)child);
+	}
+}
+
+
+// called before a write, writes must compose the same way as in immediate mode,
+// so the pending state is first folded into the representation being written
+void World::markTransformDirty(EntityRef entity, u8 flag)
+{
+	EntityData& data = m_entities[entity.index];
+	if (m_dirty_child_globals > 0) foldDirtyDescendants(entity);
+	if (data.dirty_transform == flag) return;
+
+	const EntityPtr parent = getParent(entity);
+	if (parent.isValid()) {
+		if (flag == DIRTY_GLOBAL) {
+			m_transforms[entity.index] = getPendingTransform(entity);
+			++m_dirty_child_globals;
+		}
+		else if (data.dirty_transform & DIRTY_GLOBAL) {
+			m_hierarchy[data.hierarchy].local_transform = getPendingTransform((EntityRef)parent).inverted() * m_transforms[entity.index];
+			--m_dirty_child_globals;
+		}
+	}
+	if (data.dirty_transform == 0) m_dirty_transforms.push(entity);
+	data.dirty_transform = flag;
+}
+
+
+void World::deferTransforms()
+{
+	ASSERT(!m_defer_transforms);
+	m_defer_transforms = true;
+}
+
+
+void World::updateTransformFromDirty(EntityRef entity)
+{
+	EntityData& data = m_entities[entity.index];
+	if (data.hierarchy < 0) return;
+
+	Hierarchy& h = m_hierarchy[data.hierarchy];
+	if (!h.parent.isValid()) return;
+
+	// parent is already final, it's either not moved or it's in previous level
+	const Transform& parent_tr = m_transforms[h.parent.index];
+	if (data.dirty_transform & DIRTY_GLOBAL) {
+		h.local_transform = parent_tr.inverted() * m_transforms[entity.index];
+	}
+	else {
+		m_transforms[entity.index] = parent_tr * h.local_transform;
+	}
+}
+
+
+void World::flushTransforms()
+{
+	PROFILE_FUNCTION();
+	ASSERT(m_defer_transforms);
+	m_defer_transforms = false;
+	if (m_dirty_transforms.empty()) return;
+
+	m_moved_entities.clear();
+	// roots of moved subtrees are dirty entities without dirty ancestors
+	for (EntityRef e : m_dirty_transforms) {
+		EntityData& data = m_entities[e.index];
+		if (!data.valid || data.dirty_transform == 0 || (data.dirty_transform & DIRTY_QUEUED)) continue;
+
+		if (hasDirtyAncestor(e)) continue;
+
+		data.dirty_transform |= DIRTY_QUEUED;
+		m_moved_entities.push(e);
+	}
+
+	// breadth first, entities in one level depend only on the previous level, so each level is updated in parallel
+	u32 level_begin = 0;
+	while (level_begin < (u32)m_moved_entities.size()) {
+		const u32 level_end = m_moved_entities.size();
+		jobs::forEach(level_end - level_begin, 512, [&](i32 from, i32 to){
+			for (i32 i = from; i < to; ++i) {
+				updateTransformFromDirty(m_moved_entities[level_begin + i]);
+			}
+		});
+
+		for (u32 i = level_begin; i < level_end; ++i) {
+			const EntityRef e = m_moved_entities[i];
+			const i32 hierarchy_idx = m_entities[e.index].hierarchy;
+			if (hierarchy_idx < 0) continue;
+			for (EntityPtr child = m_hierarchy[hierarchy_idx].first_child; child.isValid(); child = getNextSibling((EntityRef)child)) {
+				m_entities[child.index].dirty_transform |= DIRTY_QUEUED;
+				m_moved_entities.push((EntityRef)child);
+			}
+		}
+		level_begin = level_end;
+	}
+
+	for (EntityRef e : m_dirty_transforms) m_entities[e.index].dirty_transform = 0;
+	m_dirty_child_globals = 0;
+	for (EntityRef e : m_moved_entities) m_entities[e.index].dirty_transform = 0;
+	m_dirty_transforms.clear();
+
+	m_entities_moved.invoke(m_moved_entities);
+	for (EntityRef e : m_moved_entities) m_entity_moved.invoke(e);
+}
+
+
 void World::transformEntity(EntityRef entity, bool update_local)
 {
+	if (m_defer_transforms) {
+		// marked before the write
+		ASSERT(update_local);
+		ASSERT(m_entities[entity.index].dirty_transform & DIRTY_GLOBAL);
+		return;
+	}
+
 	const int hierarchy_idx = m_entities[entity.index].hierarchy;
-	m_entity_moved.invoke(entity);
+	notifyMoved(entity);
 	if (hierarchy_idx >= 0) {
 		Hierarchy& h = m_hierarchy[hierarchy_idx];
 		const Transform my_transform = getTransform(entity);
@@ -145,6 +310,7 @@ void World::transformEntity(EntityRef entity, bool update_local)
 
 void World::setRotation(EntityRef entity, const Quat& rot)
 {
+	if (m_defer_transforms) markTransformDirty(entity, DIRTY_GLOBAL);
 	m_transforms[entity.index].rot = rot;
 	transformEntity(entity, true);
 }
@@ -152,6 +318,7 @@ void World::setRotation(EntityRef entity, const Quat& rot)
 
 void World::setRotation(EntityRef entity, float x, float y, float z, float w)
 {
+	if (m_defer_transforms) markTransformDirty(entity, DIRTY_GLOBAL);
 	m_transforms[entity.index].rot.set(x, y, z, w);
 	transformEntity(entity, true);
 }
@@ -165,11 +332,12 @@ bool World::hasEntity(EntityRef entity) const
 
 void World::setTransformKeepChildren(EntityRef entity, const Transform& transform)
 {
+	ASSERT(!m_defer_transforms);
 	Transform& tmp = m_transforms[entity.index];
 	tmp = transform;
 	
 	int hierarchy_idx = m_entities[entity.index].hierarchy;
-	entityTransformed().invoke(entity);
+	notifyMoved(entity);
 	if (hierarchy_idx >= 0)
 	{
 		Hierarchy& h = m_hierarchy[hierarchy_idx];
@@ -194,6 +362,7 @@ void World::setTransformKeepChildren(EntityRef entity, const Transform& transfor
 
 void World::setTransform(EntityRef entity, const Transform& transform)
 {
+	if (m_defer_transforms) markTransformDirty(entity, DIRTY_GLOBAL);
 	Transform& tmp = m_transforms[entity.index];
 	tmp = transform;
 	transformEntity(entity, true);
@@ -202,6 +371,7 @@ void World::setTransform(EntityRef entity, const Transform& transform)
 
 void World::setTransform(EntityRef entity, const RigidTransform& transform)
 {
+	if (m_defer_transforms) markTransformDirty(entity, DIRTY_GLOBAL);
 	auto& tmp = m_transforms[entity.index];
 	tmp.pos = transform.pos;
 	tmp.rot = transform.rot;
@@ -211,6 +381,7 @@ void World::setTransform(EntityRef entity, const RigidTransform& transform)
 
 void World::setTransform(EntityRef entity, const DVec3& pos, const Quat& rot, const Vec3& scale)
 {
+	if (m_defer_transforms) markTransformDirty(entity, DIRTY_GLOBAL);
 	auto& tmp = m_transforms[entity.index];
 	tmp.pos = pos;
 	tmp.rot = rot;
@@ -237,6 +408,7 @@ Matrix World::getRelativeMatrix(EntityRef entity, const DVec3& base_pos) const
 
 void World::setPosition(EntityRef entity, const DVec3& pos)
 {
+	if (m_defer_transforms) markTransformDirty(entity, DIRTY_GLOBAL);
 	m_transforms[entity.index].pos = pos;
 	transformEntity(entity, true);
 }
@@ -338,20 +510,20 @@ void World::emplaceEntity(EntityRef entity)
 	data.hierarchy = -1;
 	data.components = 0;
 	data.valid = true;
+	data.dirty_transform = 0;
 
-	m_entity_created.invoke(entity);
+	if (m_is_batch) m_batched_entities.push(entity);
+	else m_entity_created.invoke(entity);
 }
 
 
-EntityRef World::createEntity(const DVec3& position, const Quat& rotation)
+EntityRef World::allocEntity()
 {
 	EntityData* data;
 	EntityRef entity;
-	Transform* tr;
 	if (m_first_free_slot >= 0)
 	{
 		data = &m_entities[m_first_free_slot];
-		tr = &m_transforms[m_first_free_slot];
 		entity.index = m_first_free_slot;
 		if (data->next >= 0) m_entities[data->next].prev = -1;
 		m_first_free_slot = data->next;
@@ -360,21 +532,103 @@ EntityRef World::createEntity(const DVec3& position, const Quat& rotation)
 	{
 		entity.index = m_entities.size();
 		data = &m_entities.emplace();
-		tr = &m_transforms.emplace();
+		m_transforms.emplace();
 	}
-	tr->pos = position;
-	tr->rot = rotation;
-	tr->scale = Vec3(1);
 	data->name = -1;
 	data->hierarchy = -1;
 	data->components = 0;
 	data->valid = true;
-	m_entity_created.invoke(entity);
+	data->dirty_transform = 0;
+	return entity;
+}
+
+
+EntityRef World::createEntity(const DVec3& position, const Quat& rotation)
+{
+	const EntityRef entity = allocEntity();
+	Transform& tr = m_transforms[entity.index];
+	tr.pos = position;
+	tr.rot = rotation;
+	tr.scale = Vec3(1);
+
+	if (m_is_batch) m_batched_entities.push(entity);
+	else m_entity_created.invoke(entity);
 
 	return entity;
 }
 
 
+void World::instantiate(const WorldTemplate& tpl, u32 count, Array<EntityPtr>& map)
+{
+	PROFILE_FUNCTION();
+	const u32 entities_count = tpl.entities.size();
+	map.resize(count * tpl.map_size);
+	for (EntityPtr& e : map) e = INVALID_ENTITY;
+
+	// free slots are reused first, so this can reserve more than needed
+	m_entities.reserve(m_entities.size() + count * entities_count);
+	m_transforms.reserve(m_transforms.size() + count * entities_count);
+	m_names.reserve(m_names.size() + count * tpl.names.size());
+	m_hierarchy.reserve(m_hierarchy.size() + count * tpl.hierarchy.size());
+	if (m_is_batch) m_batched_entities.reserve(m_batched_entities.size() + count * entities_count);
+
+	for (u32 i = 0; i < count; ++i) {
+		EntityPtr* instance_map = &map[i * tpl.map_size];
+		for (u32 j = 0; j < entities_count; ++j) {
+			const EntityRef e = allocEntity();
+			m_transforms[e.index] = tpl.transforms[j];
+			instance_map[tpl.entities[j].index] = e;
+		}
+
+		for (const WorldTemplate::Name& src : tpl.names) {
+			EntityName& name = m_names.emplace();
+			name.entity = (EntityRef)instance_map[src.entity.index];
+			copyString(name.name, src.name);
+			m_entities[name.entity.index].name = m_names.size() - 1;
+		}
+
+		auto remap = [&](EntityPtr e){ return e.isValid() ? instance_map[e.index] : INVALID_ENTITY; };
+		for (const WorldTemplate::Hierarchy& src : tpl.hierarchy) {
+			Hierarchy& h = m_hierarchy.emplace();
+			h.entity = (EntityRef)instance_map[src.entity.index];
+			h.parent = remap(src.parent);
+			h.first_child = remap(src.first_child);
+			h.next_sibling = remap(src.next_sibling);
+			h.local_transform = src.local_transform;
+			m_entities[h.entity.index].hierarchy = m_hierarchy.size() - 1;
+		}
+	}
+
+	for (u32 i = 0; i < count; ++i) {
+		for (const EntityRef& src : tpl.entities) {
+			const EntityRef e = (EntityRef)map[i * tpl.map_size + src.index];
+			if (m_is_batch) m_batched_entities.push(e);
+			else m_entity_created.invoke(e);
+		}
+	}
+}
+
+
+void World::beginBatch()
+{
+	ASSERT(!m_is_batch);
+	m_is_batch = true;
+}
+
+
+void World::endBatch()
+{
+	ASSERT(m_is_batch);
+	m_is_batch = false;
+	for (EntityRef e : m_batched_entities) m_entity_created.invoke(e);
+	for (const BatchedComponent& cmp : m_batched_components) {
+		m_component_added.invoke(ComponentUID(cmp.entity, cmp.type, m_component_type_map[cmp.type.index].scene));
+	}
+	m_batched_entities.clear();
+	m_batched_components.clear();
+}
+
+
 void World::destroyEntity(EntityRef entity)
 {
 	EntityData& entity_data = m_entities[entity.index];
@@ -564,6 +818,11 @@ void World::updateGlobalTransform(EntityRef entity)
 {
 	const Hierarchy& h = m_hierarchy[m_entities[entity.index].hierarchy];
 	ASSERT(h.parent.isValid());
+	if (m_defer_transforms) {
+		// parent can be dirty, so global transform is computed in flush, marked before the write
+		ASSERT(m_entities[entity.index].dirty_transform & DIRTY_LOCAL);
+		return;
+	}
 	Transform parent_tr = getTransform((EntityRef)h.parent);
 	
 	Transform new_tr = parent_tr * h.local_transform;
@@ -580,6 +839,7 @@ void World::setLocalPosition(EntityRef entity, const DVec3& pos)
 		return;
 	}
 
+	if (m_defer_transforms) markTransformDirty(entity, DIRTY_LOCAL);
 	m_hierarchy[hierarchy_idx].local_transform.pos = pos;
 	updateGlobalTransform(entity);
 }
@@ -593,6 +853,7 @@ void World::setLocalRotation(EntityRef entity, const Quat& rot)
 		setRotation(entity, rot);
 		return;
 	}
+	if (m_defer_transforms) markTransformDirty(entity, DIRTY_LOCAL);
 	m_hierarchy[hierarchy_idx].local_transform.rot = rot;
 	updateGlobalTransform(entity);
 }
@@ -607,6 +868,7 @@ void World::setLocalTransform(EntityRef entity, const Transform& transform)
 		return;
 	}
 
+	if (m_defer_transforms) markTransformDirty(entity, DIRTY_LOCAL);
 	Hierarchy& h = m_hierarchy[hierarchy_idx];
 	h.local_transform = transform;
 	updateGlobalTransform(entity);
@@ -740,8 +1002,79 @@ void World::deserialize(InputMemoryStream& serializer, EntityMap& entity_map, bo
 }
 
 
+WorldTemplate::WorldTemplate(IAllocator& allocator)
+	: entities(allocator)
+	, transforms(allocator)
+	, names(allocator)
+	, hierarchy(allocator)
+{}
+
+
+void WorldTemplate::clear()
+{
+	map_size = 0;
+	entities.clear();
+	transforms.clear();
+	names.clear();
+	hierarchy.clear();
+}
+
+
+void WorldTemplate::deserialize(InputMemoryStream& serializer, bool vec3_scale)
+{
+	clear();
+	serializer.read<u32>();
+
+	for (EntityPtr e = serializer.read<EntityPtr>(); e.isValid(); e = serializer.read<EntityPtr>()) {
+		entities.push((EntityRef)e);
+		map_size = maximum(map_size, u32(e.index + 1));
+		Transform& tr = transforms.emplace();
+		serializer.read(tr.pos);
+		serializer.read(tr.rot);
+		if (vec3_scale) {
+			serializer.read(tr.scale);
+		}
+		else {
+			serializer.read(tr.scale.x);
+			float padding;
+			serializer.read(padding);
+		}
+		tr.scale.y = tr.scale.z = tr.scale.x;
+	}
+
+	u32 count;
+	serializer.read(count);
+	for (u32 i = 0; i < count; ++i) {
+		Name& name = names.emplace();
+		serializer.read(name.entity);
+		copyString(name.name, serializer.readString());
+	}
+
+	serializer.read(count);
+	for (u32 i = 0; i < count; ++i) {
+		Hierarchy& h = hierarchy.emplace();
+		serializer.read(h.entity);
+		serializer.read(h.parent);
+		serializer.read(h.first_child);
+		serializer.read(h.next_sibling);
+		serializer.read(h.local_transform.pos);
+		serializer.read(h.local_transform.rot);
+		if (vec3_scale) {
+			serializer.read(h.local_transform.scale);
+		}
+		else {
+			serializer.read(h.local_transform.scale.x);
+			float padding;
+			serializer.read(padding);
+			h.local_transform.scale.z = h.local_transform.scale.y = h.local_transform.scale.x;
+		}
+	}
+}
+
+
 void World::setScale(EntityRef entity, const Vec3& scale)
 {
+	if (m_defer_transforms) markTransformDirty(entity, DIRTY_GLOBAL);
 	m_transforms[entity.index].scale = scale;
 	transformEntity(entity, true);
 }
@@ -834,8 +1167,12 @@ void World::destroyComponent(EntityRef entity, ComponentType type)
 
 void World::onComponentCreated(EntityRef entity, ComponentType component_type, IScene* scene)
 {
-	ComponentUID cmp(entity, component_type, scene);
 	m_entities[entity.index].components |= (u64)1 << component_type.index;
+	if (m_is_batch) {
+		m_batched_components.push({entity, component_type});
+		return;
+	}
+	ComponentUID cmp(entity, component_type, scene);
 	m_component_added.invoke(cmp);
 }
 
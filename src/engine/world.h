@@ -11,6 +11,7 @@ namespace Lumix {
 
 struct ComponentUID;
 struct IScene;
+struct WorldTemplate;
 
 enum class WorldSerializedVersion : u32
 {
@@ -74,6 +75,8 @@ struct LUMIX_ENGINE_API World {
 			};
 		};
 		bool valid;
+		// combination of DirtyTransform flags
+		u8 dirty_transform;
 	};
 
 	explicit World(struct Engine& engine, IAllocator& allocator);
@@ -88,6 +91,12 @@ struct LUMIX_ENGINE_API World {
 	void destroyComponent(EntityRef entity, ComponentType type);
 	void onComponentCreated(EntityRef entity, ComponentType component_type, IScene* scene);
 	void onComponentDestroyed(EntityRef entity, ComponentType component_type, IScene* scene);
+	// creates `count` copies of entities in `tpl`, i-th copy of serialized entity `e` is map[i * tpl.map_size + e.index]
+	void instantiate(const WorldTemplate& tpl, u32 count, Array<EntityPtr>& map);
+	// entityCreated and componentAdded are not invoked until endBatch, which invokes them for everything created in the batch
+	// entities created in the batch must not be destroyed before endBatch
+	void beginBatch();
+	void endBatch();
     u64 getComponentsMask(EntityRef entity) const;
     bool hasComponent(EntityRef entity, ComponentType component_type) const;
 	ComponentUID getComponent(EntityRef entity, ComponentType type) const;
@@ -120,6 +129,10 @@ struct LUMIX_ENGINE_API World {
 	void setTransform(EntityRef entity, const Transform& transform);
 	void setTransformKeepChildren(EntityRef entity, const Transform& transform);
 	void setTransform(EntityRef entity, const DVec3& pos, const Quat& rot, const Vec3& scale);
+	// after this, changed transforms only mark entities dirty, so children of moved entities have stale transforms
+	// until flushTransforms, which updates them and notifies listeners in batch
+	void deferTransforms();
+	void flushTransforms();
 	const Transform& getTransform(EntityRef entity) const;
 	void setRotation(EntityRef entity, float x, float y, float z, float w);
 	void setRotation(EntityRef entity, const Quat& rot);
@@ -133,6 +146,8 @@ struct LUMIX_ENGINE_API World {
 
 	DelegateList<void(EntityRef)>& entityCreated() { return m_entity_created; }
 	DelegateList<void(EntityRef)>& entityTransformed() { return m_entity_moved; }
+	// invoked once per flushTransforms with all moved entities, or with single entity if transforms are not deferred
+	DelegateList<void(Span<const EntityRef>)>& entitiesTransformed() { return m_entities_moved; }
 	DelegateList<void(EntityRef)>& entityDestroyed() { return m_entity_destroyed; }
 	DelegateList<void(const ComponentUID&)>& componentDestroyed() { return m_component_destroyed; }
 	DelegateList<void(const ComponentUID&)>& componentAdded() { return m_component_added; }
@@ -148,6 +163,13 @@ struct LUMIX_ENGINE_API World {
 private:
 	void transformEntity(EntityRef entity, bool update_local);
 	void updateGlobalTransform(EntityRef entity);
+	EntityRef allocEntity();
+	void notifyMoved(EntityRef entity);
+	void markTransformDirty(EntityRef entity, u8 flag);
+	bool hasDirtyAncestor(EntityRef entity) const;
+	Transform getPendingTransform(EntityRef entity) const;
+	void foldDirtyDescendants(EntityRef entity);
+	void updateTransformFromDirty(EntityRef entity);
 
 	struct Hierarchy {
 		EntityRef entity;
@@ -169,6 +191,20 @@ private:
 		void (*destroy)(IScene*, EntityRef);
 	};
 
+	enum DirtyTransform : u8 {
+		// global transform was set, local is computed in flush
+		DIRTY_GLOBAL = 1 << 0,
+		// local transform was set, global is computed in flush
+		DIRTY_LOCAL = 1 << 1,
+		// already in m_moved_entities
+		DIRTY_QUEUED = 1 << 2
+	};
+
+	struct BatchedComponent {
+		EntityRef entity;
+		ComponentType type;
+	};
+
 	IAllocator& m_allocator;
 	Engine& m_engine;
 	ComponentTypeEntry m_component_type_map[ComponentType::MAX_TYPES_COUNT];
@@ -179,13 +215,51 @@ private:
 	Array<EntityName> m_names;
 	DelegateList<void(EntityRef)> m_entity_created;
 	DelegateList<void(EntityRef)> m_entity_moved;
+	DelegateList<void(Span<const EntityRef>)> m_entities_moved;
 	DelegateList<void(EntityRef)> m_entity_destroyed;
 	DelegateList<void(const ComponentUID&)> m_component_destroyed;
 	DelegateList<void(const ComponentUID&)> m_component_added;
+	bool m_is_batch = false;
+	bool m_defer_transforms = false;
+	Array<EntityRef> m_dirty_transforms;
+	// dirty entities with a parent and DIRTY_GLOBAL
+	u32 m_dirty_child_globals = 0;
+	Array<EntityRef> m_moved_entities;
+	Array<EntityRef> m_batched_entities;
+	Array<BatchedComponent> m_batched_components;
 	int m_first_free_slot;
 	char m_name[64];
 };
 
+// entities, names and hierarchy of a serialized world parsed once, so they can be instantiated many times without parsing
+struct LUMIX_ENGINE_API WorldTemplate {
+	struct Name {
+		EntityRef entity;
+		char name[World::ENTITY_NAME_MAX_LENGTH];
+	};
+
+	struct Hierarchy {
+		EntityRef entity;
+		EntityPtr parent;
+		EntityPtr first_child;
+		EntityPtr next_sibling;
+		Transform local_transform;
+	};
+
+	WorldTemplate(IAllocator& allocator);
+	void clear();
+	// reads what World::serialize wrote
+	void deserialize(struct InputMemoryStream& serializer, bool vec3_scale);
+
+	// max index of serialized entities + 1
+	u32 map_size = 0;
+	// serialized entities, transforms[i] belongs to entities[i]
+	Array<EntityRef> entities;
+	Array<Transform> transforms;
+	Array<Name> names;
+	Array<Hierarchy> hierarchy;
+};
+
 struct LUMIX_ENGINE_API ComponentUID final {
 	ComponentUID() {
 		scene = nullptr;
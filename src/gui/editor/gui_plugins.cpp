@@ -51,6 +51,8 @@ struct SpritePlugin final : AssetBrowser::Plugin, AssetCompiler::IPlugin
 		return m_app.getAssetCompiler().copyCompile(src);
 	}
 
+	bool canCompileInParallel() const override { return true; }
+
 	bool canCreateResource() const override { return true; }
 	const char* getDefaultExtension() const override { return "spr"; }
 
@@ -919,14 +921,17 @@ struct StudioAppPlugin : StudioApp::IPlugin
 
 
 	void init() override {
+		const char* sprite_exts[] = {"spr", nullptr};
+		m_app.getAssetCompiler().addPlugin(m_sprite_plugin, sprite_exts);
+
+		// no GPU device for the editor's pipeline
+		if (m_app.isHeadless()) return;
+
 		m_gui_editor.init();
 
 		m_app.addPlugin(m_gui_editor);
 
 		m_app.getAssetBrowser().addPlugin(m_sprite_plugin);
-
-		const char* sprite_exts[] = {"spr", nullptr};
-		m_app.getAssetCompiler().addPlugin(m_sprite_plugin, sprite_exts);
 	}
 
 	bool showGizmo(WorldView&, ComponentUID) override { return false; }
@@ -91,13 +91,13 @@ struct NavigationSceneImpl final : NavigationScene
 		, m_zones(m_allocator)
 		, m_script_scene(nullptr)
 	{
-		m_world.entityTransformed().bind<&NavigationSceneImpl::onEntityMoved>(this);
+		m_world.entitiesTransformed().bind<&NavigationSceneImpl::onEntitiesMoved>(this);
 	}
 
 
 	~NavigationSceneImpl()
 	{
-		m_world.entityTransformed().unbind<&NavigationSceneImpl::onEntityMoved>(this);
+		m_world.entitiesTransformed().unbind<&NavigationSceneImpl::onEntitiesMoved>(this);
 	}
 
 
@@ -111,6 +111,13 @@ struct NavigationSceneImpl final : NavigationScene
 	}
 
 
+	void onEntitiesMoved(Span<const EntityRef> entities)
+	{
+		if (m_agents.empty()) return;
+		for (EntityRef e : entities) onEntityMoved(e);
+	}
+
+
 	void onEntityMoved(EntityRef entity)
 	{
 		auto iter = m_agents.find(entity);
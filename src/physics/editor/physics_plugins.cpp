@@ -879,6 +879,8 @@ struct PhysicsMaterialPlugin final : AssetBrowser::Plugin, AssetCompiler::IPlugi
 		return m_app.getAssetCompiler().copyCompile(src);
 	}
 
+	bool canCompileInParallel() const override { return true; }
+
 	bool save(PhysicsMaterial* mat) {
 		FileSystem& fs = m_app.getEngine().getFileSystem();
 	
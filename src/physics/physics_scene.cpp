@@ -34,6 +34,7 @@
 #include "animation/animation_scene.h"
 #include "engine/associative_array.h"
 #include "engine/atomic.h"
+#include "engine/component_pool.h"
 #include "engine/engine.h"
 #include "engine/hash.h"
 #include "engine/job_system.h"
@@ -1693,14 +1694,17 @@ struct PhysicsSceneImpl final : PhysicsScene
 	void updateDynamicActors(bool vehicles)
 	{
 		PROFILE_FUNCTION();
+		// children and listeners are updated once for all actors in flushTransforms
+		m_world.deferTransforms();
 		for (EntityRef e : m_dynamic_actors)
 		{
 			RigidActor& actor = m_actors[e];
-			m_update_in_progress = &actor;
 			PxTransform trans = actor.physx_actor->getGlobalPose();
 			m_world.setTransform(actor.entity, fromPhysx(trans));
 		}
-		m_update_in_progress = nullptr;
+		m_is_updating_dynamic_actors = true;
+		m_world.flushTransforms();
+		m_is_updating_dynamic_actors = false;
 
 		if (!vehicles) return;
 
@@ -2431,6 +2435,12 @@ struct PhysicsSceneImpl final : PhysicsScene
 		}
 	}
 
+	void onEntitiesMoved(Span<const EntityRef> entities)
+	{
+		for (EntityRef e : entities) onEntityMoved(e);
+	}
+
+
 	void onEntityMoved(EntityRef entity)
 	{
 		const u64 cmp_mask = m_world.getComponentsMask(entity);
@@ -2451,7 +2461,9 @@ struct PhysicsSceneImpl final : PhysicsScene
 			auto iter = m_actors.find(entity);
 			if (iter.isValid()) {
 				RigidActor& actor = iter.value();
-				if (actor.physx_actor && m_update_in_progress != &actor)
+				// dynamic actors were just moved by physx
+				const bool from_physx = m_is_updating_dynamic_actors && actor.dynamic_type == DynamicType::DYNAMIC;
+				if (actor.physx_actor && !from_physx)
 				{
 					Transform trans = m_world.getTransform(entity);
 					if (actor.dynamic_type == DynamicType::KINEMATIC)
@@ -3780,10 +3792,10 @@ struct PhysicsSceneImpl final : PhysicsScene
 	PxMaterial* m_default_material;
 	FilterCallback m_filter_callback;
 
-	HashMap<EntityRef, RigidActor> m_actors;
+	ComponentPool<RigidActor> m_actors;
 	HashMap<PhysicsGeometry*, EntityRef> m_resource_actor_map;
 	AssociativeArray<EntityRef, Joint> m_joints;
-	HashMap<EntityRef, Controller> m_controllers;
+	ComponentPool<Controller> m_controllers;
 	HashMap<EntityRef, Heightfield> m_terrains;
 	HashMap<EntityRef, UniquePtr<Vehicle>> m_vehicles;
 	HashMap<EntityRef, Wheel> m_wheels;
@@ -3796,7 +3808,7 @@ struct PhysicsSceneImpl final : PhysicsScene
 	u64 m_physics_cmps_mask;
 
 	Array<EntityRef> m_dynamic_actors;
-	RigidActor* m_update_in_progress;
+	bool m_is_updating_dynamic_actors = false;
 	DelegateList<void(const ContactData&)> m_contact_callbacks;
 	bool m_is_game_running;
 	u32 m_debug_visualization_flags;
@@ -3822,7 +3834,6 @@ PhysicsSceneImpl::PhysicsSceneImpl(Engine& engine, World& context, PhysicsSystem
 	, m_joints(m_allocator)
 	, m_script_scene(nullptr)
 	, m_debug_visualization_flags(0)
-	, m_update_in_progress(nullptr)
 	, m_vehicle_batch_query(nullptr)
 	, m_system(&system)
 	, m_hit_report(*this)
@@ -3845,7 +3856,7 @@ PhysicsSceneImpl::PhysicsSceneImpl(Engine& engine, World& context, PhysicsSystem
 UniquePtr<PhysicsScene> PhysicsScene::create(PhysicsSystem& system, World& context, Engine& engine, IAllocator& allocator)
 {
 	PhysicsSceneImpl* impl = LUMIX_NEW(allocator, PhysicsSceneImpl)(engine, context, system, allocator);
-	impl->m_world.entityTransformed().bind<&PhysicsSceneImpl::onEntityMoved>(impl);
+	impl->m_world.entitiesTransformed().bind<&PhysicsSceneImpl::onEntitiesMoved>(impl);
 	impl->m_world.entityDestroyed().bind<&PhysicsSceneImpl::onEntityDestroyed>(impl);
 	PxSceneDesc sceneDesc(system.getPhysics()->getTolerancesScale());
 	sceneDesc.gravity = PxVec3(0.0f, -9.8f, 0.0f);
@@ -0,0 +1,147 @@
+#include "renderer/bvh.h"
+#include "engine/profiler.h"
+
+
+namespace Lumix
+{
+
+
+BVH::BVH(IAllocator& allocator)
+	: m_allocator(allocator)
+	, m_nodes(allocator)
+	, m_items(allocator)
+	, m_parents(allocator)
+	, m_item_leaves(allocator)
+{}
+
+
+void BVH::clear() {
+	m_nodes.clear();
+	m_items.clear();
+	m_parents.clear();
+	m_item_leaves.clear();
+}
+
+
+void BVH::build(Span<const AABB> bounds) {
+	PROFILE_FUNCTION();
+	clear();
+	const u32 count = bounds.length();
+	if (count == 0) return;
+
+	m_items.resize(count);
+	for (u32 i = 0; i < count; ++i) m_items[i] = i;
+	m_nodes.reserve(2 * (count / MAX_LEAF_SIZE + 1));
+	m_parents.reserve(m_nodes.capacity());
+	m_item_leaves.resize(count);
+
+	struct Range {
+		u32 node;
+		u32 begin;
+		u32 end;
+		u32 depth;
+	};
+
+	Array<Range> stack(m_allocator);
+	stack.reserve(MAX_DEPTH * 2);
+	m_nodes.emplace();
+	m_parents.push(INVALID_NODE);
+	stack.push({0, 0, count, 0});
+
+	while (!stack.empty()) {
+		const Range range = stack.back();
+		stack.pop();
+
+		AABB box = bounds[m_items[range.begin]];
+		AABB centroids(box.min + box.max, box.min + box.max);
+		for (u32 i = range.begin + 1; i < range.end; ++i) {
+			const AABB& b = bounds[m_items[i]];
+			box.merge(b);
+			centroids.addPoint(b.min + b.max);
+		}
+
+		Node& node = m_nodes[range.node];
+		node.min = box.min;
+		node.max = box.max;
+		node.first = range.begin;
+		node.count = range.end - range.begin;
+		if (node.count <= MAX_LEAF_SIZE) {
+			for (u32 i = range.begin; i < range.end; ++i) m_item_leaves[m_items[i]] = range.node;
+			continue;
+		}
+
+		// split in the middle of the longest axis of centroids
+		const Vec3 extent = centroids.max - centroids.min;
+		const u32 axis = extent.x > extent.y ? (extent.x > extent.z ? 0 : 2) : (extent.y > extent.z ? 1 : 2);
+		const float split = (centroids.min[axis] + centroids.max[axis]) * 0.5f;
+		u32 mid = range.begin;
+		for (u32 i = range.begin; i < range.end; ++i) {
+			const AABB& b = bounds[m_items[i]];
+			if (b.min[axis] + b.max[axis] < split) {
+				swap(m_items[i], m_items[mid]);
+				++mid;
+			}
+		}
+
+		// all centroids on one side or the tree is getting too deep, split in half so the depth stays bounded
+		const bool is_degenerate = mid == range.begin || mid == range.end;
+		if (is_degenerate || range.depth > MAX_DEPTH / 2) {
+			mid = (range.begin + range.end) / 2;
+		}
+
+		const u32 left = m_nodes.size();
+		m_nodes.emplace();
+		m_nodes.emplace();
+		m_parents.push(range.node);
+		m_parents.push(range.node);
+		// `node` might be invalidated by emplace
+		m_nodes[range.node].first = left;
+		m_nodes[range.node].count = 0;
+		stack.push({left, range.begin, mid, range.depth + 1});
+		stack.push({left + 1, mid, range.end, range.depth + 1});
+	}
+}
+
+
+void BVH::refitNode(Span<const AABB> bounds, u32 node_idx) {
+	Node& node = m_nodes[node_idx];
+	AABB box;
+	if (node.count > 0) {
+		box = bounds[m_items[node.first]];
+		for (u32 j = node.first + 1, end = node.first + node.count; j < end; ++j) {
+			box.merge(bounds[m_items[j]]);
+		}
+	}
+	else {
+		const Node& l = m_nodes[node.first];
+		const Node& r = m_nodes[node.first + 1];
+		box.min = minimum(l.min, r.min);
+		box.max = maximum(l.max, r.max);
+	}
+	node.min = box.min;
+	node.max = box.max;
+}
+
+
+void BVH::refit(Span<const AABB> bounds) {
+	PROFILE_FUNCTION();
+	ASSERT(bounds.length() == (u32)m_items.size());
+	// children always have greater index than their parent
+	for (i32 i = m_nodes.size() - 1; i >= 0; --i) {
+		refitNode(bounds, i);
+	}
+}
+
+
+void BVH::refit(Span<const AABB> bounds, Span<const u32> items) {
+	PROFILE_FUNCTION();
+	ASSERT(bounds.length() == (u32)m_items.size());
+	for (u32 item : items) {
+		for (u32 node = m_item_leaves[item]; node != INVALID_NODE; node = m_parents[node]) {
+			refitNode(bounds, node);
+		}
+	}
+}
+
+
+} // namespace Lumix
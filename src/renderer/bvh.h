@@ -0,0 +1,117 @@
+#pragma once
+
+
+#include "engine/array.h"
+#include "engine/geometry.h"
+#include "engine/math.h"
+
+
+namespace Lumix
+{
+
+// bounding volume hierarchy over boxes of user items, items are identified by their index in `bounds` passed to build
+struct LUMIX_RENDERER_API BVH {
+	struct Node {
+		Vec3 min;
+		// leaf - index of the first item in m_items, inner node - index of left child, right child is next to it
+		u32 first;
+		Vec3 max;
+		// 0 for inner nodes
+		u32 count;
+	};
+
+	explicit BVH(IAllocator& allocator);
+
+	void build(Span<const AABB> bounds);
+	// updates boxes of nodes after items moved, tree structure does not change
+	// `bounds` must have the same size as in build
+	void refit(Span<const AABB> bounds);
+	// updates only leaves containing `items` and their ancestors
+	void refit(Span<const AABB> bounds, Span<const u32> items);
+	void clear();
+	bool empty() const { return m_nodes.empty(); }
+
+	// calls `f(u32 item, float max_t) -> float` for items whose boxes are hit by the ray closer than `max_t`,
+	// `f` returns new `max_t`, so the traversal can skip everything farther than the closest hit found so far
+	// nearer children are visited first
+	template <typename F>
+	void castRay(const Vec3& origin, const Vec3& dir, float max_t, F&& f) const {
+		if (m_nodes.empty()) return;
+
+		const Vec3 inv_dir(
+			1.f / (dir.x == 0 ? 0.00000001f : dir.x),
+			1.f / (dir.y == 0 ? 0.00000001f : dir.y),
+			1.f / (dir.z == 0 ? 0.00000001f : dir.z));
+
+		u32 stack[MAX_DEPTH + 2];
+		u32 stack_size = 0;
+		float t;
+		if (!intersect(m_nodes[0], origin, inv_dir, max_t, t)) return;
+		stack[stack_size++] = 0;
+
+		while (stack_size > 0) {
+			const Node& node = m_nodes[stack[--stack_size]];
+			// max_t could have changed since node was pushed
+			if (!intersect(node, origin, inv_dir, max_t, t)) continue;
+
+			if (node.count > 0) {
+				for (u32 i = node.first, end = node.first + node.count; i < end; ++i) {
+					max_t = f(m_items[i], max_t);
+				}
+				continue;
+			}
+
+			float t_left, t_right;
+			const bool hit_left = intersect(m_nodes[node.first], origin, inv_dir, max_t, t_left);
+			const bool hit_right = intersect(m_nodes[node.first + 1], origin, inv_dir, max_t, t_right);
+			if (hit_left && hit_right) {
+				// nearer child goes last, so it's popped first
+				if (t_left < t_right) {
+					stack[stack_size++] = node.first + 1;
+					stack[stack_size++] = node.first;
+				}
+				else {
+					stack[stack_size++] = node.first;
+					stack[stack_size++] = node.first + 1;
+				}
+			}
+			else if (hit_left) {
+				stack[stack_size++] = node.first;
+			}
+			else if (hit_right) {
+				stack[stack_size++] = node.first + 1;
+			}
+		}
+	}
+
+	static constexpr u32 MAX_LEAF_SIZE = 4;
+	static constexpr u32 MAX_DEPTH = 64;
+
+	IAllocator& m_allocator;
+	Array<Node> m_nodes;
+	Array<u32> m_items;
+	// parent of each node, INVALID_NODE for root
+	Array<u32> m_parents;
+	// leaf node of each item
+	Array<u32> m_item_leaves;
+	static constexpr u32 INVALID_NODE = 0xffFFffFF;
+
+private:
+	void refitNode(Span<const AABB> bounds, u32 node_idx);
+
+	static LUMIX_FORCE_INLINE bool intersect(const Node& node, const Vec3& origin, const Vec3& inv_dir, float max_t, float& t) {
+		const float tx0 = (node.min.x - origin.x) * inv_dir.x;
+		const float tx1 = (node.max.x - origin.x) * inv_dir.x;
+		const float ty0 = (node.min.y - origin.y) * inv_dir.y;
+		const float ty1 = (node.max.y - origin.y) * inv_dir.y;
+		const float tz0 = (node.min.z - origin.z) * inv_dir.z;
+		const float tz1 = (node.max.z - origin.z) * inv_dir.z;
+		const float tmin = maximum(maximum(minimum(tx0, tx1), minimum(ty0, ty1)), minimum(tz0, tz1), 0.f);
+		const float tmax = minimum(minimum(maximum(tx0, tx1), maximum(ty0, ty1)), maximum(tz0, tz1), max_t);
+		t = tmin;
+		return tmin <= tmax;
+	}
+};
+
+
+} // namespace Lumix
@@ -271,31 +271,26 @@ struct CullingSystemImpl final : CullingSystem
 		const Sphere* LUMIX_RESTRICT end = cell.spheres + cell.header.count;
 		const EntityPtr* LUMIX_RESTRICT sphere_to_entity_map = cell.entities;
 
-		const float4 px = f4Load(frustum.xs);
-		const float4 py = f4Load(frustum.ys);
-		const float4 pz = f4Load(frustum.zs);
-		const float4 pd = f4Load(frustum.ds);
-		const float4 px2 = f4Load(&frustum.xs[4]);
-		const float4 py2 = f4Load(&frustum.ys[4]);
-		const float4 pz2 = f4Load(&frustum.zs[4]);
-		const float4 pd2 = f4Load(&frustum.ds[4]);
+		const float8 px = f8LoadUnaligned(frustum.xs);
+		const float8 py = f8LoadUnaligned(frustum.ys);
+		const float8 pz = f8LoadUnaligned(frustum.zs);
+		const float8 pd = f8LoadUnaligned(frustum.ds);
 		int cursor = results->header.count;
 
 		int i = 0;
 
 		for (const Sphere *sphere = start; sphere < end; ++sphere, ++i) {
-			const float4 cx = f4Splat(sphere->position.x);
-			const float4 cy = f4Splat(sphere->position.y);
-			const float4 cz = f4Splat(sphere->position.z);
-			const float4 r = f4Splat(-sphere->radius);
-
-			float4 t = cx * px + cy * py + cz * pz + pd;
-			t = t - r;
-			if (f4MoveMask(t)) continue;
-
-			t = cx * px2 + cy * py2 + cz * pz2 + pd2;
-			t = t - r;
-			if (f4MoveMask(t)) continue;
+			const float8 cx = f8Splat(sphere->position.x);
+			const float8 cy = f8Splat(sphere->position.y);
+			const float8 cz = f8Splat(sphere->position.z);
+			const float8 r = f8Splat(sphere->radius);
+
+			// all 8 planes at once, signed distance + radius must be >= 0 for each
+			float8 t = f8MulAdd(cx, px, pd);
+			t = f8MulAdd(cy, py, t);
+			t = f8MulAdd(cz, pz, t);
+			t = f8Add(t, r);
+			if (f8MoveMask(t)) continue;
 
 			if(cursor == lengthOf(results->entities)) {
 				results->header.count = cursor;
@@ -1348,11 +1348,11 @@ static float evalCurve(i64 time, const ofbx::AnimationCurve& curve) {
 
 // parent_scale - animated scale is not supported, but we can get rid of static scale if we ignore
 // it in writeSkeleton() and use `parent_scale` in this function
-static void compressPositions(float parent_scale, Array<FBXImporter::Key>& out)
+static void compressPositions(float parent_scale, float error, Array<FBXImporter::Key>& out)
 {
 	if (out.empty()) return;
 
-	const float ERROR = 0; 
+	const float ERROR = error; 
 	Vec3 dir = out[1].pos - out[0].pos;
 	dir *= float(1 / ofbx::fbxTimeToSeconds(out[1].time - out[0].time));
 	u32 prev = 0;
@@ -1373,11 +1373,11 @@ static void compressPositions(float parent_scale, Array<FBXImporter::Key>& out)
 	}
 }
 
-static void compressRotations(Array<FBXImporter::Key>& out)
+static void compressRotations(float error, Array<FBXImporter::Key>& out)
 {
 	if (out.empty()) return;
 
-	const float ERROR = 0; 
+	const float ERROR = error; 
 	u32 prev = 0;
 	for (u32 i = 2; i < (u32)out.size(); ++i) {
 		const float t = float(ofbx::fbxTimeToSeconds(out[prev + 1].time - out[prev].time) / ofbx::fbxTimeToSeconds(out[i].time - out[prev].time));
@@ -1526,6 +1526,37 @@ static bool isBindPosePositionTrack(u32 count, const Array<FBXImporter::Key>& ke
 	return true;
 }
 
+static bool isConstant(Span<const Vec3> values, float error) {
+	for (const Vec3& v : values) {
+		const Vec3 d = v - values[0];
+		if (fabsf(d.x) > error || fabsf(d.y) > error || fabsf(d.z) > error) return false;
+	}
+	return true;
+}
+
+static bool isConstant(Span<const Quat> values, float error) {
+	for (const Quat& v : values) {
+		const Quat& r = values[0];
+		if (fabsf(v.x - r.x) > error || fabsf(v.y - r.y) > error || fabsf(v.z - r.z) > error || fabsf(v.w - r.w) > error) return false;
+	}
+	return true;
+}
+
+static float getAngle(const Quat& a, const Quat& b) {
+	const float d = fabsf(a.x * b.x + a.y * b.y + a.z * b.z + a.w * b.w);
+	return 2 * acosf(minimum(d, 1.f));
+}
+
+// evaluates decoded keyframed curve the same way Animation does
+template <typename T, typename F>
+static T evalDecoded(const Array<u16>& times, const Array<T>& decoded, u16 t, F interpolate) {
+	if (decoded.size() == 1) return decoded[0];
+	u32 idx = 1;
+	while (idx < (u32)times.size() - 1 && times[idx] <= t) ++idx;
+	const float rel_t = float(t - times[idx - 1]) / (times[idx] - times[idx - 1]);
+	return interpolate(decoded[idx - 1], decoded[idx], rel_t);
+}
+
 void FBXImporter::writeAnimations(const char* src, const ImportConfig& cfg)
 {
 	PROFILE_FUNCTION();
@@ -1582,11 +1613,55 @@ void FBXImporter::writeAnimations(const char* src, const ImportConfig& cfg)
 				Array<Key>& keys = all_keys[u32(&bone - m_bones.begin())];
 				ofbx::Object* parent = bone->getParent();
 				const float parent_scale = parent ? (float)getScaleX(parent->getGlobalTransform()) : 1;
-				// TODO skip curves which do not change anything
-				compressRotations(keys);
-				compressPositions(parent_scale, keys);
+				const float pos_error = cfg.anim_translation_error / (parent_scale * cfg.mesh_scale * m_fbx_scale);
+				compressRotations(sinf(cfg.anim_rotation_error * 0.5f), keys);
+				compressPositions(parent_scale, pos_error, keys);
 			}
 
+			// size the curves would have without quantization, for the report
+			u64 raw_size = out_file.size() + sizeof(u32) * 2;
+			float max_translation_error = 0;
+			float max_rotation_error = 0;
+			Array<u16> times(m_allocator);
+			Array<Vec3> positions(m_allocator);
+			Array<Quat> rotations(m_allocator);
+			Array<Vec3> decoded_positions(m_allocator);
+			Array<Quat> decoded_rotations(m_allocator);
+			const u32 curve_header_size = sizeof(BoneNameHash) + sizeof(Animation::CurveType) + sizeof(u32);
+
+			auto write_positions = [&](){
+				Vec3 min = positions[0];
+				Vec3 max = positions[0];
+				for (const Vec3& p : positions) {
+					min = minimum(min, p);
+					max = maximum(max, p);
+				}
+				const Vec3 to_range = (max - min) * (1.f / 0xffFF);
+				write(min);
+				write(to_range);
+				decoded_positions.clear();
+				for (const Vec3& p : positions) {
+					Vec3 decoded;
+					for (u32 i = 0; i < 3; ++i) {
+						const float r = (&to_range.x)[i];
+						const u16 key = r > 0 ? u16(clamp(((&p.x)[i] - (&min.x)[i]) / r + 0.5f, 0.f, float(0xffFF))) : 0;
+						write(key);
+						(&decoded.x)[i] = key * r + (&min.x)[i];
+					}
+					decoded_positions.push(decoded);
+				}
+			};
+
+			auto write_rotations = [&](){
+				decoded_rotations.clear();
+				for (const Quat& r : rotations) {
+					u16 key[3];
+					Animation::quantizeRotation(r, key);
+					write(key);
+					decoded_rotations.push(Animation::dequantizeRotation(key));
+				}
+			};
+
 			const u64 stream_translations_count_pos = out_file.size();
 			u32 translation_curves_count = 0;
 			write(translation_curves_count);
@@ -1619,20 +1694,35 @@ void FBXImporter::writeAnimations(const char* src, const ImportConfig& cfg)
 
 				if (isBindPosePositionTrack(count, keys, bind_pos)) continue;
 			
-				const BoneNameHash name_hash(bone->name);
-				write(name_hash);
-				write(Animation::CurveType::KEYFRAMED);
-				write(count);
-
+				times.clear();
+				positions.clear();
 				for (Key& key : keys) {
 					if ((key.flags & 1) == 0) {
-						write(fbx_to_anim_time(key.time));
+						times.push(fbx_to_anim_time(key.time));
+						positions.push(fixOrientation(key.pos * cfg.mesh_scale * m_fbx_scale));
 					}
 				}
-				for (Key& key : keys) {
-					if ((key.flags & 1) == 0) {
-						write(fixOrientation(key.pos * cfg.mesh_scale * m_fbx_scale));
-					}
+
+				const BoneNameHash name_hash(bone->name);
+				write(name_hash);
+				raw_size += curve_header_size + count * (sizeof(u16) + sizeof(Vec3));
+				if (isConstant(positions, cfg.anim_translation_error)) {
+					write(Animation::CurveType::CONSTANT);
+					write(u32(1));
+					write(positions[0]);
+					decoded_positions.clear();
+					decoded_positions.push(positions[0]);
+				}
+				else {
+					write(Animation::CurveType::KEYFRAMED);
+					write(count);
+					write(times.begin(), times.byte_size());
+					write_positions();
+				}
+
+				for (const Key& key : keys) {
+					const Vec3 p = evalDecoded(times, decoded_positions, fbx_to_anim_time(key.time), [](const Vec3& a, const Vec3& b, float t){ return lerp(a, b, t); });
+					max_translation_error = maximum(max_translation_error, length(p - fixOrientation(key.pos * cfg.mesh_scale * m_fbx_scale)));
 				}
 				++translation_curves_count;
 			}
@@ -1672,27 +1762,56 @@ void FBXImporter::writeAnimations(const char* src, const ImportConfig& cfg)
 
 				const BoneNameHash name_hash(bone->name);
 				write(name_hash);
-				if (shouldSample(count, float(anim_len), fps, sizeof(Quat))) {
-					write(Animation::CurveType::SAMPLED);
+				times.clear();
+				rotations.clear();
+				const bool sampled = shouldSample(count, float(anim_len), fps, sizeof(Quat));
+				if (sampled) {
 					count = u32(anim_len * fps + 0.5f);
-					write(count);
 					for (u32 i = 0; i < count; ++i) {
 						const float t = float(anim_len * ((float)i / (count - 1)));
-						write(fixOrientation(sample(*bone, *layer, t + from_frame / fps).rot));
+						rotations.push(fixOrientation(sample(*bone, *layer, t + from_frame / fps).rot));
 					}
+					raw_size += curve_header_size + count * sizeof(Quat);
 				}
 				else {
-					write(Animation::CurveType::KEYFRAMED);
-					write(count);
 					for (Key& key : keys) {
 						if ((key.flags & 2) == 0) {
-							write(fbx_to_anim_time(key.time));
+							times.push(fbx_to_anim_time(key.time));
+							rotations.push(fixOrientation(key.rot));
 						}
 					}
-					for (Key& key : keys) {
-						if ((key.flags & 2) == 0) {
-							write(fixOrientation(key.rot));
-						}
+					raw_size += curve_header_size + count * (sizeof(u16) + sizeof(Quat));
+				}
+
+				if (isConstant(rotations, sinf(cfg.anim_rotation_error * 0.5f))) {
+					write(Animation::CurveType::CONSTANT);
+					write(u32(1));
+					write(rotations[0]);
+					decoded_rotations.clear();
+					decoded_rotations.push(rotations[0]);
+				}
+				else if (sampled) {
+					write(Animation::CurveType::SAMPLED);
+					write(count);
+					write_rotations();
+				}
+				else {
+					write(Animation::CurveType::KEYFRAMED);
+					write(count);
+					write(times.begin(), times.byte_size());
+					write_rotations();
+				}
+
+				if (sampled) {
+					for (u32 i = 0; i < count; ++i) {
+						const Quat& decoded = decoded_rotations.size() == 1 ? decoded_rotations[0] : decoded_rotations[i];
+						max_rotation_error = maximum(max_rotation_error, getAngle(decoded, rotations[i]));
+					}
+				}
+				else {
+					for (const Key& key : keys) {
+						const Quat r = evalDecoded(times, decoded_rotations, fbx_to_anim_time(key.time), [](const Quat& a, const Quat& b, float t){ return nlerp(a, b, t); });
+						max_rotation_error = maximum(max_rotation_error, getAngle(r, fixOrientation(key.rot)));
 					}
 				}
 				++rotation_curves_count;
@@ -1701,6 +1820,8 @@ void FBXImporter::writeAnimations(const char* src, const ImportConfig& cfg)
 			memcpy(out_file.getMutableData() + stream_rotations_count_pos, &rotation_curves_count, sizeof(rotation_curves_count));
 
 			const StaticString<LUMIX_MAX_PATH> anim_path(name, ".ani:", src);
+			logInfo(anim_path, ": ", out_file.size(), " B (", raw_size, " B unquantized), max error ", max_translation_error
+				, " (translation), ", radiansToDegrees(max_rotation_error), " deg (rotation)");
 			m_compiler.writeCompiledResource(anim_path, Span(out_file.data(), (i32)out_file.size()));
 		};
 		if (cfg.clips.length() == 0) {
@@ -49,6 +49,9 @@ struct FBXImporter
 		float autolod_coefs[4] = { 0.75f, 0.5f, 0.25f, 0.125f };
 		u8 autolod_mask = 0;
 		float bounding_scale = 1.f;
+		// max allowed error of animation curves, translation in model units, rotation in radians
+		float anim_translation_error = 0.f;
+		float anim_rotation_error = 0.f;
 		Span<const Clip> clips;
 
 	};
@@ -657,6 +657,8 @@ struct FontPlugin final : AssetBrowser::Plugin, AssetCompiler::IPlugin
 		return m_app.getAssetCompiler().copyCompile(src);
 	}
 
+	bool canCompileInParallel() const override { return true; }
+
 	bool onGUI(Span<Resource*> resources) override { return false; }
 	void onResourceUnloaded(Resource* resource) override {}
 	const char* getName() const override { return "Font"; }
@@ -678,6 +680,8 @@ struct PipelinePlugin final : AssetCompiler::IPlugin
 		return m_app.getAssetCompiler().copyCompile(src);
 	}
 
+	bool canCompileInParallel() const override { return true; }
+
 	StudioApp& m_app;
 };
 
@@ -836,6 +840,8 @@ struct MaterialPlugin final : AssetBrowser::Plugin, AssetCompiler::IPlugin
 		return m_app.getAssetCompiler().copyCompile(src);
 	}
 
+	bool canCompileInParallel() const override { return true; }
+
 
 	void saveMaterial(Material* material)
 	{
@@ -1531,6 +1537,8 @@ struct TexturePlugin final : AssetBrowser::Plugin, AssetCompiler::IPlugin
 		return m_app.getAssetCompiler().writeCompiledResource(src.c_str(), Span(out.data(), (i32)out.size()));
 	}
 
+	bool canCompileInParallel() const override { return true; }
+
 	const char* toString(Meta::Filter filter) {
 		switch (filter) {
 			case Meta::Filter::POINT: return "point";
@@ -1849,6 +1857,8 @@ struct ModelPlugin final : AssetBrowser::Plugin, AssetCompiler::IPlugin
 		u32 lod_count = 1;
 		float autolod_coefs[4] = { 0.75f, 0.5f, 0.25f, 0.125f };
 		float lods_distances[4] = { 10'000, 0, 0, 0 };
+		float anim_translation_error = 0.f;
+		float anim_rotation_error = 0.f; // degrees
 		FBXImporter::ImportConfig::Origin origin = FBXImporter::ImportConfig::Origin::SOURCE;
 		FBXImporter::ImportConfig::Physics physics = FBXImporter::ImportConfig::Physics::NONE;
 		Array<FBXImporter::ImportConfig::Clip> clips;
@@ -1867,15 +1877,19 @@ struct ModelPlugin final : AssetBrowser::Plugin, AssetCompiler::IPlugin
 		app.getAssetCompiler().registerExtension("fbx", Model::TYPE);
 	}
 
+	// 1 - quantized animations
+	u32 getVersion() const override { return 1; }
+
 
 	~ModelPlugin()
 	{
 		if (m_downscale_program) m_pipeline->getRenderer().getEndFrameDrawStream().destroy(m_downscale_program);
 		jobs::wait(&m_subres_signal);
 		auto& engine = m_app.getEngine();
-		engine.destroyWorld(*m_world);
+		// not initialized in headless studio
+		if (m_world) engine.destroyWorld(*m_world);
 		m_pipeline.reset();
-		engine.destroyWorld(*m_tile.world);
+		if (m_tile.world) engine.destroyWorld(*m_tile.world);
 		m_tile.pipeline.reset();
 	}
 
@@ -1907,6 +1921,8 @@ struct ModelPlugin final : AssetBrowser::Plugin, AssetCompiler::IPlugin
 			LuaWrapper::getOptionalField(L, LUA_GLOBALSINDEX, "import_vertex_colors", &meta.import_vertex_colors);
 			LuaWrapper::getOptionalField(L, LUA_GLOBALSINDEX, "vertex_color_is_ao", &meta.vertex_color_is_ao);
 			LuaWrapper::getOptionalField(L, LUA_GLOBALSINDEX, "lod_count", &meta.lod_count);
+			LuaWrapper::getOptionalField(L, LUA_GLOBALSINDEX, "anim_translation_error", &meta.anim_translation_error);
+			LuaWrapper::getOptionalField(L, LUA_GLOBALSINDEX, "anim_rotation_error", &meta.anim_rotation_error);
 			
 			if (LuaWrapper::getOptionalField(L, LUA_GLOBALSINDEX, "autolod0", &meta.autolod_coefs[0])) meta.autolod_mask |= 1;
 			if (LuaWrapper::getOptionalField(L, LUA_GLOBALSINDEX, "autolod1", &meta.autolod_coefs[1])) meta.autolod_mask |= 2;
@@ -2021,6 +2037,8 @@ struct ModelPlugin final : AssetBrowser::Plugin, AssetCompiler::IPlugin
 		cfg.lod_count = meta.lod_count;
 		memcpy(cfg.lods_distances, meta.lods_distances, sizeof(meta.lods_distances));
 		cfg.create_impostor = meta.create_impostor;
+		cfg.anim_translation_error = meta.anim_translation_error;
+		cfg.anim_rotation_error = degreesToRadians(meta.anim_rotation_error);
 		cfg.clips = meta.clips;
 		const PathInfo src_info(filepath);
 		m_fbx_importer.setSource(filepath, false, meta.force_skin);
@@ -2344,6 +2362,8 @@ struct ModelPlugin final : AssetBrowser::Plugin, AssetCompiler::IPlugin
 		blob.read(m_meta.force_skin);
 		blob.read(m_meta.import_vertex_colors);
 		blob.read(m_meta.vertex_color_is_ao);
+		blob.read(m_meta.anim_translation_error);
+		blob.read(m_meta.anim_rotation_error);
 		blob.read(m_meta.autolod_mask);
 		blob.read(m_meta.lod_count);
 		blob.read(m_meta.autolod_coefs);
@@ -2367,6 +2387,8 @@ struct ModelPlugin final : AssetBrowser::Plugin, AssetCompiler::IPlugin
 		blob.write(m_meta.force_skin);
 		blob.write(m_meta.import_vertex_colors);
 		blob.write(m_meta.vertex_color_is_ao);
+		blob.write(m_meta.anim_translation_error);
+		blob.write(m_meta.anim_rotation_error);
 		blob.write(m_meta.autolod_mask);
 		blob.write(m_meta.lod_count);
 		blob.write(m_meta.autolod_coefs);
@@ -2618,6 +2640,11 @@ struct ModelPlugin final : AssetBrowser::Plugin, AssetCompiler::IPlugin
 				ImGui::EndTable();
 			}
 
+			ImGuiEx::Label("Animation translation error");
+			changed = ImGui::DragFloat("##anim_pos_err", &m_meta.anim_translation_error, 0.001f, 0, FLT_MAX, "%.4f") || changed;
+			ImGuiEx::Label("Animation rotation error (deg)");
+			changed = ImGui::DragFloat("##anim_rot_err", &m_meta.anim_rotation_error, 0.01f, 0, 180, "%.3f") || changed;
+
 			ImGui::NewLine();
 			if (ImGui::BeginTable("clips", 4, ImGuiTableFlags_BordersOuter)) {
 				ImGui::TableSetupColumn("Name");
@@ -2669,6 +2696,9 @@ struct ModelPlugin final : AssetBrowser::Plugin, AssetCompiler::IPlugin
 					.cat("\nimport_vertex_colors = ").cat(m_meta.import_vertex_colors ? "true" : "false")
 					.cat("\nvertex_color_is_ao = ").cat(m_meta.vertex_color_is_ao ? "true" : "false");
 
+				if (m_meta.anim_translation_error > 0) src.cat("\nanim_translation_error = ").cat(m_meta.anim_translation_error);
+				if (m_meta.anim_rotation_error > 0) src.cat("\nanim_rotation_error = ").cat(m_meta.anim_rotation_error);
+
 				if (!m_meta.clips.empty()) {
 					src.cat("\nclips = {");
 					for (const FBXImporter::ImportConfig::Clip& clip : m_meta.clips) {
@@ -3245,6 +3275,8 @@ struct ShaderPlugin final : AssetBrowser::Plugin, AssetCompiler::IPlugin
 		return m_app.getAssetCompiler().copyCompile(src);
 	}
 
+	bool canCompileInParallel() const override { return true; }
+
 	void deserialize(InputMemoryStream& blob) override { ASSERT(false); }
 	void serialize(OutputMemoryStream& blob) override {}
 
@@ -3378,7 +3410,7 @@ struct EnvironmentProbePlugin final : PropertyGrid::IPlugin
 
 	~EnvironmentProbePlugin()
 	{
-		m_ibl_filter_shader->decRefCount();
+		if (m_ibl_filter_shader) m_ibl_filter_shader->decRefCount();
 	}
 
 	void init() {
@@ -5059,11 +5091,6 @@ struct StudioAppPlugin : StudioApp::IPlugin
 			m_app.addToolAction(&m_renderdoc_capture_action);
 		}
 
-		IAllocator& allocator = m_app.getAllocator();
-
-		AddTerrainComponentPlugin* add_terrain_plugin = LUMIX_NEW(allocator, AddTerrainComponentPlugin)(m_composite_texture_editor, m_app);
-		m_app.registerComponent(ICON_FA_MAP, "terrain", *add_terrain_plugin);
-
 		AssetCompiler& asset_compiler = m_app.getAssetCompiler();
 
 		const char* shader_exts[] = {"shd", nullptr};
@@ -5087,6 +5114,18 @@ struct StudioAppPlugin : StudioApp::IPlugin
 
 		const char* fonts_exts[] = {"ttf", nullptr};
 		asset_compiler.addPlugin(m_font_plugin, fonts_exts);
+
+		// particle emitters are compiled by the particle editor
+		m_particle_editor = ParticleEditor::create(m_app);
+		m_particle_emitter_plugin.m_particle_editor = m_particle_editor.get();
+		m_particle_emitter_property_plugin.m_particle_editor = m_particle_editor.get();
+
+		// no GPU device, e.g. -cook, only compilers are needed, the rest creates pipelines and UI
+		if (m_app.isHeadless()) return;
+
+		IAllocator& allocator = m_app.getAllocator();
+		AddTerrainComponentPlugin* add_terrain_plugin = LUMIX_NEW(allocator, AddTerrainComponentPlugin)(m_composite_texture_editor, m_app);
+		m_app.registerComponent(ICON_FA_MAP, "terrain", *add_terrain_plugin);
 		
 		AssetBrowser& asset_browser = m_app.getAssetBrowser();
 		asset_browser.addPlugin(m_model_plugin);
@@ -5115,11 +5154,7 @@ struct StudioAppPlugin : StudioApp::IPlugin
 		m_env_probe_plugin.init();
 		m_model_plugin.init();
 
-		m_particle_editor = ParticleEditor::create(m_app);
 		m_app.addPlugin(*m_particle_editor.get());
-
-		m_particle_emitter_plugin.m_particle_editor = m_particle_editor.get();
-		m_particle_emitter_property_plugin.m_particle_editor = m_particle_editor.get();
 	}
 
 	void captureRenderDoc() { gpu::captureRenderDocFrame(); }
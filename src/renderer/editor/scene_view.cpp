@@ -718,7 +718,7 @@ SceneView::~SceneView()
 	m_app.removeAction(&m_toggle_projection_action);
 	m_editor.setView(nullptr);
 	LUMIX_DELETE(m_app.getAllocator(), m_view);
-	m_debug_shape_shader->decRefCount();
+	if (m_debug_shape_shader) m_debug_shape_shader->decRefCount();
 }
 
 void SceneView::manipulate() {
@@ -94,10 +94,10 @@ private:
 	float m_camera_speed = 0.1f;
 	UniquePtr<Pipeline> m_pipeline;
 	LogUI& m_log_ui;
-	Shader* m_debug_shape_shader;
+	Shader* m_debug_shape_shader = nullptr;
 	
 	WorldEditor& m_editor;
-	struct WorldViewImpl* m_view;
+	struct WorldViewImpl* m_view = nullptr;
 
 	bool m_is_measure_active = false;
 	bool m_is_measure_from_set = false;
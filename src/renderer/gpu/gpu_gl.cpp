@@ -1155,6 +1155,18 @@ void createTexture(TextureHandle handle, u32 w, u32 h, u32 depth, TextureFormat
 	ASSERT(!is_cubemap || !is_3d);
 	ASSERT(debug_name && debug_name[0]);
 
+	if (handle->gl_handle != 0) {
+		// recreated with different size, e.g. streamed texture, bind groups keep using the same handle
+		if (u32(handle->flags & TextureFlags::RENDER_TARGET)) {
+			gl->render_target_allocated_mem -= handle->bytes_size;
+		}
+		else {
+			gl->texture_allocated_mem -= handle->bytes_size;
+		}
+		glDeleteTextures(1, &handle->gl_handle);
+		handle->gl_handle = 0;
+	}
+
 	GLuint texture;
 	GLenum internal_format = 0;
 	GLenum target = GL_TEXTURE_2D; 
@@ -1,4 +1,5 @@
 #include "renderer/material.h"
+#include "engine/atomic.h"
 #include "engine/engine.h"
 #include "engine/file_system.h"
 #include "engine/hash.h"
@@ -33,6 +34,7 @@ Material::Material(const Path& path, ResourceManager& resource_manager, Renderer
 	: Resource(path, resource_manager, allocator)
 	, m_shader(nullptr)
 	, m_uniforms(allocator)
+	, m_bytecode(allocator)
 	, m_texture_count(0)
 	, m_renderer(renderer)
 	, m_render_states(gpu::StateFlags::CULL_BACK)
@@ -119,6 +121,7 @@ Material::Uniform* Material::findUniform(RuntimeHash name_hash) {
 
 void Material::unload()
 {
+	m_bytecode.free();
 	m_uniforms.clear();
 	for (u32 i = 0; i < m_texture_count; i++) {
 		if (m_textures[i]) {
@@ -439,6 +442,26 @@ Texture* Material::getTextureByName(const char* name) const
 }
 
 
+void Material::requestTextureSize(u32 screen_size)
+{
+	// called for every rendered mesh, so do not write if it would not change anything
+	for (;;) {
+		const i32 prev = m_requested_texture_size;
+		if (prev >= (i32)screen_size) return;
+		if (compareAndExchange(&m_requested_texture_size, (i32)screen_size, prev)) return;
+	}
+}
+
+
+u32 Material::consumeRequestedTextureSize()
+{
+	for (;;) {
+		const i32 prev = m_requested_texture_size;
+		if (prev == 0 || compareAndExchange(&m_requested_texture_size, 0, prev)) return (u32)prev;
+	}
+}
+
+
 bool Material::isTextureDefine(u8 define_idx) const
 {
 	if (!m_shader) return false;
@@ -690,6 +713,26 @@ void Material::setWireframe(bool enable) {
 }
 
 bool Material::load(u64 size, const u8* mem)
+{
+	return execute(Span((const char*)mem, (u32)size));
+}
+
+// lua script can not run on a worker, since it uses manager's lua state and loads other resources,
+// so we only compile it there
+bool Material::prepare(u64 size, const u8* mem)
+{
+	PROFILE_FUNCTION();
+	return LuaWrapper::compile(Span((const char*)mem, (u32)size), getPath().c_str(), m_bytecode);
+}
+
+bool Material::finalize(u64 size, const u8* mem)
+{
+	const bool res = execute(Span((const char*)m_bytecode.data(), (u32)m_bytecode.size()));
+	m_bytecode.free();
+	return res;
+}
+
+bool Material::execute(Span<const char> content)
 {
 	PROFILE_FUNCTION();
 
@@ -700,7 +743,6 @@ bool Material::load(u64 size, const u8* mem)
 	m_render_states = gpu::StateFlags::CULL_BACK;
 	m_custom_flags = 0;
 
-	const Span<const char> content((const char*)mem, (u32)size);
 	if (!LuaWrapper::execute(L, content, getPath().c_str(), 0)) {
 		return false;
 	}
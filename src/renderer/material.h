@@ -6,6 +6,7 @@
 #include "engine/resource.h"
 #include "engine/resource_manager.h"
 #include "engine/math.h"
+#include "engine/stream.h"
 #include "gpu/gpu.h"
 
 
@@ -99,6 +100,10 @@ struct LUMIX_RENDERER_API Material final : Resource {
 	static int getCustomFlagCount();
 	void updateRenderData(bool on_before_ready);
 	Array<Uniform>& getUniforms() { return m_uniforms; }
+	// thread-safe, keeps the biggest size in pixels the material is rendered with, used by TextureStreamer
+	void requestTextureSize(u32 screen_size);
+	// returns the biggest requested size since the last call and resets it
+	u32 consumeRequestedTextureSize();
 
 	void deserialize(struct InputMemoryStream& blob);
 	void serialize(struct OutputMemoryStream& blob);
@@ -110,6 +115,9 @@ private:
 	void onBeforeReady() override;
 	void unload() override;
 	bool load(u64 size, const u8* mem) override;
+	bool prepare(u64 size, const u8* mem) override;
+	bool finalize(u64 size, const u8* mem) override;
+	bool execute(Span<const char> content);
 
 	static int uniform(lua_State* L);
 	static int int_uniform(lua_State* L);
@@ -125,6 +133,9 @@ private:
 
 	Array<Uniform> m_uniforms;
 	u32 m_custom_flags;
+	// compiled by prepare, executed by finalize
+	OutputMemoryStream m_bytecode;
+	volatile i32 m_requested_texture_size = 0;
 };
 
 } // namespace Lumix
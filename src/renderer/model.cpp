@@ -1,6 +1,7 @@
 #include "engine/lumix.h"
 
 #include "engine/array.h"
+#include "engine/atomic.h"
 #include "engine/crt.h"
 #include "engine/file_system.h"
 #include "engine/hash.h"
@@ -82,15 +83,6 @@ Mesh::~Mesh() {
 	renderer.freeSortKey(sort_key);
 }
 
-static bool hasAttribute(Mesh& mesh, Mesh::AttributeSemantic attribute)
-{
-	for(const Mesh::AttributeSemantic& attr : mesh.attributes_semantic) {
-		if(attr == attribute) return true;
-	}
-	return false;
-}
-
-
 void Mesh::setMaterial(Material* new_material, Model& model, Renderer& renderer)
 {
 	if (material) material->decRefCount();
@@ -109,7 +101,12 @@ Model::Model(const Path& path, ResourceManager& resource_manager, Renderer& rend
 	, m_meshes(m_allocator)
 	, m_bones(m_allocator)
 	, m_first_nonroot_bone_index(0)
+	, m_bones_by_depth(m_allocator)
+	, m_bone_depth_offsets(m_allocator)
 	, m_renderer(renderer)
+	, m_bvh(m_allocator)
+	, m_bvh_mesh_offsets(m_allocator)
+	, m_prepared_meshes(m_allocator)
 {
 	for (LODMeshIndices& i : m_lod_indices) i = {0, -1};
 	for (float & i : m_lod_distances) i = FLT_MAX;
@@ -152,6 +149,93 @@ bool Model::isSkinned() const
 }
 
 
+// M is Mesh or Model::PreparedMesh
+template <typename M>
+static void getTriangle(const M& mesh, u32 triangle, Vec3& p0, Vec3& p1, Vec3& p2, u32* indices) {
+	const u32 i = triangle * 3;
+	if (mesh.flags.isSet(Mesh::Flags::INDICES_16_BIT)) {
+		const u16* indices16 = (const u16*)mesh.indices.data();
+		indices[0] = indices16[i];
+		indices[1] = indices16[i + 1];
+		indices[2] = indices16[i + 2];
+	}
+	else {
+		const u32* indices32 = (const u32*)mesh.indices.data();
+		indices[0] = indices32[i];
+		indices[1] = indices32[i + 1];
+		indices[2] = indices32[i + 2];
+	}
+	p0 = mesh.vertices[indices[0]];
+	p1 = mesh.vertices[indices[1]];
+	p2 = mesh.vertices[indices[2]];
+}
+
+
+template <typename M>
+static u32 getTriangleCount(const M& mesh) {
+	const u32 index_size = mesh.flags.isSet(Mesh::Flags::INDICES_16_BIT) ? 2 : 4;
+	return u32(mesh.indices.size() / index_size / 3);
+}
+
+
+static bool castRayTriangle(const Vec3& origin, const Vec3& dir, const Vec3& p0, const Vec3& p1, const Vec3& p2, float& out_t) {
+	Vec3 normal = cross(p1 - p0, p2 - p0);
+	float q = dot(normal, dir);
+	if (q == 0)	return false;
+
+	float d = -dot(normal, p0);
+	float t = -(dot(normal, origin) + d) / q;
+	if (t < 0) return false;
+
+	Vec3 hit_point = origin + dir * t;
+
+	Vec3 edge0 = p1 - p0;
+	Vec3 VP0 = hit_point - p0;
+	if (dot(normal, cross(edge0, VP0)) < 0) return false;
+
+	Vec3 edge1 = p2 - p1;
+	Vec3 VP1 = hit_point - p1;
+	if (dot(normal, cross(edge1, VP1)) < 0) return false;
+
+	Vec3 edge2 = p0 - p2;
+	Vec3 VP2 = hit_point - p2;
+	if (dot(normal, cross(edge2, VP2)) < 0) return false;
+
+	out_t = t;
+	return true;
+}
+
+
+void Model::buildBVH() {
+	PROFILE_FUNCTION();
+	m_bvh.clear();
+	m_bvh_mesh_offsets.clear();
+
+	// called from prepare, before meshes are created
+	u32 triangle_count = 0;
+	for (int mesh_index = m_lod_indices[0].from; mesh_index <= m_lod_indices[0].to; ++mesh_index) {
+		m_bvh_mesh_offsets.push(triangle_count);
+		triangle_count += getTriangleCount(m_prepared_meshes[mesh_index]);
+	}
+	if (triangle_count == 0) return;
+
+	Array<AABB> bounds(m_allocator);
+	bounds.reserve(triangle_count);
+	for (int mesh_index = m_lod_indices[0].from; mesh_index <= m_lod_indices[0].to; ++mesh_index) {
+		const PreparedMesh& mesh = m_prepared_meshes[mesh_index];
+		for (u32 i = 0, c = getTriangleCount(mesh); i < c; ++i) {
+			Vec3 p0, p1, p2;
+			u32 indices[3];
+			getTriangle(mesh, i, p0, p1, p2, indices);
+			AABB& aabb = bounds.emplace(p0, p0);
+			aabb.addPoint(p1);
+			aabb.addPoint(p2);
+		}
+	}
+	m_bvh.build(bounds);
+}
+
+
 RayCastModelHit Model::castRay(const Vec3& origin, const Vec3& dir, const Pose* pose, EntityPtr entity, const RayCastModelHit::Filter* filter)
 {
 	static const ComponentType MODEL_INSTANCE_TYPE = reflection::getComponentType("model_instance");
@@ -160,13 +244,45 @@ RayCastModelHit Model::castRay(const Vec3& origin, const Vec3& dir, const Pose*
 	hit.is_hit = false;
 	if (!isReady()) return hit;
 
-	Matrix matrices[256];
-	ASSERT(!pose || pose->count <= lengthOf(matrices));
+	auto on_triangle_hit = [&](float t, u32 mesh_index) {
+		if (hit.is_hit && hit.t <= t) return;
+		
+		RayCastModelHit prev = hit;
+		hit.is_hit = true;
+		hit.t = t;
+		hit.entity = entity;
+		hit.mesh = &m_meshes[mesh_index];
+		hit.component_type = MODEL_INSTANCE_TYPE;
+		if (filter && !filter->invoke(hit)) hit = prev;
+	};
+
 	bool is_skinned = false;
-	for (int mesh_index = m_lod_indices[0].from; mesh_index <= m_lod_indices[0].to; ++mesh_index) {
-		Mesh& mesh = m_meshes[mesh_index];
-		is_skinned = pose && !mesh.skin.empty() && pose->count <= lengthOf(matrices);
+	if (pose && pose->count <= 256) {
+		for (int mesh_index = m_lod_indices[0].from; mesh_index <= m_lod_indices[0].to; ++mesh_index) {
+			is_skinned = is_skinned || !m_meshes[mesh_index].skin.empty();
+		}
 	}
+
+	if (!is_skinned && !m_bvh.empty()) {
+		m_bvh.castRay(origin, dir, FLT_MAX, [&](u32 triangle, float max_t) -> float {
+			u32 lod_mesh = m_bvh_mesh_offsets.size() - 1;
+			while (m_bvh_mesh_offsets[lod_mesh] > triangle) --lod_mesh;
+			const u32 mesh_index = m_lod_indices[0].from + lod_mesh;
+
+			Vec3 p0, p1, p2;
+			u32 indices[3];
+			getTriangle(m_meshes[mesh_index], triangle - m_bvh_mesh_offsets[lod_mesh], p0, p1, p2, indices);
+			float t;
+			if (castRayTriangle(origin, dir, p0, p1, p2, t)) on_triangle_hit(t, mesh_index);
+			return hit.is_hit ? minimum(hit.t, max_t) : max_t;
+		});
+		hit.origin = DVec3(origin.x, origin.y, origin.z);
+		hit.dir = dir;
+		return hit;
+	}
+
+	// skinned meshes are transformed by pose, which changes every frame, so we can not use BVH
+	Matrix matrices[256];
 	if (is_skinned) {
 		computeSkinMatrices(*pose, *this, matrices);
 	}
@@ -174,66 +290,19 @@ RayCastModelHit Model::castRay(const Vec3& origin, const Vec3& dir, const Pose*
 	for (int mesh_index = m_lod_indices[0].from; mesh_index <= m_lod_indices[0].to; ++mesh_index) {
 		const Mesh& mesh = m_meshes[mesh_index];
 		const bool is_mesh_skinned = !mesh.skin.empty() && is_skinned;
-		const u16* indices16 = (const u16*)mesh.indices.data();
-		const u32* indices32 = (const u32*)mesh.indices.data();
-		const bool is16 = mesh.flags.isSet(Mesh::Flags::INDICES_16_BIT);
-		const int index_size = is16 ? 2 : 4;
-		const Vec3* vertices = mesh.vertices.begin();
 		
-		for (i32 i = 0, c = (i32)mesh.indices.size() / index_size; i < c; i += 3) {
+		for (u32 i = 0, c = getTriangleCount(mesh); i < c; ++i) {
 			Vec3 p0, p1, p2;
-			if (is16) {
-				p0 = vertices[indices16[i]];
-				p1 = vertices[indices16[i + 1]];
-				p2 = vertices[indices16[i + 2]];
-				if (is_mesh_skinned) {
-					p0 = evaluateSkin(p0, mesh.skin[indices16[i]], matrices);
-					p1 = evaluateSkin(p1, mesh.skin[indices16[i + 1]], matrices);
-					p2 = evaluateSkin(p2, mesh.skin[indices16[i + 2]], matrices);
-				}
-			} else {
-				p0 = vertices[indices32[i]];
-				p1 = vertices[indices32[i + 1]];
-				p2 = vertices[indices32[i + 2]];
-				if (is_mesh_skinned) {
-					p0 = evaluateSkin(p0, mesh.skin[indices32[i]], matrices);
-					p1 = evaluateSkin(p1, mesh.skin[indices32[i + 1]], matrices);
-					p2 = evaluateSkin(p2, mesh.skin[indices32[i + 2]], matrices);
-				}
+			u32 indices[3];
+			getTriangle(mesh, i, p0, p1, p2, indices);
+			if (is_mesh_skinned) {
+				p0 = evaluateSkin(p0, mesh.skin[indices[0]], matrices);
+				p1 = evaluateSkin(p1, mesh.skin[indices[1]], matrices);
+				p2 = evaluateSkin(p2, mesh.skin[indices[2]], matrices);
 			}
 
-			Vec3 normal = cross(p1 - p0, p2 - p0);
-			float q = dot(normal, dir);
-			if (q == 0)	continue;
-
-			float d = -dot(normal, p0);
-			float t = -(dot(normal, origin) + d) / q;
-			if (t < 0) continue;
-
-			Vec3 hit_point = origin + dir * t;
-
-			Vec3 edge0 = p1 - p0;
-			Vec3 VP0 = hit_point - p0;
-			if (dot(normal, cross(edge0, VP0)) < 0) continue;
-
-			Vec3 edge1 = p2 - p1;
-			Vec3 VP1 = hit_point - p1;
-			if (dot(normal, cross(edge1, VP1)) < 0) continue;
-
-			Vec3 edge2 = p0 - p2;
-			Vec3 VP2 = hit_point - p2;
-			if (dot(normal, cross(edge2, VP2)) < 0) continue;
-
-			if (!hit.is_hit || hit.t > t)
-			{
-				RayCastModelHit prev = hit;
-				hit.is_hit = true;
-				hit.t = t;
-				hit.entity = entity;
-				hit.mesh = &m_meshes[mesh_index];
-				hit.component_type = MODEL_INSTANCE_TYPE;
-				if (filter && !filter->invoke(hit)) hit = prev;
-			}
+			float t;
+			if (castRayTriangle(origin, dir, p0, p1, p2, t)) on_triangle_hit(t, mesh_index);
 		}
 	}
 	hit.origin = DVec3(origin.x, origin.y, origin.z);
@@ -369,6 +438,9 @@ bool Model::parseBones(InputMemoryStream& file)
 		return false;
 	}
 
+	static volatile i32 bones_version = 0;
+	m_bones_version = (u32)atomicIncrement(&bones_version);
+
 	m_bones.reserve(bone_count);
 	for (int i = 0; i < bone_count; ++i) {
 		Model::Bone& b = m_bones.emplace(m_allocator);
@@ -423,6 +495,25 @@ bool Model::parseBones(InputMemoryStream& file)
 			m_bones[i].relative_transform = m_bones[i].transform;
 		}
 	}
+
+	// parents are before children, so depths can be computed in one pass
+	Array<u32> depths(m_allocator);
+	depths.resize(m_bones.size());
+	u32 max_depth = 0;
+	for (int i = 0; i < m_bones.size(); ++i) {
+		const i32 p = m_bones[i].parent_idx;
+		depths[i] = p < 0 ? 0 : depths[p] + 1;
+		max_depth = maximum(max_depth, depths[i]);
+	}
+	m_bones_by_depth.clear();
+	m_bone_depth_offsets.clear();
+	for (u32 depth = 1; depth <= max_depth; ++depth) {
+		m_bone_depth_offsets.push(m_bones_by_depth.size());
+		for (int i = 0; i < m_bones.size(); ++i) {
+			if (depths[i] == depth) m_bones_by_depth.push((u16)i);
+		}
+	}
+	m_bone_depth_offsets.push(m_bones_by_depth.size());
 	return true;
 }
 
@@ -439,17 +530,26 @@ int Model::getBoneIdx(const char* name)
 }
 
 
-static int getAttributeOffset(Mesh& mesh, Mesh::AttributeSemantic attr)
+static int getAttributeOffset(const gpu::VertexDecl& decl, const Mesh::AttributeSemantic* semantics, Mesh::AttributeSemantic attr)
 {
-	for (u32 i = 0; i < lengthOf(mesh.attributes_semantic); ++i) {
-		if(mesh.attributes_semantic[i] == attr) {
-			return mesh.vertex_decl.attributes[i].byte_offset;
+	for (u32 i = 0; i < decl.attributes_count; ++i) {
+		if(semantics[i] == attr) {
+			return decl.attributes[i].byte_offset;
 		}
 	}
 	return -1;
 }
 
 
+Model::PreparedMesh::PreparedMesh(const gpu::VertexDecl& vertex_decl, IAllocator& allocator)
+	: vertex_decl(vertex_decl)
+	, indices(allocator)
+	, vertices(allocator)
+	, skin(allocator)
+{}
+
+
+// runs on a worker, so meshes are only parsed into m_prepared_meshes, see createMeshes
 bool Model::parseMeshes(InputMemoryStream& file, FileVersion version)
 {
 	int object_count = 0;
@@ -457,7 +557,8 @@ bool Model::parseMeshes(InputMemoryStream& file, FileVersion version)
 	if (object_count <= 0) return false;
 
 	ASSERT(m_meshes.empty());
-	m_meshes.reserve(object_count);
+	ASSERT(m_prepared_meshes.empty());
+	m_prepared_meshes.reserve(object_count);
 	for (int i = 0; i < object_count; ++i)
 	{
 		gpu::VertexDecl vertex_decl(gpu::PrimitiveType::TRIANGLES);
@@ -473,21 +574,22 @@ bool Model::parseMeshes(InputMemoryStream& file, FileVersion version)
 		file.read(mat_path, mat_path_length);
 		mat_path[mat_path_length] = '\0';
 		
-		Material* material = m_resource_manager.getOwner().load<Material>(Path(mat_path));
-	
 		i32 str_size;
 		file.read(str_size);
 		char mesh_name[LUMIX_MAX_PATH];
 		mesh_name[str_size] = 0;
 		file.read(mesh_name, str_size);
 
-		m_meshes.emplace(material, vertex_decl, vb_stride, mesh_name, semantics, m_renderer, m_allocator);
-		addDependency(*material);
+		PreparedMesh& mesh = m_prepared_meshes.emplace(vertex_decl, m_allocator);
+		memcpy(mesh.semantics, semantics, sizeof(semantics));
+		mesh.vb_stride = vb_stride;
+		mesh.material = mat_path;
+		mesh.name = mesh_name;
 	}
 
 	for (int i = 0; i < object_count; ++i)
 	{
-		Mesh& mesh = m_meshes[i];
+		PreparedMesh& mesh = m_prepared_meshes[i];
 		int index_size;
 		int indices_count;
 		file.read(index_size);
@@ -499,24 +601,22 @@ bool Model::parseMeshes(InputMemoryStream& file, FileVersion version)
 		file.read(mesh.indices.getMutableData(), mesh.indices.size());
 
 		if (index_size == 2) mesh.flags.set(Mesh::Flags::INDICES_16_BIT);
-		const Renderer::MemRef mem = m_renderer.copy(mesh.indices.data(), (u32)mesh.indices.size());
-		mesh.index_buffer_handle = m_renderer.createBuffer(mem, gpu::BufferFlags::IMMUTABLE);
-		mesh.index_type = index_size == 2 ? gpu::DataType::U16 : gpu::DataType::U32;
-		if (!mesh.index_buffer_handle) return false;
 	}
 
 	for (int i = 0; i < object_count; ++i)
 	{
-		Mesh& mesh = m_meshes[i];
+		PreparedMesh& mesh = m_prepared_meshes[i];
 		int data_size;
 		file.read(data_size);
 		Renderer::MemRef vertices_mem = m_renderer.allocate(data_size);
+		mesh.vertex_data = vertices_mem.data;
+		mesh.vertex_data_size = data_size;
 		file.read(vertices_mem.data, data_size);
 
-		int position_attribute_offset = getAttributeOffset(mesh, Mesh::AttributeSemantic::POSITION);
-		int weights_attribute_offset = getAttributeOffset(mesh, Mesh::AttributeSemantic::WEIGHTS);
-		int bone_indices_attribute_offset = getAttributeOffset(mesh, Mesh::AttributeSemantic::INDICES);
-		bool keep_skin = hasAttribute(mesh, Mesh::AttributeSemantic::WEIGHTS) && hasAttribute(mesh, Mesh::AttributeSemantic::INDICES);
+		int position_attribute_offset = getAttributeOffset(mesh.vertex_decl, mesh.semantics, Mesh::AttributeSemantic::POSITION);
+		int weights_attribute_offset = getAttributeOffset(mesh.vertex_decl, mesh.semantics, Mesh::AttributeSemantic::WEIGHTS);
+		int bone_indices_attribute_offset = getAttributeOffset(mesh.vertex_decl, mesh.semantics, Mesh::AttributeSemantic::INDICES);
+		bool keep_skin = weights_attribute_offset >= 0 && bone_indices_attribute_offset >= 0;
 
 		int vertex_size = mesh.vb_stride;
 		int mesh_vertex_count = data_size / vertex_size;
@@ -535,8 +635,6 @@ bool Model::parseMeshes(InputMemoryStream& file, FileVersion version)
 			}
 			mesh.vertices[j] = *(const Vec3*)&vertices[offset + position_attribute_offset];
 		}
-		mesh.vertex_buffer_handle = m_renderer.createBuffer(vertices_mem, gpu::BufferFlags::IMMUTABLE);
-		if (!mesh.vertex_buffer_handle) return false;
 	}
 	file.read(m_origin_bounding_radius);
 	file.read(m_center_bounding_radius);
@@ -546,6 +644,53 @@ bool Model::parseMeshes(InputMemoryStream& file, FileVersion version)
 }
 
 
+// runs on the main thread, loads materials and uploads prepared meshes to gpu
+bool Model::createMeshes()
+{
+	PROFILE_FUNCTION();
+	m_meshes.reserve(m_prepared_meshes.size());
+	for (PreparedMesh& prepared : m_prepared_meshes) {
+		Material* material = m_resource_manager.getOwner().load<Material>(prepared.material);
+		Mesh& mesh = m_meshes.emplace(material, prepared.vertex_decl, prepared.vb_stride, prepared.name, prepared.semantics, m_renderer, m_allocator);
+		addDependency(*material);
+
+		mesh.indices = static_cast<OutputMemoryStream&&>(prepared.indices);
+		mesh.indices_count = prepared.indices_count;
+		mesh.flags = prepared.flags;
+		mesh.index_type = mesh.areIndices16() ? gpu::DataType::U16 : gpu::DataType::U32;
+		mesh.vertices = prepared.vertices.move();
+		mesh.skin = prepared.skin.move();
+
+		const Renderer::MemRef indices_mem = m_renderer.copy(mesh.indices.data(), (u32)mesh.indices.size());
+		mesh.index_buffer_handle = m_renderer.createBuffer(indices_mem, gpu::BufferFlags::IMMUTABLE);
+
+		Renderer::MemRef vertices_mem;
+		vertices_mem.data = prepared.vertex_data;
+		vertices_mem.size = prepared.vertex_data_size;
+		vertices_mem.own = true;
+		prepared.vertex_data = nullptr;
+		mesh.vertex_buffer_handle = m_renderer.createBuffer(vertices_mem, gpu::BufferFlags::IMMUTABLE);
+		if (!mesh.index_buffer_handle || !mesh.vertex_buffer_handle) return false;
+	}
+	clearPreparedMeshes();
+	return true;
+}
+
+
+void Model::clearPreparedMeshes()
+{
+	for (PreparedMesh& mesh : m_prepared_meshes) {
+		if (!mesh.vertex_data) continue;
+		Renderer::MemRef mem;
+		mem.data = mesh.vertex_data;
+		mem.size = mesh.vertex_data_size;
+		mem.own = true;
+		m_renderer.free(mem);
+	}
+	m_prepared_meshes.clear();
+}
+
+
 bool Model::parseLODs(InputMemoryStream& file)
 {
 	u32 lod_count;
@@ -570,6 +715,12 @@ bool Model::parseLODs(InputMemoryStream& file)
 
 
 bool Model::load(u64 size, const u8* mem)
+{
+	return prepare(size, mem) && finalize(size, mem);
+}
+
+
+bool Model::prepare(u64 size, const u8* mem)
 {
 	PROFILE_FUNCTION();
 	FileHeader header;
@@ -592,6 +743,7 @@ bool Model::load(u64 size, const u8* mem)
 		&& parseBones(file)
 		&& parseLODs(file))
 	{
+		buildBVH();
 		return true;
 	}
 
@@ -599,6 +751,12 @@ bool Model::load(u64 size, const u8* mem)
 }
 
 
+bool Model::finalize(u64 size, const u8* mem)
+{
+	return createMeshes();
+}
+
+
 void Model::unload()
 {
 	for (int i = 0; i < m_meshes.size(); ++i) {
@@ -614,7 +772,13 @@ void Model::unload()
 		mesh.vertex_buffer_handle = gpu::INVALID_BUFFER;
 	}
 	m_meshes.clear();
+	clearPreparedMeshes();
 	m_bones.clear();
+	m_bone_map.clear();
+	m_bones_by_depth.clear();
+	m_bone_depth_offsets.clear();
+	m_bvh.clear();
+	m_bvh_mesh_offsets.clear();
 }
 
 
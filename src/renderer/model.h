@@ -11,6 +11,7 @@
 #include "engine/stream.h"
 #include "engine/string.h"
 #include "gpu/gpu.h"
+#include "renderer/bvh.h"
 
 
 struct lua_State;
@@ -179,6 +180,12 @@ public:
 	i32 getBoneParent(u32 idx) { return m_bones[idx].parent_idx; }
 	const Bone& getBone(u32 i) const { return m_bones[i]; }
 	int getFirstNonrootBoneIndex() const { return m_first_nonroot_bone_index; }
+	// nonroot bones sorted by depth in hierarchy, bones with the same depth do not depend on each other
+	Span<const u16> getBonesByDepth() const { return m_bones_by_depth; }
+	// ranges in getBonesByDepth() with the same depth, [offsets[i], offsets[i + 1])
+	Span<const u32> getBoneDepthOffsets() const { return m_bone_depth_offsets; }
+	// unique among all models, changes each time bones are loaded, so data derived from bones know when to update
+	u32 getBonesVersion() const { return m_bones_version; }
 	BoneMap::ConstIterator getBoneIndex(BoneNameHash hash) const { return m_bone_map.find(hash); }
 	void getPose(Pose& pose);
 	void getRelativePose(Pose& pose);
@@ -203,10 +210,34 @@ private:
 	bool parseBones(InputMemoryStream& file);
 	bool parseMeshes(InputMemoryStream& file, FileVersion version);
 	bool parseLODs(InputMemoryStream& file);
+	void buildBVH();
+	bool createMeshes();
+	void clearPreparedMeshes();
 	int getBoneIdx(const char* name);
 
 	void unload() override;
 	bool load(u64 size, const u8* mem) override;
+	bool prepare(u64 size, const u8* mem) override;
+	bool finalize(u64 size, const u8* mem) override;
+
+	// mesh parsed by prepare on a worker, meshes can not be created there because they need renderer's sort keys
+	struct PreparedMesh {
+		PreparedMesh(const gpu::VertexDecl& vertex_decl, IAllocator& allocator);
+
+		gpu::VertexDecl vertex_decl;
+		Mesh::AttributeSemantic semantics[gpu::VertexDecl::MAX_ATTRIBUTES];
+		u32 vb_stride;
+		Path material;
+		StaticString<LUMIX_MAX_PATH> name;
+		OutputMemoryStream indices;
+		int indices_count;
+		FlagSet<Mesh::Flags, u8> flags;
+		Array<Vec3> vertices;
+		Array<Mesh::Skin> skin;
+		// allocated by Renderer::allocate, ownership goes to the vertex buffer
+		void* vertex_data = nullptr;
+		u32 vertex_data_size = 0;
+	};
 
 private:
 	IAllocator& m_allocator;
@@ -220,6 +251,14 @@ private:
 	BoneMap m_bone_map;
 	AABB m_aabb;
 	int m_first_nonroot_bone_index;
+	Array<u16> m_bones_by_depth;
+	Array<u32> m_bone_depth_offsets;
+	u32 m_bones_version = 0;
+	// over triangles of LOD0 meshes, used by castRay on models without pose
+	BVH m_bvh;
+	// index of the first triangle of each LOD0 mesh in m_bvh items
+	Array<u32> m_bvh_mesh_offsets;
+	Array<PreparedMesh> m_prepared_meshes;
 };
 
 
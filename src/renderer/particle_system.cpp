@@ -268,6 +268,9 @@ void ParticleEmitter::deserialize(InputMemoryStream& blob, bool has_autodestroy,
 	setResource(res);
 }
 
+// float4 can be a vector type and those lose their attributes as template arguments, so registers are stored as plain floats
+struct alignas(16) RegisterValue { float v[4]; };
+
 static float4* getStream(const ParticleEmitter& emitter
 	, DataStream stream
 	, u32 offset
@@ -377,7 +380,7 @@ struct BinaryHelper {
 
 struct TernaryHelper {
 	static float4 madd(float4 a, float4 b, float4 c) {
-		return f4Add(f4Mul(a, b), c);
+		return f4MulAdd(a, b, c);
 	}
 
 	static float4 mix(float4 a, float4 b, float4 c) {
@@ -459,8 +462,9 @@ bool ParticleEmitter::update(float dt, PageAllocator& allocator)
 	volatile i32 counter = 0;
 	jobs::runOnWorkers([&](){
 		PROFILE_FUNCTION();
-		Array<float4> reg_mem(m_allocator);
-		reg_mem.resize(m_resource->getRegistersCount() * 256);
+		Array<RegisterValue> reg_storage(m_allocator);
+		reg_storage.resize(m_resource->getRegistersCount() * 256);
+		float4* reg_mem = (float4*)reg_storage.begin();
 		for (;;) {
 			const i32 from = atomicAdd(&counter, 1024);
 			if (from >= (i32)m_particles_count) return;
@@ -476,12 +480,12 @@ bool ParticleEmitter::update(float dt, PageAllocator& allocator)
 					case InstructionType::GT: {
 						DataStream dst = ip.read<DataStream>();
 						DataStream op0 = ip.read<DataStream>();
-						const float4* arg0 = getStream(*this, dst, fromf4, reg_mem.begin());
+						const float4* arg0 = getStream(*this, dst, fromf4, reg_mem);
 						const float4* end = arg0 + stepf4;
 						const InstructionType inner_type = ip.read<InstructionType>();
 
 						auto helper = [&](auto f, auto arg1_getter){
-							float4* arg1 = arg1_getter.get(*this, fromf4, stepf4, reg_mem.begin());
+							float4* arg1 = arg1_getter.get(*this, fromf4, stepf4, reg_mem);
 							for (const float4* beg = arg0; arg0 != end; ++arg0) {
 								const float4 tmp = f(*arg0, *arg1);
 								const int m = f4MoveMask(tmp);
@@ -539,7 +543,7 @@ bool ParticleEmitter::update(float dt, PageAllocator& allocator)
 						helper.emitter = this;
 						helper.fromf4 = fromf4;
 						helper.stepf4 = stepf4;
-						helper.reg_mem = reg_mem.begin();
+						helper.reg_mem = reg_mem;
 						const DataStream dst = ip.read<DataStream>();
 						helper.run<f4Mul>(dst, ip);
 					}
@@ -548,7 +552,7 @@ bool ParticleEmitter::update(float dt, PageAllocator& allocator)
 						helper.emitter = this;
 						helper.fromf4 = fromf4;
 						helper.stepf4 = stepf4;
-						helper.reg_mem = reg_mem.begin();
+						helper.reg_mem = reg_mem;
 						const DataStream dst = ip.read<DataStream>();
 						helper.run<f4Div>(dst, ip);
 					}
@@ -557,7 +561,7 @@ bool ParticleEmitter::update(float dt, PageAllocator& allocator)
 						helper.emitter = this;
 						helper.fromf4 = fromf4;
 						helper.stepf4 = stepf4;
-						helper.reg_mem = reg_mem.begin();
+						helper.reg_mem = reg_mem;
 						const DataStream dst = ip.read<DataStream>();
 						helper.run<TernaryHelper::madd>(dst, ip);
 						break;
@@ -567,7 +571,7 @@ bool ParticleEmitter::update(float dt, PageAllocator& allocator)
 						helper.emitter = this;
 						helper.fromf4 = fromf4;
 						helper.stepf4 = stepf4;
-						helper.reg_mem = reg_mem.begin();
+						helper.reg_mem = reg_mem;
 						const DataStream dst = ip.read<DataStream>();
 						helper.run<f4Add>(dst, ip);
 						break;
@@ -575,7 +579,7 @@ bool ParticleEmitter::update(float dt, PageAllocator& allocator)
 					case InstructionType::MOV: {
 						const DataStream dst = ip.read<DataStream>();
 						const DataStream op0 = ip.read<DataStream>();
-						float4* result = getStream(*this, dst, fromf4, reg_mem.begin());
+						float4* result = getStream(*this, dst, fromf4, reg_mem);
 						const float4* const end = result + stepf4;
 				
 						if (op0.type == DataStream::CONST) {
@@ -586,7 +590,7 @@ bool ParticleEmitter::update(float dt, PageAllocator& allocator)
 							}
 						}
 						else {
-							const float4* src = getStream(*this, op0, fromf4, reg_mem.begin());
+							const float4* src = getStream(*this, op0, fromf4, reg_mem);
 
 							for (; result != end; ++result, ++src) {
 								*result = *src;
@@ -598,8 +602,8 @@ bool ParticleEmitter::update(float dt, PageAllocator& allocator)
 					case InstructionType::COS: {
 						const DataStream dst = ip.read<DataStream>();
 						const DataStream op0 = ip.read<DataStream>();
-						const float* arg = (float*)getStream(*this, op0, fromf4, reg_mem.begin());
-						float* result = (float*)getStream(*this, dst, fromf4, reg_mem.begin());
+						const float* arg = (float*)getStream(*this, op0, fromf4, reg_mem);
+						float* result = (float*)getStream(*this, dst, fromf4, reg_mem);
 						const float* const end = result + stepf4 * 4;
 
 						for (; result != end; ++result, ++arg) {
@@ -610,8 +614,8 @@ bool ParticleEmitter::update(float dt, PageAllocator& allocator)
 					case InstructionType::SIN: {
 						const DataStream dst = ip.read<DataStream>();
 						const DataStream op0 = ip.read<DataStream>();
-						const float* arg = (float*)getStream(*this, op0, fromf4, reg_mem.begin());
-						float* result = (float*)getStream(*this, dst, fromf4, reg_mem.begin());
+						const float* arg = (float*)getStream(*this, op0, fromf4, reg_mem);
+						float* result = (float*)getStream(*this, dst, fromf4, reg_mem);
 						const float* const end = result + stepf4 * 4;
 
 						for (; result != end; ++result, ++arg) {
@@ -667,8 +671,9 @@ void ParticleEmitter::fillInstanceData(float* data) const {
 	volatile i32 counter = 0;
 	jobs::runOnWorkers([&](){
 		PROFILE_FUNCTION();
-		Array<float4> reg_mem(m_allocator);
-		reg_mem.resize(m_resource->getRegistersCount() * 256);
+		Array<RegisterValue> reg_storage(m_allocator);
+		reg_storage.resize(m_resource->getRegistersCount() * 256);
+		float4* reg_mem = (float4*)reg_storage.begin();
 		for (;;) {
 			const u32 from = (u32)atomicAdd(&counter, 1024);
 			if (from >= m_particles_count) return;
@@ -684,7 +689,7 @@ void ParticleEmitter::fillInstanceData(float* data) const {
 					case InstructionType::SIN: {
 						DataStream dst_stream = ip.read<DataStream>();
 						DataStream op0 = ip.read<DataStream>();
-						const float* arg = (float*)getStream(*this, op0, fromf4, reg_mem.begin());
+						const float* arg = (float*)getStream(*this, op0, fromf4, reg_mem);
 						
 						if (dst_stream.type == DataStream::OUT) {
 							u8 output_idx = dst_stream.index;
@@ -695,7 +700,7 @@ void ParticleEmitter::fillInstanceData(float* data) const {
 							}
 						}
 						else {
-							float* result = (float*)getStream(*this, dst_stream, fromf4, reg_mem.begin());
+							float* result = (float*)getStream(*this, dst_stream, fromf4, reg_mem);
 							const float* const end = result + stepf4 * 4;
 
 							for (; result != end; ++result, ++arg) {
@@ -707,7 +712,7 @@ void ParticleEmitter::fillInstanceData(float* data) const {
 					case InstructionType::COS: {
 						DataStream dst_stream = ip.read<DataStream>();
 						DataStream op0 = ip.read<DataStream>();
-						const float* arg = (float*)getStream(*this, op0, fromf4, reg_mem.begin());
+						const float* arg = (float*)getStream(*this, op0, fromf4, reg_mem);
 						if (dst_stream.type == DataStream::OUT) {
 							i32 output_idx = dst_stream.index;
 							const u32 stride = m_resource->getOutputsCount();
@@ -717,7 +722,7 @@ void ParticleEmitter::fillInstanceData(float* data) const {
 							}
 						}
 						else {
-							float* result = (float*)getStream(*this, dst_stream, fromf4, reg_mem.begin());
+							float* result = (float*)getStream(*this, dst_stream, fromf4, reg_mem);
 							const float* const end = result + stepf4 * 4;
 
 							for (; result != end; ++result, ++arg) {
@@ -731,7 +736,7 @@ void ParticleEmitter::fillInstanceData(float* data) const {
 						helper.emitter = this;
 						helper.fromf4 = fromf4;
 						helper.stepf4 = stepf4;
-						helper.reg_mem = reg_mem.begin();
+						helper.reg_mem = reg_mem;
 						helper.out_mem = data;
 						DataStream dst = ip.read<DataStream>();
 						helper.run<TernaryHelper::madd>(dst, ip);
@@ -742,7 +747,7 @@ void ParticleEmitter::fillInstanceData(float* data) const {
 						helper.emitter = this;
 						helper.fromf4 = fromf4;
 						helper.stepf4 = stepf4;
-						helper.reg_mem = reg_mem.begin();
+						helper.reg_mem = reg_mem;
 						helper.out_mem = data;
 						DataStream dst = ip.read<DataStream>();
 						helper.run<TernaryHelper::mix>(dst, ip);
@@ -753,7 +758,7 @@ void ParticleEmitter::fillInstanceData(float* data) const {
 						helper.emitter = this;
 						helper.fromf4 = fromf4;
 						helper.stepf4 = stepf4;
-						helper.reg_mem = reg_mem.begin();
+						helper.reg_mem = reg_mem;
 						helper.out_mem = data;
 						DataStream dst = ip.read<DataStream>();
 						helper.run<f4Mul>(dst, ip);
@@ -764,7 +769,7 @@ void ParticleEmitter::fillInstanceData(float* data) const {
 						helper.emitter = this;
 						helper.fromf4 = fromf4;
 						helper.stepf4 = stepf4;
-						helper.reg_mem = reg_mem.begin();
+						helper.reg_mem = reg_mem;
 						helper.out_mem = data;
 						DataStream dst = ip.read<DataStream>();
 						helper.run<f4Div>(dst, ip);
@@ -775,7 +780,7 @@ void ParticleEmitter::fillInstanceData(float* data) const {
 						helper.emitter = this;
 						helper.fromf4 = fromf4;
 						helper.stepf4 = stepf4;
-						helper.reg_mem = reg_mem.begin();
+						helper.reg_mem = reg_mem;
 						helper.out_mem = data;
 						DataStream dst = ip.read<DataStream>();
 						helper.run<f4Add>(dst, ip);
@@ -793,7 +798,7 @@ void ParticleEmitter::fillInstanceData(float* data) const {
 						ASSERT(dst.type == DataStream::OUT);
 						const u8 output_idx = dst.index;
 						const u32 stride = m_resource->getOutputsCount();
-						const float* arg = (float*)getStream(*this, op0, fromf4, reg_mem.begin());
+						const float* arg = (float*)getStream(*this, op0, fromf4, reg_mem);
 						float* out = data + output_idx + fromf4 * 4 * stride;
 						for (u32 i = 0, j = 0; i < stepf4 * 4; ++i, j += stride) {
 							if (arg[i] < keys[0]) {
@@ -830,7 +835,7 @@ void ParticleEmitter::fillInstanceData(float* data) const {
 							}
 						}
 						else {
-							const float* arg = (float*)getStream(*this, op0, fromf4, reg_mem.begin());
+							const float* arg = (float*)getStream(*this, op0, fromf4, reg_mem);
 							ASSERT(dst.type == DataStream::OUT);
 							u8 output_idx = dst.index;
 							float* res = data + output_idx + fromf4 * 4 * stride;
@@ -28,6 +28,7 @@
 #include "particle_system.h"
 #include "pipeline.h"
 #include "pose.h"
+#include "radix_sort.h"
 #include "renderer.h"
 #include "render_scene.h"
 #include "shader.h"
@@ -1630,7 +1631,7 @@ struct PipelineImpl final : Pipeline
 		const gpu::StateFlags render_state = m_render_states[render_state_handle];
 
 		m_renderer.pushJob("terrain", [this, cp, render_state, define_mask](DrawStream& stream){
-			const HashMap<EntityRef, Terrain*>& terrains = m_scene->getTerrains();
+			const ComponentPool<Terrain*>& terrains = m_scene->getTerrains();
 			if(terrains.empty()) return;
 
 			World& world = m_scene->getWorld();
@@ -1754,7 +1755,7 @@ struct PipelineImpl final : Pipeline
 		gpu::StateFlags render_state = state_handle.valid ? m_render_states[state_handle.value] : gpu::StateFlags::NONE;
 
 		m_renderer.pushJob("grass", [this, cp, define_mask, render_state](DrawStream& stream){
-			const HashMap<EntityRef, Terrain*>& terrains = m_scene->getTerrains();
+			const ComponentPool<Terrain*>& terrains = m_scene->getTerrains();
 			const World& world = m_scene->getWorld();
 			const float global_lod_multiplier = m_renderer.getLODMultiplier();
 
@@ -3391,6 +3392,15 @@ struct PipelineImpl final : Pipeline
 			AutoInstancer& instancer = view.instancers[instancer_idx];
 			instancer.init(m_renderer.getMaxSortKey() + 1);
 
+			// size of meshes on screen in pixels, TextureStreamer picks mips of their textures based on it
+			const bool request_texture_sizes = !view.cp.is_shadow;
+			const float screen_size_factor = m_viewport.is_ortho ? m_viewport.h / m_viewport.ortho_size : m_viewport.h / tanf(m_viewport.fov * 0.5f);
+			auto get_screen_size = [&](const ModelInstance& mi, const Transform& tr, float squared_dist) -> u32 {
+				const float radius = mi.model->getOriginBoundingRadius() * maximum(tr.scale.x, tr.scale.y, tr.scale.z);
+				const float dist = m_viewport.is_ortho ? 1.f : maximum(sqrtf(squared_dist), 0.01f);
+				return u32(minimum(radius * screen_size_factor / dist, 65536.f));
+			};
+
 			for(;;) {
 				const CullResult* page = iterator.next();
 				if(!page) break;
@@ -3438,10 +3448,12 @@ struct PipelineImpl final : Pipeline
 							const float squared_length = float(squaredLength(pos - lod_ref_point));
 								
 							const u32 lod_idx = mi.model->getLODMeshIndices(squared_length * global_lod_multiplier_rcp);
+							const u32 screen_size = request_texture_sizes ? get_screen_size(mi, entity_data[e.index], squared_length) : 0;
 
 							auto create_key = [&](const LODMeshIndices& lod){
 								for (int mesh_idx = lod.from; mesh_idx <= lod.to; ++mesh_idx) {
 									const Mesh& mesh = mi.meshes[mesh_idx];
+									if (screen_size) (mi.custom_material ? mi.custom_material : mesh.material)->requestTextureSize(screen_size);
 									const u8 layer = mi.custom_material ? mi.custom_material->getLayer() : mesh.layer;
 									const u32 bucket = bucket_map[layer];
 									const u32 mesh_sort_key = mi.custom_material ? 0x00FFffFF : mesh.sort_key;
@@ -3498,10 +3510,12 @@ struct PipelineImpl final : Pipeline
 							const float squared_length = float(squaredLength(pos - lod_ref_point));
 								
 							const u32 lod_idx = mi.model->getLODMeshIndices(squared_length * global_lod_multiplier_rcp);
+							const u32 screen_size = request_texture_sizes ? get_screen_size(mi, entity_data[e.index], squared_length) : 0;
 
 							auto create_key = [&](const LODMeshIndices& lod){
 								for (int mesh_idx = lod.from; mesh_idx <= lod.to; ++mesh_idx) {
 									const Mesh& mesh = mi.meshes[mesh_idx];
+									if (screen_size) mesh.material->requestTextureSize(screen_size);
 									const u32 bucket = bucket_map[mesh.layer];
 									ASSERT(!mi.custom_material);
 									const u64 subrenderable = e.index | type_mask | ((u64)mesh_idx << SORT_KEY_MESH_IDX_SHIFT);
@@ -3594,113 +3608,21 @@ struct PipelineImpl final : Pipeline
 		view.sorter.pack();
 	}
 
-	struct Histogram {
-		static constexpr u32 BITS = 11;
-		static constexpr u32 SIZE = 1 << BITS;
-		static constexpr u32 BIT_MASK = SIZE - 1;
-		static constexpr i32 STEP = 4096;
-
-		u32 m_histogram[SIZE];
-		bool m_sorted;
-		jobs::Mutex m_cs;
-
-		void compute(const u64* keys, const u64* values, int size, u16 shift) {
-			memset(m_histogram, 0, sizeof(m_histogram));
-			m_sorted = true;
-
-			volatile i32 counter = 0;
-			auto work = [&](){
-				PROFILE_BLOCK("compute histogram");
-				u32 histogram[SIZE];
-				bool sorted = true;
-				memset(histogram, 0, sizeof(histogram));
-
-				i32 begin = atomicAdd(&counter, STEP);
-
-				while (begin < size) {
-					const i32 end = minimum(size, begin + STEP);
-
-					u64 key = begin > 0 ? keys[begin - 1] : keys[0];
-					u64 prev_key = key;
-					for (i32 i = begin; i < end; ++i) {
-						key = keys[i];
-						const u16 index = (key >> shift) & BIT_MASK;
-						++histogram[index];
-						sorted &= prev_key <= key;
-						prev_key = key;
-					}
-					begin = atomicAdd(&counter, STEP);
-				}
-
-				jobs::MutexGuard lock(m_cs);
-				m_sorted &= sorted;
-				for (u32 i = 0; i < lengthOf(m_histogram); ++i) {
-					m_histogram[i] += histogram[i]; 
-				}
-			};
-
-			if (size < STEP) {
-				work();
-			}
-			else {
-				jobs::runOnWorkers(work);
-			}
-		}
-	};
-
-
-	void radixSort(u64* _keys, u64* _values, int size) {
+	void radixSort(u64* keys, u64* values, int size) {
 		PROFILE_FUNCTION();
 		profiler::pushInt("count", size);
 		if (size == 0) return;
 
-		Array<u64> tmp_mem(m_allocator);
-
-		u64* keys = _keys;
-		u64* values = _values;
-		u64* tmp_keys = nullptr;
-		u64* tmp_values = nullptr;
-
-		Histogram histogram;
-		u16 shift = 0;
-
-		for (int pass = 0; pass < 6; ++pass) {
-			histogram.compute(keys, values, size, shift);
-
-			if (histogram.m_sorted) {
-				if (pass & 1) {
-					memcpy(_keys, tmp_mem.begin(), tmp_mem.byte_size() / 2);
-					memcpy(_values, &tmp_mem[size], tmp_mem.byte_size() / 2);
-				}
-				return;
-			}
-
-			if (!tmp_keys) {
-				tmp_mem.resize(size * 2);
-				tmp_keys = tmp_mem.begin();
-				tmp_values = &tmp_mem[size];
-			}
-
-			u32 offset = 0;
-			for (int i = 0; i < Histogram::SIZE; ++i) {
-				const u32 count = histogram.m_histogram[i];
-				histogram.m_histogram[i] = offset;
-				offset += count;
-			}
-
-			for (int i = 0; i < size; ++i) {
-				const u64 key = keys[i];
-				const u16 index = (key >> shift) & Histogram::BIT_MASK;
-				const u32 dest = histogram.m_histogram[index]++;
-				tmp_keys[dest] = key;
-				tmp_values[dest] = values[i];
-			}
+		// scratch memory lives until the end of frame, large views which do not fit in frame allocator use m_allocator
+		LinearAllocator& frame_allocator = m_renderer.getCurrentFrameAllocator();
+		const size_t scratch_size = getRadixSortScratchSize(size);
+		u8* scratch = (u8*)frame_allocator.tryAllocateAligned(scratch_size, 64);
+		const bool is_scratch_heap = !scratch;
+		if (is_scratch_heap) scratch = (u8*)m_allocator.allocate_aligned(scratch_size, 64);
 
-			swap(tmp_keys, keys);
-			swap(tmp_values, values);
+		Lumix::radixSort(keys, values, size, scratch);
 
-			shift += Histogram::BITS;
-		}
+		if (is_scratch_heap) m_allocator.deallocate_aligned(scratch);
 	}
 
 	void clear(u32 flags, float r, float g, float b, float a, float depth) {
@@ -2,6 +2,7 @@
 #include "engine/math.h"
 #include "engine/profiler.h"
 #include "engine/math.h"
+#include "engine/simd.h"
 #include "renderer/model.h"
 
 
@@ -26,17 +27,94 @@ Pose::~Pose()
 }
 
 
-void Pose::blend(Pose& rhs, float weight)
+// nlerp of 4 quaternions, SoA, same operations as scalar nlerp
+static LUMIX_FORCE_INLINE void nlerp4(float4* a, const float4* b, float4 t) {
+	const float4 zero = f4Splat(0);
+	const float4 one = f4Splat(1);
+	const float4 inv = f4Sub(one, t);
+	const float4 dot = f4Add(f4Add(f4Add(f4Mul(a[0], b[0]), f4Mul(a[1], b[1])), f4Mul(a[2], b[2])), f4Mul(a[3], b[3]));
+	t = f4Blend(t, f4Sub(zero, t), f4CmpLT(dot, zero));
+	for (u32 i = 0; i < 4; ++i) a[i] = f4Add(f4Mul(a[i], inv), f4Mul(b[i], t));
+	const float4 len2 = f4Add(f4Add(f4Add(f4Mul(a[0], a[0]), f4Mul(a[1], a[1])), f4Mul(a[2], a[2])), f4Mul(a[3], a[3]));
+	const float4 l = f4Div(one, f4Sqrt(len2));
+	for (u32 i = 0; i < 4; ++i) a[i] = f4Mul(a[i], l);
+}
+
+struct UniformWeight {
+	float get(u32 bone) const { return weight; }
+	float4 get4(u32 bone) const { return f4Splat(weight); }
+	// weights for positions of 4 bones starting at `bone`, as 3 float4
+	void getPositionWeights(u32 bone, float4* out) const { out[0] = out[1] = out[2] = f4Splat(weight); }
+	float weight;
+};
+
+struct BoneWeights {
+	float get(u32 bone) const { return weights[bone]; }
+	float4 get4(u32 bone) const { return f4LoadUnaligned(weights + bone); }
+	void getPositionWeights(u32 bone, float4* out) const {
+		alignas(16) float tmp[12];
+		for (u32 j = 0; j < 12; ++j) tmp[j] = weights[bone + j / 3];
+		for (u32 j = 0; j < 3; ++j) out[j] = f4Load(tmp + j * 4);
+	}
+	const float* weights;
+};
+
+// 4 bones at once, positions are processed as flat float array, rotations are transposed to SoA
+// same operations in the same order as the scalar tail, so results are equal as long as the compiler does not contract them
+template <typename Weight>
+static void blendPoses(Pose& pose, const Pose& rhs, const Weight& weight, u32 from, u32 to) {
+	const float4 one = f4Splat(1);
+	u32 i = from;
+	for (; i + 4 <= to; i += 4) {
+		float* pos = &pose.positions[i].x;
+		const float* rhs_pos = &rhs.positions[i].x;
+		float4 w[3];
+		weight.getPositionWeights(i, w);
+		for (u32 j = 0; j < 3; ++j) {
+			const float4 p = f4LoadUnaligned(pos + j * 4);
+			const float4 r = f4LoadUnaligned(rhs_pos + j * 4);
+			f4StoreUnaligned(pos + j * 4, f4Add(f4Mul(p, f4Sub(one, w[j])), f4Mul(r, w[j])));
+		}
+
+		float4 q[4];
+		float4 rq[4];
+		for (u32 j = 0; j < 4; ++j) {
+			q[j] = f4LoadUnaligned(&pose.rotations[i + j]);
+			rq[j] = f4LoadUnaligned(&rhs.rotations[i + j]);
+		}
+		f4Transpose(q[0], q[1], q[2], q[3]);
+		f4Transpose(rq[0], rq[1], rq[2], rq[3]);
+		nlerp4(q, rq, weight.get4(i));
+		f4Transpose(q[0], q[1], q[2], q[3]);
+		for (u32 j = 0; j < 4; ++j) f4StoreUnaligned(&pose.rotations[i + j], q[j]);
+	}
+
+	for (; i < to; ++i) {
+		const float w = weight.get(i);
+		pose.positions[i] = pose.positions[i] * (1 - w) + rhs.positions[i] * w;
+		pose.rotations[i] = nlerp(pose.rotations[i], rhs.rotations[i], w);
+	}
+}
+
+
+void Pose::blend(const Pose& rhs, float weight, u32 from_bone, u32 to_bone)
 {
 	ASSERT(count == rhs.count);
 	if (weight <= 0.001f) return;
 	weight = clamp(weight, 0.0f, 1.0f);
-	float inv = 1.0f - weight;
-	for (int i = 0, c = count; i < c; ++i)
-	{
-		positions[i] = positions[i] * inv + rhs.positions[i] * weight;
-		rotations[i] = nlerp(rotations[i], rhs.rotations[i], weight);
-	}
+	to_bone = minimum(to_bone, count);
+	if (from_bone >= to_bone) return;
+	blendPoses(*this, rhs, UniformWeight{weight}, from_bone, to_bone);
+}
+
+
+void Pose::blend(const Pose& rhs, Span<const float> weights, u32 from_bone, u32 to_bone)
+{
+	ASSERT(count == rhs.count);
+	ASSERT(weights.length() == count);
+	to_bone = minimum(to_bone, count);
+	if (from_bone >= to_bone) return;
+	blendPoses(*this, rhs, BoneWeights{weights.begin()}, from_bone, to_bone);
 }
 
 
@@ -62,11 +140,66 @@ void Pose::resize(int count)
 void Pose::computeAbsolute(Model& model)
 {
 	if (is_absolute) return;
-	for (u32 i = model.getFirstNonrootBoneIndex(); i < count; ++i)
-	{
-		int parent = model.getBone(i).parent_idx;
-		positions[i] = rotations[parent].rotate(positions[i]) + positions[parent];
-		rotations[i] = rotations[parent] * rotations[i];
+	// bones with the same depth do not depend on each other, so we can process 4 of them at once
+	const Span<const u16> bones = model.getBonesByDepth();
+	const Span<const u32> offsets = model.getBoneDepthOffsets();
+	const float4 two = f4Splat(2);
+	for (u32 level = 0; level + 1 < offsets.length(); ++level) {
+		u32 i = offsets[level];
+		const u32 end = offsets[level + 1];
+		for (; i + 4 <= end; i += 4) {
+			const u16* idx = bones.begin() + i;
+			alignas(16) float tmp[3][4];
+			alignas(16) float tmp_parent[3][4];
+			float4 pq[4];
+			float4 q[4];
+			for (u32 j = 0; j < 4; ++j) {
+				const i32 parent = model.getBone(idx[j]).parent_idx;
+				pq[j] = f4LoadUnaligned(&rotations[parent]);
+				q[j] = f4LoadUnaligned(&rotations[idx[j]]);
+				for (u32 k = 0; k < 3; ++k) {
+					tmp[k][j] = (&positions[idx[j]].x)[k];
+					tmp_parent[k][j] = (&positions[parent].x)[k];
+				}
+			}
+			f4Transpose(pq[0], pq[1], pq[2], pq[3]);
+			f4Transpose(q[0], q[1], q[2], q[3]);
+			const float4 vx = f4Load(tmp[0]);
+			const float4 vy = f4Load(tmp[1]);
+			const float4 vz = f4Load(tmp[2]);
+
+			// parent.rot.rotate(pos) + parent.pos, same operations as Quat::rotate
+			const float4 uvx = f4Sub(f4Mul(pq[1], vz), f4Mul(pq[2], vy));
+			const float4 uvy = f4Sub(f4Mul(pq[2], vx), f4Mul(pq[0], vz));
+			const float4 uvz = f4Sub(f4Mul(pq[0], vy), f4Mul(pq[1], vx));
+			const float4 uuvx = f4Sub(f4Mul(pq[1], uvz), f4Mul(pq[2], uvy));
+			const float4 uuvy = f4Sub(f4Mul(pq[2], uvx), f4Mul(pq[0], uvz));
+			const float4 uuvz = f4Sub(f4Mul(pq[0], uvy), f4Mul(pq[1], uvx));
+			const float4 w2 = f4Mul(two, pq[3]);
+			f4Store(tmp[0], f4Add(f4Add(f4Add(vx, f4Mul(uvx, w2)), f4Mul(uuvx, two)), f4Load(tmp_parent[0])));
+			f4Store(tmp[1], f4Add(f4Add(f4Add(vy, f4Mul(uvy, w2)), f4Mul(uuvy, two)), f4Load(tmp_parent[1])));
+			f4Store(tmp[2], f4Add(f4Add(f4Add(vz, f4Mul(uvz, w2)), f4Mul(uuvz, two)), f4Load(tmp_parent[2])));
+
+			// parent.rot * rot, same operations as Quat::operator*
+			float4 r[4];
+			r[0] = f4Sub(f4Add(f4Add(f4Mul(pq[3], q[0]), f4Mul(q[3], pq[0])), f4Mul(pq[1], q[2])), f4Mul(q[1], pq[2]));
+			r[1] = f4Sub(f4Add(f4Add(f4Mul(pq[3], q[1]), f4Mul(q[3], pq[1])), f4Mul(pq[2], q[0])), f4Mul(q[2], pq[0]));
+			r[2] = f4Sub(f4Add(f4Add(f4Mul(pq[3], q[2]), f4Mul(q[3], pq[2])), f4Mul(pq[0], q[1])), f4Mul(q[0], pq[1]));
+			r[3] = f4Sub(f4Sub(f4Sub(f4Mul(pq[3], q[3]), f4Mul(pq[0], q[0])), f4Mul(pq[1], q[1])), f4Mul(pq[2], q[2]));
+			f4Transpose(r[0], r[1], r[2], r[3]);
+
+			for (u32 j = 0; j < 4; ++j) {
+				f4StoreUnaligned(&rotations[idx[j]], r[j]);
+				positions[idx[j]] = Vec3(tmp[0][j], tmp[1][j], tmp[2][j]);
+			}
+		}
+
+		for (; i < end; ++i) {
+			const u32 bone = bones[i];
+			const int parent = model.getBone(bone).parent_idx;
+			positions[bone] = rotations[parent].rotate(positions[bone]) + positions[parent];
+			rotations[bone] = rotations[parent] * rotations[bone];
+		}
 	}
 	is_absolute = true;
 }
@@ -23,7 +23,10 @@ struct LUMIX_RENDERER_API Pose
 	void resize(int count);
 	void computeAbsolute(Model& model);
 	void computeRelative(Model& model);
-	void blend(Pose& rhs, float weight);
+	// only bones in [from_bone, to_bone) are blended
+	void blend(const Pose& rhs, float weight, u32 from_bone = 0, u32 to_bone = 0xffFFffFF);
+	// `weights` - one per bone, e.g. 0 for bones masked out
+	void blend(const Pose& rhs, Span<const float> weights, u32 from_bone = 0, u32 to_bone = 0xffFFffFF);
 
 	IAllocator& allocator;
 	bool is_absolute;
@@ -0,0 +1,127 @@
+#include "engine/allocator.h"
+#include "engine/atomic.h"
+#include "engine/crt.h"
+#include "engine/job_system.h"
+#include "engine/math.h"
+#include "engine/profiler.h"
+#include "radix_sort.h"
+
+
+namespace Lumix
+{
+
+// parallel LSD radix sort
+// keys are split into blocks and every block has its own histogram, 
+// so blocks can be scattered in parallel and the sort stays stable
+struct RadixSort {
+	static constexpr u32 BITS = 11;
+	static constexpr u32 SIZE = 1 << BITS;
+	static constexpr u32 BIT_MASK = SIZE - 1;
+	static constexpr u32 PASSES = (64 + BITS - 1) / BITS;
+	static constexpr i32 MIN_BLOCK_SIZE = 16 * 1024;
+	static constexpr i32 MAX_BLOCKS = 64;
+};
+
+static i32 getBlockSize(i32 size) {
+	return maximum(RadixSort::MIN_BLOCK_SIZE, (size + RadixSort::MAX_BLOCKS - 1) / RadixSort::MAX_BLOCKS);
+}
+
+static size_t getHistogramsSize(i32 block_count) {
+	return sizeof(u32) * RadixSort::SIZE * block_count;
+}
+
+size_t getRadixSortScratchSize(i32 size) {
+	const i32 block_size = getBlockSize(size);
+	const i32 block_count = (size + block_size - 1) / block_size;
+	return getHistogramsSize(block_count) + 2 * sizeof(u64) * size;
+}
+
+void radixSort(u64* _keys, u64* _values, i32 size, u8* scratch) {
+	if (size == 0) return;
+
+	const i32 block_size = getBlockSize(size);
+	const i32 block_count = (size + block_size - 1) / block_size;
+	const size_t histograms_size = getHistogramsSize(block_count);
+	u32* histograms = (u32*)scratch;
+
+	u64* keys = _keys;
+	u64* values = _values;
+	u64* tmp_keys = nullptr;
+	u64* tmp_values = nullptr;
+	u32 shift = 0;
+
+	for (u32 pass = 0; pass < RadixSort::PASSES; ++pass, shift += RadixSort::BITS) {
+		volatile i32 is_unsorted = 0;
+		jobs::forEach(block_count, 1, [&](i32 from, i32 to){
+			PROFILE_BLOCK("compute histograms");
+			for (i32 block = from; block < to; ++block) {
+				u32* LUMIX_RESTRICT histogram = histograms + block * RadixSort::SIZE;
+				memset(histogram, 0, sizeof(u32) * RadixSort::SIZE);
+				
+				const i32 begin = block * block_size;
+				const i32 end = minimum(size, begin + block_size);
+				u64 prev_key = begin > 0 ? keys[begin - 1] : keys[0];
+				bool sorted = true;
+				for (i32 i = begin; i < end; ++i) {
+					const u64 key = keys[i];
+					++histogram[(key >> shift) & RadixSort::BIT_MASK];
+					sorted &= prev_key <= key;
+					prev_key = key;
+				}
+				if (!sorted) is_unsorted = 1;
+			}
+		});
+		if (!is_unsorted) break;
+
+		// histograms -> scatter offsets, block b writes its keys with digit d after keys with digit d from block b - 1
+		u32 offset = 0;
+		bool single_digit = false;
+		for (u32 digit = 0; digit < RadixSort::SIZE; ++digit) {
+			const u32 digit_start = offset;
+			for (i32 block = 0; block < block_count; ++block) {
+				u32& h = histograms[block * RadixSort::SIZE + digit];
+				const u32 count = h;
+				h = offset;
+				offset += count;
+			}
+			single_digit = single_digit || offset - digit_start == (u32)size;
+		}
+		// all keys have the same digit, scatter would not change anything
+		if (single_digit) continue;
+
+		if (!tmp_keys) {
+			tmp_keys = (u64*)(scratch + histograms_size);
+			tmp_values = tmp_keys + size;
+		}
+
+		jobs::forEach(block_count, 1, [&](i32 from, i32 to){
+			PROFILE_BLOCK("scatter");
+			for (i32 block = from; block < to; ++block) {
+				u32* LUMIX_RESTRICT offsets = histograms + block * RadixSort::SIZE;
+				const i32 begin = block * block_size;
+				const i32 end = minimum(size, begin + block_size);
+				for (i32 i = begin; i < end; ++i) {
+					const u64 key = keys[i];
+					const u32 dest = offsets[(key >> shift) & RadixSort::BIT_MASK]++;
+					tmp_keys[dest] = key;
+					tmp_values[dest] = values[i];
+				}
+			}
+		});
+
+		swap(tmp_keys, keys);
+		swap(tmp_values, values);
+	}
+
+	if (keys != _keys) {
+		jobs::forEach(block_count, 1, [&](i32 from, i32 to){
+			PROFILE_BLOCK("copy");
+			const i32 begin = from * block_size;
+			const i32 end = minimum(size, to * block_size);
+			memcpy(_keys + begin, keys + begin, (end - begin) * sizeof(keys[0]));
+			memcpy(_values + begin, values + begin, (end - begin) * sizeof(values[0]));
+		});
+	}
+}
+
+} // namespace Lumix
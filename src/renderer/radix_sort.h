@@ -0,0 +1,15 @@
+#pragma once
+
+
+#include "engine/lumix.h"
+
+
+namespace Lumix
+{
+
+// size in bytes of the scratch memory radixSort needs for `size` keys
+LUMIX_RENDERER_API size_t getRadixSortScratchSize(i32 size);
+// stable parallel sort of `keys` and their `values` by key, `scratch` must be 64 bytes aligned
+LUMIX_RENDERER_API void radixSort(u64* keys, u64* values, i32 size, u8* scratch);
+
+} // namespace Lumix
@@ -2,11 +2,14 @@
 
 #include "engine/array.h"
 #include "engine/associative_array.h"
+#include "engine/atomic.h"
+#include "engine/component_pool.h"
 #include "engine/crt.h"
 #include "engine/engine.h"
 #include "engine/file_system.h"
 #include "engine/geometry.h"
 #include "engine/hash.h"
+#include "engine/job_system.h"
 #include "engine/log.h"
 #include "engine/lua_wrapper.h"
 #include "engine/math.h"
@@ -18,6 +21,7 @@
 #include "engine/stream.h"
 #include "engine/world.h"
 #include "imgui/IconsFontAwesome5.h"
+#include "renderer/bvh.h"
 #include "renderer/culling_system.h"
 #include "renderer/draw_stream.h"
 #include "renderer/font.h"
@@ -92,6 +96,19 @@ struct ReflectionProbe::LoadJob {
 };
 
 struct RenderSceneImpl final : RenderScene {
+	// raycast acceleration structure, it's not modified while any raycast uses it, see acquireModelInstancesBVH
+	struct ModelInstancesBVH {
+		ModelInstancesBVH(IAllocator& allocator) : bvh(allocator), bounds(allocator), entities(allocator), items(allocator) {}
+
+		BVH bvh;
+		Array<AABB> bounds;
+		Array<EntityRef> entities;
+		// index to `entities` for each entity, -1 if the entity is not in bvh
+		Array<i32> items;
+		// the scene holds one reference
+		volatile i32 refs = 1;
+	};
+
 	RenderSceneImpl(Renderer& renderer,
 		Engine& engine,
 		World& world,
@@ -100,9 +117,10 @@ struct RenderSceneImpl final : RenderScene {
 	~RenderSceneImpl()
 	{
 		m_renderer.getEndFrameDrawStream().destroy(m_reflection_probes_texture);
-		m_world.entityTransformed().unbind<&RenderSceneImpl::onEntityMoved>(this);
+		m_world.entitiesTransformed().unbind<&RenderSceneImpl::onEntitiesMoved>(this);
 		m_world.entityDestroyed().unbind<&RenderSceneImpl::onEntityDestroyed>(this);
 		m_culling_system.reset();
+		releaseModelInstancesBVH(*m_model_instances_bvh);
 	}
 
 	void getInstancedModelBlob(EntityRef entity, OutputMemoryStream& value) {
@@ -1400,7 +1418,7 @@ struct RenderSceneImpl final : RenderScene {
 	}
 
 
-	const HashMap<EntityRef, PointLight>& getPointLights() override
+	const ComponentPool<PointLight>& getPointLights() override
 	{
 		return m_point_lights;
 	}
@@ -1449,6 +1467,24 @@ struct RenderSceneImpl final : RenderScene {
 	}
 
 
+	void onEntitiesMoved(Span<const EntityRef> entities)
+	{
+		{
+			jobs::MutexGuard guard(m_model_instances_bvh_mutex);
+			for (EntityRef e : entities) {
+				if (e.index < m_model_instances.size() && m_model_instances[e.index].model) {
+					m_model_instances_bvh_moved.push(e);
+				}
+			}
+			// refitting whole tree is cheaper than refitting each moved leaf separately
+			if ((u32)m_model_instances_bvh_moved.size() > m_model_instances_bvh->entities.size() / 4) {
+				m_model_instances_bvh_moved.clear();
+				m_model_instances_bvh_refit_all = 1;
+			}
+		}
+		for (EntityRef e : entities) onEntityMoved(e);
+	}
+
 	void onEntityMoved(EntityRef entity)
 	{
 		const u64 cmp_mask = m_world.getComponentsMask(entity);
@@ -1510,7 +1546,7 @@ struct RenderSceneImpl final : RenderScene {
 
 	Engine& getEngine() const override { return m_engine; }
 
-	const HashMap<EntityRef, Terrain*>& getTerrains() override {
+	const ComponentPool<Terrain*>& getTerrains() override {
 		return m_terrains;
 	}
 
@@ -2499,6 +2535,87 @@ struct RenderSceneImpl final : RenderScene {
 		return hit;
 	}
 
+	AABB getModelInstanceBounds(EntityRef e) const {
+		const Transform& tr = m_world.getTransform(e);
+		const float radius = m_model_instances[e.index].model->getOriginBoundingRadius() * maximum(tr.scale.x, tr.scale.y, tr.scale.z);
+		const Vec3 pos(tr.pos);
+		return AABB(pos - Vec3(radius), pos + Vec3(radius));
+	}
+
+	// m_model_instances_bvh_mutex must be locked
+	void updateModelInstancesBVH() {
+		const bool refit_all = m_model_instances_bvh_refit_all;
+		if (!m_model_instances_bvh_dirty && !refit_all && m_model_instances_bvh_moved.empty()) return;
+
+		PROFILE_FUNCTION();
+		ModelInstancesBVH* bvh = m_model_instances_bvh;
+		// other jobs are still traversing current bvh, it can't be modified, so we build a new one
+		const bool rebuild = m_model_instances_bvh_dirty || bvh->refs > 1;
+		if (bvh->refs > 1) {
+			releaseModelInstancesBVH(*bvh);
+			bvh = LUMIX_NEW(m_allocator, ModelInstancesBVH)(m_allocator);
+			m_model_instances_bvh = bvh;
+		}
+
+		if (rebuild) {
+			bvh->entities.clear();
+			bvh->items.resize(m_model_instances.size());
+			for (i32 i = 0, c = m_model_instances.size(); i < c; ++i) {
+				const ModelInstance& r = m_model_instances[i];
+				const bool is_in_bvh = r.flags.isSet(ModelInstance::VALID) && r.model;
+				bvh->items[i] = is_in_bvh ? bvh->entities.size() : -1;
+				if (is_in_bvh) bvh->entities.push({i});
+			}
+		}
+
+		if (rebuild || refit_all) {
+			bvh->bounds.resize(bvh->entities.size());
+			for (u32 i = 0, c = bvh->entities.size(); i < c; ++i) {
+				bvh->bounds[i] = getModelInstanceBounds(bvh->entities[i]);
+			}
+			if (rebuild) bvh->bvh.build(bvh->bounds);
+			else bvh->bvh.refit(bvh->bounds);
+		}
+		else {
+			Array<u32> items(m_allocator);
+			items.reserve(m_model_instances_bvh_moved.size());
+			for (EntityRef e : m_model_instances_bvh_moved) {
+				if (e.index >= bvh->items.size() || bvh->items[e.index] < 0) continue;
+				const u32 item = bvh->items[e.index];
+				bvh->bounds[item] = getModelInstanceBounds(e);
+				items.push(item);
+			}
+			bvh->bvh.refit(bvh->bounds, items);
+		}
+
+		m_model_instances_bvh_dirty = 0;
+		m_model_instances_bvh_refit_all = 0;
+		m_model_instances_bvh_moved.clear();
+	}
+
+	// returns up-to-date bvh, it stays valid until released, even if the scene rebuilds its bvh in the meantime
+	ModelInstancesBVH& acquireModelInstancesBVH() {
+		jobs::MutexGuard guard(m_model_instances_bvh_mutex);
+		updateModelInstancesBVH();
+		atomicIncrement(&m_model_instances_bvh->refs);
+		return *m_model_instances_bvh;
+	}
+
+	void releaseModelInstancesBVH(ModelInstancesBVH& bvh) {
+		if (atomicDecrement(&bvh.refs) == 0) LUMIX_DELETE(m_allocator, &bvh);
+	}
+
+	void castRays(Span<const Ray> rays, Span<RayCastModelHit> hits, EntityPtr ignored_model_instance) override {
+		PROFILE_FUNCTION();
+		ASSERT(rays.length() == hits.length());
+		jobs::forEach(rays.length(), 16, [&](i32 from, i32 to){
+			PROFILE_BLOCK("cast rays");
+			for (i32 i = from; i < to; ++i) {
+				hits[i] = castRay(rays[i].origin, rays[i].dir, ignored_model_instance);
+			}
+		});
+	}
+
 	RayCastModelHit castRay(const DVec3& origin, const Vec3& dir, EntityPtr ignored_model_instance) override {
 		return castRay(origin, dir, [&](const RayCastModelHit& hit) -> bool {
 			return hit.entity != ignored_model_instance || !ignored_model_instance.isValid();
@@ -2618,18 +2735,19 @@ struct RenderSceneImpl final : RenderScene {
 		RayCastModelHit hit = castRayInstancedModels(origin, dir, filter);
 		double cur_dist = hit.is_hit ? hit.t : DBL_MAX;
 
+		ModelInstancesBVH& bvh = acquireModelInstancesBVH();
 		const World& world = getWorld();
-		for (int i = 0; i < m_model_instances.size(); ++i) {
-			auto& r = m_model_instances[i];
-			if (!r.flags.isSet(ModelInstance::ENABLED)) continue;
-			if (!r.flags.isSet(ModelInstance::VALID)) continue;
-			if (!r.model) continue;
+		bvh.bvh.castRay(Vec3(origin), dir, hit.is_hit ? hit.t : FLT_MAX, [&](u32 item, float max_t) -> float {
+			const EntityRef entity = bvh.entities[item];
+			auto& r = m_model_instances[entity.index];
+			if (!r.flags.isSet(ModelInstance::ENABLED)) return max_t;
+			if (!r.flags.isSet(ModelInstance::VALID)) return max_t;
+			if (!r.model) return max_t;
 
-			const EntityRef entity{i};
 			const Transform& tr = world.getTransform(entity);
 			float radius = r.model->getOriginBoundingRadius();
 			const double dist = length(tr.pos - origin);
-			if (dist - radius * maximum(tr.scale.x, tr.scale.y, tr.scale.z) > cur_dist) continue;
+			if (dist - radius * maximum(tr.scale.x, tr.scale.y, tr.scale.z) > cur_dist) return max_t;
 			
 			const Transform& inv_tr = tr.inverted();
 			const Vec3 ray_origin_model_space = Vec3(inv_tr.transform(origin));
@@ -2658,7 +2776,9 @@ struct RenderSceneImpl final : RenderScene {
 					}
 				}
 			}
-		}
+			return hit.is_hit ? minimum(hit.t, max_t) : max_t;
+		});
+		releaseModelInstancesBVH(bvh);
 
 		const RayCastModelHit pg_hit = castRayProceduralGeometry(origin, dir, filter);
 		if (pg_hit.is_hit && (pg_hit.t < hit.t || !hit.is_hit)) {
@@ -2799,6 +2919,7 @@ struct RenderSceneImpl final : RenderScene {
 
 	void modelUnloaded(Model*, EntityRef entity)
 	{
+		m_model_instances_bvh_dirty = 1;
 		auto& r = m_model_instances[entity.index];
 		r.meshes = nullptr;
 		r.mesh_count = 0;
@@ -2812,6 +2933,7 @@ struct RenderSceneImpl final : RenderScene {
 	void modelLoaded(Model* model, EntityRef entity)
 	{
 		ASSERT(model->isReady());
+		m_model_instances_bvh_dirty = 1;
 		auto& r = m_model_instances[entity.index];
 
 		float bounding_radius = r.model->getOriginBoundingRadius();
@@ -2998,6 +3120,7 @@ struct RenderSceneImpl final : RenderScene {
 			old_model->decRefCount();
 			return;
 		}
+		m_model_instances_bvh_dirty = 1;
 		if (old_model)
 		{
 			removeFromModelEntityMap(old_model, entity);
@@ -3204,7 +3327,7 @@ struct RenderSceneImpl final : RenderScene {
 		return iter.value();
 	}
 
-	const HashMap<EntityRef, ParticleEmitter>& getParticleEmitters() const override { return m_particle_emitters; }
+	const ComponentPool<ParticleEmitter>& getParticleEmitters() const override { return m_particle_emitters; }
 
 	IAllocator& m_allocator;
 	World& m_world;
@@ -3214,10 +3337,17 @@ struct RenderSceneImpl final : RenderScene {
 	u64 m_render_cmps_mask;
 
 	EntityPtr m_active_global_light_entity;
-	HashMap<EntityRef, PointLight> m_point_lights;
-	HashMap<EntityRef, Decal> m_decals;
+	ComponentPool<PointLight> m_point_lights;
+	ComponentPool<Decal> m_decals;
 	HashMap<EntityRef, CurveDecal> m_curve_decals;
 	Array<ModelInstance> m_model_instances;
+	// acceleration structure for raycasts against model instances, updated lazily on first raycast after a change
+	ModelInstancesBVH* m_model_instances_bvh;
+	// moved since last update, guarded by m_model_instances_bvh_mutex
+	Array<EntityRef> m_model_instances_bvh_moved;
+	jobs::Mutex m_model_instances_bvh_mutex;
+	volatile i32 m_model_instances_bvh_dirty = 1;
+	volatile i32 m_model_instances_bvh_refit_all = 0;
 	HashMap<EntityRef, InstancedModel> m_instanced_models;
 	HashMap<EntityRef, Environment> m_environments;
 	HashMap<EntityRef, Camera> m_cameras;
@@ -3226,8 +3356,8 @@ struct RenderSceneImpl final : RenderScene {
 	AssociativeArray<EntityRef, EnvironmentProbe> m_environment_probes;
 	AssociativeArray<EntityRef, ReflectionProbe> m_reflection_probes;
 	HashMap<EntityRef, ProceduralGeometry> m_procedural_geometries;
-	HashMap<EntityRef, Terrain*> m_terrains;
-	HashMap<EntityRef, ParticleEmitter> m_particle_emitters;
+	ComponentPool<Terrain*> m_terrains;
+	ComponentPool<ParticleEmitter> m_particle_emitters;
 	gpu::TextureHandle m_reflection_probes_texture = gpu::INVALID_TEXTURE;
 
 	Array<DebugTriangle> m_debug_triangles;
@@ -3428,6 +3558,8 @@ RenderSceneImpl::RenderSceneImpl(Renderer& renderer,
 	, m_allocator(allocator)
 	, m_model_entity_map(m_allocator)
 	, m_model_instances(m_allocator)
+	, m_model_instances_bvh(LUMIX_NEW(m_allocator, ModelInstancesBVH)(m_allocator))
+	, m_model_instances_bvh_moved(m_allocator)
 	, m_instanced_models(m_allocator)
 	, m_cameras(m_allocator)
 	, m_terrains(m_allocator)
@@ -3451,7 +3583,7 @@ RenderSceneImpl::RenderSceneImpl(Renderer& renderer,
 	, m_furs(m_allocator)
 {
 
-	m_world.entityTransformed().bind<&RenderSceneImpl::onEntityMoved>(this);
+	m_world.entitiesTransformed().bind<&RenderSceneImpl::onEntitiesMoved>(this);
 	m_world.entityDestroyed().bind<&RenderSceneImpl::onEntityDestroyed>(this);
 	m_culling_system = CullingSystem::create(m_allocator, engine.getPageAllocator());
 	m_model_instances.reserve(5000);
@@ -3502,6 +3634,8 @@ void RenderScene::registerLuaAPI(lua_State* L, Renderer& renderer)
 
 	LuaWrapper::createSystemClosure(L, "Renderer", &renderer, "setLODMultiplier", &LuaWrapper::wrapMethodClosure<&Renderer::setLODMultiplier>);
 	LuaWrapper::createSystemClosure(L, "Renderer", &renderer, "getLODMultiplier", &LuaWrapper::wrapMethodClosure<&Renderer::getLODMultiplier>);
+	LuaWrapper::createSystemClosure(L, "Renderer", &renderer, "setTextureStreamingBudget", &LuaWrapper::wrapMethodClosure<&Renderer::setTextureStreamingBudget>);
+	LuaWrapper::createSystemClosure(L, "Renderer", &renderer, "getTextureStreamingBudget", &LuaWrapper::wrapMethodClosure<&Renderer::getTextureStreamingBudget>);
 
 	#undef REGISTER_FUNCTION
 }
@@ -2,6 +2,7 @@
 
 
 #include "engine/array.h"
+#include "engine/component_pool.h"
 #include "engine/lumix.h"
 #include "engine/flag_set.h"
 #include "engine/geometry.h"
@@ -292,6 +293,8 @@ struct LUMIX_RENDERER_API RenderScene : IScene
 
 	virtual RayCastModelHit castRay(const DVec3& origin, const Vec3& dir, const Delegate<bool (const RayCastModelHit&)> filter) = 0;
 	virtual RayCastModelHit castRay(const DVec3& origin, const Vec3& dir, EntityPtr ignore) = 0;
+	// casts rays in parallel, must be called from a job
+	virtual void castRays(Span<const Ray> rays, Span<RayCastModelHit> hits, EntityPtr ignore) = 0;
 	virtual RayCastModelHit castRayTerrain(const DVec3& origin, const Vec3& dir) = 0;
 	virtual RayCastModelHit castRayInstancedModels(const DVec3& ray_origin, const Vec3& ray_dir, const Delegate<bool (const RayCastModelHit&)>& filter) = 0;
 	virtual void getRay(EntityRef entity, const Vec2& screen_pos, DVec3& origin, Vec3& dir) = 0;
@@ -350,7 +353,7 @@ struct LUMIX_RENDERER_API RenderScene : IScene
 	virtual void setParticleEmitterPath(EntityRef entity, const Path& path) = 0;
 	virtual Path getParticleEmitterPath(EntityRef entity) = 0;
 	virtual void updateParticleEmitter(EntityRef entity, float dt) = 0;
-	virtual const HashMap<EntityRef, struct ParticleEmitter>& getParticleEmitters() const = 0;
+	virtual const ComponentPool<struct ParticleEmitter>& getParticleEmitters() const = 0;
 	virtual ParticleEmitter& getParticleEmitter(EntityRef e) = 0;
 
 	virtual Path getInstancedModelPath(EntityRef entity) = 0;
@@ -395,7 +398,7 @@ struct LUMIX_RENDERER_API RenderScene : IScene
 	virtual Vec3 getDecalHalfExtents(EntityRef entity) = 0;
 
 	virtual Terrain* getTerrain(EntityRef entity) = 0;
-	virtual const HashMap<EntityRef, Terrain*>& getTerrains() = 0;
+	virtual const ComponentPool<Terrain*>& getTerrains() = 0;
 	virtual float getTerrainHeightAt(EntityRef entity, float x, float z) = 0;
 	virtual Vec3 getTerrainNormalAt(EntityRef entity, float x, float z) = 0;
 	virtual void setTerrainMaterialPath(EntityRef entity, const Path& path) = 0;
@@ -440,7 +443,7 @@ struct LUMIX_RENDERER_API RenderScene : IScene
 	virtual bool getEnvironmentCastShadows(EntityRef entity) = 0;
 	virtual void setEnvironmentCastShadows(EntityRef entity, bool enable) = 0;
 	virtual Environment& getEnvironment(EntityRef entity) = 0;
-	virtual const HashMap<EntityRef, PointLight>& getPointLights() = 0;
+	virtual const ComponentPool<PointLight>& getPointLights() = 0;
 	virtual PointLight& getPointLight(EntityRef entity) = 0;
 	virtual float getLightRange(EntityRef entity) = 0;
 	virtual void setLightRange(EntityRef entity, float value) = 0;
@@ -28,6 +28,7 @@
 #include "renderer/shader.h"
 #include "renderer/terrain.h"
 #include "renderer/texture.h"
+#include "renderer/texture_streamer.h"
 
 
 namespace Lumix {
@@ -380,6 +381,7 @@ struct RendererImpl final : Renderer
 		, m_plugins(m_allocator)
 		, m_free_sort_keys(m_allocator)
 		, m_sort_key_to_mesh_map(m_allocator)
+		, m_texture_streamer(*this, m_allocator)
 	{
 		RenderScene::reflect();
 
@@ -397,6 +399,9 @@ struct RendererImpl final : Renderer
 
 	float getLODMultiplier() const override { return m_lod_multiplier; }
 	void setLODMultiplier(float value) override { m_lod_multiplier = maximum(0.f, value); }
+	u32 getTextureStreamingBudget() const override { return u32(m_texture_streamer.getBudget() / (1024 * 1024)); }
+	void setTextureStreamingBudget(u32 megabytes) override { m_texture_streamer.setBudget(u64(megabytes) * 1024 * 1024); }
+	TextureStreamer& getTextureStreamer() override { return m_texture_streamer; }
 
 	u32 getVersion() const override { return 0; }
 	void serialize(OutputMemoryStream& stream) const override {}
@@ -413,6 +418,8 @@ struct RendererImpl final : Renderer
 		m_font_manager->destroy();
 		LUMIX_DELETE(m_allocator, m_font_manager);
 
+		if (m_headless) return;
+
 		frame();
 		frame();
 		frame();
@@ -444,7 +451,7 @@ struct RendererImpl final : Renderer
 		return false;
 	}
 
-	void init() override {
+	void initGPU() {
 		gpu::InitFlags flags = gpu::InitFlags::VSYNC;
 		
 		char cmd_line[4096];
@@ -469,6 +476,8 @@ struct RendererImpl final : Renderer
 
 			gpu::MemoryStats mem_stats;
 			if (gpu::getMemoryStats(mem_stats)) {
+				m_init_memory_stats = mem_stats;
+				m_has_memory_stats = true;
 				logInfo("Initial GPU memory stats:\n",
 					"total: ", (mem_stats.total_available_mem / (1024.f * 1024.f)), "MB\n"
 					"currect: ", (mem_stats.current_available_mem / (1024.f * 1024.f)), "MB\n"
@@ -482,13 +491,19 @@ struct RendererImpl final : Renderer
 			m_profiler.init();
 		}, &signal, 1);
 		jobs::wait(&signal);
+	}
+
+	void init() override {
+		// no window, e.g. -cook, resources are only compiled, nothing is rendered, so there's no GPU device
+		m_headless = m_engine.getWindowHandle() == os::INVALID_WINDOW;
+		if (m_headless) logInfo("No window, renderer runs without GPU device");
+		else initGPU();
 
 		m_cpu_frame = m_frames[0].get();
 		m_gpu_frame = m_frames[0].get();
 
 		MaterialBuffer& mb = m_material_buffer;
 		const u32 MAX_MATERIAL_CONSTS_COUNT = 400;
-		mb.buffer = gpu::allocBufferHandle();
 		mb.map.insert(RuntimeHash(), 0);
 		mb.data.resize(MAX_MATERIAL_CONSTS_COUNT);
 		mb.data[0].hash = RuntimeHash();
@@ -500,15 +515,18 @@ struct RendererImpl final : Renderer
 		}
 		mb.data.back().next_free = -1;
 			
-		DrawStream& stream = m_cpu_frame->draw_stream;
-		stream.createBuffer(mb.buffer
-			, gpu::BufferFlags::UNIFORM_BUFFER
-			, Material::MAX_UNIFORMS_BYTES * MAX_MATERIAL_CONSTS_COUNT
-			, nullptr
-		);
-
-		float default_mat[Material::MAX_UNIFORMS_FLOATS] = {};
-		stream.update(mb.buffer, &default_mat, sizeof(default_mat));
+		if (!m_headless) {
+			mb.buffer = gpu::allocBufferHandle();
+			DrawStream& stream = m_cpu_frame->draw_stream;
+			stream.createBuffer(mb.buffer
+				, gpu::BufferFlags::UNIFORM_BUFFER
+				, Material::MAX_UNIFORMS_BYTES * MAX_MATERIAL_CONSTS_COUNT
+				, nullptr
+			);
+
+			float default_mat[Material::MAX_UNIFORMS_FLOATS] = {};
+			stream.update(mb.buffer, &default_mat, sizeof(default_mat));
+		}
 
 		ResourceManagerHub& manager = m_engine.getResourceManager();
 		m_pipeline_manager.create(PipelineResource::TYPE, manager);
@@ -634,6 +652,11 @@ struct RendererImpl final : Renderer
 
 	gpu::BufferHandle createBuffer(const MemRef& memory, gpu::BufferFlags flags) override
 	{
+		if (m_headless) {
+			if (memory.own) free(memory);
+			return gpu::INVALID_BUFFER;
+		}
+
 		gpu::BufferHandle handle = gpu::allocBufferHandle();
 		if(!handle) return handle;
 
@@ -701,6 +724,11 @@ struct RendererImpl final : Renderer
 
 	gpu::TextureHandle createTexture(u32 w, u32 h, u32 depth, gpu::TextureFormat format, gpu::TextureFlags flags, const MemRef& memory, const char* debug_name) override
 	{
+		if (m_headless) {
+			if (memory.own) free(memory);
+			return gpu::INVALID_TEXTURE;
+		}
+
 		gpu::TextureHandle handle = gpu::allocTextureHandle();
 		if(!handle) return handle;
 
@@ -757,6 +785,7 @@ struct RendererImpl final : Renderer
 
 	gpu::ProgramHandle queueShaderCompile(Shader& shader, gpu::StateFlags state, gpu::VertexDecl decl, u32 defines) override {
 		ASSERT(shader.isReady());
+		if (m_headless) return gpu::INVALID_PROGRAM;
 		jobs::MutexGuard lock(m_cpu_frame->shader_mutex);
 		
 		for (const auto& i : m_cpu_frame->to_compile_shaders) {
@@ -917,6 +946,9 @@ struct RendererImpl final : Renderer
 		}
 		m_cpu_frame->to_compile_shaders.clear();
 
+		// pipelines recorded sizes of materials on screen during this frame
+		m_texture_streamer.update(m_material_manager, m_has_memory_stats ? &m_init_memory_stats : nullptr);
+
 		u32 frame_data_mem = 0;
 		for (const Local<FrameData>& fd : m_frames) {
 			frame_data_mem += fd->linear_allocator.getCommited();
@@ -953,6 +985,12 @@ struct RendererImpl final : Renderer
 	u32 m_max_sort_key = 0;
 	u32 m_frame_number = 0;
 	float m_lod_multiplier = 1;
+	TextureStreamer m_texture_streamer;
+	// only dedicated memory is used from these, which does not change, so they are queried just once
+	gpu::MemoryStats m_init_memory_stats;
+	bool m_has_memory_stats = false;
+	// there's no GPU device, handles are not created and frames are not rendered
+	bool m_headless = false;
 
 	Array<RenderPlugin*> m_plugins;
 	Local<FrameData> m_frames[3];
@@ -987,7 +1025,7 @@ struct RendererImpl final : Renderer
 FrameData::FrameData(struct RendererImpl& renderer, IAllocator& allocator, PageAllocator& page_allocator) 
 	: renderer(renderer)
 	, to_compile_shaders(allocator)
-	, linear_allocator(1024 * 1024 * 64)
+	, linear_allocator(1024 * 1024 * 256)
 	, draw_stream(renderer)
 	, begin_frame_draw_stream(renderer)
 	, end_frame_draw_stream(renderer)
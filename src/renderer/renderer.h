@@ -45,6 +45,10 @@ struct LUMIX_RENDERER_API Renderer : IPlugin {
 	virtual struct Engine& getEngine() = 0;
 	virtual float getLODMultiplier() const = 0;
 	virtual void setLODMultiplier(float value) = 0;
+	// in MB, streamed textures are kept under this budget
+	virtual u32 getTextureStreamingBudget() const = 0;
+	virtual void setTextureStreamingBudget(u32 megabytes) = 0;
+	virtual struct TextureStreamer& getTextureStreamer() = 0;
 	
 	virtual struct LinearAllocator& getCurrentFrameAllocator() = 0;
 	virtual IAllocator& getAllocator() = 0;
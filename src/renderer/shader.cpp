@@ -45,6 +45,7 @@ Shader::Shader(const Path& path, ResourceManager& resource_manager, Renderer& re
 	, m_defines(m_allocator)
 	, m_programs(m_allocator)
 	, m_sources(m_allocator)
+	, m_bytecode(m_allocator)
 {
 	m_sources.path = path;
 }
@@ -363,6 +364,30 @@ int include(lua_State* L)
 
 bool Shader::load(u64 size, const u8* mem)
 {
+	return execute(Span((const char*)mem, (u32)size));
+}
+
+
+// lua script can not run on a worker, since it uses engine's lua state and loads other resources,
+// so we only compile it there
+bool Shader::prepare(u64 size, const u8* mem)
+{
+	PROFILE_FUNCTION();
+	return LuaWrapper::compile(Span((const char*)mem, (u32)size), getPath().c_str(), m_bytecode);
+}
+
+
+bool Shader::finalize(u64 size, const u8* mem)
+{
+	const bool res = execute(Span((const char*)m_bytecode.data(), (u32)m_bytecode.size()));
+	m_bytecode.free();
+	return res;
+}
+
+
+bool Shader::execute(Span<const char> content)
+{
+	PROFILE_FUNCTION();
 	lua_State* root_state = m_renderer.getEngine().getState();
 	lua_State* L = lua_newthread(root_state);
 	const int state_ref = luaL_ref(root_state, LUA_REGISTRYINDEX);
@@ -390,7 +415,6 @@ bool Shader::load(u64 size, const u8* mem)
 	lua_pushcfunction(L, LuaAPI::uniform);
 	lua_setfield(L, LUA_GLOBALSINDEX, "uniform");
 
-	const Span<const char> content((const char*)mem, (int)size);
 	if (!LuaWrapper::execute(L, content, getPath().c_str(), 0)) {
 		luaL_unref(root_state, LUA_REGISTRYINDEX, state_ref);
 		return false;
@@ -403,6 +427,7 @@ bool Shader::load(u64 size, const u8* mem)
 
 void Shader::unload()
 {
+	m_bytecode.free();
 	for (const ProgramPair& p : m_programs) {
 		m_renderer.getEndFrameDrawStream().destroy(p.program);
 	}
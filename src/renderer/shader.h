@@ -3,6 +3,7 @@
 #include "engine/hash.h"
 #include "engine/hash_map.h"
 #include "engine/resource.h"
+#include "engine/stream.h"
 #include "engine/string.h"
 #include "gpu/gpu.h"
 
@@ -130,7 +131,13 @@ public:
 private:
 	void unload() override;
 	bool load(u64 size, const u8* mem) override;
+	bool prepare(u64 size, const u8* mem) override;
+	bool finalize(u64 size, const u8* mem) override;
+	bool execute(Span<const char> content);
 	void onBeforeReady() override;
+
+	// compiled by prepare, executed by finalize
+	OutputMemoryStream m_bytecode;
 };
 
 template<>
@@ -15,6 +15,7 @@
 #include "renderer/draw_stream.h"
 #include "renderer/renderer.h"
 #include "renderer/texture.h"
+#include "renderer/texture_streamer.h"
 #include "stb/stb_image.h"
 
 namespace Lumix
@@ -274,6 +275,60 @@ void Texture::onDataUpdated(u32 x, u32 y, u32 w, u32 h)
 }
 
 
+static void setPendingUpload(Texture& texture, gpu::TextureFlags flags, const Renderer::MemRef& mem, bool has_mips)
+{
+	ASSERT(!texture.pending_upload.data);
+	Texture::PendingUpload& upload = texture.pending_upload;
+	upload.desc.width = texture.width;
+	upload.desc.height = texture.height;
+	upload.desc.depth = texture.depth;
+	upload.desc.mips = texture.mips;
+	upload.desc.format = texture.format;
+	upload.desc.is_cubemap = texture.is_cubemap;
+	upload.flags = flags;
+	upload.data = mem.data;
+	upload.size = mem.size;
+	upload.has_mips = has_mips;
+	upload.first_mip = 0;
+}
+
+
+static Renderer::MemRef takeUploadMemory(Texture::PendingUpload& upload)
+{
+	Renderer::MemRef mem_ref;
+	mem_ref.data = upload.data;
+	mem_ref.size = upload.size;
+	mem_ref.own = true;
+	upload.data = nullptr;
+	upload.size = 0;
+	return mem_ref;
+}
+
+
+// 2D textures only, mips before `first_mip` are skipped
+static bool setMipsUpload(Texture::PendingUpload& upload, Renderer& renderer, const gpu::TextureDesc& desc, const u8* image_data, u32 size, u32 first_mip)
+{
+	ASSERT(!upload.data);
+	ASSERT(desc.depth == 1 && !desc.is_cubemap);
+	u32 offset = 0;
+	for (u32 mip = 0; mip < first_mip; ++mip) {
+		offset += gpu::getSize(desc.format, maximum(desc.width >> mip, 1), maximum(desc.height >> mip, 1));
+	}
+	if (first_mip >= desc.mips || offset >= size) return false;
+
+	const Renderer::MemRef mem = renderer.copy(image_data + offset, size - offset);
+	upload.desc = desc;
+	upload.desc.width = maximum(desc.width >> first_mip, 1);
+	upload.desc.height = maximum(desc.height >> first_mip, 1);
+	upload.desc.mips = desc.mips - first_mip;
+	upload.data = mem.data;
+	upload.size = mem.size;
+	upload.has_mips = true;
+	upload.first_mip = first_mip;
+	return true;
+}
+
+
 static bool loadRaw(Texture& texture, InputMemoryStream& file, IAllocator& allocator)
 {
 	PROFILE_FUNCTION();
@@ -327,16 +382,10 @@ static bool loadRaw(Texture& texture, InputMemoryStream& file, IAllocator& alloc
 
 	const gpu::TextureFlags flag_3d = header.depth > 1 && !header.is_array ? gpu::TextureFlags::IS_3D : gpu::TextureFlags::NONE;
 
-	texture.handle = texture.renderer.createTexture(texture.width
-		, texture.height
-		, texture.depth
-		, texture.format
-		, (texture.getGPUFlags() & ~gpu::TextureFlags::SRGB) | flag_3d | gpu::TextureFlags::NO_MIPS 
-		, dst_mem
-		, texture.getPath().c_str());
 	texture.mips = 1;
 	texture.is_cubemap = false;
-	return texture.handle;
+	setPendingUpload(texture, (texture.getGPUFlags() & ~gpu::TextureFlags::SRGB) | flag_3d | gpu::TextureFlags::NO_MIPS, dst_mem, false);
+	return true;
 }
 
 
@@ -388,15 +437,9 @@ bool Texture::loadTGA(IInputStream& file)
 		if (data_reference) mem = renderer.copy(image_dest, image_size);
 		const bool is_srgb = flags & (u32)Flags::SRGB;
 		format = is_srgb ? gpu::TextureFormat::SRGBA : gpu::TextureFormat::RGBA8;
-		handle = renderer.createTexture(header.width
-			, header.height
-			, 1
-			, format
-			, getGPUFlags() & ~gpu::TextureFlags::SRGB | gpu::TextureFlags::NO_MIPS
-			, mem
-			, getPath().c_str());
 		depth = 1;
-		return handle;
+		setPendingUpload(*this, getGPUFlags() & ~gpu::TextureFlags::SRGB | gpu::TextureFlags::NO_MIPS, mem, false);
+		return true;
 	}
 
 	if (header.bitsPerPixel < 24)
@@ -503,15 +546,9 @@ bool Texture::loadTGA(IInputStream& file)
 	if (data_reference) mem = renderer.copy(image_dest, image_size);
 	const bool is_srgb = flags & (u32)Flags::SRGB;
 	format = is_srgb ? gpu::TextureFormat::SRGBA : gpu::TextureFormat::RGBA8;
-	handle = renderer.createTexture(header.width
-		, header.height
-		, 1
-		, format
-		, getGPUFlags() & ~gpu::TextureFlags::SRGB | gpu::TextureFlags::NO_MIPS
-		, mem
-		, getPath().c_str());
 	depth = 1;
-	return handle;
+	setPendingUpload(*this, getGPUFlags() & ~gpu::TextureFlags::SRGB | gpu::TextureFlags::NO_MIPS, mem, false);
+	return true;
 }
 
 
@@ -548,13 +585,11 @@ u8* Texture::getLBCInfo(const void* data, gpu::TextureDesc& desc) {
 	return (u8*)data + sizeof(*hdr);
 }
 
-static gpu::TextureHandle loadTexture(Renderer& renderer, const gpu::TextureDesc& desc, const Renderer::MemRef& memory, gpu::TextureFlags flags, const char* debug_name)
+// creates texture on an existing handle, if the handle already has a texture, it's replaced
+static void uploadTexture(Renderer& renderer, gpu::TextureHandle handle, const gpu::TextureDesc& desc, const Renderer::MemRef& memory, gpu::TextureFlags flags, const char* debug_name)
 {
 	ASSERT(memory.size > 0);
 
-	const gpu::TextureHandle handle = gpu::allocTextureHandle();
-	if (!handle) return handle;
-
 	DrawStream& stream = renderer.getDrawStream();
 	if (desc.is_cubemap) flags = flags | gpu::TextureFlags::IS_CUBE;
 	if (desc.mips < 2) flags = flags | gpu::TextureFlags::NO_MIPS;
@@ -575,6 +610,14 @@ static gpu::TextureHandle loadTexture(Renderer& renderer, const gpu::TextureDesc
 	}
 	ASSERT(memory.own);
 	stream.freeMemory(memory.data, renderer.getAllocator());
+}
+
+static gpu::TextureHandle loadTexture(Renderer& renderer, const gpu::TextureDesc& desc, const Renderer::MemRef& memory, gpu::TextureFlags flags, const char* debug_name)
+{
+	const gpu::TextureHandle handle = gpu::allocTextureHandle();
+	if (!handle) return handle;
+
+	uploadTexture(renderer, handle, desc, memory, flags, debug_name);
 	return handle;
 }
 
@@ -638,17 +681,14 @@ static gpu::TextureHandle loadTexture(Renderer& renderer, const gpu::TextureDesc
 					}
 					
 					Renderer::MemRef mem = texture.renderer.copy(tmp.data(), (u32)tmp.size());
-					texture.handle = loadTexture(texture.renderer, desc, mem, texture.getGPUFlags(), texture.getPath().c_str());
-					if (texture.handle) {
-						texture.mips = info.m_total_levels;
-						texture.width = desc.width;
-						texture.height = desc.height;
-						texture.mips = desc.mips;
-						texture.depth = desc.depth;
-						texture.is_cubemap = desc.is_cubemap;
-					}
-
-					return texture.handle;
+					texture.width = desc.width;
+					texture.height = desc.height;
+					texture.mips = desc.mips;
+					texture.depth = desc.depth;
+					texture.is_cubemap = desc.is_cubemap;
+					texture.format = desc.format;
+					setPendingUpload(texture, texture.getGPUFlags(), mem, true);
+					return true;
 				}
 			}
 		}
@@ -679,18 +719,29 @@ static bool loadLBC(Texture& texture, const u8* data, u32 size)
 		}
 	}
 
-	Renderer::MemRef mem = texture.renderer.copy(image_data, size - offset);
-	texture.handle = loadTexture(texture.renderer, desc, mem, texture.getGPUFlags(), texture.getPath().c_str());
-	if (texture.handle) {
-		texture.width = desc.width;
-		texture.height = desc.height;
-		texture.mips = desc.mips;
-		texture.depth = desc.depth;
-		texture.is_cubemap = desc.is_cubemap;
-		texture.format = desc.format;
+	texture.width = desc.width;
+	texture.height = desc.height;
+	texture.mips = desc.mips;
+	texture.depth = desc.depth;
+	texture.is_cubemap = desc.is_cubemap;
+	texture.format = desc.format;
+
+	// textures accessed on cpu or with point filter are usually data, not something seen from a distance
+	const bool is_streamable = desc.depth == 1
+		&& !desc.is_cubemap
+		&& texture.data_reference == 0
+		&& (texture.flags & (u32)Texture::Flags::POINT) == 0
+		&& !startsWith(texture.getPath().c_str(), ".lumix/asset_tiles/");
+	const u32 tail_mip = is_streamable ? TextureStreamer::getTailMip(desc.width, desc.height, desc.mips) : 0;
+	if (tail_mip > 0) {
+		// only the mip tail is uploaded now, TextureStreamer loads the rest when it's visible
+		texture.pending_upload.flags = texture.getGPUFlags();
+		return setMipsUpload(texture.pending_upload, texture.renderer, desc, image_data, size - offset, tail_mip);
 	}
 
-	return texture.handle;
+	Renderer::MemRef mem = texture.renderer.copy(image_data, size - offset);
+	setPendingUpload(texture, texture.getGPUFlags(), mem, true);
+	return true;
 }
 
 gpu::TextureFlags Texture::getGPUFlags() const
@@ -719,6 +770,13 @@ gpu::TextureFlags Texture::getGPUFlags() const
 
 
 bool Texture::load(u64 size, const u8* mem)
+{
+	return prepare(size, mem) && finalize(size, mem);
+}
+
+
+// decodes texture on a worker, only the upload to gpu is left for finalize
+bool Texture::prepare(u64 size, const u8* mem)
 {
 	PROFILE_FUNCTION();
 	profiler::pushString(getPath().c_str());
@@ -760,8 +818,101 @@ bool Texture::load(u64 size, const u8* mem)
 }
 
 
+bool Texture::finalize(u64 size, const u8* mem)
+{
+	PROFILE_FUNCTION();
+	ASSERT(pending_upload.data);
+	const Renderer::MemRef mem_ref = takeUploadMemory(pending_upload);
+
+	if (pending_upload.has_mips) {
+		handle = loadTexture(renderer, pending_upload.desc, mem_ref, pending_upload.flags, getPath().c_str());
+	}
+	else {
+		const gpu::TextureDesc& desc = pending_upload.desc;
+		handle = renderer.createTexture(desc.width, desc.height, desc.depth, desc.format, pending_upload.flags, mem_ref, getPath().c_str());
+	}
+	resident_mip = pending_upload.first_mip;
+	if (handle && resident_mip > 0) renderer.getTextureStreamer().add(*this);
+	return handle;
+}
+
+
+bool Texture::streamMips(u32 first_mip)
+{
+	ASSERT(!m_stream_request.isValid());
+	ASSERT(!m_streamed_upload.data);
+	if (!handle || first_mip == resident_mip) return false;
+
+	m_streamed_upload.first_mip = first_mip;
+	m_streamed_upload.flags = getGPUFlags();
+	FileSystem& fs = m_resource_manager.getOwner().getFileSystem();
+	const Path res_path(".lumix/resources/", getPath().getHash(), ".res");
+	const FileSystem::PrepareCallback prepare_cb = makeDelegate<&Texture::prepareStreamedMips>(this);
+	const FileSystem::ContentCallback cb = makeDelegate<&Texture::onStreamedMipsLoaded>(this);
+	m_stream_request = fs.getContent(res_path, prepare_cb, cb, FileSystem::Priority::LOW);
+	return m_stream_request.isValid();
+}
+
+
+// runs on a worker, copies requested mips from the compiled texture
+bool Texture::prepareStreamedMips(Span<const u8> content, OutputMemoryStream& output)
+{
+	PROFILE_FUNCTION();
+	u32 offset;
+	if (!unpackCompiledContent(content, output, offset)) return false;
+
+	// mips are copied to m_streamed_upload, so `output` is just scratch memory for decompression
+	const Span<const u8> unpacked = output.empty() ? content : Span<const u8>(output);
+	InputMemoryStream file(unpacked.begin() + offset, unpacked.length() - offset);
+	char ext[4] = {};
+	u32 file_flags;
+	if (!file.read(ext, 3) || !file.read(&file_flags, sizeof(file_flags))) return false;
+	if (!equalIStrings(ext, "lbc")) return false;
+
+	const u8* data = (const u8*)file.getBuffer() + file.getPosition();
+	const u32 size = u32(file.size() - file.getPosition());
+	if (size < sizeof(LBCHeader)) return false;
+
+	gpu::TextureDesc desc;
+	const u8* image_data = getLBCInfo(data, desc);
+	// file changed since the texture was loaded, it's going to be reloaded anyway
+	if (!image_data || desc.width != width || desc.height != height || desc.mips != mips || desc.format != format) return false;
+
+	return setMipsUpload(m_streamed_upload, renderer, desc, image_data, size - u32(image_data - data), m_streamed_upload.first_mip);
+}
+
+
+void Texture::onStreamedMipsLoaded(u64 size, const u8* mem, bool success)
+{
+	m_stream_request = FileSystem::AsyncHandle::invalid();
+	if (!success || !m_streamed_upload.data) {
+		// keep what's on gpu and do not try again
+		logWarning("Failed to stream texture ", getPath());
+		if (m_streamed_upload.data) renderer.free(takeUploadMemory(m_streamed_upload));
+		renderer.getTextureStreamer().remove(*this);
+		return;
+	}
+
+	const Renderer::MemRef mem_ref = takeUploadMemory(m_streamed_upload);
+	uploadTexture(renderer, handle, m_streamed_upload.desc, mem_ref, m_streamed_upload.flags, getPath().c_str());
+	resident_mip = m_streamed_upload.first_mip;
+}
+
+
 void Texture::unload()
 {
+	if (pending_upload.data) {
+		// prepared, but never finalized
+		renderer.free(takeUploadMemory(pending_upload));
+	}
+	if (m_stream_request.isValid()) {
+		// waits for prepareStreamedMips if it's running
+		m_resource_manager.getOwner().getFileSystem().cancel(m_stream_request);
+		m_stream_request = FileSystem::AsyncHandle::invalid();
+	}
+	if (m_streamed_upload.data) renderer.free(takeUploadMemory(m_streamed_upload));
+	if (streaming_idx != NOT_STREAMED) renderer.getTextureStreamer().remove(*this);
+	resident_mip = 0;
 	if (handle) {
 		renderer.getEndFrameDrawStream().destroy(handle);
 		handle = gpu::INVALID_TEXTURE;
@@ -127,10 +127,41 @@ struct LUMIX_RENDERER_API Texture final : Resource {
 	OutputMemoryStream data;
 	Renderer& renderer;
 
+	// decoded by prepare on a worker, uploaded to gpu by finalize on the main thread
+	struct PendingUpload {
+		gpu::TextureDesc desc;
+		gpu::TextureFlags flags;
+		// allocated by Renderer::allocate
+		void* data = nullptr;
+		u32 size = 0;
+		// data contains all mips of all layers, otherwise it's just the first mip
+		bool has_mips = false;
+		// mips before this one are not in data, they are streamed later
+		u32 first_mip = 0;
+	};
+	PendingUpload pending_upload;
+
+	static constexpr u32 NOT_STREAMED = 0xffFFffFF;
+	// first mip on gpu, mips before it are streamed in by TextureStreamer when needed
+	u32 resident_mip = 0;
+	// index in TextureStreamer
+	u32 streaming_idx = NOT_STREAMED;
+
+	// reads the texture again and recreates it on gpu with mips from `first_mip`, handle does not change
+	bool streamMips(u32 first_mip);
+	bool isStreaming() const { return m_stream_request.isValid(); }
+
 private:
 	void unload() override;
 	bool load(u64 size, const u8* mem) override;
+	bool prepare(u64 size, const u8* mem) override;
+	bool finalize(u64 size, const u8* mem) override;
 	bool loadTGA(IInputStream& file);
+	bool prepareStreamedMips(Span<const u8> content, OutputMemoryStream& output);
+	void onStreamedMipsLoaded(u64 size, const u8* mem, bool success);
+
+	FileSystem::AsyncHandle m_stream_request = FileSystem::AsyncHandle::invalid();
+	PendingUpload m_streamed_upload;
 };
 
 
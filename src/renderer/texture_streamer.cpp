@@ -0,0 +1,204 @@
+#include "engine/log.h"
+#include "engine/math.h"
+#include "engine/profiler.h"
+#include "engine/resource_manager.h"
+#include "renderer/material.h"
+#include "renderer/renderer.h"
+#include "renderer/texture.h"
+#include "renderer/texture_streamer.h"
+
+
+namespace Lumix
+{
+
+
+TextureStreamer::TextureStreamer(Renderer& renderer, IAllocator& allocator)
+	: m_renderer(renderer)
+	, m_allocator(allocator)
+	, m_textures(allocator)
+	, m_items(allocator)
+	, m_last_seen_frames(allocator)
+{}
+
+
+u32 TextureStreamer::getTailMip(u32 w, u32 h, u32 mips) {
+	u32 mip = 0;
+	while (mip + 1 < mips && maximum(w >> mip, h >> mip) > MIP_TAIL_SIZE) ++mip;
+	return mip;
+}
+
+
+u32 TextureStreamer::getWantedMip(u32 size, u32 tail_mip, u32 screen_size) {
+	if (screen_size == 0) return tail_mip;
+	u32 mip = 0;
+	while (mip < tail_mip && (size >> (mip + 1)) >= screen_size) ++mip;
+	return mip;
+}
+
+
+u64 TextureStreamer::getSize(const Item& item, u32 first_mip) {
+	u64 size = 0;
+	for (u32 mip = first_mip; mip < item.mips; ++mip) size += item.mip_sizes[mip];
+	return size;
+}
+
+
+u64 TextureStreamer::computeTargets(Span<Item> items, u64 budget, IAllocator& allocator) {
+	PROFILE_FUNCTION();
+	// keep what's resident if there's enough memory, so textures do not flicker between mips
+	u64 total = 0;
+	for (Item& item : items) {
+		item.target_mip = minimum(item.wanted_mip, item.resident_mip);
+		total += getSize(item, item.target_mip);
+	}
+	if (total <= budget) return total;
+
+	// drop mips nobody needs
+	for (Item& item : items) {
+		if (item.target_mip < item.wanted_mip) {
+			total -= getSize(item, item.target_mip) - getSize(item, item.wanted_mip);
+			item.target_mip = item.wanted_mip;
+		}
+	}
+	if (total <= budget) return total;
+
+	// still over budget, drop mips of textures with the most texels per pixel on screen first
+	auto texels_per_pixel = [&](u32 idx){
+		const Item& item = items[idx];
+		return float(item.size >> item.target_mip) / maximum(item.screen_size, 1);
+	};
+	auto less = [&](u32 a, u32 b){ return texels_per_pixel(a) < texels_per_pixel(b); };
+
+	// max heap of items which can still drop a mip
+	Array<u32> heap(allocator);
+	heap.reserve(items.length());
+	auto sift_down = [&](u32 i){
+		for (;;) {
+			const u32 l = i * 2 + 1;
+			const u32 r = l + 1;
+			u32 biggest = i;
+			if (l < (u32)heap.size() && less(heap[biggest], heap[l])) biggest = l;
+			if (r < (u32)heap.size() && less(heap[biggest], heap[r])) biggest = r;
+			if (biggest == i) return;
+			swap(heap[i], heap[biggest]);
+			i = biggest;
+		}
+	};
+	for (u32 i = 0; i < items.length(); ++i) {
+		if (items[i].target_mip < items[i].tail_mip) heap.push(i);
+	}
+	for (i32 i = heap.size() / 2 - 1; i >= 0; --i) sift_down(i);
+
+	while (total > budget && !heap.empty()) {
+		Item& item = items[heap[0]];
+		total -= item.mip_sizes[item.target_mip];
+		++item.target_mip;
+		if (item.target_mip == item.tail_mip) {
+			heap[0] = heap.back();
+			heap.pop();
+		}
+		if (!heap.empty()) sift_down(0);
+	}
+	return total;
+}
+
+
+void TextureStreamer::add(Texture& texture) {
+	ASSERT(texture.streaming_idx == Texture::NOT_STREAMED);
+	ASSERT(texture.mips <= MAX_MIPS);
+	texture.streaming_idx = m_textures.size();
+	m_textures.push(&texture);
+	m_last_seen_frames.push(m_frame);
+
+	Item& item = m_items.emplace();
+	item.mips = texture.mips;
+	item.size = maximum(texture.width, texture.height);
+	item.tail_mip = getTailMip(texture.width, texture.height, texture.mips);
+	item.resident_mip = texture.resident_mip;
+	item.wanted_mip = item.tail_mip;
+	item.screen_size = 0;
+	item.target_mip = texture.resident_mip;
+	for (u32 mip = 0; mip < item.mips; ++mip) {
+		item.mip_sizes[mip] = gpu::getSize(texture.format, maximum(texture.width >> mip, 1), maximum(texture.height >> mip, 1));
+	}
+}
+
+
+void TextureStreamer::remove(Texture& texture) {
+	const u32 idx = texture.streaming_idx;
+	ASSERT(m_textures[idx] == &texture);
+	texture.streaming_idx = Texture::NOT_STREAMED;
+	if (idx + 1 != (u32)m_textures.size()) {
+		m_textures.back()->streaming_idx = idx;
+	}
+	m_textures.swapAndPop(idx);
+	m_items.swapAndPop(idx);
+	m_last_seen_frames.swapAndPop(idx);
+}
+
+
+void TextureStreamer::update(ResourceManager& material_manager, const gpu::MemoryStats* memory_stats) {
+	PROFILE_FUNCTION();
+	++m_frame;
+
+	for (Resource* res : material_manager.getResourceTable()) {
+		Material* material = static_cast<Material*>(res);
+		const u32 screen_size = material->consumeRequestedTextureSize();
+		if (screen_size == 0) continue;
+
+		for (i32 i = 0, c = material->getTextureCount(); i < c; ++i) {
+			Texture* texture = material->getTexture(i);
+			if (!texture || texture->streaming_idx == Texture::NOT_STREAMED) continue;
+
+			Item& item = m_items[texture->streaming_idx];
+			item.screen_size = maximum(item.screen_size, screen_size);
+			m_last_seen_frames[texture->streaming_idx] = m_frame;
+		}
+	}
+
+	for (u32 i = 0, c = m_items.size(); i < c; ++i) {
+		Item& item = m_items[i];
+		item.resident_mip = m_textures[i]->resident_mip;
+		if (item.screen_size > 0) {
+			item.wanted_mip = getWantedMip(item.size, item.tail_mip, item.screen_size);
+		}
+		else if (m_frame - m_last_seen_frames[i] > UNUSED_FRAMES) {
+			item.wanted_mip = item.tail_mip;
+		}
+		// otherwise it's not visible just for a moment, keep what it wanted before
+	}
+
+	u64 budget = m_budget;
+	// do not take more than half of the video memory, the rest is for buffers, render targets, other apps...
+	if (memory_stats && memory_stats->dedicated_vidmem > 0) budget = minimum(budget, memory_stats->dedicated_vidmem / 2);
+	computeTargets(m_items, budget, m_allocator);
+
+	u32 pending = 0;
+	for (Texture* texture : m_textures) {
+		if (texture->isStreaming()) ++pending;
+	}
+	// evict first, so the memory is free for mips streamed in
+	for (u32 i = 0, c = m_items.size(); i < c && pending < MAX_PENDING_REQUESTS; ++i) {
+		const Item& item = m_items[i];
+		Texture* texture = m_textures[i];
+		if (item.target_mip <= item.resident_mip || texture->isStreaming()) continue;
+		if (texture->streamMips(item.target_mip)) ++pending;
+	}
+	for (u32 i = 0, c = m_items.size(); i < c && pending < MAX_PENDING_REQUESTS; ++i) {
+		const Item& item = m_items[i];
+		Texture* texture = m_textures[i];
+		if (item.target_mip >= item.resident_mip || texture->isStreaming()) continue;
+		if (texture->streamMips(item.target_mip)) ++pending;
+	}
+
+	m_resident_size = 0;
+	for (Item& item : m_items) {
+		m_resident_size += getSize(item, item.resident_mip);
+		item.screen_size = 0;
+	}
+	static u32 resident_counter = profiler::createCounter("Streamed textures (MB)", 0);
+	profiler::pushCounter(resident_counter, float(double(m_resident_size) / (1024.0 * 1024.0)));
+}
+
+
+} // namespace Lumix
@@ -0,0 +1,78 @@
+#pragma once
+
+
+#include "engine/array.h"
+#include "engine/lumix.h"
+
+
+namespace Lumix
+{
+
+struct Renderer;
+struct ResourceManager;
+struct Texture;
+namespace gpu { struct MemoryStats; }
+
+// decides which mips of streamable textures are on gpu
+// textures start with the mip tail, higher mips are streamed in when meshes using them are big enough on screen
+// and evicted when textures do not fit in the budget
+struct LUMIX_RENDERER_API TextureStreamer {
+	static constexpr u32 MAX_MIPS = 16;
+	// mips up to this size are always on gpu
+	static constexpr u32 MIP_TAIL_SIZE = 64;
+	static constexpr u32 MAX_PENDING_REQUESTS = 8;
+	// textures which are not visible for this number of frames do not need their higher mips
+	static constexpr u32 UNUSED_FRAMES = 120;
+
+	// input and output of computeTargets, it does not touch gpu, so streaming decisions can be made and tested without one
+	struct Item {
+		// size in bytes of each mip
+		u64 mip_sizes[MAX_MIPS];
+		u32 mips;
+		// max(width, height) of mip 0
+		u32 size;
+		u32 tail_mip;
+		u32 resident_mip;
+		u32 wanted_mip;
+		// size in pixels of the biggest mesh using the texture on screen, 0 if not visible
+		u32 screen_size;
+		// computed by computeTargets
+		u32 target_mip;
+	};
+
+	TextureStreamer(Renderer& renderer, IAllocator& allocator);
+
+	// first mip of the tail, 0 if texture is small enough to not be streamed
+	static u32 getTailMip(u32 w, u32 h, u32 mips);
+	// first mip needed to render texture `screen_size` pixels big
+	static u32 getWantedMip(u32 size, u32 tail_mip, u32 screen_size);
+	// size in bytes of mips from `first_mip` to the last one
+	static u64 getSize(const Item& item, u32 first_mip);
+	// keeps resident mips while they fit in the budget, otherwise drops mips which are not wanted
+	// and then mips with the most texels per pixel on screen; returns size of all targets
+	static u64 computeTargets(Span<Item> items, u64 budget, IAllocator& allocator);
+
+	void add(Texture& texture);
+	void remove(Texture& texture);
+	// collects screen sizes from materials, computes targets and starts streaming of textures
+	// `memory_stats` can be null if they are not available
+	void update(ResourceManager& material_manager, const gpu::MemoryStats* memory_stats);
+
+	u64 getBudget() const { return m_budget; }
+	void setBudget(u64 budget) { m_budget = budget; }
+	u64 getResidentSize() const { return m_resident_size; }
+
+private:
+	Renderer& m_renderer;
+	IAllocator& m_allocator;
+	// m_items[i] belongs to m_textures[i]
+	Array<Texture*> m_textures;
+	Array<Item> m_items;
+	Array<u32> m_last_seen_frames;
+	u64 m_budget = 1024 * 1024 * 1024;
+	u64 m_resident_size = 0;
+	u32 m_frame = 0;
+};
+
+
+} // namespace Lumix
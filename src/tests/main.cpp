@@ -0,0 +1,65 @@
+#include "engine/allocators.h"
+#include "engine/log.h"
+#include "engine/profiler.h"
+#include "engine/string.h"
+#include "tests/tests.h"
+#include <stdio.h>
+
+using namespace Lumix;
+
+static tests::Test* g_first_test = nullptr;
+static tests::Test** g_last_test = &g_first_test;
+static u32 g_failures = 0;
+
+tests::Test::Test(const char* name, TestFunction function)
+	: name(name)
+	, function(function)
+	, next(nullptr)
+{
+	*g_last_test = this;
+	g_last_test = &next;
+}
+
+void tests::fail(const char* file, int line, const char* expression) {
+	logError(file, "(", line, "): ", expression);
+	++g_failures;
+}
+
+static void logToStdout(LogLevel level, const char* message) {
+	if (level == LogLevel::ERROR) printf("Error: ");
+	printf("%s\n", message);
+	fflush(stdout);
+}
+
+// usage: tests [name...], runs all tests if no name is given, returns number of failed tests
+int main(int argc, char* argv[]) {
+	profiler::setThreadName("Main thread");
+	registerLogCallback<logToStdout>();
+
+	DefaultAllocator allocator;
+	u32 run_count = 0;
+	u32 failed_count = 0;
+	for (tests::Test* t = g_first_test; t; t = t->next) {
+		bool selected = argc < 2;
+		for (int i = 1; i < argc; ++i) {
+			selected = selected || equalStrings(argv[i], t->name);
+		}
+		if (!selected) continue;
+
+		const u32 failures = g_failures;
+		t->function(allocator);
+		++run_count;
+		if (g_failures != failures) {
+			++failed_count;
+			logInfo("FAILED ", t->name);
+		}
+		else {
+			logInfo("OK ", t->name);
+		}
+	}
+
+	if (run_count == 0) logError("No test matches the command line.");
+	else logInfo(run_count - failed_count, "/", run_count, " tests passed");
+	unregisterLogCallback<logToStdout>();
+	return run_count == 0 ? 1 : failed_count;
+}
@@ -0,0 +1,99 @@
+#include "engine/array.h"
+#include "engine/crt.h"
+#include "engine/math.h"
+#include "renderer/pose.h"
+#include "tests/tests.h"
+
+using namespace Lumix;
+
+static void randomizePose(Pose& pose, u32 count) {
+	pose.resize(count);
+	for (u32 i = 0; i < count; ++i) {
+		pose.positions[i] = Vec3(randFloat(-10, 10), randFloat(-10, 10), randFloat(-10, 10));
+		pose.rotations[i] = normalize(Quat(randFloat(-1, 1), randFloat(-1, 1), randFloat(-1, 1), randFloat(-1, 1)));
+	}
+}
+
+static void copyPose(Pose& dst, const Pose& src) {
+	dst.resize(src.count);
+	memcpy(dst.positions, src.positions, sizeof(src.positions[0]) * src.count);
+	memcpy(dst.rotations, src.rotations, sizeof(src.rotations[0]) * src.count);
+}
+
+// the same math as Pose::blend, one bone at a time
+static void blendScalar(Pose& pose, const Pose& rhs, const float* weights, u32 from, u32 to) {
+	for (u32 i = from; i < to; ++i) {
+		const float w = weights[i];
+		pose.positions[i] = pose.positions[i] * (1 - w) + rhs.positions[i] * w;
+		pose.rotations[i] = nlerp(pose.rotations[i], rhs.rotations[i], w);
+	}
+}
+
+// bitwise, SIMD results must not differ from scalar ones at all
+static bool equalPoses(const Pose& a, const Pose& b) {
+	return a.count == b.count
+		&& memcmp(a.positions, b.positions, sizeof(a.positions[0]) * a.count) == 0
+		&& memcmp(a.rotations, b.rotations, sizeof(a.rotations[0]) * a.count) == 0;
+}
+
+LUMIX_TEST(pose_blend) {
+	Pose pose(allocator), rhs(allocator), expected(allocator);
+	Array<float> weights(allocator);
+	// counts which are not multiple of 4 test the scalar tail
+	for (u32 iteration = 0; iteration < 500; ++iteration) {
+		const u32 count = rand(1, 130);
+		randomizePose(pose, count);
+		randomizePose(rhs, count);
+		copyPose(expected, pose);
+		const float weight = randFloat(0.002f, 1);
+		weights.clear();
+		for (u32 i = 0; i < count; ++i) weights.push(weight);
+
+		blendScalar(expected, rhs, weights.begin(), 0, count);
+		pose.blend(rhs, weight);
+		LUMIX_EXPECT(equalPoses(pose, expected));
+	}
+}
+
+LUMIX_TEST(pose_blend_masked) {
+	Pose pose(allocator), rhs(allocator), expected(allocator);
+	Array<float> weights(allocator);
+	for (u32 iteration = 0; iteration < 500; ++iteration) {
+		const u32 count = rand(1, 130);
+		randomizePose(pose, count);
+		randomizePose(rhs, count);
+		copyPose(expected, pose);
+		weights.clear();
+		for (u32 i = 0; i < count; ++i) weights.push(rand(0, 3) == 0 ? 0 : randFloat(0, 1));
+
+		blendScalar(expected, rhs, weights.begin(), 0, count);
+		pose.blend(rhs, weights);
+		LUMIX_EXPECT(equalPoses(pose, expected));
+	}
+}
+
+LUMIX_TEST(pose_blend_range) {
+	Pose pose(allocator), rhs(allocator), expected(allocator);
+	Array<float> weights(allocator);
+	for (u32 iteration = 0; iteration < 500; ++iteration) {
+		const u32 count = rand(1, 130);
+		const u32 from = rand(0, count - 1);
+		const u32 to = rand(from, count);
+		randomizePose(pose, count);
+		randomizePose(rhs, count);
+		copyPose(expected, pose);
+		weights.clear();
+		for (u32 i = 0; i < count; ++i) weights.push(randFloat(0, 1));
+
+		// bones outside of the range must not change
+		blendScalar(expected, rhs, weights.begin(), from, to);
+		pose.blend(rhs, weights, from, to);
+		LUMIX_EXPECT(equalPoses(pose, expected));
+
+		const float weight = randFloat(0.002f, 1);
+		for (float& w : weights) w = weight;
+		blendScalar(expected, rhs, weights.begin(), from, to);
+		pose.blend(rhs, weight, from, to);
+		LUMIX_EXPECT(equalPoses(pose, expected));
+	}
+}
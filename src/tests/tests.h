@@ -0,0 +1,34 @@
+#pragma once
+
+#include "engine/lumix.h"
+
+namespace Lumix {
+
+struct IAllocator;
+
+namespace tests {
+
+using TestFunction = void (*)(IAllocator& allocator);
+
+// registered with LUMIX_TEST
+struct Test {
+	Test(const char* name, TestFunction function);
+
+	const char* name;
+	TestFunction function;
+	Test* next;
+};
+
+// marks the running test as failed, the test continues
+void fail(const char* file, int line, const char* expression);
+
+} // namespace tests
+
+#define LUMIX_TEST(NAME) \
+	static void test_##NAME(IAllocator& allocator); \
+	static tests::Test test_registration_##NAME(#NAME, test_##NAME); \
+	static void test_##NAME(IAllocator& allocator)
+
+#define LUMIX_EXPECT(x) do { if (!(x)) tests::fail(__FILE__, __LINE__, #x); } while (false)
+
+} // namespace Lumix
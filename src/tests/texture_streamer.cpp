@@ -0,0 +1,155 @@
+#include "engine/array.h"
+#include "engine/crt.h"
+#include "engine/math.h"
+#include "renderer/texture_streamer.h"
+#include "tests/tests.h"
+
+using namespace Lumix;
+
+// square RGBA8 texture with a full mip chain, `screen_size` == 0 means it's not visible
+static TextureStreamer::Item makeItem(u32 size, u32 screen_size, u32 resident_mip) {
+	TextureStreamer::Item item = {};
+	item.size = size;
+	item.mips = 1;
+	while ((size >> item.mips) > 0) ++item.mips;
+	for (u32 mip = 0; mip < item.mips; ++mip) {
+		const u64 mip_size = size >> mip;
+		item.mip_sizes[mip] = mip_size * mip_size * 4;
+	}
+	item.tail_mip = TextureStreamer::getTailMip(size, size, item.mips);
+	item.screen_size = screen_size;
+	item.wanted_mip = TextureStreamer::getWantedMip(size, item.tail_mip, screen_size);
+	item.resident_mip = resident_mip;
+	return item;
+}
+
+static u64 getTargetsSize(Span<const TextureStreamer::Item> items) {
+	u64 size = 0;
+	for (const TextureStreamer::Item& item : items) size += TextureStreamer::getSize(item, item.target_mip);
+	return size;
+}
+
+LUMIX_TEST(texture_streamer_tail_mip) {
+	// 4096 >> 6 == MIP_TAIL_SIZE
+	LUMIX_EXPECT(TextureStreamer::getTailMip(4096, 4096, 13) == 6);
+	LUMIX_EXPECT(TextureStreamer::getTailMip(4096, 1024, 13) == 6);
+	LUMIX_EXPECT(TextureStreamer::getTailMip(1024, 4096, 13) == 6);
+	// small textures are not streamed
+	LUMIX_EXPECT(TextureStreamer::getTailMip(64, 64, 7) == 0);
+	LUMIX_EXPECT(TextureStreamer::getTailMip(16, 16, 5) == 0);
+	// last mip is the tail if the texture does not have enough mips
+	LUMIX_EXPECT(TextureStreamer::getTailMip(4096, 4096, 3) == 2);
+	LUMIX_EXPECT(TextureStreamer::getTailMip(4096, 4096, 1) == 0);
+}
+
+LUMIX_TEST(texture_streamer_wanted_mip) {
+	// not visible
+	LUMIX_EXPECT(TextureStreamer::getWantedMip(1024, 4, 0) == 4);
+	// as big as the texture or bigger on screen
+	LUMIX_EXPECT(TextureStreamer::getWantedMip(1024, 4, 1024) == 0);
+	LUMIX_EXPECT(TextureStreamer::getWantedMip(1024, 4, 4000) == 0);
+	// smallest mip which is at least as big as the screen size
+	LUMIX_EXPECT(TextureStreamer::getWantedMip(1024, 4, 512) == 1);
+	LUMIX_EXPECT(TextureStreamer::getWantedMip(1024, 4, 300) == 1);
+	LUMIX_EXPECT(TextureStreamer::getWantedMip(1024, 4, 256) == 2);
+	// never below the tail
+	LUMIX_EXPECT(TextureStreamer::getWantedMip(1024, 4, 1) == 4);
+	LUMIX_EXPECT(TextureStreamer::getWantedMip(1024, 0, 1) == 0);
+}
+
+LUMIX_TEST(texture_streamer_keep_resident) {
+	TextureStreamer::Item items[] = {
+		// resident mips are kept if they fit, even if they are not wanted
+		makeItem(1024, 128, 0),
+		makeItem(1024, 0, 2),
+		// wanted mips are streamed in
+		makeItem(2048, 2048, 5),
+	};
+	const u64 total = TextureStreamer::computeTargets(Span(items), 1024 * 1024 * 1024, allocator);
+	LUMIX_EXPECT(items[0].target_mip == 0);
+	LUMIX_EXPECT(items[1].target_mip == 2);
+	LUMIX_EXPECT(items[2].target_mip == 0);
+	LUMIX_EXPECT(total == getTargetsSize(Span(items)));
+}
+
+LUMIX_TEST(texture_streamer_drop_unwanted) {
+	TextureStreamer::Item items[] = {
+		makeItem(1024, 128, 0),
+		makeItem(1024, 0, 0),
+		makeItem(1024, 1024, 0),
+	};
+	// wanted mips fit, resident do not
+	const u64 wanted_size = TextureStreamer::getSize(items[0], items[0].wanted_mip)
+		+ TextureStreamer::getSize(items[1], items[1].wanted_mip)
+		+ TextureStreamer::getSize(items[2], items[2].wanted_mip);
+	const u64 total = TextureStreamer::computeTargets(Span(items), wanted_size + 1, allocator);
+	LUMIX_EXPECT(total == wanted_size);
+	LUMIX_EXPECT(total == getTargetsSize(Span(items)));
+	for (const TextureStreamer::Item& item : items) LUMIX_EXPECT(item.target_mip == item.wanted_mip);
+}
+
+LUMIX_TEST(texture_streamer_eviction_order) {
+	// all want and have mip 0, with different texels per pixel on screen
+	const TextureStreamer::Item items[] = {
+		makeItem(1024, 1000, 0), // 1.02 texels per pixel
+		makeItem(1024, 520, 0), // 1.97
+		makeItem(1024, 600, 0), // 1.71
+	};
+	for (const TextureStreamer::Item& item : items) LUMIX_EXPECT(item.wanted_mip == 0);
+	const u64 full_size = getTargetsSize(Span(items));
+
+	// each step is exactly one more mip 0 over the budget, so it drops mip 0 of the next texture
+	// in the order of texels per pixel, which are all below 1 with mip 1
+	const u32 expected_order[] = { 1, 2, 0 };
+	for (u32 step = 1; step <= lengthOf(expected_order); ++step) {
+		TextureStreamer::Item tmp[lengthOf(items)];
+		memcpy(tmp, items, sizeof(items));
+		const u64 budget = full_size - step * items[0].mip_sizes[0];
+		const u64 total = TextureStreamer::computeTargets(Span(tmp), budget, allocator);
+		LUMIX_EXPECT(total == budget);
+		LUMIX_EXPECT(total == getTargetsSize(Span(tmp)));
+		for (u32 i = 0; i < lengthOf(expected_order); ++i) {
+			LUMIX_EXPECT(tmp[expected_order[i]].target_mip == (i < step ? 1u : 0u));
+		}
+	}
+}
+
+LUMIX_TEST(texture_streamer_tail) {
+	TextureStreamer::Item items[] = {
+		makeItem(4096, 4096, 0),
+		makeItem(1024, 512, 0),
+		makeItem(64, 64, 0),
+	};
+	u64 tail_size = 0;
+	for (const TextureStreamer::Item& item : items) tail_size += TextureStreamer::getSize(item, item.tail_mip);
+
+	// not even tails fit, they are never dropped
+	const u64 total = TextureStreamer::computeTargets(Span(items), 0, allocator);
+	LUMIX_EXPECT(total == tail_size);
+	for (const TextureStreamer::Item& item : items) LUMIX_EXPECT(item.target_mip == item.tail_mip);
+}
+
+LUMIX_TEST(texture_streamer_budget) {
+	Array<TextureStreamer::Item> items(allocator);
+	u64 tail_size = 0;
+	for (u32 i = 0; i < 500; ++i) {
+		const u32 size = 64 << rand(0, 6);
+		TextureStreamer::Item& item = items.emplace(makeItem(size, rand(0, 1) ? 0 : rand(1, 4096), rand(0, 6)));
+		item.resident_mip = minimum(item.resident_mip, item.tail_mip);
+		tail_size += TextureStreamer::getSize(item, item.tail_mip);
+	}
+
+	const u64 budgets[] = { 0, tail_size, tail_size + 1024 * 1024, 64 * 1024 * 1024, 256 * 1024 * 1024, 0xffFFffFFffFF };
+	for (u64 budget : budgets) {
+		Array<TextureStreamer::Item> tmp(allocator);
+		for (const TextureStreamer::Item& item : items) tmp.push(item);
+		const u64 total = TextureStreamer::computeTargets(tmp, budget, allocator);
+		LUMIX_EXPECT(total == getTargetsSize(tmp));
+		LUMIX_EXPECT(total <= maximum(budget, tail_size));
+		for (const TextureStreamer::Item& item : tmp) {
+			LUMIX_EXPECT(item.target_mip <= item.tail_mip);
+			// mips which are neither resident nor wanted are never streamed in
+			LUMIX_EXPECT(item.target_mip >= minimum(item.resident_mip, item.wanted_mip));
+		}
+	}
+}